@@ -0,0 +1,80 @@
+#include "Benchmark.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+using namespace dae::Benchmark;
+
+void Suite::BeginSection(const std::string& title)
+{
+	m_Section = title;
+	m_IsSectionPrinted = false;
+}
+
+void Suite::Print(const Result& result)
+{
+	// Sections whose benchmarks are all filtered out stay quiet
+	if (!m_IsSectionPrinted)
+	{
+		std::cout << std::endl << m_Section << std::endl;
+		m_IsSectionPrinted = true;
+	}
+
+	std::cout << "  " << std::left << std::setw(56) << result.name.substr(result.name.find('/') + 1) << std::right << std::fixed
+		<< std::setw(12) << std::setprecision(3) << result.nanosecondsPerOp << " ns/op"
+		<< std::setw(16) << std::setprecision(0) << result.opsPerSecond << " ops/s" << std::endl;
+}
+
+bool Suite::Save(const std::string& path) const
+{
+	std::ofstream file{ path };
+	if (!file)
+		return false;
+
+	// One "<ns/op> <name>" per line, the name last since it contains spaces
+	file << std::setprecision(9);
+	for (const Result& result : m_Results)
+		file << result.nanosecondsPerOp << ' ' << result.name << '\n';
+
+	return static_cast<bool>(file);
+}
+
+bool Suite::Compare(const std::string& baselinePath, double tolerance) const
+{
+	std::ifstream file{ baselinePath };
+	if (!file)
+	{
+		std::cout << "Could not read baseline " << baselinePath << std::endl;
+		return false;
+	}
+
+	std::unordered_map<std::string, double> baseline{};
+	double nanosecondsPerOp{};
+	std::string name{};
+	while (file >> nanosecondsPerOp && std::getline(file >> std::ws, name))
+		baseline[name] = nanosecondsPerOp;
+
+	std::cout << std::endl << "Compared to " << baselinePath << std::endl;
+	bool hasRegressed{ false };
+	for (const Result& result : m_Results)
+	{
+		const auto it{ baseline.find(result.name) };
+		if (it == baseline.end())
+			continue;
+
+		const double change{ result.nanosecondsPerOp / it->second - 1.0 };
+		if (change > tolerance)
+		{
+			std::cout << "  REGRESSED " << result.name << " " << std::setprecision(1) << change * 100.0 << "% slower" << std::endl;
+			hasRegressed = true;
+		}
+		else if (change < -tolerance)
+			std::cout << "  improved  " << result.name << " " << std::setprecision(1) << -change * 100.0 << "% faster" << std::endl;
+	}
+
+	if (!hasRegressed)
+		std::cout << "  No regressions beyond " << std::setprecision(0) << tolerance * 100.0 << "%" << std::endl;
+	return !hasRegressed;
+}
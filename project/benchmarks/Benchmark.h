@@ -0,0 +1,97 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "SDL_timer.h"
+
+namespace dae
+{
+	namespace Benchmark
+	{
+		// Results written here can not be optimized away, so neither can the work producing them
+		inline volatile float g_Sink{};
+
+		template<typename T>
+		void Consume(const T& value)
+		{
+			g_Sink = g_Sink + static_cast<float>(value);
+		}
+
+		struct Result
+		{
+			std::string name{};
+			double nanosecondsPerOp{};
+			double opsPerSecond{};
+		};
+
+		/**
+		 * \brief Times benchmarks, prints their ns/op and ops/s and keeps the results to save or compare against a saved baseline.
+		 * Every benchmark is called until one repetition takes long enough to time reliably,
+		 * the fastest of several repetitions is reported since anything slower was disturbed by something else.
+		 */
+		class Suite final
+		{
+		public:
+			explicit Suite(const std::string& filter = {}) : m_Filter(filter) {}
+			~Suite() = default;
+
+			Suite(const Suite&) = delete;
+			Suite(Suite&&) noexcept = delete;
+			Suite& operator=(const Suite&) = delete;
+			Suite& operator=(Suite&&) noexcept = delete;
+
+			void BeginSection(const std::string& title);
+
+			// function performs opsPerCall operations per call, returns nothing when the filter skips it
+			template<typename Function>
+			std::optional<Result> Run(const std::string& name, uint64_t opsPerCall, Function&& function)
+			{
+				const std::string fullName{ m_Section + "/" + name };
+				if (!m_Filter.empty() && fullName.find(m_Filter) == std::string::npos)
+					return {};
+
+				const double frequency{ static_cast<double>(SDL_GetPerformanceFrequency()) };
+				const auto timeCalls = [&](uint64_t numCalls)
+					{
+						const uint64_t start{ SDL_GetPerformanceCounter() };
+						for (uint64_t call{}; call < numCalls; ++call)
+							function();
+						return (SDL_GetPerformanceCounter() - start) / frequency;
+					};
+
+				uint64_t numCalls{ 1 };
+				while (timeCalls(numCalls) < m_MinRepetitionTime)
+					numCalls *= 2;
+
+				double bestTime{ timeCalls(numCalls) };
+				for (int repetition{ 1 }; repetition < m_NumRepetitions; ++repetition)
+					bestTime = std::min(bestTime, timeCalls(numCalls));
+
+				const double numOps{ static_cast<double>(numCalls * opsPerCall) };
+				m_Results.push_back({ fullName, bestTime * 1e9 / numOps, numOps / bestTime });
+				Print(m_Results.back());
+				return m_Results.back();
+			}
+
+			const std::vector<Result>& GetResults() const { return m_Results; }
+
+			bool Save(const std::string& path) const;
+			// Prints every benchmark that got more than tolerance (0.1 is 10%) slower than in the baseline, returns false if any did
+			bool Compare(const std::string& baselinePath, double tolerance) const;
+
+		private:
+			static constexpr double m_MinRepetitionTime{ 0.05 };
+			static constexpr int m_NumRepetitions{ 5 };
+
+			void Print(const Result& result);
+
+			std::string m_Filter{};
+			std::string m_Section{};
+			bool m_IsSectionPrinted{};
+			std::vector<Result> m_Results{};
+		};
+	}
+}
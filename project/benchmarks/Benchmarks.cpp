@@ -0,0 +1,497 @@
+#include "Benchmark.h"
+#include "../src/BRDFs.h"
+#include "../src/Kernels.h"
+#include "../src/Scene.h"
+#include "../src/UniformGrid.h"
+#include "../src/Utils.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace dae;
+
+namespace
+{
+	constexpr uint32_t g_Seed{ 1234 };
+	constexpr int g_NumInputs{ 1024 }; // Per call, small enough to stay in the L1 cache so the kernels are measured and not the memory
+
+	// Fixed seed inputs, every run times the exact same work
+	class InputGenerator final
+	{
+	public:
+		float Next(float min = -1.f, float max = 1.f) { return std::uniform_real_distribution<float>{ min, max }(m_Generator); }
+		Vector3 NextVector() { return { Next(), Next(), Next() }; }
+		Vector3 NextDirection() { return Vector3{ Next(), Next(), Next() + 1.5f }.Normalized(); }
+
+		std::vector<Vector3> NextVectors(int count)
+		{
+			std::vector<Vector3> vectors(count);
+			for (Vector3& vector : vectors)
+				vector = NextVector();
+			return vectors;
+		}
+
+		std::vector<Vector3> NextDirections(int count)
+		{
+			std::vector<Vector3> directions(count);
+			for (Vector3& direction : directions)
+				direction = NextDirection();
+			return directions;
+		}
+
+	private:
+		std::mt19937 m_Generator{ g_Seed };
+	};
+
+	// Spheres spread in front of the camera between five walls
+	class Scene_Benchmark final : public Scene
+	{
+	public:
+		explicit Scene_Benchmark(int numSpheres) : m_NumSpheres(numSpheres) {}
+
+		void Initialize() override
+		{
+			InputGenerator inputs{};
+			for (int i{}; i < m_NumSpheres; ++i)
+				AddSphere({ inputs.Next(-4.f, 4.f), inputs.Next(.5f, 9.5f), inputs.Next(2.f, 9.f) }, inputs.Next(.1f, .5f));
+
+			AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f });
+			AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f });
+			AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+			AddPlane({ 0.f, 10.f, 0.f }, { 0.f, -1.f, 0.f });
+			AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f });
+		}
+
+	private:
+		int m_NumSpheres{};
+	};
+
+#pragma region Math
+	void RunMathBenchmarks(Benchmark::Suite& suite)
+	{
+		InputGenerator inputs{};
+		const std::vector<Vector3> a{ inputs.NextVectors(g_NumInputs) };
+		const std::vector<Vector3> b{ inputs.NextVectors(g_NumInputs) };
+		const std::vector<Vector3> normals{ inputs.NextDirections(g_NumInputs) };
+		const Matrix matrix{ Matrix::CreateRotation(.3f, .7f, .1f) * Matrix::CreateTranslation(1.f, 2.f, 3.f) };
+
+		const auto overInputs = [&](auto kernel)
+			{
+				return [&, kernel]()
+					{
+						for (int i{}; i < g_NumInputs; ++i)
+							kernel(i);
+					};
+			};
+
+		suite.BeginSection("Math");
+		suite.Run("Vector3::Dot", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(Vector3::Dot(a[i], b[i])); }));
+		suite.Run("Vector3::Cross", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(Vector3::Cross(a[i], b[i]).x); }));
+		suite.Run("Vector3::Normalized", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(a[i].Normalized().x); }));
+		suite.Run("Vector3::Magnitude", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(a[i].Magnitude()); }));
+		suite.Run("Vector3::Reflect", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(Vector3::Reflect(a[i], normals[i]).x); }));
+		suite.Run("Matrix::TransformVector", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(matrix.TransformVector(a[i]).x); }));
+		suite.Run("Matrix::TransformPoint", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(matrix.TransformPoint(a[i]).x); }));
+		suite.Run("Matrix::operator*", g_NumInputs, overInputs([&](int i)
+			{
+				Benchmark::Consume((matrix * Matrix::CreateTranslation(a[i]))[3].x);
+			}));
+		suite.Run("Matrix::CreateRotation", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(Matrix::CreateRotation(a[i])[0].x); }));
+	}
+#pragma endregion
+
+#pragma region Intersection
+	// The quadratic formula Intersect_Sphere used before, kept to measure against
+	bool Intersect_SphereQuadratic(const Sphere& sphere, const Ray& ray, float& t)
+	{
+		const Vector3 sphereToRay{ ray.origin - sphere.origin };
+
+		const float A{ Vector3::Dot(ray.direction,ray.direction) };
+		const float B{ 2 * Vector3::Dot(ray.direction, sphereToRay) };
+		const float C{ Vector3::Dot(sphereToRay, sphereToRay) - (sphere.radius * sphere.radius) };
+
+		const float discriminant{ (B * B) - (4 * A * C) };
+		if (discriminant <= 0)
+			return false;
+
+		const float sqrtDiscriminant{ std::sqrt(discriminant) };
+		float hitT{ (-B - sqrtDiscriminant) / (2 * A) };
+		if (hitT < ray.min)
+			hitT = (-B + sqrtDiscriminant) / (2 * A);
+
+		if (!(hitT >= ray.min && hitT <= ray.max))
+			return false;
+
+		t = hitT;
+		return true;
+	}
+
+	template<int Width>
+	std::vector<SpherePacket<Width>> MakePackets(const std::vector<Sphere>& spheres)
+	{
+		std::vector<SpherePacket<Width>> packets((spheres.size() + Width - 1) / Width);
+		for (size_t index{}; index < spheres.size(); ++index)
+			packets[index / Width].Set(static_cast<int>(index % Width), spheres[index]);
+		return packets;
+	}
+
+	// Closest hit of every ray against every primitive, about a third of the rays hit a sphere
+	void RunIntersectionBenchmarks(Benchmark::Suite& suite)
+	{
+		constexpr int numSpheres{ 64 };
+		constexpr int numRays{ g_NumInputs };
+		constexpr uint64_t numTests{ numRays * numSpheres };
+
+		InputGenerator inputs{};
+		std::vector<Sphere> spheres(numSpheres);
+		for (Sphere& sphere : spheres)
+		{
+			sphere.origin = { inputs.Next() * 10.f, inputs.Next() * 10.f, 20.f + inputs.Next() * 10.f };
+			sphere.radius = .5f + inputs.Next() * .3f;
+		}
+
+		std::vector<Plane> planes(numSpheres);
+		for (Plane& plane : planes)
+		{
+			plane.origin = { inputs.Next() * 10.f, inputs.Next() * 10.f, 20.f + inputs.Next() * 10.f };
+			plane.normal = -inputs.NextDirection();
+		}
+
+		std::vector<Ray> rays(numRays);
+		for (Ray& ray : rays)
+		{
+			ray.origin = { inputs.Next(), inputs.Next(), 0.f };
+			ray.direction = Vector3{ inputs.Next() * .4f, inputs.Next() * .4f, 1.f }.Normalized();
+		}
+
+		const auto closestHits = [&](const auto& primitives, auto intersect)
+			{
+				return [&, intersect]()
+					{
+						for (const Ray& ray : rays)
+						{
+							float closestT{ FLT_MAX };
+							for (const auto& primitive : primitives)
+							{
+								float t{};
+								if (intersect(primitive, ray, t) && t < closestT)
+									closestT = t;
+							}
+							Benchmark::Consume(closestT);
+						}
+					};
+			};
+
+		const auto closestPacketHits = [&](const auto& packets)
+			{
+				return [&]()
+					{
+						for (const Ray& ray : rays)
+						{
+							float closestT{ FLT_MAX };
+							for (const auto& packet : packets)
+								GeometryUtils::Intersect_SpherePacket(packet, ray, closestT);
+							Benchmark::Consume(closestT);
+						}
+					};
+			};
+
+		const std::vector<SpherePacket<4>> packets4{ MakePackets<4>(spheres) };
+		const std::vector<SpherePacket<8>> packets8{ MakePackets<8>(spheres) };
+
+		suite.BeginSection("Intersection");
+		const std::optional<Benchmark::Result> quadratic{ suite.Run("Sphere, quadratic formula (previous)", numTests, closestHits(spheres,
+			[](const Sphere& sphere, const Ray& ray, float& t) { return Intersect_SphereQuadratic(sphere, ray, t); })) };
+		suite.Run("GeometryUtils::Intersect_Sphere", numTests, closestHits(spheres,
+			[](const Sphere& sphere, const Ray& ray, float& t) { return GeometryUtils::Intersect_Sphere(sphere, ray, t); }));
+		const std::optional<Benchmark::Result> packet4{ suite.Run("GeometryUtils::Intersect_SpherePacket<4>", numTests, closestPacketHits(packets4)) };
+		std::optional<Benchmark::Result> packet8{};
+		if (DetectInstructionSet() >= InstructionSet::AVX2)
+			packet8 = suite.Run("GeometryUtils::Intersect_SpherePacket<8>", numTests, closestPacketHits(packets8));
+		suite.Run("GeometryUtils::HitTest_Sphere with HitRecord", numTests, closestHits(spheres, [](const Sphere& sphere, const Ray& ray, float& t)
+			{
+				HitRecord hitRecord{};
+				if (!GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord))
+					return false;
+				t = hitRecord.t;
+				return true;
+			}));
+		suite.Run("GeometryUtils::Intersect_Plane", numTests, closestHits(planes,
+			[](const Plane& plane, const Ray& ray, float& t) { return GeometryUtils::Intersect_Plane(plane, ray, t); }));
+		suite.Run("GeometryUtils::HitTest_Plane with HitRecord", numTests, closestHits(planes, [](const Plane& plane, const Ray& ray, float& t)
+			{
+				HitRecord hitRecord{};
+				if (!GeometryUtils::HitTest_Plane(plane, ray, hitRecord))
+					return false;
+				t = hitRecord.t;
+				return true;
+			}));
+
+		if (quadratic && packet4 && packet8)
+			std::cout << "  Sphere speedup over the quadratic formula: 4-wide " << std::setprecision(2) << quadratic->nanosecondsPerOp / packet4->nanosecondsPerOp
+				<< "x, 8-wide " << quadratic->nanosecondsPerOp / packet8->nanosecondsPerOp << "x" << std::endl;
+	}
+#pragma endregion
+
+#pragma region Kernels
+	// Every variant of the dispatched kernels this CPU can run, on the same inputs
+	void RunKernelBenchmarks(Benchmark::Suite& suite)
+	{
+		constexpr int numSpheres{ 64 };
+		constexpr int numRays{ g_NumInputs };
+		constexpr uint32_t numLights{ 3 };
+
+		InputGenerator inputs{};
+		std::vector<Sphere> spheres(numSpheres);
+		for (Sphere& sphere : spheres)
+		{
+			sphere.origin = { inputs.Next() * 10.f, inputs.Next() * 10.f, 20.f + inputs.Next() * 10.f };
+			sphere.radius = .5f + inputs.Next() * .3f;
+		}
+		const std::vector<SpherePacket<8>> packets{ MakePackets<8>(spheres) };
+
+		std::vector<Ray> rays(numRays);
+		for (Ray& ray : rays)
+		{
+			ray.origin = { inputs.Next(), inputs.Next(), 0.f };
+			ray.direction = Vector3{ inputs.Next() * .4f, inputs.Next() * .4f, 1.f }.Normalized();
+		}
+
+		// The same directions as a row of camera rays from the origin, for the rasterizer
+		std::vector<float> directions[3]{};
+		for (const Ray& ray : rays)
+		{
+			directions[0].push_back(ray.direction.x);
+			directions[1].push_back(ray.direction.y);
+			directions[2].push_back(ray.direction.z);
+		}
+		std::vector<float> depths(numRays, FLT_MAX);
+		std::vector<uint32_t> primitives(numRays);
+		const VisibilitySpan span{ {}, Ray{}.min, { directions[0].data(), directions[1].data(), directions[2].data() }, depths.data(), primitives.data(), numRays };
+
+		std::vector<ColorRGB> colors(numRays);
+		for (ColorRGB& color : colors)
+			color = { inputs.Next(0.f, 2.f), inputs.Next(0.f, 2.f), inputs.Next(0.f, 2.f) };
+		std::vector<uint32_t> pixels(numRays);
+
+		std::vector<float> contributions[3]{}, throughputs[3]{}, radiances[3]{};
+		std::vector<float> shadowFactors(numRays * numLights);
+		for (int channel{}; channel < 3; ++channel)
+		{
+			contributions[channel].resize(numRays * numLights);
+			for (float& contribution : contributions[channel])
+				contribution = inputs.Next(0.f, 1.f);
+			throughputs[channel].resize(numRays);
+			for (float& throughput : throughputs[channel])
+				throughput = inputs.Next(0.f, 1.f);
+			radiances[channel].resize(numRays);
+		}
+		for (float& shadowFactor : shadowFactors)
+			shadowFactor = inputs.Next() > 0.f ? .5f : 1.f;
+		const RadianceStreams streams{ { contributions[0].data(), contributions[1].data(), contributions[2].data() }, shadowFactors.data(), numLights,
+			{ throughputs[0].data(), throughputs[1].data(), throughputs[2].data() }, { radiances[0].data(), radiances[1].data(), radiances[2].data() } };
+
+		suite.BeginSection("Kernels");
+		for (int index{}; index <= static_cast<int>(DetectInstructionSet()); ++index)
+		{
+			const KernelTable& kernels{ GetKernels(static_cast<InstructionSet>(index)) };
+			const std::string name{ ToString(kernels.instructionSet) };
+
+			suite.Run("intersectSpheres, " + name, numRays * numSpheres, [&]()
+				{
+					for (const Ray& ray : rays)
+					{
+						float t{ FLT_MAX };
+						Benchmark::Consume(kernels.intersectSpheres(packets.data(), static_cast<uint32_t>(packets.size()), ray, t));
+					}
+				});
+			suite.Run("rasterizeSphere, " + name, numRays * numSpheres, [&]()
+				{
+					for (uint32_t sphere{}; sphere < numSpheres; ++sphere)
+						kernels.rasterizeSphere(spheres[sphere], sphere, span);
+					Benchmark::Consume(primitives[numRays - 1]);
+				});
+			suite.Run("resolveRadiance per ray, " + name, numRays, [&]()
+				{
+					kernels.resolveRadiance(streams, 0, numRays);
+					Benchmark::Consume(radiances[0][numRays - 1]);
+				});
+			suite.Run("tonemap per pixel, " + name, numRays, [&]()
+				{
+					kernels.tonemap(colors.data(), .5f, pixels.data(), numRays, {});
+					Benchmark::Consume(pixels[numRays - 1]);
+				});
+		}
+	}
+#pragma endregion
+
+#pragma region Scene
+	// Camera rays through the scene, ns per ray
+	void RunSceneBenchmarks(Benchmark::Suite& suite)
+	{
+		InputGenerator inputs{};
+		std::vector<Ray> rays(g_NumInputs);
+		for (Ray& ray : rays)
+		{
+			ray.origin = { 0.f, 5.f, -5.f };
+			ray.direction = Vector3{ inputs.Next() * .5f, inputs.Next() * .5f, 1.f }.Normalized();
+		}
+
+		suite.BeginSection("Scene");
+		for (const int numSpheres : { 8, 64, 512, 4096 })
+		{
+			Scene_Benchmark scene{ numSpheres };
+			scene.Initialize();
+
+			const std::string spheres{ std::to_string(numSpheres) + " spheres" };
+			suite.Run("Scene::GetClosestHit, " + spheres, g_NumInputs, [&]()
+				{
+					for (const Ray& ray : rays)
+					{
+						HitRecord hitRecord{};
+						scene.GetClosestHit(ray, hitRecord);
+						Benchmark::Consume(hitRecord.t);
+					}
+				});
+			suite.Run("Scene::DoesHit, " + spheres, g_NumInputs, [&]()
+				{
+					for (const Ray& ray : rays)
+						Benchmark::Consume(scene.DoesHit(ray));
+				});
+		}
+	}
+#pragma endregion
+
+#pragma region BVH
+	// Both tree builders and the grid over the bounds of random spheres at the density of the scenes above, ns per sphere
+	void RunBVHBenchmarks(Benchmark::Suite& suite)
+	{
+		suite.BeginSection("BVH");
+		for (const int numSpheres : { 4096, 100000 })
+		{
+			InputGenerator inputs{};
+			const float side{ std::cbrt(static_cast<float>(numSpheres)) };
+			std::vector<AABB> bounds(numSpheres);
+			for (AABB& sphereBounds : bounds)
+				sphereBounds = AABB::FromSphere({ { inputs.Next(0.f, side), inputs.Next(0.f, side), inputs.Next(0.f, side) }, inputs.Next(.1f, .5f) });
+
+			WideBVH bvh{};
+			const std::string spheres{ std::to_string(numSpheres) + " spheres" };
+			suite.Run("WideBVH::Build, binned SAH, " + spheres, numSpheres, [&]()
+				{
+					bvh.Build(bounds, BVHBuilder::BinnedSAH);
+					Benchmark::Consume(bvh.GetNodes().size());
+				});
+			suite.Run("WideBVH::Build, linear, " + spheres, numSpheres, [&]()
+				{
+					bvh.Build(bounds, BVHBuilder::Linear);
+					Benchmark::Consume(bvh.GetNodes().size());
+				});
+
+			UniformGrid grid{};
+			suite.Run("UniformGrid::IsUniform, " + spheres, numSpheres, [&]() { Benchmark::Consume(UniformGrid::IsUniform(bounds)); });
+			suite.Run("UniformGrid::Build, " + spheres, numSpheres, [&]()
+				{
+					grid.Build(bounds);
+					Benchmark::Consume(grid.GetPrimitiveIndices().size());
+				});
+		}
+
+		// Every sphere changed, like an animated scene does every frame. These spheres spread evenly enough to be put in a grid
+		Scene_Benchmark scene{ 4096 };
+		scene.Initialize();
+		suite.Run("Scene::MarkDirty, every sphere of 4096", 4096, [&]() { scene.MarkDirty(SceneComponent::Spheres); });
+	}
+#pragma endregion
+
+#pragma region BRDF
+	void RunBRDFBenchmarks(Benchmark::Suite& suite)
+	{
+		InputGenerator inputs{};
+		const std::vector<Vector3> normals{ inputs.NextDirections(g_NumInputs) };
+		const std::vector<Vector3> lights{ inputs.NextDirections(g_NumInputs) };
+		const std::vector<Vector3> views{ inputs.NextDirections(g_NumInputs) };
+		std::vector<Vector3> halfVectors(g_NumInputs);
+		for (int i{}; i < g_NumInputs; ++i)
+			halfVectors[i] = (lights[i] + views[i]).Normalized();
+
+		const ColorRGB color{ .972f, .960f, .915f };
+		const auto overInputs = [&](auto kernel)
+			{
+				return [&, kernel]()
+					{
+						for (int i{}; i < g_NumInputs; ++i)
+							kernel(i);
+					};
+			};
+
+		suite.BeginSection("BRDF");
+		suite.Run("BRDF::Lambert(float)", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(BRDF::Lambert(normals[i].x, color).r); }));
+		suite.Run("BRDF::Lambert(ColorRGB)", g_NumInputs, overInputs([&](int i)
+			{
+				Benchmark::Consume(BRDF::Lambert(ColorRGB{ normals[i].x, normals[i].y, normals[i].z }, color).r);
+			}));
+		suite.Run("BRDF::Phong", g_NumInputs, overInputs([&](int i) { Benchmark::Consume(BRDF::Phong(.5f, 15.f, lights[i], views[i], normals[i]).r); }));
+		suite.Run("BRDF::FresnelFunction_Schlick", g_NumInputs, overInputs([&](int i)
+			{
+				Benchmark::Consume(BRDF::FresnelFunction_Schlick(halfVectors[i], views[i], color).r);
+			}));
+		suite.Run("BRDF::NormalDistribution_GGX", g_NumInputs, overInputs([&](int i)
+			{
+				Benchmark::Consume(BRDF::NormalDistribution_GGX(normals[i], halfVectors[i], .6f));
+			}));
+		suite.Run("BRDF::GeometryFunction_SchlickGGX", g_NumInputs, overInputs([&](int i)
+			{
+				Benchmark::Consume(BRDF::GeometryFunction_SchlickGGX(normals[i], views[i], .6f));
+			}));
+		suite.Run("BRDF::GeometryFunction_Smith", g_NumInputs, overInputs([&](int i)
+			{
+				Benchmark::Consume(BRDF::GeometryFunction_Smith(normals[i], views[i], lights[i], .6f));
+			}));
+	}
+#pragma endregion
+
+	// Returns the value following option on the command line, or an empty string
+	std::string GetOptionValue(int argc, char* args[], const std::string& option)
+	{
+		for (int i{ 1 }; i + 1 < argc; ++i)
+		{
+			if (option == args[i])
+				return args[i + 1];
+		}
+		return {};
+	}
+}
+
+// Benchmarks [--filter <text>] [--save <file>] [--compare <file>] [--tolerance <percent>]
+// --compare exits with 1 when a benchmark got slower than in the saved baseline by more than the tolerance (10% by default)
+int main(int argc, char* args[])
+{
+	Benchmark::Suite suite{ GetOptionValue(argc, args, "--filter") };
+
+	RunMathBenchmarks(suite);
+	RunIntersectionBenchmarks(suite);
+	RunKernelBenchmarks(suite);
+	RunSceneBenchmarks(suite);
+	RunBVHBenchmarks(suite);
+	RunBRDFBenchmarks(suite);
+
+	const std::string savePath{ GetOptionValue(argc, args, "--save") };
+	if (!savePath.empty() && !suite.Save(savePath))
+		std::cout << "Could not save the results to " << savePath << std::endl;
+
+	const std::string baselinePath{ GetOptionValue(argc, args, "--compare") };
+	if (!baselinePath.empty())
+	{
+		const std::string tolerance{ GetOptionValue(argc, args, "--tolerance") };
+		if (!suite.Compare(baselinePath, tolerance.empty() ? .1 : std::stod(tolerance) / 100.0))
+			return 1;
+	}
+
+	return 0;
+}
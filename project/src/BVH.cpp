@@ -0,0 +1,478 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <bit>
+#include <execution>
+#include <numeric>
+
+using namespace dae;
+
+namespace
+{
+	// Ranges longer than this are split into chunks of it that are processed in parallel
+	constexpr uint32_t g_ChunkSize{ 16384 };
+	constexpr int g_NumBins{ 16 };
+	constexpr int g_RadixBits{ 8 };
+	constexpr uint32_t g_NumRadixBuckets{ 1u << g_RadixBits };
+	constexpr int g_MortonBits{ 30 }; // 10 per axis
+
+	// Plain floats instead of an AABB, whose Vector3 members are constructed out of line, bins are reset for every split
+	struct Bin
+	{
+		float min[3]{ FLT_MAX, FLT_MAX, FLT_MAX };
+		float max[3]{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t count{};
+
+		void Add(const AABB& bounds)
+		{
+			Grow(bounds.min.x, bounds.min.y, bounds.min.z, bounds.max.x, bounds.max.y, bounds.max.z);
+			++count;
+		}
+
+		void Add(const Bin& bin)
+		{
+			Grow(bin.min[0], bin.min[1], bin.min[2], bin.max[0], bin.max[1], bin.max[2]);
+			count += bin.count;
+		}
+
+		// From values like AABB::Grow
+		void Grow(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+		{
+			const float oldMin[3]{ min[0], min[1], min[2] };
+			const float oldMax[3]{ max[0], max[1], max[2] };
+			min[0] = std::min(oldMin[0], minX);
+			min[1] = std::min(oldMin[1], minY);
+			min[2] = std::min(oldMin[2], minZ);
+			max[0] = std::max(oldMax[0], maxX);
+			max[1] = std::max(oldMax[1], maxY);
+			max[2] = std::max(oldMax[2], maxZ);
+		}
+
+		float GetSurfaceArea() const
+		{
+			const float x{ max[0] - min[0] }, y{ max[1] - min[1] }, z{ max[2] - min[2] };
+			return 2.f * (x * y + y * z + z * x);
+		}
+
+		AABB GetBounds() const { return { { min[0], min[1], min[2] }, { max[0], max[1], max[2] } }; }
+	};
+
+	struct SAHBins
+	{
+		Bin axes[3][g_NumBins]{};
+	};
+
+	uint32_t GetNumChunks(uint32_t count)
+	{
+		return std::max(1u, (count + g_ChunkSize - 1) / g_ChunkSize);
+	}
+
+	// Calls function(chunk, first, count) for every chunk of [first, first + count), in parallel when there is more than one
+	template<typename Function>
+	void ForEachChunk(uint32_t first, uint32_t count, Function function)
+	{
+		const uint32_t numChunks{ GetNumChunks(count) };
+		if (numChunks == 1)
+		{
+			function(0u, first, count);
+			return;
+		}
+
+		std::vector<uint32_t> chunks(numChunks);
+		std::iota(chunks.begin(), chunks.end(), 0u);
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](uint32_t chunk)
+			{
+				const uint32_t chunkFirst{ first + chunk * g_ChunkSize };
+				function(chunk, chunkFirst, std::min(g_ChunkSize, first + count - chunkFirst));
+			});
+	}
+
+	// function(first, count) of every chunk, merged in chunk order. Small ranges run inline without allocating
+	template<typename Result, typename Function, typename Merge>
+	Result ReduceChunks(uint32_t first, uint32_t count, Function function, Merge merge)
+	{
+		const uint32_t numChunks{ GetNumChunks(count) };
+		if (numChunks == 1)
+			return function(first, count);
+
+		std::vector<Result> results(numChunks);
+		ForEachChunk(first, count, [&](uint32_t chunk, uint32_t chunkFirst, uint32_t chunkCount) { results[chunk] = function(chunkFirst, chunkCount); });
+		for (uint32_t chunk{ 1 }; chunk < numChunks; ++chunk)
+			merge(results[0], results[chunk]);
+		return results[0];
+	}
+
+	void MergeBounds(AABB& bounds, const AABB& other)
+	{
+		bounds.Grow(other);
+	}
+
+	// Halves rounded up to whole leaves, so every leaf but the last of a range is full
+	uint32_t GetMedianCount(uint32_t count)
+	{
+		return (count / 2 + WideBVH::maxLeafSize - 1) / WideBVH::maxLeafSize * WideBVH::maxLeafSize;
+	}
+
+	// Puts two zero bits in front of each of the lower 10 bits
+	uint32_t SpreadBits(uint32_t value)
+	{
+		value = (value | (value << 16)) & 0x030000ffu;
+		value = (value | (value << 8)) & 0x0300f00fu;
+		value = (value | (value << 4)) & 0x030c30c3u;
+		value = (value | (value << 2)) & 0x09249249u;
+		return value;
+	}
+}
+
+void WideBVH::Build(const std::vector<AABB>& primitiveBounds, BVHBuilder builder)
+{
+	const uint32_t numPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+	m_Nodes.clear();
+	m_Leaves.clear();
+	m_PrimitiveIndices.resize(numPrimitives);
+	std::iota(m_PrimitiveIndices.begin(), m_PrimitiveIndices.end(), 0);
+	if (numPrimitives == 0)
+		return;
+
+	BuildTask root{ 0, 0, { 0, numPrimitives } };
+	if (builder == BVHBuilder::Linear)
+	{
+		SortByMortonCode(primitiveBounds);
+	}
+	else
+	{
+		m_BuildPrimitives.resize(numPrimitives);
+		root.bounds = ReduceChunks<AABB>(0, numPrimitives, [&](uint32_t first, uint32_t count)
+			{
+				AABB bounds{};
+				for (uint32_t index{ first }; index < first + count; ++index)
+				{
+					m_BuildPrimitives[index] = { primitiveBounds[index], primitiveBounds[index].GetCenter(), index };
+					bounds.Grow(primitiveBounds[index]);
+				}
+				return bounds;
+			}, MergeBounds);
+	}
+
+	// A level at a time, its nodes cover disjoint ranges and are split in parallel
+	m_Nodes.emplace_back();
+	std::vector<BuildTask> tasks{ root };
+	std::vector<BuildTask> nextTasks{};
+	std::vector<NodeSplit> splits{};
+	std::vector<uint32_t> taskIndices{};
+	while (!tasks.empty())
+	{
+		splits.assign(tasks.size(), NodeSplit{});
+		taskIndices.resize(tasks.size());
+		std::iota(taskIndices.begin(), taskIndices.end(), 0u);
+		std::for_each(std::execution::par, taskIndices.begin(), taskIndices.end(), [&](uint32_t index)
+			{
+				SplitNode(tasks[index], builder, splits[index]);
+			});
+
+		// Allocated in task order, so the inner children of a node are next to each other and after it
+		nextTasks.clear();
+		for (size_t index{}; index < tasks.size(); ++index)
+		{
+			const NodeSplit& split{ splits[index] };
+			const uint32_t nodeIndex{ tasks[index].nodeIndex };
+			m_Nodes[nodeIndex].numChildren = split.numRanges;
+			for (uint32_t slot{}; slot < split.numRanges; ++slot)
+			{
+				const Leaf& range{ split.ranges[slot] };
+				if (range.count <= maxLeafSize)
+				{
+					m_Nodes[nodeIndex].children[slot] = ~static_cast<int32_t>(m_Leaves.size());
+					m_Leaves.push_back(range);
+				}
+				else
+				{
+					const uint32_t child{ static_cast<uint32_t>(m_Nodes.size()) };
+					m_Nodes[nodeIndex].children[slot] = static_cast<int32_t>(child);
+					m_Nodes.emplace_back();
+					nextTasks.push_back({ child, tasks[index].depth + 1, range, split.bounds[slot] });
+				}
+			}
+		}
+		std::swap(tasks, nextTasks);
+	}
+
+	if (builder == BVHBuilder::BinnedSAH)
+	{
+		ForEachChunk(0, numPrimitives, [&](uint32_t, uint32_t first, uint32_t count)
+			{
+				for (uint32_t index{ first }; index < first + count; ++index)
+					m_PrimitiveIndices[index] = m_BuildPrimitives[index].index;
+			});
+	}
+
+	// The boxes of the nodes are filled in bottom up
+	m_LeafBounds.resize(m_Leaves.size());
+	std::transform(std::execution::par, m_Leaves.begin(), m_Leaves.end(), m_LeafBounds.begin(), [&](const Leaf& leaf)
+		{
+			AABB bounds{};
+			for (uint32_t index{ leaf.first }; index < leaf.first + leaf.count; ++index)
+				bounds.Grow(primitiveBounds[m_PrimitiveIndices[index]]);
+			return bounds;
+		});
+	Refit(m_LeafBounds);
+}
+
+void WideBVH::Refit(const std::vector<AABB>& leafBounds)
+{
+	// Children come after their parent, walking backwards visits them first
+	for (size_t nodeIndex{ m_Nodes.size() }; nodeIndex-- > 0;)
+	{
+		BVHNode& node{ m_Nodes[nodeIndex] };
+		for (uint32_t slot{}; slot < node.numChildren; ++slot)
+		{
+			const int32_t child{ node.children[slot] };
+			node.SetBounds(static_cast<int>(slot), child < 0 ? leafBounds[~child] : m_Nodes[child].GetBounds());
+		}
+	}
+}
+
+void WideBVH::SortByMortonCode(const std::vector<AABB>& primitiveBounds)
+{
+	const uint32_t numPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+	const AABB centerBounds{ ReduceChunks<AABB>(0, numPrimitives, [&](uint32_t first, uint32_t count)
+		{
+			AABB bounds{};
+			for (uint32_t index{ first }; index < first + count; ++index)
+				bounds.Grow(primitiveBounds[index].GetCenter());
+			return bounds;
+		}, MergeBounds) };
+
+	// Centers quantized to 1024 steps per axis, their bits interleaved. Clamped like the SAH bins
+	const Vector3 extent{ centerBounds.max - centerBounds.min };
+	const float scaleX{ extent.x > 0.f ? 1023.f / extent.x : 0.f };
+	const float scaleY{ extent.y > 0.f ? 1023.f / extent.y : 0.f };
+	const float scaleZ{ extent.z > 0.f ? 1023.f / extent.z : 0.f };
+	m_MortonCodes.resize(numPrimitives);
+	ForEachChunk(0, numPrimitives, [&](uint32_t, uint32_t first, uint32_t count)
+		{
+			for (uint32_t index{ first }; index < first + count; ++index)
+			{
+				const Vector3 center{ primitiveBounds[index].GetCenter() };
+				const auto quantize = [](float value) { return static_cast<uint32_t>(std::min(std::max(0.f, value), 1023.f)); };
+				const uint32_t x{ quantize((center.x - centerBounds.min.x) * scaleX) };
+				const uint32_t y{ quantize((center.y - centerBounds.min.y) * scaleY) };
+				const uint32_t z{ quantize((center.z - centerBounds.min.z) * scaleZ) };
+				m_MortonCodes[index] = SpreadBits(x) << 2 | SpreadBits(y) << 1 | SpreadBits(z);
+			}
+		});
+
+	// Least significant digit first radix sort of the codes along with the primitive indices.
+	// Every chunk counts its digits, then scatters them to where the earlier chunks' same digits end, which keeps the sort stable
+	m_SortedCodes.resize(numPrimitives);
+	m_SortedIndices.resize(numPrimitives);
+	std::vector<uint32_t> offsets(GetNumChunks(numPrimitives) * g_NumRadixBuckets);
+	for (int shift{}; shift < g_MortonBits; shift += g_RadixBits)
+	{
+		ForEachChunk(0, numPrimitives, [&](uint32_t chunk, uint32_t first, uint32_t count)
+			{
+				uint32_t* pCounts{ offsets.data() + chunk * g_NumRadixBuckets };
+				std::fill(pCounts, pCounts + g_NumRadixBuckets, 0u);
+				for (uint32_t index{ first }; index < first + count; ++index)
+					++pCounts[(m_MortonCodes[index] >> shift) & (g_NumRadixBuckets - 1)];
+			});
+
+		uint32_t offset{};
+		for (uint32_t bucket{}; bucket < g_NumRadixBuckets; ++bucket)
+		{
+			for (size_t chunkOffset{ bucket }; chunkOffset < offsets.size(); chunkOffset += g_NumRadixBuckets)
+			{
+				const uint32_t count{ offsets[chunkOffset] };
+				offsets[chunkOffset] = offset;
+				offset += count;
+			}
+		}
+
+		ForEachChunk(0, numPrimitives, [&](uint32_t chunk, uint32_t first, uint32_t count)
+			{
+				uint32_t* pOffsets{ offsets.data() + chunk * g_NumRadixBuckets };
+				for (uint32_t index{ first }; index < first + count; ++index)
+				{
+					const uint32_t destination{ pOffsets[(m_MortonCodes[index] >> shift) & (g_NumRadixBuckets - 1)]++ };
+					m_SortedCodes[destination] = m_MortonCodes[index];
+					m_SortedIndices[destination] = m_PrimitiveIndices[index];
+				}
+			});
+		m_MortonCodes.swap(m_SortedCodes);
+		m_PrimitiveIndices.swap(m_SortedIndices);
+	}
+}
+
+void WideBVH::SplitNode(const BuildTask& task, BVHBuilder builder, NodeSplit& split)
+{
+	// Nodes below maxDepth of a lopsided tree are halved by count, at most log8 of the primitives more levels
+	const bool isMedian{ task.depth >= maxDepth };
+	const bool isSAH{ builder == BVHBuilder::BinnedSAH && !isMedian };
+
+	split.ranges[0] = task.range;
+	split.bounds[0] = task.bounds;
+	split.numRanges = 1;
+	while (split.numRanges < BVHNode::width)
+	{
+		// The child that is the most expensive to traverse is split next: the largest surface for SAH, the most primitives otherwise
+		uint32_t largest{ UINT32_MAX };
+		float largestCost{};
+		for (uint32_t slot{}; slot < split.numRanges; ++slot)
+		{
+			if (split.ranges[slot].count <= maxLeafSize)
+				continue;
+
+			const float cost{ isSAH ? split.bounds[slot].GetSurfaceArea() : static_cast<float>(split.ranges[slot].count) };
+			if (largest == UINT32_MAX || cost > largestCost)
+			{
+				largest = slot;
+				largestCost = cost;
+			}
+		}
+		if (largest == UINT32_MAX)
+			break;
+
+		const Leaf range{ split.ranges[largest] };
+		AABB firstBounds{}, secondBounds{};
+		uint32_t firstCount{};
+		if (builder == BVHBuilder::Linear)
+			firstCount = isMedian ? GetMedianCount(range.count) : SplitAtMortonBit(range);
+		else if (isMedian)
+			firstCount = SplitAtMedian(range);
+		else
+			firstCount = SplitBySAH(range, firstBounds, secondBounds);
+
+		split.ranges[largest] = { range.first, firstCount };
+		split.bounds[largest] = firstBounds;
+		split.ranges[split.numRanges] = { range.first + firstCount, range.count - firstCount };
+		split.bounds[split.numRanges++] = secondBounds;
+	}
+}
+
+uint32_t WideBVH::SplitAtMedian(const Leaf& range)
+{
+	const auto begin{ m_BuildPrimitives.begin() + range.first };
+	AABB centerBounds{};
+	std::for_each(begin, begin + range.count, [&](const BuildPrimitive& primitive) { centerBounds.Grow(primitive.center); });
+	const Vector3 extent{ centerBounds.max - centerBounds.min };
+	const int axis{ extent.x > extent.y && extent.x > extent.z ? 0 : extent.y > extent.z ? 1 : 2 };
+
+	const uint32_t firstCount{ GetMedianCount(range.count) };
+	std::nth_element(begin, begin + firstCount, begin + range.count, [axis](const BuildPrimitive& a, const BuildPrimitive& b) { return a.center[axis] < b.center[axis]; });
+	return firstCount;
+}
+
+uint32_t WideBVH::SplitAtMortonBit(const Leaf& range) const
+{
+	const uint32_t firstCode{ m_MortonCodes[range.first] };
+	const uint32_t lastCode{ m_MortonCodes[range.first + range.count - 1] };
+	if (firstCode == lastCode)
+		return GetMedianCount(range.count);
+
+	// The sorted codes share every bit above the highest one where the first and the last differ, it is clear in the first part
+	const uint32_t bit{ 1u << (31 - std::countl_zero(firstCode ^ lastCode)) };
+	const auto begin{ m_MortonCodes.begin() + range.first };
+	return static_cast<uint32_t>(std::partition_point(begin, begin + range.count, [bit](uint32_t code) { return (code & bit) == 0; }) - begin);
+}
+
+uint32_t WideBVH::SplitBySAH(const Leaf& range, AABB& firstBounds, AABB& secondBounds)
+{
+	const AABB centerBounds{ ReduceChunks<AABB>(range.first, range.count, [&](uint32_t first, uint32_t count)
+		{
+			AABB bounds{};
+			for (uint32_t index{ first }; index < first + count; ++index)
+				bounds.Grow(m_BuildPrimitives[index].center);
+			return bounds;
+		}, MergeBounds) };
+
+	// Centers are binned between their bounds along every axis that they spread over
+	const float binMin[3]{ centerBounds.min.x, centerBounds.min.y, centerBounds.min.z };
+	const float extent[3]{ centerBounds.max.x - binMin[0], centerBounds.max.y - binMin[1], centerBounds.max.z - binMin[2] };
+	float binScale[3]{};
+	for (int axis{}; axis < 3; ++axis)
+		binScale[axis] = extent[axis] > 0.f ? g_NumBins / extent[axis] : 0.f;
+	const auto getBin = [&](const Vector3& center, int axis)
+		{
+			// Clamped before the conversion, extents close to zero or to FLT_MAX turn the product into infinity or NaN
+			const float coordinate{ axis == 0 ? center.x : axis == 1 ? center.y : center.z };
+			return static_cast<int>(std::min(std::max(0.f, (coordinate - binMin[axis]) * binScale[axis]), g_NumBins - 1.f));
+		};
+
+	const SAHBins bins{ ReduceChunks<SAHBins>(range.first, range.count, [&](uint32_t first, uint32_t count)
+		{
+			SAHBins chunkBins{};
+			for (uint32_t index{ first }; index < first + count; ++index)
+			{
+				const BuildPrimitive& primitive{ m_BuildPrimitives[index] };
+				for (int axis{}; axis < 3; ++axis)
+					chunkBins.axes[axis][getBin(primitive.center, axis)].Add(primitive.bounds);
+			}
+			return chunkBins;
+		}, [](SAHBins& result, const SAHBins& other)
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				for (int bin{}; bin < g_NumBins; ++bin)
+					result.axes[axis][bin].Add(other.axes[axis][bin]);
+			}
+		}) };
+
+	// Cost of a plane is the surface of each side times its number of primitives. Counting whole leaves instead packs them full
+	// but loose, rays then test more of them
+	float bestCost{ FLT_MAX };
+	int bestAxis{ -1 };
+	int bestBin{};
+	Bin bestFirstSide{}, bestSecondSide{};
+	for (int axis{}; axis < 3; ++axis)
+	{
+		if (binScale[axis] == 0.f)
+			continue;
+
+		// Everything from a plane to the last bin, then everything before it
+		Bin secondSides[g_NumBins]{};
+		Bin secondSide{};
+		for (int bin{ g_NumBins - 1 }; bin > 0; --bin)
+		{
+			secondSide.Add(bins.axes[axis][bin]);
+			secondSides[bin] = secondSide;
+		}
+
+		Bin firstSide{};
+		for (int bin{ 1 }; bin < g_NumBins; ++bin)
+		{
+			firstSide.Add(bins.axes[axis][bin - 1]);
+			const Bin& secondSide{ secondSides[bin] };
+			if (firstSide.count == 0 || secondSide.count == 0)
+				continue;
+
+			const float cost{ firstSide.GetSurfaceArea() * firstSide.count + secondSide.GetSurfaceArea() * secondSide.count };
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+				bestFirstSide = firstSide;
+				bestSecondSide = secondSide;
+			}
+		}
+	}
+
+	const auto begin{ m_BuildPrimitives.begin() + range.first };
+	const auto end{ begin + range.count };
+	if (bestAxis < 0)
+	{
+		// Every center in the same place, any half is as good as another
+		const uint32_t firstCount{ GetMedianCount(range.count) };
+		firstBounds = {};
+		secondBounds = {};
+		std::for_each(begin, begin + firstCount, [&](const BuildPrimitive& primitive) { firstBounds.Grow(primitive.bounds); });
+		std::for_each(begin + firstCount, end, [&](const BuildPrimitive& primitive) { secondBounds.Grow(primitive.bounds); });
+		return firstCount;
+	}
+
+	firstBounds = bestFirstSide.GetBounds();
+	secondBounds = bestSecondSide.GetBounds();
+	const auto isFirst = [&](const BuildPrimitive& primitive) { return getBin(primitive.center, bestAxis) < bestBin; };
+	const auto middle{ range.count > g_ChunkSize ? std::partition(std::execution::par, begin, end, isFirst) : std::partition(begin, end, isFirst) };
+	return static_cast<uint32_t>(middle - begin);
+}
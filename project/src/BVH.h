@@ -0,0 +1,127 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Up to eight children with their bounds in structure of arrays layout, one ray is tested against all of them at once.
+	// 256 bytes, so a node starts on a cache line and fills four of them
+	struct alignas(64) BVHNode
+	{
+		static constexpr int width{ 8 };
+
+		float minX[width]{};
+		float minY[width]{};
+		float minZ[width]{};
+		float maxX[width]{};
+		float maxY[width]{};
+		float maxZ[width]{};
+		int32_t children[width]{}; // Index of an inner node, or ~index of a leaf
+		uint32_t numChildren{}; // The first numChildren slots are used
+
+		void SetBounds(int slot, const AABB& bounds)
+		{
+			minX[slot] = bounds.min.x;
+			minY[slot] = bounds.min.y;
+			minZ[slot] = bounds.min.z;
+			maxX[slot] = bounds.max.x;
+			maxY[slot] = bounds.max.y;
+			maxZ[slot] = bounds.max.z;
+		}
+
+		AABB GetBounds() const
+		{
+			AABB bounds{};
+			for (uint32_t slot{}; slot < numChildren; ++slot)
+				bounds.Grow(AABB{ { minX[slot], minY[slot], minZ[slot] }, { maxX[slot], maxY[slot], maxZ[slot] } });
+			return bounds;
+		}
+	};
+	static_assert(sizeof(BVHNode) == 256);
+
+	enum class BVHBuilder : uint8_t
+	{
+		BinnedSAH, // Splits where the surface area heuristic predicts the cheapest traversal, the better tree
+		Linear // Splits primitives sorted along a Morton curve, many times faster to build
+	};
+
+	/**
+	 * \brief Bounding volume hierarchy with eight children per node, built top down over the bounds of primitives.
+	 * A leaf holds up to maxLeafSize primitives, few enough to test them with a single SpherePacket<8>.
+	 * The root is node 0, every node comes before its children and the children of a node are next to each other.
+	 * Both builders split all nodes of a level in parallel, large ranges are also binned and sorted in parallel.
+	 */
+	class WideBVH final
+	{
+	public:
+		static constexpr uint32_t maxLeafSize{ 8 };
+		static constexpr uint32_t maxDepth{ 24 }; // Deeper nodes are split at the median, which bounds the depth of any tree
+
+		struct Leaf
+		{
+			uint32_t first{}; // Into GetPrimitiveIndices
+			uint32_t count{};
+		};
+
+		WideBVH() = default;
+		~WideBVH() = default;
+
+		WideBVH(const WideBVH&) = delete;
+		WideBVH(WideBVH&&) noexcept = delete;
+		WideBVH& operator=(const WideBVH&) = delete;
+		WideBVH& operator=(WideBVH&&) noexcept = delete;
+
+		void Build(const std::vector<AABB>& primitiveBounds, BVHBuilder builder = BVHBuilder::BinnedSAH);
+		// The primitives moved but stay in their leaves, leafBounds holds the new bounds of every leaf
+		void Refit(const std::vector<AABB>& leafBounds);
+
+		bool IsEmpty() const { return m_Nodes.empty(); }
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		const std::vector<Leaf>& GetLeaves() const { return m_Leaves; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+	private:
+		struct BuildTask
+		{
+			uint32_t nodeIndex{};
+			uint32_t depth{};
+			Leaf range{};
+			AABB bounds{}; // Only known to the SAH builder
+		};
+
+		// Moved around by the SAH builder instead of just its index, so every pass over a range reads memory in order
+		struct BuildPrimitive
+		{
+			AABB bounds{};
+			Vector3 center{};
+			uint32_t index{};
+		};
+
+		// The ranges a node's children cover, with their bounds when the builder needs them
+		struct NodeSplit
+		{
+			Leaf ranges[BVHNode::width]{};
+			AABB bounds[BVHNode::width]{};
+			uint32_t numRanges{};
+		};
+
+		void SortByMortonCode(const std::vector<AABB>& primitiveBounds);
+		void SplitNode(const BuildTask& task, BVHBuilder builder, NodeSplit& split);
+		uint32_t SplitAtMedian(const Leaf& range);
+		uint32_t SplitAtMortonBit(const Leaf& range) const;
+		uint32_t SplitBySAH(const Leaf& range, AABB& firstBounds, AABB& secondBounds);
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<Leaf> m_Leaves{};
+		std::vector<uint32_t> m_PrimitiveIndices{}; // Grouped per leaf
+
+		// Build scratch, kept so rebuilding every frame does not allocate
+		std::vector<BuildPrimitive> m_BuildPrimitives{};
+		std::vector<uint32_t> m_MortonCodes{}; // Per entry of m_PrimitiveIndices, sorted while building linearly
+		std::vector<uint32_t> m_SortedCodes{};
+		std::vector<uint32_t> m_SortedIndices{};
+		std::vector<AABB> m_LeafBounds{};
+	};
+}
@@ -0,0 +1,110 @@
+//External includes
+#include "SDL.h"
+#include "SDL_surface.h"
+
+//Project includes
+#include "BatchRenderer.h"
+#include "CameraPath.h"
+#include "Scene.h"
+
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace dae;
+
+BatchRenderer::BatchRenderer(int width, int height) :
+	m_Renderer(width, height)
+{
+	const SDL_Surface* pBuffer = m_Renderer.GetBuffer();
+	for (auto& pStaging : m_pStagingBuffers)
+	{
+		pStaging = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, pBuffer->format->format);
+	}
+}
+
+BatchRenderer::~BatchRenderer()
+{
+	for (auto& pStaging : m_pStagingBuffers)
+	{
+		SDL_FreeSurface(pStaging);
+		pStaging = nullptr;
+	}
+}
+
+bool BatchRenderer::Run(Scene* pScene, const CameraPath& path, const BatchSettings& settings)
+{
+	int lastFrame{ settings.lastFrame };
+	if (lastFrame < 0)
+		lastFrame = static_cast<int>((path.GetEndTime() - path.GetStartTime()) * settings.framesPerSecond);
+
+	int jobFirstFrame{}, jobLastFrame{};
+	if (!GetJobFrameRange(settings.firstFrame, lastFrame, settings.jobIndex, settings.jobCount, jobFirstFrame, jobLastFrame))
+	{
+		std::cout << "Job " << settings.jobIndex << "/" << settings.jobCount << " has no frames to render" << std::endl;
+		return true;
+	}
+
+	std::cout << "Rendering frames " << jobFirstFrame << "-" << jobLastFrame
+		<< " (job " << settings.jobIndex << "/" << settings.jobCount << ")" << std::endl;
+
+	const SDL_Surface* pBuffer = m_Renderer.GetBuffer();
+	const size_t bufferSize{ static_cast<size_t>(pBuffer->pitch) * pBuffer->h };
+
+	std::future<bool> pendingWrites[m_NumStagingBuffers]{};
+	bool succeeded{ true };
+
+	for (int frame{ jobFirstFrame }; frame <= jobLastFrame; ++frame)
+	{
+		const float time{ path.GetStartTime() + frame / settings.framesPerSecond };
+		path.ApplyToCamera(time, pScene->GetCamera());
+		pScene->MarkDirty(SceneComponent::Camera);
+
+		m_Renderer.Render(pScene);
+
+		//Wait until the previous write from this staging slot finished before reusing it
+		const int slot{ frame % m_NumStagingBuffers };
+		if (pendingWrites[slot].valid())
+			succeeded &= pendingWrites[slot].get();
+
+		SDL_Surface* pStaging = m_pStagingBuffers[slot];
+		std::memcpy(pStaging->pixels, pBuffer->pixels, bufferSize);
+
+		std::ostringstream filename;
+		filename << settings.outputPrefix << std::setw(4) << std::setfill('0') << frame << ".bmp";
+
+		pendingWrites[slot] = std::async(std::launch::async, [pStaging, name = filename.str()]()
+			{
+				const bool saved{ SDL_SaveBMP(pStaging, name.c_str()) == 0 };
+				if (!saved)
+					std::cout << "Failed to write " << name << std::endl;
+				return saved;
+			});
+	}
+
+	for (auto& pendingWrite : pendingWrites)
+	{
+		if (pendingWrite.valid())
+			succeeded &= pendingWrite.get();
+	}
+
+	return succeeded;
+}
+
+bool BatchRenderer::GetJobFrameRange(int firstFrame, int lastFrame, int jobIndex, int jobCount, int& jobFirstFrame, int& jobLastFrame)
+{
+	if (jobCount < 1 || jobIndex < 0 || jobIndex >= jobCount || lastFrame < firstFrame)
+		return false;
+
+	//Spread the remainder over the first jobs so chunk sizes differ by at most one frame
+	const int totalFrames{ lastFrame - firstFrame + 1 };
+	const int chunkSize{ totalFrames / jobCount };
+	const int remainder{ totalFrames % jobCount };
+
+	jobFirstFrame = firstFrame + jobIndex * chunkSize + std::min(jobIndex, remainder);
+	jobLastFrame = jobFirstFrame + chunkSize - 1 + (jobIndex < remainder ? 1 : 0);
+
+	return jobFirstFrame <= jobLastFrame;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+
+#include "Renderer.h"
+
+struct SDL_Surface;
+
+namespace dae
+{
+	class Scene;
+	class CameraPath;
+
+	struct BatchSettings
+	{
+		std::string cameraPathFile{};
+		std::string outputPrefix{ "frame_" };
+
+		int firstFrame{ 0 };
+		int lastFrame{ -1 };	// -1 >> up to the last keyframe
+		float framesPerSecond{ 30.f };
+
+		// Farm distribution: this process renders chunk jobIndex of jobCount
+		int jobIndex{ 0 };
+		int jobCount{ 1 };
+	};
+
+	/**
+	 * \brief Renders a camera path headlessly to numbered BMP files.
+	 * Frame N is written on a worker thread while frame N+1 is being ray traced.
+	 */
+	class BatchRenderer final
+	{
+	public:
+		BatchRenderer(int width, int height);
+		~BatchRenderer();
+
+		BatchRenderer(const BatchRenderer&) = delete;
+		BatchRenderer(BatchRenderer&&) noexcept = delete;
+		BatchRenderer& operator=(const BatchRenderer&) = delete;
+		BatchRenderer& operator=(BatchRenderer&&) noexcept = delete;
+
+		bool Run(Scene* pScene, const CameraPath& path, const BatchSettings& settings);
+
+		/**
+		 * \brief Splits [firstFrame,lastFrame] into jobCount contiguous chunks
+		 * \return false if this job has no frames to render
+		 */
+		static bool GetJobFrameRange(int firstFrame, int lastFrame, int jobIndex, int jobCount, int& jobFirstFrame, int& jobLastFrame);
+
+	private:
+		static constexpr int m_NumStagingBuffers{ 2 };
+
+		Renderer m_Renderer;
+		SDL_Surface* m_pStagingBuffers[m_NumStagingBuffers]{};
+	};
+}
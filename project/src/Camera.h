@@ -30,6 +30,10 @@ namespace dae
 
 		Matrix cameraToWorld{};
 
+		// Window position the user looks at (the mouse cursor), -1 until known
+		int focusX{ -1 };
+		int focusY{ -1 };
+
 		Matrix CalculateCameraToWorld()
 		{
 			Vector3 worldUp{Vector3::UnitY};
@@ -49,6 +53,16 @@ namespace dae
 			return cameraToWorld;
 		}
 
+		void SetRotation(float pitch, float yaw)
+		{
+			totalPitch = pitch;
+			totalYaw = yaw;
+
+			const Matrix finalRotation = Matrix::CreateRotation(totalPitch, totalYaw, 0);
+			forward = finalRotation.TransformVector(Vector3::UnitZ);
+			forward.Normalize();
+		}
+
 		void Update(Timer* pTimer)
 		{
 			const float deltaTime = pTimer->GetElapsed();
@@ -78,6 +92,7 @@ namespace dae
 
 
 			//Mouse Input
+			SDL_GetMouseState(&focusX, &focusY);
 			
 			int mouseX{}, mouseY{};
 			const uint32_t mouseState = SDL_GetRelativeMouseState(&mouseX, &mouseY);
@@ -0,0 +1,124 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "Camera.h"
+
+namespace dae
+{
+	namespace
+	{
+		float CatmullRom(float p0, float p1, float p2, float p3, float t)
+		{
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			return 0.5f * ((2.f * p1)
+				+ (-p0 + p2) * t
+				+ (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2
+				+ (-p0 + 3.f * p1 - 3.f * p2 + p3) * t3);
+		}
+
+		Vector3 CatmullRom(const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& p3, float t)
+		{
+			return {
+				CatmullRom(p0.x, p1.x, p2.x, p3.x, t),
+				CatmullRom(p0.y, p1.y, p2.y, p3.y, t),
+				CatmullRom(p0.z, p1.z, p2.z, p3.z, t)
+			};
+		}
+
+		// Turning from one angle to the other the short way round, in [-PI, PI]
+		float GetAngleDifference(float from, float to)
+		{
+			return std::remainder(to - from, PI_2);
+		}
+	}
+
+	bool CameraPath::LoadFromFile(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		if (!file)
+			return false;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream lineStream(line);
+			std::string sCommand;
+			lineStream >> sCommand;
+
+			if (sCommand == "key")
+			{
+				CameraKeyframe keyframe{};
+				float yawDegrees{}, pitchDegrees{};
+				lineStream >> keyframe.time
+					>> keyframe.origin.x >> keyframe.origin.y >> keyframe.origin.z
+					>> yawDegrees >> pitchDegrees >> keyframe.fovAngle;
+
+				if (!lineStream.fail())
+				{
+					keyframe.yaw = yawDegrees * TO_RADIANS;
+					keyframe.pitch = pitchDegrees * TO_RADIANS;
+					AddKeyframe(keyframe);
+				}
+			}
+		}
+
+		return !m_Keyframes.empty();
+	}
+
+	void CameraPath::AddKeyframe(const CameraKeyframe& keyframe)
+	{
+		//Keep keys sorted on time so Evaluate can walk them in order
+		auto it = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), keyframe.time,
+			[](float time, const CameraKeyframe& other) { return time < other.time; });
+		m_Keyframes.insert(it, keyframe);
+	}
+
+	CameraKeyframe CameraPath::Evaluate(float time) const
+	{
+		if (m_Keyframes.empty())
+			return {};
+		if (time <= m_Keyframes.front().time)
+			return m_Keyframes.front();
+		if (time >= m_Keyframes.back().time)
+			return m_Keyframes.back();
+
+		//Find the segment [k1,k2] containing time, clamp the outer control points at the ends
+		size_t k2{ 1 };
+		while (m_Keyframes[k2].time < time)
+			++k2;
+		const size_t k1{ k2 - 1 };
+		const size_t k0{ k1 > 0 ? k1 - 1 : k1 };
+		const size_t k3{ k2 + 1 < m_Keyframes.size() ? k2 + 1 : k2 };
+
+		const CameraKeyframe& p0 = m_Keyframes[k0];
+		const CameraKeyframe& p1 = m_Keyframes[k1];
+		const CameraKeyframe& p2 = m_Keyframes[k2];
+		const CameraKeyframe& p3 = m_Keyframes[k3];
+
+		const float segmentLength{ p2.time - p1.time };
+		const float t{ segmentLength > 0.f ? (time - p1.time) / segmentLength : 0.f };
+
+		CameraKeyframe result{};
+		result.time = time;
+		result.origin = CatmullRom(p0.origin, p1.origin, p2.origin, p3.origin, t);
+		// Yaws are unwrapped around p1, so a path crossing +-180 degrees keeps turning the same way instead of spinning back
+		const float yaw2{ p1.yaw + GetAngleDifference(p1.yaw, p2.yaw) };
+		result.yaw = CatmullRom(p1.yaw + GetAngleDifference(p1.yaw, p0.yaw), p1.yaw, yaw2, yaw2 + GetAngleDifference(p2.yaw, p3.yaw), t);
+		result.pitch = CatmullRom(p0.pitch, p1.pitch, p2.pitch, p3.pitch, t);
+		result.fovAngle = CatmullRom(p0.fovAngle, p1.fovAngle, p2.fovAngle, p3.fovAngle, t);
+		return result;
+	}
+
+	void CameraPath::ApplyToCamera(float time, Camera& camera) const
+	{
+		const CameraKeyframe keyframe = Evaluate(time);
+		camera.origin = keyframe.origin;
+		camera.fovAngle = keyframe.fovAngle;
+		camera.SetRotation(keyframe.pitch, keyframe.yaw);
+	}
+}
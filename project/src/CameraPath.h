@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Maths.h"
+
+namespace dae
+{
+	struct Camera;
+
+	struct CameraKeyframe
+	{
+		float time{};
+		Vector3 origin{};
+		float yaw{};		// radians
+		float pitch{};		// radians
+		float fovAngle{ 90.f };
+	};
+
+	/**
+	 * \brief Keyframed camera path used for headless fly-through rendering.
+	 * Origin, yaw, pitch and fov are interpolated with a Catmull-Rom spline through the keys, yaw along the shortest arc between keys.
+	 */
+	class CameraPath final
+	{
+	public:
+		CameraPath() = default;
+
+		/**
+		 * \brief Loads keyframes from a text file, one per line:
+		 * key <time> <originX> <originY> <originZ> <yawDegrees> <pitchDegrees> <fovAngle>
+		 * Lines starting with # are comments.
+		 * \return false if the file could not be opened or holds no keyframes
+		 */
+		bool LoadFromFile(const std::string& filename);
+
+		void AddKeyframe(const CameraKeyframe& keyframe);
+
+		CameraKeyframe Evaluate(float time) const;
+		void ApplyToCamera(float time, Camera& camera) const;
+
+		float GetStartTime() const { return m_Keyframes.empty() ? 0.f : m_Keyframes.front().time; }
+		float GetEndTime() const { return m_Keyframes.empty() ? 0.f : m_Keyframes.back().time; }
+		bool IsEmpty() const { return m_Keyframes.empty(); }
+
+	private:
+		std::vector<CameraKeyframe> m_Keyframes{};
+	};
+}
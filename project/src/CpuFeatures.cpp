@@ -0,0 +1,133 @@
+#include "CpuFeatures.h"
+
+#include <cstdlib>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	// eax, ebx, ecx, edx of a CPUID leaf
+	void Cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+	{
+#if defined(_MSC_VER)
+		int info[4]{};
+		__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (int index{}; index < 4; ++index)
+			registers[index] = static_cast<uint32_t>(info[index]);
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	// Register states the operating system saves on a context switch, only valid when CPUID reports OSXSAVE
+	uint64_t GetEnabledRegisterStates()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		uint32_t low{}, high{};
+		__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+	}
+
+	bool HasBit(uint32_t value, int bit)
+	{
+		return (value >> bit) & 1u;
+	}
+
+	InstructionSet SelectInstructionSet()
+	{
+		const InstructionSet detected{ DetectInstructionSet() };
+
+		const char* pOverride{ std::getenv("DAE_ISA") };
+		if (!pOverride)
+			return detected;
+
+		InstructionSet forced{};
+		if (!ParseInstructionSet(pOverride, forced))
+		{
+			std::cout << "DAE_ISA=" << pOverride << " is not one of scalar, sse4.2, avx2 or avx512, using " << ToString(detected) << std::endl;
+			return detected;
+		}
+
+		// Forcing a variant the CPU does not have would crash on the first illegal instruction
+		if (forced > detected)
+		{
+			std::cout << "DAE_ISA=" << pOverride << " is not supported by this CPU, using " << ToString(detected) << std::endl;
+			return detected;
+		}
+		return forced;
+	}
+}
+
+InstructionSet dae::DetectInstructionSet()
+{
+	uint32_t registers[4]{};
+	Cpuid(0, 0, registers);
+	const uint32_t maxLeaf{ registers[0] };
+
+	Cpuid(1, 0, registers);
+	const uint32_t features{ registers[2] };
+	if (!HasBit(features, 20))
+		return InstructionSet::Scalar;
+
+	// AVX also needs the operating system to save the ymm registers (and zmm and mask registers for AVX-512)
+	if (!HasBit(features, 27) || !HasBit(features, 28) || maxLeaf < 7)
+		return InstructionSet::SSE42;
+	const uint64_t registerStates{ GetEnabledRegisterStates() };
+	if ((registerStates & 0x6) != 0x6)
+		return InstructionSet::SSE42;
+
+	Cpuid(7, 0, registers);
+	const uint32_t extendedFeatures{ registers[1] };
+	if (!HasBit(extendedFeatures, 5))
+		return InstructionSet::SSE42;
+
+	if (!HasBit(extendedFeatures, 16) || (registerStates & 0xe6) != 0xe6)
+		return InstructionSet::AVX2;
+	return InstructionSet::AVX512;
+}
+
+InstructionSet dae::GetInstructionSet()
+{
+	static const InstructionSet instructionSet{ SelectInstructionSet() };
+	return instructionSet;
+}
+
+const char* dae::ToString(InstructionSet instructionSet)
+{
+	switch (instructionSet)
+	{
+	case InstructionSet::Scalar:
+		return "scalar";
+	case InstructionSet::SSE42:
+		return "sse4.2";
+	case InstructionSet::AVX2:
+		return "avx2";
+	case InstructionSet::AVX512:
+		return "avx512";
+	default:
+		return "unknown";
+	}
+}
+
+bool dae::ParseInstructionSet(const std::string& name, InstructionSet& instructionSet)
+{
+	for (int index{}; index < static_cast<int>(InstructionSet::Count); ++index)
+	{
+		if (name == ToString(static_cast<InstructionSet>(index)))
+		{
+			instructionSet = static_cast<InstructionSet>(index);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// MSVC emits instructions of any instruction set from intrinsics anywhere, GCC and Clang only in functions compiled for it.
+// Only call those functions on CPUs that support the instruction set, see GetInstructionSet
+#if defined(__GNUC__) || defined(__clang__)
+#define DAE_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define DAE_TARGET_AVX __attribute__((target("avx")))
+#define DAE_TARGET_AVX2 __attribute__((target("avx2")))
+#define DAE_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define DAE_TARGET_SSE42
+#define DAE_TARGET_AVX
+#define DAE_TARGET_AVX2
+#define DAE_TARGET_AVX512
+#endif
+
+// Code shared by the variants of a kernel is inlined into each of them, so it is compiled for that variant's instruction set
+#if defined(_MSC_VER)
+#define DAE_FORCE_INLINE __forceinline
+#else
+#define DAE_FORCE_INLINE __attribute__((always_inline)) inline
+#endif
+
+namespace dae
+{
+	// Ordered, every instruction set includes the ones before it
+	enum class InstructionSet : uint8_t
+	{
+		Scalar,
+		SSE42,
+		AVX2,
+		AVX512,
+		Count
+	};
+
+	// Best instruction set the CPU and the operating system both support, asks CPUID on every call
+	InstructionSet DetectInstructionSet();
+
+	// Detected once, lowered by the DAE_ISA environment variable (scalar, sse4.2, avx2 or avx512) to compare or work around a variant
+	InstructionSet GetInstructionSet();
+
+	const char* ToString(InstructionSet instructionSet);
+	bool ParseInstructionSet(const std::string& name, InstructionSet& instructionSet);
+}
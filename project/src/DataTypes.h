@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 
@@ -16,6 +18,34 @@ namespace dae
 		unsigned char materialIndex{ 0 };
 	};
 
+	//Width spheres in structure of arrays layout, one lane per sphere, so one ray is tested against all of them at once
+	template<int Width>
+	struct SpherePacket
+	{
+		static constexpr int width{ Width };
+
+		alignas(32) float originX[Width]{};
+		alignas(32) float originY[Width]{};
+		alignas(32) float originZ[Width]{};
+		alignas(32) float radius[Width]{};
+		alignas(32) float radiusSquared[Width]{}; // Negative in unused lanes, they never hit
+
+		SpherePacket()
+		{
+			for (int lane{}; lane < Width; ++lane)
+				radiusSquared[lane] = -1.f;
+		}
+
+		void Set(int lane, const Sphere& sphere)
+		{
+			originX[lane] = sphere.origin.x;
+			originY[lane] = sphere.origin.y;
+			originZ[lane] = sphere.origin.z;
+			radius[lane] = sphere.radius;
+			radiusSquared[lane] = sphere.radius * sphere.radius;
+		}
+	};
+
 	struct Plane
 	{
 		Vector3 origin{};
@@ -129,15 +159,65 @@ namespace dae
 
 		void UpdateTransforms()
 		{
-			throw std::runtime_error("Not Implemented Yet");
 			//Calculate Final Transform 
-			//const auto finalTransform = ...
+			const Matrix finalTransform{ scaleTransform * rotationTransform * translationTransform };
 
 			//Transform Positions (positions > transformedPositions)
-			//...
+			transformedPositions.clear();
+			transformedPositions.reserve(positions.size());
+			for (const Vector3& position : positions)
+				transformedPositions.push_back(finalTransform.TransformPoint(position));
 
 			//Transform Normals (normals > transformedNormals)
-			//...
+			//Normals take the inverse scale so non-uniform scaling keeps them perpendicular, translation does not apply to them
+			const Matrix normalTransform{ Matrix::CreateScale(1.f / scaleTransform[0].x, 1.f / scaleTransform[1].y, 1.f / scaleTransform[2].z) * rotationTransform };
+			transformedNormals.clear();
+			transformedNormals.reserve(normals.size());
+			for (const Vector3& normal : normals)
+				transformedNormals.push_back(normalTransform.TransformVector(normal).Normalized());
+		}
+	};
+
+	//Axis aligned bounding box, empty until something is added
+	struct AABB
+	{
+		Vector3 min{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 max{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+		// Inline and from values, the builders grow boxes millions of times and std::min of references into memory compiles to branches
+		void Grow(const Vector3& point)
+		{
+			Grow(point, point);
+		}
+
+		void Grow(const AABB& bounds)
+		{
+			Grow(bounds.min, bounds.max);
+		}
+
+		void Grow(const Vector3& otherMin, const Vector3& otherMax)
+		{
+			const AABB old{ *this };
+			min.x = std::min(old.min.x, otherMin.x);
+			min.y = std::min(old.min.y, otherMin.y);
+			min.z = std::min(old.min.z, otherMin.z);
+			max.x = std::max(old.max.x, otherMax.x);
+			max.y = std::max(old.max.y, otherMax.y);
+			max.z = std::max(old.max.z, otherMax.z);
+		}
+
+		Vector3 GetCenter() const { return (min + max) * .5f; }
+
+		float GetSurfaceArea() const
+		{
+			const Vector3 size{ max - min };
+			return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		static AABB FromSphere(const Sphere& sphere)
+		{
+			const Vector3 extent{ sphere.radius, sphere.radius, sphere.radius };
+			return { sphere.origin - extent, sphere.origin + extent };
 		}
 	};
 #pragma endregion
@@ -145,7 +225,9 @@ namespace dae
 	enum class LightType
 	{
 		Point,
-		Directional
+		Directional,
+		SphereArea,	// Sphere of radius around origin
+		RectArea	// Rectangle around origin spanned by +-edgeU and +-edgeV, emitting towards direction
 	};
 
 	struct Light
@@ -153,7 +235,11 @@ namespace dae
 		Vector3 origin{};
 		Vector3 direction{};
 		ColorRGB color{};
-		float intensity{};
+		float intensity{}; // Emitted radiance for area lights
+
+		float radius{};
+		Vector3 edgeU{};
+		Vector3 edgeV{};
 
 		LightType type{};
 	};
@@ -168,6 +254,26 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	enum class PrimitiveType : uint8_t
+	{
+		None,
+		Sphere,
+		Plane,
+		Triangle
+	};
+
+	//Slim result of the closest-hit search, the full HitRecord is only reconstructed for the winner
+	struct Intersection
+	{
+		float t{ FLT_MAX };
+		uint32_t primitiveIndex{ UINT32_MAX };
+		PrimitiveType primitiveType{ PrimitiveType::None };
+
+		//Barycentric coordinates of the hit, only used by triangles
+		float u{};
+		float v{};
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -177,5 +283,37 @@ namespace dae
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
 	};
+
+	//Reflection or refraction ray spawned at a hit, throughput is the fraction of its radiance reaching the pixel
+	struct SecondaryRay
+	{
+		Ray ray{};
+		ColorRGB throughput{};
+	};
+
+	//Rectangle of pixels in the frame buffer
+	struct Tile
+	{
+		int x{};
+		int y{};
+		int width{};
+		int height{};
+	};
+
+	//Index into one of the Scene's arrays, unlike a pointer it stays valid when the array grows.
+	//Handles from before the arrays were replaced keep an older generation, see Scene::IsCurrent
+	template<typename T>
+	struct Handle
+	{
+		uint32_t index{ UINT32_MAX };
+		uint32_t generation{};
+
+		bool IsValid() const { return index != UINT32_MAX; }
+	};
+
+	using SphereHandle = Handle<Sphere>;
+	using PlaneHandle = Handle<Plane>;
+	using TriangleMeshHandle = Handle<TriangleMesh>;
+	using LightHandle = Handle<Light>;
 #pragma endregion
 }
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace dae;
+
+namespace
+{
+	// B3 spline, separable weights of the 5x5 kernel
+	constexpr float g_Kernel[]{ 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+}
+
+const std::vector<ColorRGB>& Denoiser::Denoise(const DenoiserInput& input)
+{
+	m_Width = input.width;
+	m_Height = input.height;
+	m_NumTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+
+	const int numTiles{ m_NumTilesX * ((m_Height + m_TileSize - 1) / m_TileSize) };
+	if (m_TileIndices.size() != static_cast<size_t>(numTiles))
+	{
+		m_TileIndices.resize(numTiles);
+		std::iota(m_TileIndices.begin(), m_TileIndices.end(), 0);
+	}
+
+	Demodulate(input);
+
+	// Noise drops with the square root of the sample count, so the filter may preserve more detail as samples come in
+	float colorPhi{ m_ColorPhi * std::sqrt(input.sampleWeight) };
+	int source{};
+	for (int iteration{}; iteration < m_Iterations; ++iteration)
+	{
+		const int stepSize{ 1 << iteration };
+		std::for_each(std::execution::par, m_TileIndices.begin(), m_TileIndices.end(), [&](int tileIndex)
+			{
+				FilterTile(tileIndex, stepSize, colorPhi, m_Irradiance[source], m_Irradiance[1 - source]);
+			});
+
+		source = 1 - source;
+		colorPhi *= 0.5f;
+	}
+
+	if (source != 0)
+		std::swap(m_Irradiance[0], m_Irradiance[1]);
+
+	Remodulate();
+	return m_Colors;
+}
+
+void Denoiser::Demodulate(const DenoiserInput& input)
+{
+	const size_t numPixels{ static_cast<size_t>(m_Width) * m_Height };
+	m_Irradiance[0].Resize(numPixels);
+	m_Irradiance[1].Resize(numPixels);
+	m_Albedo.Resize(numPixels);
+	m_Normals.Resize(numPixels);
+	m_Depths.resize(numPixels);
+	m_Colors.resize(numPixels);
+
+	// Black albedo (misses, lights) can not be divided out, those pixels are filtered as they are
+	const auto demodulate = [](float color, float albedo, float& factor)
+		{
+			factor = albedo > 0.01f ? albedo : 1.f;
+			return color / factor;
+		};
+
+	std::for_each(std::execution::par, m_TileIndices.begin(), m_TileIndices.end(), [&](int tileIndex)
+		{
+			const int x0{ (tileIndex % m_NumTilesX) * m_TileSize };
+			const int y0{ (tileIndex / m_NumTilesX) * m_TileSize };
+			for (int py{ y0 }; py < std::min(y0 + m_TileSize, m_Height); ++py)
+			{
+				for (int px{ x0 }; px < std::min(x0 + m_TileSize, m_Width); ++px)
+				{
+					const size_t index{ static_cast<size_t>(px + (py * m_Width)) };
+					const ColorRGB color{ input.pColors[index] * input.sampleWeight };
+					const ColorRGB albedo{ input.pAlbedos[index] * input.sampleWeight };
+
+					m_Irradiance[0].r[index] = demodulate(color.r, albedo.r, m_Albedo.r[index]);
+					m_Irradiance[0].g[index] = demodulate(color.g, albedo.g, m_Albedo.g[index]);
+					m_Irradiance[0].b[index] = demodulate(color.b, albedo.b, m_Albedo.b[index]);
+					m_Normals.Set(index, input.pNormals[index] * input.sampleWeight);
+					m_Depths[index] = input.pDepths[index] * input.sampleWeight;
+				}
+			}
+		});
+}
+
+void Denoiser::FilterTile(int tileIndex, int stepSize, float colorPhi, const ColorStream& source, ColorStream& destination) const
+{
+	const int x0{ (tileIndex % m_NumTilesX) * m_TileSize };
+	const int y0{ (tileIndex / m_NumTilesX) * m_TileSize };
+	const int x1{ std::min(x0 + m_TileSize, m_Width) };
+	const int y1{ std::min(y0 + m_TileSize, m_Height) };
+
+	const float colorFactor{ 1.f / (colorPhi * colorPhi) };
+	const float normalFactor{ 1.f / m_NormalPhi };
+	const float depthPhi{ m_DepthPhi * stepSize };
+
+	for (int py{ y0 }; py < y1; ++py)
+	{
+		float sumR[m_TileSize]{}, sumG[m_TileSize]{}, sumB[m_TileSize]{}, sumWeights[m_TileSize]{};
+
+		for (int ky{ -m_KernelRadius }; ky <= m_KernelRadius; ++ky)
+		{
+			const int qy{ py + ky * stepSize };
+			if (qy < 0 || qy >= m_Height)
+				continue;
+
+			for (int kx{ -m_KernelRadius }; kx <= m_KernelRadius; ++kx)
+			{
+				// Only the pixels of the row whose tap lands inside the image, the loop below stays branch free
+				const int offset{ kx * stepSize };
+				const int begin{ std::max(x0, -offset) };
+				const int end{ std::min(x1, m_Width - offset) };
+				const float kernelWeight{ g_Kernel[ky + m_KernelRadius] * g_Kernel[kx + m_KernelRadius] };
+
+				const int p0{ py * m_Width };
+				const int q0{ qy * m_Width + offset };
+				for (int px{ begin }; px < end; ++px)
+				{
+					const int p{ p0 + px };
+					const int q{ q0 + px };
+
+					const float colorDistance{ Square(source.r[q] - source.r[p]) + Square(source.g[q] - source.g[p]) + Square(source.b[q] - source.b[p]) };
+					const float normalDistance{ Square(m_Normals.x[q] - m_Normals.x[p]) + Square(m_Normals.y[q] - m_Normals.y[p])
+						+ Square(m_Normals.z[q] - m_Normals.z[p]) };
+					const float depthDistance{ std::abs(m_Depths[q] - m_Depths[p]) / (depthPhi * m_Depths[p] + 1e-4f) };
+
+					const float weight{ kernelWeight * std::exp(-(colorDistance * colorFactor + normalDistance * normalFactor + depthDistance)) };
+					sumR[px - x0] += source.r[q] * weight;
+					sumG[px - x0] += source.g[q] * weight;
+					sumB[px - x0] += source.b[q] * weight;
+					sumWeights[px - x0] += weight;
+				}
+			}
+		}
+
+		// The center tap always has a weight, the sum is never zero
+		for (int px{ x0 }; px < x1; ++px)
+		{
+			const size_t index{ static_cast<size_t>(px + (py * m_Width)) };
+			const float invWeight{ 1.f / sumWeights[px - x0] };
+			destination.r[index] = sumR[px - x0] * invWeight;
+			destination.g[index] = sumG[px - x0] * invWeight;
+			destination.b[index] = sumB[px - x0] * invWeight;
+		}
+	}
+}
+
+void Denoiser::Remodulate()
+{
+	std::for_each(std::execution::par, m_TileIndices.begin(), m_TileIndices.end(), [&](int tileIndex)
+		{
+			const int x0{ (tileIndex % m_NumTilesX) * m_TileSize };
+			const int y0{ (tileIndex / m_NumTilesX) * m_TileSize };
+			for (int py{ y0 }; py < std::min(y0 + m_TileSize, m_Height); ++py)
+			{
+				for (int px{ x0 }; px < std::min(x0 + m_TileSize, m_Width); ++px)
+				{
+					const size_t index{ static_cast<size_t>(px + (py * m_Width)) };
+					m_Colors[index] = { m_Irradiance[0].r[index] * m_Albedo.r[index], m_Irradiance[0].g[index] * m_Albedo.g[index],
+						m_Irradiance[0].b[index] * m_Albedo.b[index] };
+				}
+			}
+		});
+}
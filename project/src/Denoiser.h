@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+
+#include "Wavefront.h"
+
+namespace dae
+{
+	// Features of the first surface a path hits, the denoiser uses them to find edges the noise hides
+	struct PixelFeatures
+	{
+		ColorRGB albedo{};
+		Vector3 normal{};
+		float depth{};
+	};
+
+	// Per pixel buffers of the image to denoise, the renderer hands in running sums over its accumulated samples
+	struct DenoiserInput
+	{
+		int width{};
+		int height{};
+		const ColorRGB* pColors{};
+		const ColorRGB* pAlbedos{};
+		const Vector3* pNormals{};
+		const float* pDepths{};
+		float sampleWeight{ 1.f }; // Turns the sums into averages
+	};
+
+	/**
+	 * \brief Edge avoiding a-trous wavelet filter (Dammertz et al. 2010) for low sample path traced images.
+	 * The color is divided by the albedo so only the lighting gets blurred, then filtered with a 5x5 B3 spline kernel whose taps
+	 * spread further apart every iteration and are weighted down across color, normal and depth edges.
+	 * Tiles are filtered in parallel from SoA planes, the inner loops run over contiguous pixels of a row.
+	 */
+	class Denoiser final
+	{
+	public:
+		Denoiser() = default;
+		~Denoiser() = default;
+
+		Denoiser(const Denoiser&) = delete;
+		Denoiser(Denoiser&&) noexcept = delete;
+		Denoiser& operator=(const Denoiser&) = delete;
+		Denoiser& operator=(Denoiser&&) noexcept = delete;
+
+		// Returns the filtered colors row by row, valid until the next call
+		const std::vector<ColorRGB>& Denoise(const DenoiserInput& input);
+
+		int GetIterations() const { return m_Iterations; }
+		void SetIterations(int iterations) { m_Iterations = std::max(iterations, 0); }
+
+	private:
+		static constexpr int m_TileSize{ 64 };
+		static constexpr int m_KernelRadius{ 2 };
+
+		void Demodulate(const DenoiserInput& input);
+		void FilterTile(int tileIndex, int stepSize, float colorPhi, const ColorStream& source, ColorStream& destination) const;
+		void Remodulate();
+
+		int m_Iterations{ 5 };
+		float m_ColorPhi{ 2.f };	// Irradiance difference that still blends, shrinks with more samples and every iteration
+		float m_NormalPhi{ 0.1f };	// Squared length of the difference between normals
+		float m_DepthPhi{ 0.02f };	// Depth difference relative to the depth of the pixel, per pixel of step size
+
+		int m_Width{};
+		int m_Height{};
+		int m_NumTilesX{};
+
+		ColorStream m_Irradiance[2]{}; // Ping-pong between iterations
+		ColorStream m_Albedo{};
+		Vector3Stream m_Normals{};
+		std::vector<float> m_Depths{};
+
+		std::vector<ColorRGB> m_Colors{};
+		std::vector<int> m_TileIndices{};
+	};
+}
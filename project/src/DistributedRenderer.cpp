@@ -0,0 +1,374 @@
+#include "DistributedRenderer.h"
+
+#include <iostream>
+#include <sstream>
+
+#include "Renderer.h"
+#include "Scene.h"
+
+using namespace dae;
+using namespace dae::Distributed;
+
+namespace
+{
+	bool SendPacket(const Socket& socket, MessageType type, const void* pPayload, size_t size)
+	{
+		const MessageHeader header{ type, static_cast<uint32_t>(size) };
+		return socket.Send(&header, sizeof(header)) && (size == 0 || socket.Send(pPayload, size));
+	}
+
+	size_t GetTilePixelBytes(const Tile& tile)
+	{
+		return static_cast<size_t>(tile.width) * tile.height * 3;
+	}
+}
+
+#pragma region Coordinator
+RenderCoordinator::RenderCoordinator(uint16_t port, const Scene* pScene, bool acceptsRemoteWorkers) :
+	m_ListenSocket(Socket::Listen(port, acceptsRemoteWorkers))
+{
+	SerializeScene(pScene);
+
+	if (m_ListenSocket.IsValid())
+		m_AcceptThread = std::thread(&RenderCoordinator::AcceptWorkers, this);
+	else
+		std::cout << "Could not listen on port " << port << ", rendering locally" << std::endl;
+}
+
+RenderCoordinator::~RenderCoordinator()
+{
+	{
+		std::lock_guard lock(m_Mutex);
+		m_IsShuttingDown = true;
+	}
+	m_TileAvailable.notify_all();
+
+	if (m_AcceptThread.joinable())
+	{
+		//Shutting the listening socket down makes the accept the thread is blocked in fail
+		m_ListenSocket.Shutdown();
+		m_AcceptThread.join();
+	}
+
+	for (const auto& pWorker : m_Workers)
+	{
+		if (pWorker->thread.joinable())
+			pWorker->thread.join();
+	}
+}
+
+int RenderCoordinator::GetNumWorkers() const
+{
+	std::lock_guard lock(m_Mutex);
+	return m_NumLiveWorkers;
+}
+
+void RenderCoordinator::SetTileTimeout(int milliseconds)
+{
+	std::lock_guard lock(m_Mutex);
+	m_TileTimeout = milliseconds;
+}
+
+void RenderCoordinator::SerializeScene(const Scene* pScene)
+{
+	std::ostringstream stream{};
+	pScene->Serialize(stream);
+	auto pSceneData = std::make_shared<const std::string>(stream.str());
+
+	std::lock_guard lock(m_Mutex);
+	m_pSceneData = std::move(pSceneData);
+	m_SceneGeneration = pScene->GetContentGeneration();
+	++m_SceneVersion;
+}
+
+void RenderCoordinator::RenderFrame(Scene* pScene, Renderer* pRenderer)
+{
+	//Only this thread changes the scene, so the generation can be compared without the lock
+	if (pScene->GetContentGeneration() != m_SceneGeneration)
+		SerializeScene(pScene);
+
+	const Camera& camera = pScene->GetCamera();
+	const int width{ pRenderer->GetWidth() };
+	const int height{ pRenderer->GetHeight() };
+
+	std::unique_lock lock(m_Mutex);
+
+	++m_CurrentFrame.frameIndex;
+	m_CurrentFrame.width = width;
+	m_CurrentFrame.height = height;
+	m_CurrentFrame.lightingMode = static_cast<int32_t>(pRenderer->GetLightingMode());
+	m_CurrentFrame.renderMode = static_cast<int32_t>(pRenderer->GetRenderMode());
+	m_CurrentFrame.shadowsEnabled = pRenderer->AreShadowsEnabled();
+	m_CurrentFrame.shadowMapsEnabled = pRenderer->AreShadowMapsEnabled();
+	m_CurrentFrame.lightCacheEnabled = pRenderer->IsLightCacheEnabled();
+	m_CurrentFrame.lightCacheCellSize = pRenderer->GetLightCacheCellSize();
+	m_CurrentFrame.reflectionsEnabled = pRenderer->AreReflectionsEnabled();
+	m_CurrentFrame.maxBounces = pRenderer->GetMaxBounces();
+	m_CurrentFrame.throughputThreshold = pRenderer->GetThroughputThreshold();
+	m_CurrentFrame.maxPathLength = pRenderer->GetMaxPathLength();
+	m_CurrentFrame.cameraOrigin = camera.origin;
+	m_CurrentFrame.cameraForward = camera.forward;
+	m_CurrentFrame.cameraFovAngle = camera.fovAngle;
+	m_CurrentFrame.cameraPitch = camera.totalPitch;
+	m_CurrentFrame.cameraYaw = camera.totalYaw;
+	m_pFrameRenderer = pRenderer;
+	pRenderer->ResetSecondaryRayCount(); // Tiles from workers and from here add theirs
+
+	m_PendingTiles.clear();
+	for (int y{}; y < height; y += m_TileSize)
+	{
+		for (int x{}; x < width; x += m_TileSize)
+		{
+			m_PendingTiles.push_back({ x, y, std::min(m_TileSize, width - x), std::min(m_TileSize, height - y) });
+		}
+	}
+	m_RemainingTiles = static_cast<int>(m_PendingTiles.size());
+	m_TileAvailable.notify_all();
+
+	while (m_RemainingTiles > 0)
+	{
+		//Without live workers (none connected or all of them died) the remaining tiles are rendered here
+		if (m_NumLiveWorkers == 0 && !m_PendingTiles.empty())
+		{
+			const Tile tile{ m_PendingTiles.front() };
+			m_PendingTiles.pop_front();
+
+			lock.unlock();
+			pRenderer->RenderTile(pScene, tile);
+			lock.lock();
+
+			--m_RemainingTiles;
+			continue;
+		}
+
+		m_FrameProgress.wait(lock);
+	}
+	m_pFrameRenderer = nullptr;
+	lock.unlock();
+
+	pRenderer->Present();
+}
+
+void RenderCoordinator::AcceptWorkers()
+{
+	while (true)
+	{
+		Socket client{ m_ListenSocket.Accept() };
+
+		std::lock_guard lock(m_Mutex);
+		if (m_IsShuttingDown || !client.IsValid())
+			return;
+
+		auto pWorker = std::make_unique<WorkerConnection>();
+		pWorker->socket = std::move(client);
+		pWorker->thread = std::thread(&RenderCoordinator::ServeWorker, this, pWorker.get());
+		m_Workers.push_back(std::move(pWorker));
+	}
+}
+
+void RenderCoordinator::ServeWorker(WorkerConnection* pWorker)
+{
+	const Socket& socket = pWorker->socket;
+	std::shared_ptr<const std::string> pSceneData{};
+	uint32_t sentSceneVersion{};
+	{
+		std::lock_guard lock(m_Mutex);
+		pSceneData = m_pSceneData;
+		sentSceneVersion = m_SceneVersion;
+	}
+	if (!SendPacket(socket, MessageType::Scene, pSceneData->data(), pSceneData->size()))
+		return;
+
+	{
+		std::lock_guard lock(m_Mutex);
+		++m_NumLiveWorkers;
+	}
+	std::cout << "Render worker connected" << std::endl;
+
+	uint32_t sentFrameIndex{};
+	int tileTimeout{ -1 };
+	std::vector<uint8_t> pixels{};
+
+	while (true)
+	{
+		Tile tile{};
+		FrameMessage frame{};
+		Renderer* pRenderer{};
+		uint32_t sceneVersion{};
+		int currentTileTimeout{};
+		{
+			std::unique_lock lock(m_Mutex);
+			m_TileAvailable.wait(lock, [this]() { return m_IsShuttingDown || !m_PendingTiles.empty(); });
+			if (m_IsShuttingDown)
+				break;
+
+			tile = m_PendingTiles.front();
+			m_PendingTiles.pop_front();
+			frame = m_CurrentFrame;
+			pRenderer = m_pFrameRenderer;
+			sceneVersion = m_SceneVersion;
+			pSceneData = m_pSceneData;
+			currentTileTimeout = m_TileTimeout;
+		}
+
+		//The worker rebuilds its scene and renderer from a new scene, the frame has to follow it again
+		bool succeeded{ true };
+		if (currentTileTimeout != tileTimeout)
+		{
+			succeeded = socket.SetReceiveTimeout(currentTileTimeout);
+			tileTimeout = currentTileTimeout;
+		}
+		if (succeeded && sceneVersion != sentSceneVersion)
+		{
+			succeeded = SendPacket(socket, MessageType::Scene, pSceneData->data(), pSceneData->size());
+			sentSceneVersion = sceneVersion;
+			sentFrameIndex = 0;
+		}
+		if (succeeded && frame.frameIndex != sentFrameIndex)
+		{
+			succeeded = SendPacket(socket, MessageType::Frame, &frame, sizeof(frame));
+			sentFrameIndex = frame.frameIndex;
+		}
+		succeeded = succeeded && SendPacket(socket, MessageType::Tile, &tile, sizeof(tile));
+
+		MessageHeader resultHeader{};
+		TileResultMessage result{};
+		pixels.resize(GetTilePixelBytes(tile));
+		succeeded = succeeded
+			&& socket.Receive(&resultHeader, sizeof(resultHeader))
+			&& resultHeader.type == MessageType::TileResult
+			&& resultHeader.size == sizeof(result) + pixels.size()
+			&& socket.Receive(&result, sizeof(result))
+			&& socket.Receive(pixels.data(), pixels.size());
+
+		if (!succeeded)
+		{
+			//Worker died or stalled mid-frame, reissue its tile to whoever is left. A stalled one is cut off, a late answer would be out of sync
+			std::cout << "Render worker lost, reissuing its tile" << std::endl;
+			socket.Shutdown();
+			{
+				std::lock_guard lock(m_Mutex);
+				m_PendingTiles.push_front(tile);
+				--m_NumLiveWorkers;
+			}
+			m_TileAvailable.notify_one();
+			m_FrameProgress.notify_all();
+			return;
+		}
+
+		pRenderer->WriteTile(tile, pixels.data(), result.secondaryRayCount);
+		{
+			std::lock_guard lock(m_Mutex);
+			--m_RemainingTiles;
+		}
+		m_FrameProgress.notify_all();
+	}
+
+	{
+		std::lock_guard lock(m_Mutex);
+		--m_NumLiveWorkers;
+	}
+	SendPacket(socket, MessageType::Shutdown, nullptr, 0);
+}
+#pragma endregion
+
+#pragma region Worker
+bool RenderWorker::Connect(const std::string& host, uint16_t port)
+{
+	m_Socket = Socket::Connect(host, port);
+	return m_Socket.IsValid();
+}
+
+bool RenderWorker::Run()
+{
+	std::unique_ptr<Scene> pScene{};
+	std::unique_ptr<Renderer> pRenderer{};
+	std::vector<uint8_t> pixels{};
+
+	while (true)
+	{
+		MessageHeader header{};
+		if (!m_Socket.Receive(&header, sizeof(header)))
+			return false;
+
+		switch (header.type)
+		{
+		case MessageType::Scene:
+		{
+			std::string sceneData(header.size, '\0');
+			if (!m_Socket.Receive(sceneData.data(), sceneData.size()))
+				return false;
+
+			//A scene that changed replaces the old one, the renderer's caches belonged to that. The next frame creates a new one
+			try
+			{
+				pScene = std::make_unique<Scene_Remote>(sceneData);
+				pScene->Initialize();
+				pRenderer.reset();
+			}
+			catch (const std::exception& exception)
+			{
+				std::cout << exception.what() << std::endl;
+				return false;
+			}
+			break;
+		}
+		case MessageType::Frame:
+		{
+			FrameMessage frame{};
+			if (header.size != sizeof(frame) || !m_Socket.Receive(&frame, sizeof(frame)) || !pScene)
+				return false;
+
+			if (!pRenderer || pRenderer->GetWidth() != frame.width || pRenderer->GetHeight() != frame.height)
+				pRenderer = std::make_unique<Renderer>(frame.width, frame.height);
+
+			pRenderer->SetLightingMode(static_cast<Renderer::LightingMode>(frame.lightingMode));
+			pRenderer->SetRenderMode(static_cast<Renderer::RenderMode>(frame.renderMode));
+			pRenderer->SetShadowsEnabled(frame.shadowsEnabled != 0);
+			pRenderer->SetShadowMapsEnabled(frame.shadowMapsEnabled != 0);
+			pRenderer->SetLightCacheEnabled(frame.lightCacheEnabled != 0);
+			pRenderer->SetLightCacheCellSize(frame.lightCacheCellSize);
+			pRenderer->SetReflectionsEnabled(frame.reflectionsEnabled != 0);
+			pRenderer->SetMaxBounces(frame.maxBounces);
+			pRenderer->SetThroughputThreshold(frame.throughputThreshold);
+			pRenderer->SetMaxPathLength(frame.maxPathLength);
+
+			Camera& camera = pScene->GetCamera();
+			camera.origin = frame.cameraOrigin;
+			camera.forward = frame.cameraForward;
+			camera.fovAngle = frame.cameraFovAngle;
+			camera.totalPitch = frame.cameraPitch;
+			camera.totalYaw = frame.cameraYaw;
+			pScene->MarkDirty(SceneComponent::Camera);
+			break;
+		}
+		case MessageType::Tile:
+		{
+			Tile tile{};
+			if (header.size != sizeof(tile) || !m_Socket.Receive(&tile, sizeof(tile)) || !pRenderer)
+				return false;
+
+			if (tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0 ||
+				tile.x + tile.width > pRenderer->GetWidth() || tile.y + tile.height > pRenderer->GetHeight())
+				return false;
+
+			pixels.resize(GetTilePixelBytes(tile));
+			pRenderer->ResetSecondaryRayCount();
+			pRenderer->RenderTile(pScene.get(), tile, pixels.data());
+
+			const TileResultMessage result{ tile, pRenderer->GetSecondaryRayCount() };
+			const MessageHeader resultHeader{ MessageType::TileResult, static_cast<uint32_t>(sizeof(result) + pixels.size()) };
+			if (!m_Socket.Send(&resultHeader, sizeof(resultHeader)) ||
+				!m_Socket.Send(&result, sizeof(result)) ||
+				!m_Socket.Send(pixels.data(), pixels.size()))
+				return false;
+			break;
+		}
+		case MessageType::Shutdown:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+#pragma endregion
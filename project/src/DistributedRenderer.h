@@ -0,0 +1,139 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Socket.h"
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+
+	namespace Distributed
+	{
+		enum class MessageType : uint32_t
+		{
+			Scene,		// Coordinator >> Worker: serialized scene, sent on connection and again before the first frame after its content changed
+			Frame,		// Coordinator >> Worker: camera and render settings of the frame the next tiles belong to
+			Tile,		// Coordinator >> Worker: tile to render
+			TileResult,	// Worker >> Coordinator: TileResultMessage followed by the tile's RGB8 pixels
+			Shutdown	// Coordinator >> Worker
+		};
+
+		struct MessageHeader
+		{
+			MessageType type{};
+			uint32_t size{};
+		};
+
+		struct FrameMessage
+		{
+			uint32_t frameIndex{};
+			int32_t width{};
+			int32_t height{};
+			int32_t lightingMode{};
+			int32_t renderMode{};
+			int32_t shadowsEnabled{};
+			int32_t shadowMapsEnabled{};
+			int32_t lightCacheEnabled{};
+			float lightCacheCellSize{};
+			int32_t reflectionsEnabled{};
+			int32_t maxBounces{};
+			float throughputThreshold{};
+			int32_t maxPathLength{};
+
+			Vector3 cameraOrigin{};
+			Vector3 cameraForward{};
+			float cameraFovAngle{};
+			float cameraPitch{};
+			float cameraYaw{};
+		};
+
+		struct TileResultMessage
+		{
+			Tile tile{};
+			uint64_t secondaryRayCount{}; // Traced for this tile, added to the coordinator's frame statistics
+		};
+	}
+
+	/**
+	 * \brief Hands out tiles of each frame to connected render workers and reassembles their results.
+	 * Tiles of a worker that disconnects or does not answer in time are reissued, without workers the coordinator renders tiles itself.
+	 * The scene is serialized again whenever its content generation changes, workers receive it before their next tile.
+	 */
+	class RenderCoordinator final
+	{
+	public:
+		// Workers on other machines can only connect with acceptsRemoteWorkers, the scene and tiles travel unauthenticated
+		RenderCoordinator(uint16_t port, const Scene* pScene, bool acceptsRemoteWorkers = false);
+		~RenderCoordinator();
+
+		RenderCoordinator(const RenderCoordinator&) = delete;
+		RenderCoordinator(RenderCoordinator&&) noexcept = delete;
+		RenderCoordinator& operator=(const RenderCoordinator&) = delete;
+		RenderCoordinator& operator=(RenderCoordinator&&) noexcept = delete;
+
+		bool IsListening() const { return m_ListenSocket.IsValid(); }
+		int GetNumWorkers() const;
+
+		// A worker that takes longer to answer a tile is dropped, 0 waits forever
+		void SetTileTimeout(int milliseconds);
+
+		void RenderFrame(Scene* pScene, Renderer* pRenderer);
+
+	private:
+		struct WorkerConnection
+		{
+			Socket socket{};
+			std::thread thread{};
+		};
+
+		static constexpr int m_TileSize{ 32 };
+
+		void SerializeScene(const Scene* pScene);
+		void AcceptWorkers();
+		void ServeWorker(WorkerConnection* pWorker);
+
+		Socket m_ListenSocket{};
+		std::thread m_AcceptThread{};
+		std::shared_ptr<const std::string> m_pSceneData{}; // Shared with the workers' threads still sending an older version
+		uint64_t m_SceneGeneration{}; // Content generation m_pSceneData was serialized at
+		uint32_t m_SceneVersion{}; // Bumped with every new m_pSceneData
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_TileAvailable{};
+		std::condition_variable m_FrameProgress{};
+
+		std::vector<std::unique_ptr<WorkerConnection>> m_Workers{};
+		int m_NumLiveWorkers{};
+		bool m_IsShuttingDown{ false };
+		int m_TileTimeout{ 10000 }; // Milliseconds, generous enough for a worker that first rebuilds a new scene
+
+		Distributed::FrameMessage m_CurrentFrame{};
+		Renderer* m_pFrameRenderer{};
+		std::deque<Tile> m_PendingTiles{};
+		int m_RemainingTiles{};
+	};
+
+	/**
+	 * \brief Connects to a RenderCoordinator, rebuilds its scene and renders the tiles it receives until shut down
+	 */
+	class RenderWorker final
+	{
+	public:
+		RenderWorker() = default;
+
+		bool Connect(const std::string& host, uint16_t port);
+		bool Run();
+
+	private:
+		Socket m_Socket{};
+	};
+}
@@ -0,0 +1,754 @@
+#include "Kernels.h"
+
+#include "Utils.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+
+using namespace dae;
+
+namespace
+{
+	static_assert(sizeof(ColorRGB) == 3 * sizeof(float), "Colors are loaded as packed floats");
+	static_assert(WideBVH::maxLeafSize == SpherePacket<8>::width, "A leaf of spheres is one packet");
+
+	// Slab distances are rounded, growing the far one by 1 + 2 * gamma(3) keeps rays that graze a box from missing it (PBRT, 6.8.2)
+	constexpr float g_RobustFarScale{ 1.0000004f };
+	// Seven entries per level at most. WideBVH splits nodes deeper than maxDepth by count, which takes at most 11 more levels to reach leaves of 2^32 primitives
+	constexpr int g_MaxStackSize{ 256 };
+	static_assert(g_MaxStackSize >= (BVHNode::width - 1) * (WideBVH::maxDepth + 11) + 1, "Deep enough for any tree WideBVH builds");
+
+	// Closest or any hit through the tree, Kernels supplies the instruction set specific IntersectChildren and IntersectPacket
+	template<typename Kernels, bool isAnyHit>
+	DAE_FORCE_INLINE int TraverseSphereBVH(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray, float& t)
+	{
+		// Left uninitialized, clearing the whole stack costs more than most traversals
+		struct Entry
+		{
+			int32_t child;
+			float distance;
+		};
+		Entry stack[g_MaxStackSize];
+		int stackSize{};
+		stack[stackSize++] = { 0, ray.min };
+
+		const Vector3 inverseDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+		int hitSlot{ -1 };
+		while (stackSize > 0)
+		{
+			// Everything in there is farther than a hit found since it was pushed
+			const Entry entry{ stack[--stackSize] };
+			if (entry.distance > t)
+				continue;
+
+			if (entry.child < 0)
+			{
+				const int lane{ Kernels::IntersectPacket(pPackets[~entry.child], ray, t) };
+				if (lane >= 0)
+				{
+					hitSlot = ~entry.child * SpherePacket<8>::width + lane;
+					if constexpr (isAnyHit)
+						return hitSlot;
+				}
+				continue;
+			}
+
+			const BVHNode& node{ pNodes[entry.child] };
+			alignas(32) float distances[BVHNode::width];
+			uint32_t hitMask{ Kernels::IntersectChildren(node, ray.origin, inverseDirection, ray.min, std::min(t, ray.max), distances) };
+
+			// Sorted farthest first, so the nearest child is visited next
+			const int firstEntry{ stackSize };
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const int slot{ std::countr_zero(hitMask) };
+				const Entry child{ node.children[slot], distances[slot] };
+				if (child.child >= 0)
+				{
+					for (size_t line{}; line < sizeof(BVHNode); line += 64)
+						_mm_prefetch(reinterpret_cast<const char*>(pNodes + child.child) + line, _MM_HINT_T0);
+				}
+
+				int index{ stackSize++ };
+				for (; index > firstEntry && stack[index - 1].distance < child.distance; --index)
+					stack[index] = stack[index - 1];
+				stack[index] = child;
+			}
+		}
+		return hitSlot;
+	}
+
+	// The rays of span from first on, where a wider kernel hands its tail to a narrower one
+	VisibilitySpan GetSpanTail(const VisibilitySpan& span, uint32_t first)
+	{
+		VisibilitySpan tail{ span };
+		for (const float*& pDirections : tail.pDirections)
+			pDirections += first;
+		tail.pDepths += first;
+		tail.pPrimitives += first;
+		tail.count -= first;
+		return tail;
+	}
+
+#pragma region Scalar
+	int IntersectSpheres_Scalar(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray, float& t)
+	{
+		int hitIndex{ -1 };
+		for (uint32_t packetIndex{}; packetIndex < numPackets; ++packetIndex)
+		{
+			const SpherePacket<8>& packet{ pPackets[packetIndex] };
+			for (int lane{}; lane < 8; ++lane)
+			{
+				if (packet.radiusSquared[lane] < 0.f)
+					continue;
+
+				const Sphere sphere{ { packet.originX[lane], packet.originY[lane], packet.originZ[lane] }, packet.radius[lane] };
+				float sphereT{};
+				if (GeometryUtils::Intersect_Sphere(sphere, ray, sphereT) && sphereT < t)
+				{
+					t = sphereT;
+					hitIndex = static_cast<int>(packetIndex * 8 + lane);
+				}
+			}
+		}
+		return hitIndex;
+	}
+
+	bool HitTestSpheres_Scalar(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray)
+	{
+		float t{ FLT_MAX };
+		return IntersectSpheres_Scalar(pPackets, numPackets, ray, t) >= 0;
+	}
+
+	struct BVHKernels_Scalar
+	{
+		// Bit per child whose box overlaps [tMin, tMax] along the ray, pDistances receives where the ray enters them
+		static uint32_t IntersectChildren(const BVHNode& node, const Vector3& origin, const Vector3& inverseDirection, float tMin, float tMax, float* pDistances)
+		{
+			uint32_t hitMask{};
+			for (uint32_t slot{}; slot < node.numChildren; ++slot)
+			{
+				const float t0x{ (node.minX[slot] - origin.x) * inverseDirection.x };
+				const float t0y{ (node.minY[slot] - origin.y) * inverseDirection.y };
+				const float t0z{ (node.minZ[slot] - origin.z) * inverseDirection.z };
+				const float t1x{ (node.maxX[slot] - origin.x) * inverseDirection.x };
+				const float t1y{ (node.maxY[slot] - origin.y) * inverseDirection.y };
+				const float t1z{ (node.maxZ[slot] - origin.z) * inverseDirection.z };
+
+				const float nearT{ std::max(std::max(std::min(t0x, t1x), std::min(t0y, t1y)), std::max(std::min(t0z, t1z), tMin)) };
+				const float farT{ std::min(std::min(std::max(t0x, t1x), std::max(t0y, t1y)), std::max(t0z, t1z)) * g_RobustFarScale };
+				pDistances[slot] = nearT;
+				if (nearT <= std::min(farT, tMax))
+					hitMask |= 1u << slot;
+			}
+			return hitMask;
+		}
+
+		static int IntersectPacket(const SpherePacket<8>& packet, const Ray& ray, float& t)
+		{
+			return IntersectSpheres_Scalar(&packet, 1, ray, t);
+		}
+	};
+
+	int IntersectSphereBVH_Scalar(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray, float& t)
+	{
+		return TraverseSphereBVH<BVHKernels_Scalar, false>(pNodes, pPackets, ray, t);
+	}
+
+	bool HitTestSphereBVH_Scalar(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray)
+	{
+		float t{ FLT_MAX };
+		return TraverseSphereBVH<BVHKernels_Scalar, true>(pNodes, pPackets, ray, t) >= 0;
+	}
+
+	void RasterizeSphere_Scalar(const Sphere& sphere, uint32_t primitive, const VisibilitySpan& span)
+	{
+		Ray ray{ span.origin };
+		ray.min = span.rayMin;
+		for (uint32_t index{}; index < span.count; ++index)
+		{
+			ray.direction = { span.pDirections[0][index], span.pDirections[1][index], span.pDirections[2][index] };
+			float t{};
+			if (GeometryUtils::Intersect_Sphere(sphere, ray, t) && t < span.pDepths[index])
+			{
+				span.pDepths[index] = t;
+				span.pPrimitives[index] = primitive;
+			}
+		}
+	}
+
+	void ResolveRadiance(const RadianceStreams& streams, uint32_t begin, uint32_t end)
+	{
+		for (uint32_t ray{ begin }; ray < end; ++ray)
+		{
+			ColorRGB radiance{ 0,0,0 };
+			for (uint32_t light{}; light < streams.numLights; ++light)
+			{
+				const size_t index{ static_cast<size_t>(ray) * streams.numLights + light };
+				radiance += { streams.pContributions[0][index], streams.pContributions[1][index], streams.pContributions[2][index] };
+				radiance *= streams.pShadowFactors[index];
+			}
+
+			streams.pRadiances[0][ray] = streams.pThroughputs[0][ray] * radiance.r;
+			streams.pRadiances[1][ray] = streams.pThroughputs[1][ray] * radiance.g;
+			streams.pRadiances[2][ray] = streams.pThroughputs[2][ray] * radiance.b;
+		}
+	}
+
+	void Tonemap_Scalar(const ColorRGB* pColors, float scale, uint32_t* pPixels, uint32_t count, const PixelLayout& layout)
+	{
+		for (uint32_t index{}; index < count; ++index)
+		{
+			ColorRGB color{ pColors[index] * scale };
+			color.MaxToOne();
+
+			pPixels[index] = (static_cast<uint32_t>(static_cast<uint8_t>(color.r * 255)) << layout.redShift)
+				| (static_cast<uint32_t>(static_cast<uint8_t>(color.g * 255)) << layout.greenShift)
+				| (static_cast<uint32_t>(static_cast<uint8_t>(color.b * 255)) << layout.blueShift) | layout.alphaMask;
+		}
+	}
+#pragma endregion
+
+#pragma region SSE4.2
+	int IntersectSpheres_SSE42(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray, float& t)
+	{
+		int hitIndex{ -1 };
+		for (uint32_t packetIndex{}; packetIndex < numPackets; ++packetIndex)
+		{
+			for (int firstLane{}; firstLane < 8; firstLane += 4)
+			{
+				const int lane{ GeometryUtils::Intersect_SphereLanes(pPackets[packetIndex], firstLane, ray, t) };
+				if (lane >= 0)
+					hitIndex = static_cast<int>(packetIndex * 8 + lane);
+			}
+		}
+		return hitIndex;
+	}
+
+	bool HitTestSpheres_SSE42(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray)
+	{
+		for (uint32_t packetIndex{}; packetIndex < numPackets; ++packetIndex)
+		{
+			float t{ FLT_MAX };
+			if (GeometryUtils::Intersect_SphereLanes(pPackets[packetIndex], 0, ray, t) >= 0 || GeometryUtils::Intersect_SphereLanes(pPackets[packetIndex], 4, ray, t) >= 0)
+				return true;
+		}
+		return false;
+	}
+
+	struct BVHKernels_SSE42
+	{
+		DAE_TARGET_SSE42 static uint32_t IntersectChildren(const BVHNode& node, const Vector3& origin, const Vector3& inverseDirection, float tMin, float tMax,
+			float* pDistances)
+		{
+			const __m128 originX{ _mm_set1_ps(origin.x) }, originY{ _mm_set1_ps(origin.y) }, originZ{ _mm_set1_ps(origin.z) };
+			const __m128 inverseX{ _mm_set1_ps(inverseDirection.x) }, inverseY{ _mm_set1_ps(inverseDirection.y) }, inverseZ{ _mm_set1_ps(inverseDirection.z) };
+
+			uint32_t hitMask{};
+			for (int half{}; half < BVHNode::width; half += 4)
+			{
+				const __m128 t0x{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX + half), originX), inverseX) };
+				const __m128 t0y{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY + half), originY), inverseY) };
+				const __m128 t0z{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ + half), originZ), inverseZ) };
+				const __m128 t1x{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX + half), originX), inverseX) };
+				const __m128 t1y{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY + half), originY), inverseY) };
+				const __m128 t1z{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ + half), originZ), inverseZ) };
+
+				const __m128 nearT{ _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(tMin))) };
+				const __m128 farT{ _mm_min_ps(_mm_mul_ps(_mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_max_ps(t0z, t1z)),
+					_mm_set1_ps(g_RobustFarScale)), _mm_set1_ps(tMax)) };
+				_mm_store_ps(pDistances + half, nearT);
+				hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(nearT, farT))) << half;
+			}
+			return hitMask & ((1u << node.numChildren) - 1);
+		}
+
+		DAE_TARGET_SSE42 static int IntersectPacket(const SpherePacket<8>& packet, const Ray& ray, float& t)
+		{
+			const int lowerLane{ GeometryUtils::Intersect_SphereLanes(packet, 0, ray, t) };
+			const int upperLane{ GeometryUtils::Intersect_SphereLanes(packet, 4, ray, t) };
+			return upperLane >= 0 ? upperLane : lowerLane;
+		}
+	};
+
+	DAE_TARGET_SSE42 int IntersectSphereBVH_SSE42(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray, float& t)
+	{
+		return TraverseSphereBVH<BVHKernels_SSE42, false>(pNodes, pPackets, ray, t);
+	}
+
+	DAE_TARGET_SSE42 bool HitTestSphereBVH_SSE42(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray)
+	{
+		float t{ FLT_MAX };
+		return TraverseSphereBVH<BVHKernels_SSE42, true>(pNodes, pPackets, ray, t) >= 0;
+	}
+
+	// Rows of pStream at rays [ray, ray + 4) for one light, strided by the number of lights
+	DAE_TARGET_SSE42 __m128 GatherLights4(const float* pStream, size_t firstIndex, uint32_t numLights)
+	{
+		return _mm_setr_ps(pStream[firstIndex], pStream[firstIndex + numLights], pStream[firstIndex + 2 * numLights], pStream[firstIndex + 3 * numLights]);
+	}
+
+	// Intersect_SphereLanes with the sphere in every lane and a ray per lane
+	DAE_TARGET_SSE42 void RasterizeSphere_SSE42(const Sphere& sphere, uint32_t primitive, const VisibilitySpan& span)
+	{
+		const __m128 toRayX{ _mm_set1_ps(span.origin.x - sphere.origin.x) };
+		const __m128 toRayY{ _mm_set1_ps(span.origin.y - sphere.origin.y) };
+		const __m128 toRayZ{ _mm_set1_ps(span.origin.z - sphere.origin.z) };
+		const __m128 radiusSquared{ _mm_set1_ps(sphere.radius * sphere.radius) };
+		const __m128 c{ _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, toRayX), _mm_mul_ps(toRayY, toRayY)), _mm_mul_ps(toRayZ, toRayZ)),
+			radiusSquared) };
+		const __m128 signMask{ _mm_set1_ps(-0.f) };
+		const __m128 rayMin{ _mm_set1_ps(span.rayMin) };
+		const __m128 rayMax{ _mm_set1_ps(FLT_MAX) };
+		const __m128 primitives{ _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(primitive))) };
+
+		uint32_t index{};
+		for (; index + 4 <= span.count; index += 4)
+		{
+			const __m128 directionX{ _mm_loadu_ps(span.pDirections[0] + index) };
+			const __m128 directionY{ _mm_loadu_ps(span.pDirections[1] + index) };
+			const __m128 directionZ{ _mm_loadu_ps(span.pDirections[2] + index) };
+
+			const __m128 projection{ _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, directionX), _mm_mul_ps(toRayY, directionY)),
+				_mm_mul_ps(toRayZ, directionZ))) };
+			const __m128 perpendicularX{ _mm_add_ps(toRayX, _mm_mul_ps(projection, directionX)) };
+			const __m128 perpendicularY{ _mm_add_ps(toRayY, _mm_mul_ps(projection, directionY)) };
+			const __m128 perpendicularZ{ _mm_add_ps(toRayZ, _mm_mul_ps(projection, directionZ)) };
+			const __m128 discriminant{ _mm_sub_ps(radiusSquared, _mm_add_ps(_mm_add_ps(_mm_mul_ps(perpendicularX, perpendicularX),
+				_mm_mul_ps(perpendicularY, perpendicularY)), _mm_mul_ps(perpendicularZ, perpendicularZ))) };
+
+			const __m128 root{ _mm_or_ps(_mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps())), _mm_and_ps(projection, signMask)) };
+			const __m128 q{ _mm_add_ps(projection, root) };
+			const __m128 cOverQ{ _mm_div_ps(c, q) };
+			const __m128 t0{ _mm_min_ps(cOverQ, q) };
+			const __m128 t1{ _mm_max_ps(cOverQ, q) };
+
+			const __m128 depth{ _mm_loadu_ps(span.pDepths + index) };
+			const __m128 candidate{ _mm_blendv_ps(t1, t0, _mm_cmpge_ps(t0, rayMin)) };
+			const __m128 isHit{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), _mm_cmpge_ps(candidate, rayMin)),
+				_mm_and_ps(_mm_cmple_ps(candidate, rayMax), _mm_cmplt_ps(candidate, depth))) };
+
+			float* pPrimitives{ reinterpret_cast<float*>(span.pPrimitives + index) };
+			_mm_storeu_ps(span.pDepths + index, _mm_blendv_ps(depth, candidate, isHit));
+			_mm_storeu_ps(pPrimitives, _mm_blendv_ps(_mm_loadu_ps(pPrimitives), primitives, isHit));
+		}
+		RasterizeSphere_Scalar(sphere, primitive, GetSpanTail(span, index));
+	}
+
+	DAE_TARGET_SSE42 void ResolveRadiance_SSE42(const RadianceStreams& streams, uint32_t begin, uint32_t end)
+	{
+		uint32_t ray{ begin };
+		for (; ray + 4 <= end; ray += 4)
+		{
+			__m128 radiance[3]{ _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+			for (uint32_t light{}; light < streams.numLights; ++light)
+			{
+				const size_t index{ static_cast<size_t>(ray) * streams.numLights + light };
+				const __m128 shadowFactor{ GatherLights4(streams.pShadowFactors, index, streams.numLights) };
+				for (int channel{}; channel < 3; ++channel)
+					radiance[channel] = _mm_mul_ps(_mm_add_ps(radiance[channel], GatherLights4(streams.pContributions[channel], index, streams.numLights)), shadowFactor);
+			}
+
+			for (int channel{}; channel < 3; ++channel)
+				_mm_storeu_ps(streams.pRadiances[channel] + ray, _mm_mul_ps(_mm_loadu_ps(streams.pThroughputs[channel] + ray), radiance[channel]));
+		}
+		ResolveRadiance(streams, ray, end);
+	}
+
+	// Four colors from r g b r | g b r g | b r g b into one register per channel
+	DAE_TARGET_SSE42 void LoadColors4(const ColorRGB* pColors, __m128& r, __m128& g, __m128& b)
+	{
+		const float* pFloats{ &pColors->r };
+		const __m128 v0{ _mm_loadu_ps(pFloats) };
+		const __m128 v1{ _mm_loadu_ps(pFloats + 4) };
+		const __m128 v2{ _mm_loadu_ps(pFloats + 8) };
+
+		const __m128 r2g2b2r3{ _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 0, 3, 2)) };
+		const __m128 g0b0g1b1{ _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 0, 2, 1)) };
+		const __m128 g2g2g3b3{ _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(3, 2, 3, 3)) };
+		const __m128 b2b2b3b3{ _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0)) };
+
+		r = _mm_shuffle_ps(v0, r2g2b2r3, _MM_SHUFFLE(3, 0, 3, 0));
+		g = _mm_shuffle_ps(g0b0g1b1, g2g2g3b3, _MM_SHUFFLE(2, 0, 2, 0));
+		b = _mm_shuffle_ps(g0b0g1b1, b2b2b3b3, _MM_SHUFFLE(2, 0, 3, 1));
+	}
+
+	// static_cast<uint8_t>(channel * 255) shifted into place, truncated and wrapped like the scalar conversion
+	DAE_TARGET_SSE42 __m128i PackChannel4(__m128 channel, int shift)
+	{
+		const __m128i value{ _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(channel, _mm_set1_ps(255.f))), _mm_set1_epi32(0xff)) };
+		return _mm_sll_epi32(value, _mm_cvtsi32_si128(shift));
+	}
+
+	DAE_TARGET_SSE42 void Tonemap_SSE42(const ColorRGB* pColors, float scale, uint32_t* pPixels, uint32_t count, const PixelLayout& layout)
+	{
+		const __m128 scales{ _mm_set1_ps(scale) };
+		const __m128 ones{ _mm_set1_ps(1.f) };
+
+		uint32_t index{};
+		for (; index + 4 <= count; index += 4)
+		{
+			__m128 r{}, g{}, b{};
+			LoadColors4(pColors + index, r, g, b);
+			r = _mm_mul_ps(r, scales);
+			g = _mm_mul_ps(g, scales);
+			b = _mm_mul_ps(b, scales);
+
+			// Operands swapped so NaNs pick the same channel as std::max
+			const __m128 maxValue{ _mm_max_ps(_mm_max_ps(b, g), r) };
+			const __m128 divisor{ _mm_blendv_ps(ones, maxValue, _mm_cmpgt_ps(maxValue, ones)) };
+			r = _mm_div_ps(r, divisor);
+			g = _mm_div_ps(g, divisor);
+			b = _mm_div_ps(b, divisor);
+
+			const __m128i pixels{ _mm_or_si128(_mm_or_si128(PackChannel4(r, layout.redShift), PackChannel4(g, layout.greenShift)),
+				_mm_or_si128(PackChannel4(b, layout.blueShift), _mm_set1_epi32(static_cast<int>(layout.alphaMask)))) };
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + index), pixels);
+		}
+		Tonemap_Scalar(pColors + index, scale, pPixels + index, count - index, layout);
+	}
+#pragma endregion
+
+#pragma region AVX2
+	DAE_TARGET_AVX2 int IntersectSpheres_AVX2(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray, float& t)
+	{
+		int hitIndex{ -1 };
+		for (uint32_t packetIndex{}; packetIndex < numPackets; ++packetIndex)
+		{
+			const int lane{ GeometryUtils::Intersect_SpherePacket(pPackets[packetIndex], ray, t) };
+			if (lane >= 0)
+				hitIndex = static_cast<int>(packetIndex * 8 + lane);
+		}
+		return hitIndex;
+	}
+
+	DAE_TARGET_AVX2 bool HitTestSpheres_AVX2(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray)
+	{
+		for (uint32_t packetIndex{}; packetIndex < numPackets; ++packetIndex)
+		{
+			if (GeometryUtils::HitTest_SpherePacket(pPackets[packetIndex], ray))
+				return true;
+		}
+		return false;
+	}
+
+	struct BVHKernels_AVX2
+	{
+		DAE_TARGET_AVX2 static uint32_t IntersectChildren(const BVHNode& node, const Vector3& origin, const Vector3& inverseDirection, float tMin, float tMax,
+			float* pDistances)
+		{
+			const __m256 originX{ _mm256_set1_ps(origin.x) }, originY{ _mm256_set1_ps(origin.y) }, originZ{ _mm256_set1_ps(origin.z) };
+			const __m256 inverseX{ _mm256_set1_ps(inverseDirection.x) }, inverseY{ _mm256_set1_ps(inverseDirection.y) }, inverseZ{ _mm256_set1_ps(inverseDirection.z) };
+
+			const __m256 t0x{ _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minX), originX), inverseX) };
+			const __m256 t0y{ _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minY), originY), inverseY) };
+			const __m256 t0z{ _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.minZ), originZ), inverseZ) };
+			const __m256 t1x{ _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxX), originX), inverseX) };
+			const __m256 t1y{ _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxY), originY), inverseY) };
+			const __m256 t1z{ _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.maxZ), originZ), inverseZ) };
+
+			const __m256 nearT{ _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t0x, t1x), _mm256_min_ps(t0y, t1y)),
+				_mm256_max_ps(_mm256_min_ps(t0z, t1z), _mm256_set1_ps(tMin))) };
+			const __m256 farT{ _mm256_min_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t0x, t1x), _mm256_max_ps(t0y, t1y)), _mm256_max_ps(t0z, t1z)),
+				_mm256_set1_ps(g_RobustFarScale)), _mm256_set1_ps(tMax)) };
+			_mm256_store_ps(pDistances, nearT);
+			return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(nearT, farT, _CMP_LE_OQ))) & ((1u << node.numChildren) - 1);
+		}
+
+		DAE_TARGET_AVX2 static int IntersectPacket(const SpherePacket<8>& packet, const Ray& ray, float& t)
+		{
+			return GeometryUtils::Intersect_SpherePacket(packet, ray, t);
+		}
+	};
+
+	DAE_TARGET_AVX2 int IntersectSphereBVH_AVX2(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray, float& t)
+	{
+		return TraverseSphereBVH<BVHKernels_AVX2, false>(pNodes, pPackets, ray, t);
+	}
+
+	DAE_TARGET_AVX2 bool HitTestSphereBVH_AVX2(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray)
+	{
+		float t{ FLT_MAX };
+		return TraverseSphereBVH<BVHKernels_AVX2, true>(pNodes, pPackets, ray, t) >= 0;
+	}
+
+	DAE_TARGET_AVX2 void RasterizeSphere_AVX2(const Sphere& sphere, uint32_t primitive, const VisibilitySpan& span)
+	{
+		const __m256 toRayX{ _mm256_set1_ps(span.origin.x - sphere.origin.x) };
+		const __m256 toRayY{ _mm256_set1_ps(span.origin.y - sphere.origin.y) };
+		const __m256 toRayZ{ _mm256_set1_ps(span.origin.z - sphere.origin.z) };
+		const __m256 radiusSquared{ _mm256_set1_ps(sphere.radius * sphere.radius) };
+		const __m256 c{ _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, toRayX), _mm256_mul_ps(toRayY, toRayY)), _mm256_mul_ps(toRayZ, toRayZ)),
+			radiusSquared) };
+		const __m256 signMask{ _mm256_set1_ps(-0.f) };
+		const __m256 rayMin{ _mm256_set1_ps(span.rayMin) };
+		const __m256 rayMax{ _mm256_set1_ps(FLT_MAX) };
+		const __m256 primitives{ _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(primitive))) };
+
+		uint32_t index{};
+		for (; index + 8 <= span.count; index += 8)
+		{
+			const __m256 directionX{ _mm256_loadu_ps(span.pDirections[0] + index) };
+			const __m256 directionY{ _mm256_loadu_ps(span.pDirections[1] + index) };
+			const __m256 directionZ{ _mm256_loadu_ps(span.pDirections[2] + index) };
+
+			const __m256 projection{ _mm256_sub_ps(_mm256_setzero_ps(), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, directionX), _mm256_mul_ps(toRayY, directionY)),
+				_mm256_mul_ps(toRayZ, directionZ))) };
+			const __m256 perpendicularX{ _mm256_add_ps(toRayX, _mm256_mul_ps(projection, directionX)) };
+			const __m256 perpendicularY{ _mm256_add_ps(toRayY, _mm256_mul_ps(projection, directionY)) };
+			const __m256 perpendicularZ{ _mm256_add_ps(toRayZ, _mm256_mul_ps(projection, directionZ)) };
+			const __m256 discriminant{ _mm256_sub_ps(radiusSquared, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(perpendicularX, perpendicularX),
+				_mm256_mul_ps(perpendicularY, perpendicularY)), _mm256_mul_ps(perpendicularZ, perpendicularZ))) };
+
+			const __m256 root{ _mm256_or_ps(_mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps())), _mm256_and_ps(projection, signMask)) };
+			const __m256 q{ _mm256_add_ps(projection, root) };
+			const __m256 cOverQ{ _mm256_div_ps(c, q) };
+			const __m256 t0{ _mm256_min_ps(cOverQ, q) };
+			const __m256 t1{ _mm256_max_ps(cOverQ, q) };
+
+			const __m256 depth{ _mm256_loadu_ps(span.pDepths + index) };
+			const __m256 candidate{ _mm256_blendv_ps(t1, t0, _mm256_cmp_ps(t0, rayMin, _CMP_GE_OQ)) };
+			const __m256 isHit{ _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(candidate, rayMin, _CMP_GE_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(candidate, rayMax, _CMP_LE_OQ), _mm256_cmp_ps(candidate, depth, _CMP_LT_OQ))) };
+
+			float* pPrimitives{ reinterpret_cast<float*>(span.pPrimitives + index) };
+			_mm256_storeu_ps(span.pDepths + index, _mm256_blendv_ps(depth, candidate, isHit));
+			_mm256_storeu_ps(pPrimitives, _mm256_blendv_ps(_mm256_loadu_ps(pPrimitives), primitives, isHit));
+		}
+		RasterizeSphere_SSE42(sphere, primitive, GetSpanTail(span, index));
+	}
+
+	DAE_TARGET_AVX2 void ResolveRadiance_AVX2(const RadianceStreams& streams, uint32_t begin, uint32_t end)
+	{
+		const __m256i laneOffsets{ _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(streams.numLights))) };
+
+		uint32_t ray{ begin };
+		for (; ray + 8 <= end; ray += 8)
+		{
+			__m256 radiance[3]{ _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+			for (uint32_t light{}; light < streams.numLights; ++light)
+			{
+				const size_t index{ static_cast<size_t>(ray) * streams.numLights + light };
+				const __m256 shadowFactor{ _mm256_i32gather_ps(streams.pShadowFactors + index, laneOffsets, 4) };
+
+				for (int channel{}; channel < 3; ++channel)
+				{
+					const __m256 contribution{ _mm256_i32gather_ps(streams.pContributions[channel] + index, laneOffsets, 4) };
+					radiance[channel] = _mm256_mul_ps(_mm256_add_ps(radiance[channel], contribution), shadowFactor);
+				}
+			}
+
+			for (int channel{}; channel < 3; ++channel)
+				_mm256_storeu_ps(streams.pRadiances[channel] + ray, _mm256_mul_ps(_mm256_loadu_ps(streams.pThroughputs[channel] + ray), radiance[channel]));
+		}
+		ResolveRadiance(streams, ray, end);
+	}
+
+	DAE_TARGET_AVX2 __m256i PackChannel8(__m256 channel, int shift)
+	{
+		const __m256i value{ _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(channel, _mm256_set1_ps(255.f))), _mm256_set1_epi32(0xff)) };
+		return _mm256_sll_epi32(value, _mm_cvtsi32_si128(shift));
+	}
+
+	DAE_TARGET_AVX2 void Tonemap_AVX2(const ColorRGB* pColors, float scale, uint32_t* pPixels, uint32_t count, const PixelLayout& layout)
+	{
+		const __m256 scales{ _mm256_set1_ps(scale) };
+		const __m256 ones{ _mm256_set1_ps(1.f) };
+
+		uint32_t index{};
+		for (; index + 8 <= count; index += 8)
+		{
+			__m128 r0{}, g0{}, b0{}, r1{}, g1{}, b1{};
+			LoadColors4(pColors + index, r0, g0, b0);
+			LoadColors4(pColors + index + 4, r1, g1, b1);
+			__m256 r{ _mm256_mul_ps(_mm256_set_m128(r1, r0), scales) };
+			__m256 g{ _mm256_mul_ps(_mm256_set_m128(g1, g0), scales) };
+			__m256 b{ _mm256_mul_ps(_mm256_set_m128(b1, b0), scales) };
+
+			const __m256 maxValue{ _mm256_max_ps(_mm256_max_ps(b, g), r) };
+			const __m256 divisor{ _mm256_blendv_ps(ones, maxValue, _mm256_cmp_ps(maxValue, ones, _CMP_GT_OQ)) };
+			r = _mm256_div_ps(r, divisor);
+			g = _mm256_div_ps(g, divisor);
+			b = _mm256_div_ps(b, divisor);
+
+			const __m256i pixels{ _mm256_or_si256(_mm256_or_si256(PackChannel8(r, layout.redShift), PackChannel8(g, layout.greenShift)),
+				_mm256_or_si256(PackChannel8(b, layout.blueShift), _mm256_set1_epi32(static_cast<int>(layout.alphaMask)))) };
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pPixels + index), pixels);
+		}
+		Tonemap_SSE42(pColors + index, scale, pPixels + index, count - index, layout);
+	}
+#pragma endregion
+
+#pragma region AVX-512
+	// Pairs with a leftover packet, so every sphere goes through the sixteen lane math and rounds the same whichever packet it is in
+	const SpherePacket<8> g_EmptyPacket{};
+
+	DAE_TARGET_AVX512 int IntersectSpheres_AVX512(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray, float& t)
+	{
+		int hitIndex{ -1 };
+		for (uint32_t packetIndex{}; packetIndex < numPackets; packetIndex += 2)
+		{
+			const SpherePacket<8>& second{ packetIndex + 1 < numPackets ? pPackets[packetIndex + 1] : g_EmptyPacket };
+			const int lane{ GeometryUtils::Intersect_SpherePackets(pPackets[packetIndex], second, ray, t) };
+			if (lane >= 0)
+				hitIndex = static_cast<int>(packetIndex * 8 + lane);
+		}
+		return hitIndex;
+	}
+
+	DAE_TARGET_AVX512 bool HitTestSpheres_AVX512(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray)
+	{
+		for (uint32_t packetIndex{}; packetIndex < numPackets; packetIndex += 2)
+		{
+			const SpherePacket<8>& second{ packetIndex + 1 < numPackets ? pPackets[packetIndex + 1] : g_EmptyPacket };
+			float t{ FLT_MAX };
+			if (GeometryUtils::Intersect_SpherePackets(pPackets[packetIndex], second, ray, t) >= 0)
+				return true;
+		}
+		return false;
+	}
+
+	// Nodes are eight wide and tested as in AVX2, sixteen lanes would only test empty children. Leaves round like the other AVX-512 kernels
+	struct BVHKernels_AVX512
+	{
+		DAE_TARGET_AVX512 static uint32_t IntersectChildren(const BVHNode& node, const Vector3& origin, const Vector3& inverseDirection, float tMin, float tMax,
+			float* pDistances)
+		{
+			return BVHKernels_AVX2::IntersectChildren(node, origin, inverseDirection, tMin, tMax, pDistances);
+		}
+
+		DAE_TARGET_AVX512 static int IntersectPacket(const SpherePacket<8>& packet, const Ray& ray, float& t)
+		{
+			return GeometryUtils::Intersect_SpherePackets(packet, g_EmptyPacket, ray, t);
+		}
+	};
+
+	DAE_TARGET_AVX512 int IntersectSphereBVH_AVX512(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray, float& t)
+	{
+		return TraverseSphereBVH<BVHKernels_AVX512, false>(pNodes, pPackets, ray, t);
+	}
+
+	DAE_TARGET_AVX512 bool HitTestSphereBVH_AVX512(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray)
+	{
+		float t{ FLT_MAX };
+		return TraverseSphereBVH<BVHKernels_AVX512, true>(pNodes, pPackets, ray, t) >= 0;
+	}
+
+	// Sixteen rays per step through Intersect_SphereLanes16, the last step masks off the rays past the span instead of leaving a tail
+	DAE_TARGET_AVX512 void RasterizeSphere_AVX512(const Sphere& sphere, uint32_t primitive, const VisibilitySpan& span)
+	{
+		const __m512 toRayX{ _mm512_set1_ps(span.origin.x - sphere.origin.x) };
+		const __m512 toRayY{ _mm512_set1_ps(span.origin.y - sphere.origin.y) };
+		const __m512 toRayZ{ _mm512_set1_ps(span.origin.z - sphere.origin.z) };
+		const __m512 radiusSquared{ _mm512_set1_ps(sphere.radius * sphere.radius) };
+		const __m512 rayMin{ _mm512_set1_ps(span.rayMin) };
+		const __m512 rayMax{ _mm512_set1_ps(FLT_MAX) };
+		const __m512i primitives{ _mm512_set1_epi32(static_cast<int>(primitive)) };
+
+		for (uint32_t index{}; index < span.count; index += 16)
+		{
+			const __mmask16 lanes{ static_cast<__mmask16>(span.count - index >= 16 ? 0xffffu : (1u << (span.count - index)) - 1) };
+			const __m512 depth{ _mm512_maskz_loadu_ps(lanes, span.pDepths + index) };
+			__m512 candidate{};
+			const __mmask16 isHit{ static_cast<__mmask16>(lanes & GeometryUtils::Intersect_SphereLanes16(toRayX, toRayY, toRayZ,
+				_mm512_maskz_loadu_ps(lanes, span.pDirections[0] + index), _mm512_maskz_loadu_ps(lanes, span.pDirections[1] + index),
+				_mm512_maskz_loadu_ps(lanes, span.pDirections[2] + index), radiusSquared, rayMin, rayMax, depth, candidate)) };
+
+			_mm512_mask_storeu_ps(span.pDepths + index, isHit, candidate);
+			_mm512_mask_storeu_epi32(span.pPrimitives + index, isHit, primitives);
+		}
+	}
+
+	DAE_TARGET_AVX512 void ResolveRadiance_AVX512(const RadianceStreams& streams, uint32_t begin, uint32_t end)
+	{
+		const __m512i laneOffsets{ _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+			_mm512_set1_epi32(static_cast<int>(streams.numLights))) };
+
+		uint32_t ray{ begin };
+		for (; ray + 16 <= end; ray += 16)
+		{
+			__m512 radiance[3]{ _mm512_setzero_ps(), _mm512_setzero_ps(), _mm512_setzero_ps() };
+			for (uint32_t light{}; light < streams.numLights; ++light)
+			{
+				const size_t index{ static_cast<size_t>(ray) * streams.numLights + light };
+				const __m512 shadowFactor{ _mm512_i32gather_ps(laneOffsets, streams.pShadowFactors + index, 4) };
+
+				for (int channel{}; channel < 3; ++channel)
+				{
+					const __m512 contribution{ _mm512_i32gather_ps(laneOffsets, streams.pContributions[channel] + index, 4) };
+					radiance[channel] = _mm512_mul_ps(_mm512_add_ps(radiance[channel], contribution), shadowFactor);
+				}
+			}
+
+			for (int channel{}; channel < 3; ++channel)
+				_mm512_storeu_ps(streams.pRadiances[channel] + ray, _mm512_mul_ps(_mm512_loadu_ps(streams.pThroughputs[channel] + ray), radiance[channel]));
+		}
+		ResolveRadiance_AVX2(streams, ray, end);
+	}
+
+	DAE_TARGET_AVX512 __m512i PackChannel16(__m512 channel, int shift)
+	{
+		const __m512i value{ _mm512_and_si512(_mm512_cvttps_epi32(_mm512_mul_ps(channel, _mm512_set1_ps(255.f))), _mm512_set1_epi32(0xff)) };
+		return _mm512_sll_epi32(value, _mm_cvtsi32_si128(shift));
+	}
+
+	DAE_TARGET_AVX512 __m512 Combine16(const __m128 quarters[4])
+	{
+		const __m512 lower{ _mm512_insertf32x4(_mm512_castps128_ps512(quarters[0]), quarters[1], 1) };
+		return _mm512_insertf32x4(_mm512_insertf32x4(lower, quarters[2], 2), quarters[3], 3);
+	}
+
+	DAE_TARGET_AVX512 void Tonemap_AVX512(const ColorRGB* pColors, float scale, uint32_t* pPixels, uint32_t count, const PixelLayout& layout)
+	{
+		const __m512 scales{ _mm512_set1_ps(scale) };
+		const __m512 ones{ _mm512_set1_ps(1.f) };
+
+		uint32_t index{};
+		for (; index + 16 <= count; index += 16)
+		{
+			__m128 quarterR[4]{}, quarterG[4]{}, quarterB[4]{};
+			for (int quarter{}; quarter < 4; ++quarter)
+				LoadColors4(pColors + index + quarter * 4, quarterR[quarter], quarterG[quarter], quarterB[quarter]);
+			__m512 r{ _mm512_mul_ps(Combine16(quarterR), scales) };
+			__m512 g{ _mm512_mul_ps(Combine16(quarterG), scales) };
+			__m512 b{ _mm512_mul_ps(Combine16(quarterB), scales) };
+
+			const __m512 maxValue{ _mm512_max_ps(_mm512_max_ps(b, g), r) };
+			const __m512 divisor{ _mm512_mask_blend_ps(_mm512_cmp_ps_mask(maxValue, ones, _CMP_GT_OQ), ones, maxValue) };
+			r = _mm512_div_ps(r, divisor);
+			g = _mm512_div_ps(g, divisor);
+			b = _mm512_div_ps(b, divisor);
+
+			const __m512i pixels{ _mm512_or_si512(_mm512_or_si512(PackChannel16(r, layout.redShift), PackChannel16(g, layout.greenShift)),
+				_mm512_or_si512(PackChannel16(b, layout.blueShift), _mm512_set1_epi32(static_cast<int>(layout.alphaMask)))) };
+			_mm512_storeu_si512(pPixels + index, pixels);
+		}
+		Tonemap_AVX2(pColors + index, scale, pPixels + index, count - index, layout);
+	}
+#pragma endregion
+
+	constexpr KernelTable g_KernelTables[]
+	{
+		{ InstructionSet::Scalar, IntersectSpheres_Scalar, HitTestSpheres_Scalar, IntersectSphereBVH_Scalar, HitTestSphereBVH_Scalar,
+			RasterizeSphere_Scalar, ResolveRadiance, Tonemap_Scalar },
+		{ InstructionSet::SSE42, IntersectSpheres_SSE42, HitTestSpheres_SSE42, IntersectSphereBVH_SSE42, HitTestSphereBVH_SSE42,
+			RasterizeSphere_SSE42, ResolveRadiance_SSE42, Tonemap_SSE42 },
+		{ InstructionSet::AVX2, IntersectSpheres_AVX2, HitTestSpheres_AVX2, IntersectSphereBVH_AVX2, HitTestSphereBVH_AVX2,
+			RasterizeSphere_AVX2, ResolveRadiance_AVX2, Tonemap_AVX2 },
+		{ InstructionSet::AVX512, IntersectSpheres_AVX512, HitTestSpheres_AVX512, IntersectSphereBVH_AVX512, HitTestSphereBVH_AVX512,
+			RasterizeSphere_AVX512, ResolveRadiance_AVX512, Tonemap_AVX512 },
+	};
+	static_assert(std::size(g_KernelTables) == static_cast<size_t>(InstructionSet::Count));
+}
+
+const KernelTable& dae::GetKernels()
+{
+	static const KernelTable& kernels{ GetKernels(GetInstructionSet()) };
+	return kernels;
+}
+
+const KernelTable& dae::GetKernels(InstructionSet instructionSet)
+{
+	return g_KernelTables[static_cast<int>(instructionSet)];
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+
+#include "BVH.h"
+#include "CpuFeatures.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Where the channels go in a 32 bit pixel with 8 bits per channel, like every surface the renderer writes to
+	struct PixelLayout
+	{
+		int redShift{ 16 };
+		int greenShift{ 8 };
+		int blueShift{};
+		uint32_t alphaMask{ 0xff000000u }; // Opaque alpha, 0 for formats without one
+	};
+
+	// Inputs and outputs of the wavefront radiance resolve, color channels as separate r, g and b streams
+	struct RadianceStreams
+	{
+		const float* pContributions[3]{}; // Per ray and light, at ray * numLights + light
+		const float* pShadowFactors{}; // Same layout, what the light is scaled by, 0.5 when it is blocked and 1 when not
+		uint32_t numLights{};
+		const float* pThroughputs[3]{}; // Per ray
+		float* pRadiances[3]{}; // Per ray, throughput times the light that reached it
+	};
+
+	// A run of camera rays from one origin, directions as separate x, y and z streams, and the closest hit of each ray so far
+	struct VisibilitySpan
+	{
+		Vector3 origin{};
+		float rayMin{};
+		const float* pDirections[3]{};
+		float* pDepths{}; // FLT_MAX where nothing was hit yet
+		uint32_t* pPrimitives{};
+		uint32_t count{};
+	};
+
+	/**
+	 * \brief The hot kernels compiled once per instruction set, see GetKernels.
+	 * Every variant produces bit identical results to the scalar one, only the intersections may round differently. Within a variant every
+	 * sphere intersection rounds the same, so rasterized and traced rays agree on the exact distance.
+	 */
+	struct KernelTable
+	{
+		InstructionSet instructionSet{};
+
+		// Closest sphere in [ray.min, ray.max] that is closer than t, returns its index or -1 and t unchanged
+		int (*intersectSpheres)(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray, float& t){};
+		// Any sphere in [ray.min, ray.max]
+		bool (*hitTestSpheres)(const SpherePacket<8>* pPackets, uint32_t numPackets, const Ray& ray){};
+		// Same as intersectSpheres through a tree whose leaf i is pPackets[i], nearest children first. Returns packet * 8 + lane or -1
+		int (*intersectSphereBVH)(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray, float& t){};
+		bool (*hitTestSphereBVH)(const BVHNode* pNodes, const SpherePacket<8>* pPackets, const Ray& ray){};
+
+		// Rays of the span that hit the sphere closer than their depth take its distance and primitive, the same t as intersectSpheres
+		void (*rasterizeSphere)(const Sphere& sphere, uint32_t primitive, const VisibilitySpan& span){};
+
+		// Per ray in [begin, end): light contributions summed in light order, everything so far halved by each occluded light, times the throughput
+		void (*resolveRadiance)(const RadianceStreams& streams, uint32_t begin, uint32_t end){};
+
+		// colors * scale scaled down to a maximum channel of 1 and packed into pixels, ColorRGB::MaxToOne followed by SDL_MapRGB
+		void (*tonemap)(const ColorRGB* pColors, float scale, uint32_t* pPixels, uint32_t count, const PixelLayout& layout){};
+	};
+
+	// Kernels of GetInstructionSet, chosen once
+	const KernelTable& GetKernels();
+	// Kernels of a specific instruction set, only call them when it is not above DetectInstructionSet
+	const KernelTable& GetKernels(InstructionSet instructionSet);
+}
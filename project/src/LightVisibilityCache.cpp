@@ -0,0 +1,102 @@
+#include "LightVisibilityCache.h"
+#include "Scene.h"
+
+#include <algorithm>
+
+using namespace dae;
+
+namespace
+{
+	// Grid coordinate along one axis, clamped so points far away still map to a cell. Rounds down without a call to floor
+	uint64_t GetCellCoordinate(float position, float cellsPerUnit)
+	{
+		const float cell{ std::clamp(position * cellsPerUnit, -1e9f, 1e9f) };
+		const int32_t truncated{ static_cast<int32_t>(cell) };
+		return static_cast<uint32_t>(truncated - (cell < truncated));
+	}
+
+	// 0 to 8, the component rounded to quarters
+	uint64_t GetNormalCoordinate(float component)
+	{
+		return static_cast<uint64_t>(std::clamp(component, -1.f, 1.f) * 4.f + 4.5f);
+	}
+}
+
+void LightVisibilityCache::Update(const Scene& scene)
+{
+	if (scene.GetContentGeneration() == m_SceneGeneration)
+		return;
+	m_SceneGeneration = scene.GetContentGeneration();
+
+	if (!m_pSlots)
+		m_pSlots = std::make_unique<std::atomic<uint64_t>[]>(numSlots);
+
+	// Cells of older generations no longer match. Before the generation comes around again every slot is cleared
+	if (++m_Generation == 0)
+	{
+		for (uint32_t index{}; index < numSlots; ++index)
+			m_pSlots[index].store(0, std::memory_order_relaxed);
+		m_Generation = 1;
+	}
+}
+
+void LightVisibilityCache::SetCellSize(float cellSize)
+{
+	if (cellSize == m_CellSize)
+		return;
+
+	m_CellSize = cellSize;
+	m_CellsPerUnit = 1.f / cellSize;
+	m_SceneGeneration = UINT64_MAX; // Cells of the old size cover other points
+}
+
+uint64_t LightVisibilityCache::GetKey(const Vector3& point, const Vector3& normal, uint32_t lightIndex) const
+{
+	const uint64_t words[4]{ GetCellCoordinate(point.x, m_CellsPerUnit), GetCellCoordinate(point.y, m_CellsPerUnit), GetCellCoordinate(point.z, m_CellsPerUnit),
+		GetNormalCoordinate(normal.x) | GetNormalCoordinate(normal.y) << 4 | GetNormalCoordinate(normal.z) << 8 | static_cast<uint64_t>(lightIndex) << 12 };
+
+	// FNV-1a over the words and the MurmurHash3 finalizer, the lower half picks the slot and the upper half tells cells in it apart
+	uint64_t key{ 0xcbf29ce484222325ull };
+	for (const uint64_t word : words)
+		key = (key ^ word) * 0x100000001b3ull;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdull;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ull;
+	key ^= key >> 33;
+	return key;
+}
+
+LightVisibilityCache::Visibility LightVisibilityCache::Find(uint64_t key) const
+{
+	const uint64_t slot{ m_pSlots[key & (numSlots - 1)].load(std::memory_order_relaxed) };
+	if (!IsCurrent(slot, key))
+		return Visibility::Unknown;
+
+	const uint64_t numVisible{ slot & m_CountMask };
+	const uint64_t numBlocked{ (slot >> m_BlockedShift) & m_CountMask };
+	if (numBlocked == 0 && numVisible >= confirmations)
+		return Visibility::Visible;
+	if (numVisible == 0 && numBlocked >= confirmations)
+		return Visibility::Blocked;
+	return Visibility::Unknown;
+}
+
+void LightVisibilityCache::Record(uint64_t key, bool isBlocked)
+{
+	std::atomic<uint64_t>& slot{ m_pSlots[key & (numSlots - 1)] };
+	const uint64_t emptySlot{ (key >> 32) << 32 | static_cast<uint64_t>(m_Generation) << m_GenerationShift };
+	const uint64_t increment{ isBlocked ? uint64_t{ 1 } << m_BlockedShift : uint64_t{ 1 } };
+	const uint64_t countMask{ isBlocked ? m_CountMask << m_BlockedShift : m_CountMask };
+
+	// Counts saturate, a cell that saw both answers stays undecided anyway
+	uint64_t expected{ slot.load(std::memory_order_relaxed) };
+	uint64_t desired{};
+	do
+	{
+		desired = IsCurrent(expected, key) ? expected : emptySlot;
+		if ((desired & countMask) == countMask)
+			return;
+		desired += increment;
+	} while (!slot.compare_exchange_weak(expected, desired, std::memory_order_relaxed));
+}
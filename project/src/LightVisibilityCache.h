@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Scene;
+
+	/**
+	 * \brief Whether lights are blocked at surface points, remembered per cell of a world space grid so shadow rays are traced once per cell.
+	 * A cell is a cube of the cell size along each axis, a normal rounded to quarters and a light. Cells live in a lossy hash table of numSlots,
+	 * a cell evicts whatever other cell was in its slot. Shadow rays of a cell are traced until confirmations of them agree, then the cell
+	 * answers for every point in it. Cells on a shadow edge see both answers and keep tracing. Smaller cells put fewer points on the
+	 * wrong side of a shadow edge that their cell did not see, at the cost of tracing more rays before cells answer.
+	 * Lookups and records are lock-free, so any number of threads may use the cache while no Update runs.
+	 */
+	class LightVisibilityCache final
+	{
+	public:
+		static constexpr float defaultCellSize{ 0.1f };
+		static constexpr uint32_t numSlots{ 1 << 20 };
+		static constexpr uint32_t confirmations{ 3 };
+
+		enum class Visibility
+		{
+			Unknown,
+			Visible,
+			Blocked
+		};
+
+		LightVisibilityCache() = default;
+		~LightVisibilityCache() = default;
+
+		LightVisibilityCache(const LightVisibilityCache&) = delete;
+		LightVisibilityCache(LightVisibilityCache&&) noexcept = delete;
+		LightVisibilityCache& operator=(const LightVisibilityCache&) = delete;
+		LightVisibilityCache& operator=(LightVisibilityCache&&) noexcept = delete;
+
+		// Forgets every cell when the scene's content changed since the last call
+		void Update(const Scene& scene);
+
+		// In world units, the next Update forgets every cell when it changes
+		void SetCellSize(float cellSize);
+		float GetCellSize() const { return m_CellSize; }
+
+		// Of the cell of point on a surface facing normal, lit by light lightIndex
+		uint64_t GetKey(const Vector3& point, const Vector3& normal, uint32_t lightIndex) const;
+
+		// Unknown until the cell's traced shadow rays agreed often enough
+		Visibility Find(uint64_t key) const;
+		void Record(uint64_t key, bool isBlocked); // A shadow ray traced in the cell
+
+	private:
+		// A slot holds the upper half of its cell's key, the generation it was recorded in and how many rays were visible and blocked
+		static constexpr int m_GenerationShift{ 16 };
+		static constexpr int m_BlockedShift{ 8 };
+		static constexpr uint64_t m_CountMask{ 0xff };
+
+		bool IsCurrent(uint64_t slot, uint64_t key) const { return (slot >> 32) == (key >> 32) && ((slot >> m_GenerationShift) & 0xffff) == m_Generation; }
+
+		std::unique_ptr<std::atomic<uint64_t>[]> m_pSlots{}; // All 0 until the first Update, which never matches a generation
+		uint16_t m_Generation{};
+		float m_CellSize{ defaultCellSize };
+		float m_CellsPerUnit{ 1.f / defaultCellSize };
+		uint64_t m_SceneGeneration{ UINT64_MAX };
+	};
+}
@@ -2,10 +2,39 @@
 #include "Maths.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
+#include "MemoryArena.h"
+#include "Sampling.h"
+#include "Serialization.h"
 
 namespace dae
 {
 #pragma region Material BASE
+	enum class MaterialType : uint8_t
+	{
+		SolidColor,
+		Lambert,
+		LambertPhong,
+		CookTorrence,
+		Dielectric
+	};
+
+	//Perfect specular part of a material, followed by the renderer as reflection and refraction rays
+	struct SpecularScatter
+	{
+		ColorRGB reflectance{};
+		ColorRGB transmittance{};
+		float ior{ 1.f };
+	};
+
+	//Bounce direction picked by a material for the path tracer
+	struct BSDFSample
+	{
+		Vector3 direction{};
+		ColorRGB weight{}; // BRDF * cos / pdf
+		float pdf{}; // Solid angle, 0 for perfectly specular bounces
+		bool isSpecular{};
+	};
+
 	class Material
 	{
 	public:
@@ -24,7 +53,59 @@ namespace dae
 		 * \param v view direction
 		 * \return color
 		 */
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const = 0;
+
+		/**
+		 * \brief Function used to determine how much light is mirrored and transmitted at the hit
+		 * \param hitRecord current hitrecord
+		 * \param rayDirection direction of the incoming ray
+		 * \return reflectance and transmittance, black for purely diffuse materials
+		 */
+		virtual SpecularScatter GetSpecularScatter([[maybe_unused]] const HitRecord& hitRecord, [[maybe_unused]] const Vector3& rayDirection) const
+		{
+			return {};
+		}
+
+		/**
+		 * \brief Importance samples a bounce direction for the path tracer, cosine weighted unless overridden
+		 * \param hitRecord current hitrecord
+		 * \param v direction towards the viewer (the opposite of the incoming ray)
+		 * \param sample uniform 2D sample
+		 * \param lobeSample uniform sample used to pick between lobes
+		 * \return false when the path ends here
+		 */
+		virtual bool SampleBSDF(const HitRecord& hitRecord, const Vector3& v, const Sample2D& sample, [[maybe_unused]] float lobeSample, BSDFSample& bsdfSample) const
+		{
+			const Vector3 n{ hitRecord.normal.Normalized() };
+			bsdfSample.direction = Sampling::CosineSampleHemisphere(n, sample);
+			bsdfSample.pdf = GetPdf(hitRecord, bsdfSample.direction, v);
+			if (bsdfSample.pdf <= 0.f)
+				return false;
+
+			bsdfSample.weight = Shade(hitRecord, bsdfSample.direction, v) * (Vector3::Dot(n, bsdfSample.direction) / bsdfSample.pdf);
+			bsdfSample.isSpecular = false;
+			return true;
+		}
+
+		/**
+		 * \brief Solid angle pdf with which SampleBSDF returns l, needed to weigh light samples against BSDF samples
+		 */
+		virtual float GetPdf(const HitRecord& hitRecord, const Vector3& l, [[maybe_unused]] const Vector3& v) const
+		{
+			return std::max(Vector3::Dot(hitRecord.normal.Normalized(), l), 0.f) / PI;
+		}
+
+		// Perfectly specular materials can not be lit by light samples, only by following SampleBSDF
+		virtual bool IsDeltaBSDF() const { return false; }
+
+		// Overall reflectance, divided out by the denoiser so it only blurs the lighting and keeps the colors sharp
+		virtual ColorRGB GetAlbedo() const = 0;
+
+		/**
+		 * \brief Writes the material type followed by its parameters, read back by Material::Deserialize
+		 */
+		virtual void Serialize(std::ostream& stream) const = 0;
+		static Material* Deserialize(std::istream& stream, MemoryArena& arena);
 	};
 #pragma endregion
 
@@ -38,11 +119,22 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const override
+		{
+			return m_Color;
+		}
+
+		ColorRGB GetAlbedo() const override
 		{
 			return m_Color;
 		}
 
+		void Serialize(std::ostream& stream) const override
+		{
+			Serialization::Write(stream, MaterialType::SolidColor);
+			Serialization::Write(stream, m_Color);
+		}
+
 	private:
 		ColorRGB m_Color{ colors::White };
 	};
@@ -57,11 +149,23 @@ namespace dae
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance) {}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const override
 		{
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_DiffuseColor * m_DiffuseReflectance;
+		}
+
+		void Serialize(std::ostream& stream) const override
+		{
+			Serialization::Write(stream, MaterialType::Lambert);
+			Serialization::Write(stream, m_DiffuseColor);
+			Serialization::Write(stream, m_DiffuseReflectance);
+		}
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 1.f }; //kd
@@ -80,12 +184,26 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const override
 		{
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor)
 				+ BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_DiffuseColor * m_DiffuseReflectance;
+		}
+
+		void Serialize(std::ostream& stream) const override
+		{
+			Serialization::Write(stream, MaterialType::LambertPhong);
+			Serialization::Write(stream, m_DiffuseColor);
+			Serialization::Write(stream, m_DiffuseReflectance);
+			Serialization::Write(stream, m_SpecularReflectance);
+			Serialization::Write(stream, m_PhongExponent);
+		}
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 0.5f }; //kd
@@ -104,7 +222,7 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const override
 		{
 			// Determine F0 value → (0.04, 0.04, 0.04) or Albedo based on Metalness
 			ColorRGB f0{};
@@ -155,10 +273,200 @@ namespace dae
 
 		}
 
+		SpecularScatter GetSpecularScatter(const HitRecord& hitRecord, const Vector3& rayDirection) const override
+		{
+			ColorRGB f0{ 0.04f,0.04f,0.04f };
+			if (m_Metalness == 1)
+				f0 = m_Albedo;
+
+			// Fresnel at the mirror direction, faded out with roughness since a perfect mirror ray only fits smooth surfaces
+			const ColorRGB F = BRDF::FresnelFunction_Schlick(hitRecord.normal.Normalized(), -rayDirection, f0);
+			const float smoothness{ Square(1.f - m_Roughness) };
+
+			return { F * smoothness };
+		}
+
+		bool SampleBSDF(const HitRecord& hitRecord, const Vector3& v, const Sample2D& sample, float lobeSample, BSDFSample& bsdfSample) const override
+		{
+			const Vector3 n{ hitRecord.normal.Normalized() };
+			if (Vector3::Dot(n, v) <= 0.f)
+				return false;
+
+			// GGX importance sampling for the specular lobe, cosine weighted for the diffuse one
+			if (lobeSample < GetSpecularProbability())
+				bsdfSample.direction = Vector3::Reflect(-v, Sampling::SampleGGXHalfVector(n, m_Roughness, sample));
+			else
+				bsdfSample.direction = Sampling::CosineSampleHemisphere(n, sample);
+
+			const float lDOTn{ Vector3::Dot(bsdfSample.direction, n) };
+			bsdfSample.pdf = GetPdf(hitRecord, bsdfSample.direction, v);
+			if (lDOTn <= 0.f || bsdfSample.pdf <= 0.f)
+				return false;
+
+			bsdfSample.weight = Shade(hitRecord, bsdfSample.direction, v) * (lDOTn / bsdfSample.pdf);
+			bsdfSample.isSpecular = false;
+			return true;
+		}
+
+		float GetPdf(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const override
+		{
+			const Vector3 n{ hitRecord.normal.Normalized() };
+			const float lDOTn{ Vector3::Dot(l, n) };
+			if (lDOTn <= 0.f)
+				return 0.f;
+
+			// Half vector pdf D * cos(theta_h), mapped to the reflected direction by 1 / (4 * dot(v,h))
+			const Vector3 h{ (v + l).Normalized() };
+			const float hDOTn{ std::max(Vector3::Dot(h, n), 0.0001f) };
+			const float vDOTh{ std::max(Vector3::Dot(v, h), 0.0001f) };
+			const float specularPdf{ BRDF::NormalDistribution_GGX(n, h, m_Roughness) * hDOTn / (4.f * vDOTh) };
+			const float diffusePdf{ lDOTn / PI };
+
+			const float specularProbability{ GetSpecularProbability() };
+			return specularProbability * specularPdf + (1.f - specularProbability) * diffusePdf;
+		}
+
+		ColorRGB GetAlbedo() const override
+		{
+			return m_Albedo;
+		}
+
+		void Serialize(std::ostream& stream) const override
+		{
+			Serialization::Write(stream, MaterialType::CookTorrence);
+			Serialization::Write(stream, m_Albedo);
+			Serialization::Write(stream, m_Metalness);
+			Serialization::Write(stream, m_Roughness);
+		}
+
 	private:
 		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
 		float m_Metalness{ 1.0f };
 		float m_Roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+
+		// Metals have no diffuse lobe
+		float GetSpecularProbability() const { return m_Metalness == 1 ? 1.f : 0.5f; }
 	};
 #pragma endregion
+
+#pragma region Material DIELECTRIC
+	//DIELECTRIC (glass, water, ...)
+	//==========
+	class Material_Dielectric final : public Material
+	{
+	public:
+		Material_Dielectric(const ColorRGB& tint, float ior) :
+			m_Tint(tint), m_IOR(ior)
+		{
+		}
+
+		ColorRGB Shade(const HitRecord& = {}, const Vector3& = {}, const Vector3& = {}) const override
+		{
+			// No diffuse part, all light arrives through reflection and refraction
+			return colors::Black;
+		}
+
+		SpecularScatter GetSpecularScatter(const HitRecord& hitRecord, const Vector3& rayDirection) const override
+		{
+			const float f0{ Square((m_IOR - 1.f) / (m_IOR + 1.f)) };
+			const float cosTheta{ std::abs(Vector3::Dot(hitRecord.normal.Normalized(), rayDirection)) };
+			const float F{ f0 + (1.f - f0) * std::pow(1.f - cosTheta, 5.f) };
+
+			return { ColorRGB{ F, F, F }, m_Tint * (1.f - F), m_IOR };
+		}
+
+		bool SampleBSDF(const HitRecord& hitRecord, const Vector3& v, const Sample2D&, float lobeSample, BSDFSample& bsdfSample) const override
+		{
+			Vector3 n{ hitRecord.normal.Normalized() };
+			const bool isEntering{ Vector3::Dot(v, n) > 0.f };
+			if (!isEntering)
+				n = -n;
+
+			const float eta{ isEntering ? 1.f / m_IOR : m_IOR };
+			const float cosIncident{ Vector3::Dot(v, n) };
+			const float sinTransmittedSqr{ eta * eta * (1.f - cosIncident * cosIncident) };
+
+			// Reflection or refraction picked with the Fresnel probability, so the weight is just the tint
+			float F{ 1.f };
+			if (sinTransmittedSqr <= 1.f)
+			{
+				const float f0{ Square((m_IOR - 1.f) / (m_IOR + 1.f)) };
+				F = f0 + (1.f - f0) * std::pow(1.f - cosIncident, 5.f);
+			}
+
+			if (lobeSample < F)
+			{
+				bsdfSample.direction = Vector3::Reflect(-v, n);
+				bsdfSample.weight = colors::White;
+			}
+			else
+			{
+				bsdfSample.direction = (-v * eta + n * (eta * cosIncident - std::sqrt(1.f - sinTransmittedSqr))).Normalized();
+				bsdfSample.weight = m_Tint;
+			}
+			bsdfSample.pdf = 0.f;
+			bsdfSample.isSpecular = true;
+			return true;
+		}
+
+		float GetPdf(const HitRecord&, const Vector3&, const Vector3&) const override
+		{
+			return 0.f;
+		}
+
+		bool IsDeltaBSDF() const override { return true; }
+
+		ColorRGB GetAlbedo() const override
+		{
+			return m_Tint;
+		}
+
+		void Serialize(std::ostream& stream) const override
+		{
+			Serialization::Write(stream, MaterialType::Dielectric);
+			Serialization::Write(stream, m_Tint);
+			Serialization::Write(stream, m_IOR);
+		}
+
+	private:
+		ColorRGB m_Tint{ colors::White };
+		float m_IOR{ 1.5f }; //Index Of Refraction
+	};
+#pragma endregion
+
+#pragma region Material DESERIALIZE
+	inline Material* Material::Deserialize(std::istream& stream, MemoryArena& arena)
+	{
+		MaterialType type{};
+		if (!Serialization::Read(stream, type))
+			return nullptr;
+
+		ColorRGB color{};
+		float p0{}, p1{}, p2{};
+		switch (type)
+		{
+		case MaterialType::SolidColor:
+			if (!Serialization::Read(stream, color))
+				return nullptr;
+			return arena.Create<Material_SolidColor>(color);
+		case MaterialType::Lambert:
+			if (!Serialization::Read(stream, color) || !Serialization::Read(stream, p0))
+				return nullptr;
+			return arena.Create<Material_Lambert>(color, p0);
+		case MaterialType::LambertPhong:
+			if (!Serialization::Read(stream, color) || !Serialization::Read(stream, p0) || !Serialization::Read(stream, p1) || !Serialization::Read(stream, p2))
+				return nullptr;
+			return arena.Create<Material_LambertPhong>(color, p0, p1, p2);
+		case MaterialType::CookTorrence:
+			if (!Serialization::Read(stream, color) || !Serialization::Read(stream, p0) || !Serialization::Read(stream, p1))
+				return nullptr;
+			return arena.Create<Material_CookTorrence>(color, p0, p1);
+		case MaterialType::Dielectric:
+			if (!Serialization::Read(stream, color) || !Serialization::Read(stream, p0))
+				return nullptr;
+			return arena.Create<Material_Dielectric>(color, p0);
+		}
+		return nullptr;
+	}
+#pragma endregion
 }
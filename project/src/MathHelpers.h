@@ -27,6 +27,6 @@ namespace dae
 
 	inline bool AreEqual(float a, float b, float epsilon = FLT_EPSILON)
 	{
-		return abs(a - b) < epsilon;
+		return std::abs(a - b) < epsilon;
 	}
 }
@@ -18,14 +18,6 @@ namespace dae {
 		data[3] = t;
 	}
 
-	Matrix::Matrix(const Matrix& m)
-	{
-		data[0] = m[0];
-		data[1] = m[1];
-		data[2] = m[2];
-		data[3] = m[3];
-	}
-
 	Vector3 Matrix::TransformVector(const Vector3& v) const
 	{
 		return TransformVector(v[0], v[1], v[2]);
@@ -18,7 +18,8 @@ namespace dae {
 			const Vector4& zAxis,
 			const Vector4& t);
 
-		Matrix(const Matrix& m);
+		Matrix(const Matrix& m) = default;
+		Matrix& operator=(const Matrix& m) = default;
 
 		Vector3 TransformVector(const Vector3& v) const;
 		Vector3 TransformVector(float x, float y, float z) const;
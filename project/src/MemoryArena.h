@@ -0,0 +1,105 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dae
+{
+	/**
+	 * \brief Bump allocator handing out memory from large blocks.
+	 * Allocations never move and are released all at once when the arena is reset or destroyed.
+	 * Objects made with Create are destroyed then too, newest first, raw allocations are just released.
+	 * Releasing costs one free per block, plus one destructor call per created object that is not trivially destructible.
+	 */
+	class MemoryArena final
+	{
+	public:
+		explicit MemoryArena(size_t blockSize = 64 * 1024) : m_BlockSize(blockSize) {}
+		~MemoryArena() { Reset(); }
+
+		MemoryArena(const MemoryArena&) = delete;
+		MemoryArena(MemoryArena&&) noexcept = delete;
+		MemoryArena& operator=(const MemoryArena&) = delete;
+		MemoryArena& operator=(MemoryArena&&) noexcept = delete;
+
+		void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+		{
+			if (!m_Blocks.empty())
+			{
+				if (void* pMemory = AllocateFromBlock(m_Blocks.back(), size, alignment))
+					return pMemory;
+			}
+
+			//Oversized requests get a block of their own
+			m_Blocks.push_back({ std::make_unique<std::byte[]>(std::max(m_BlockSize, size + alignment)), std::max(m_BlockSize, size + alignment), 0 });
+			return AllocateFromBlock(m_Blocks.back(), size, alignment);
+		}
+
+		template<typename T, typename... Args>
+		T* Create(Args&&... args)
+		{
+			void* pMemory{ Allocate(sizeof(T), alignof(T)) };
+			if constexpr (std::is_trivially_destructible_v<T>)
+				return new (pMemory) T(std::forward<Args>(args)...);
+			else
+			{
+				// Registered before constructing, running out of memory for the list never leaves an object without its destructor
+				m_Destructors.push_back({ pMemory, [](void* pObject) { static_cast<T*>(pObject)->~T(); } });
+				try
+				{
+					return new (pMemory) T(std::forward<Args>(args)...);
+				}
+				catch (...)
+				{
+					m_Destructors.pop_back();
+					throw;
+				}
+			}
+		}
+
+		// Destroys the created objects that need it and releases the blocks, previously returned pointers become invalid
+		void Reset()
+		{
+			for (auto it = m_Destructors.rbegin(); it != m_Destructors.rend(); ++it)
+				it->destroy(it->pObject);
+			m_Destructors.clear();
+			m_Blocks.clear();
+		}
+
+		size_t GetNumBlocks() const { return m_Blocks.size(); }
+
+	private:
+		struct Block
+		{
+			std::unique_ptr<std::byte[]> pData{};
+			size_t size{};
+			size_t used{};
+		};
+
+		static void* AllocateFromBlock(Block& block, size_t size, size_t alignment)
+		{
+			const uintptr_t base{ reinterpret_cast<uintptr_t>(block.pData.get()) };
+			const uintptr_t aligned{ (base + block.used + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1) };
+			if (aligned + size > base + block.size)
+				return nullptr;
+
+			block.used = aligned + size - base;
+			return reinterpret_cast<void*>(aligned);
+		}
+
+		struct Destructor
+		{
+			void* pObject{};
+			void (*destroy)(void*) {};
+		};
+
+		size_t m_BlockSize{};
+		std::vector<Block> m_Blocks{};
+		std::vector<Destructor> m_Destructors{}; // Of the created objects that need one, in creation order
+	};
+}
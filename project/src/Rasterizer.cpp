@@ -0,0 +1,173 @@
+#include "Rasterizer.h"
+#include "Camera.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace dae;
+
+void Rasterizer::Update(const Scene& scene, const Renderer& renderer, const Camera& camera, const Matrix& cameraToWorld, int width, int height)
+{
+	if (cameraToWorld == m_CameraToWorld && camera.fovAngle == m_FovAngle && width == m_Width && height == m_Height
+		&& scene.GetContentGeneration() == m_SceneGeneration)
+		return;
+
+	m_Origin = camera.origin;
+	m_CameraToWorld = cameraToWorld;
+	m_FovAngle = camera.fovAngle;
+	m_Width = width;
+	m_Height = height;
+	m_SceneGeneration = scene.GetContentGeneration();
+
+	const size_t numPixels{ static_cast<size_t>(width) * height };
+	for (std::vector<float>& directions : m_Directions)
+		directions.resize(numPixels);
+	m_Depths.resize(numPixels);
+	m_Primitives.resize(numPixels);
+	m_BandIndices.resize((height + bandHeight - 1) / bandHeight);
+	std::iota(m_BandIndices.begin(), m_BandIndices.end(), 0);
+
+	// The same projection as Renderer::GetViewDirection
+	m_Right = cameraToWorld.TransformVector(Vector3::UnitX);
+	m_Up = cameraToWorld.TransformVector(Vector3::UnitY);
+	m_Forward = cameraToWorld.TransformVector(Vector3::UnitZ);
+	m_ScaleY = std::tan(camera.fovAngle / 2);
+	m_ScaleX = m_ScaleY * width / static_cast<float>(height);
+
+	const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+	m_SphereRects.resize(spheres.size());
+	std::transform(std::execution::par, spheres.begin(), spheres.end(), m_SphereRects.begin(), [&](const Sphere& sphere) { return GetPixelRect(sphere); });
+
+	std::for_each(std::execution::par, m_BandIndices.begin(), m_BandIndices.end(), [&](int band) { RasterizeBand(scene, renderer, camera, band); });
+}
+
+Rasterizer::PixelRect Rasterizer::GetPixelRect(const Sphere& sphere) const
+{
+	// The sphere's bounding box in camera space, grown by what rounding in the camera's axes may be off far away
+	const Vector3 toCenter{ sphere.origin - m_Origin };
+	const float radius{ sphere.radius + 1e-4f * toCenter.Magnitude() };
+	const float x{ Vector3::Dot(toCenter, m_Right) };
+	const float y{ Vector3::Dot(toCenter, m_Up) };
+	const float z{ Vector3::Dot(toCenter, m_Forward) };
+	if (z + radius <= 0.f)
+		return {};
+	if (z - radius <= 0.f)
+		return { 0, 0, m_Width - 1, m_Height - 1 };
+
+	// Its corners seen from the camera, then widened by a pixel, so every pixel whose center looks at the box is inside
+	const float nearX[2]{ (x - radius) / (z - radius), (x + radius) / (z - radius) };
+	const float farX[2]{ (x - radius) / (z + radius), (x + radius) / (z + radius) };
+	const float nearY[2]{ (y - radius) / (z - radius), (y + radius) / (z - radius) };
+	const float farY[2]{ (y - radius) / (z + radius), (y + radius) / (z + radius) };
+	const auto toPixelX = [&](float xNdc) { return (xNdc / m_ScaleX + 1.f) * m_Width * 0.5f - 0.5f; };
+	const auto toPixelY = [&](float yNdc) { return (1.f - yNdc / m_ScaleY) * m_Height * 0.5f - 0.5f; };
+	const float pixelsX[4]{ toPixelX(nearX[0]), toPixelX(nearX[1]), toPixelX(farX[0]), toPixelX(farX[1]) };
+	const float pixelsY[4]{ toPixelY(nearY[0]), toPixelY(nearY[1]), toPixelY(farY[0]), toPixelY(farY[1]) };
+	const auto [minX, maxX] { std::minmax_element(std::begin(pixelsX), std::end(pixelsX)) };
+	const auto [minY, maxY] { std::minmax_element(std::begin(pixelsY), std::end(pixelsY)) };
+
+	const float width{ static_cast<float>(m_Width) };
+	const float height{ static_cast<float>(m_Height) };
+	return {
+		static_cast<int>(std::clamp(std::floor(*minX) - 1.f, 0.f, width)), static_cast<int>(std::clamp(std::floor(*minY) - 1.f, 0.f, height)),
+		static_cast<int>(std::clamp(std::ceil(*maxX) + 1.f, -1.f, width - 1.f)), static_cast<int>(std::clamp(std::ceil(*maxY) + 1.f, -1.f, height - 1.f)) };
+}
+
+void Rasterizer::RasterizeBand(const Scene& scene, const Renderer& renderer, const Camera& camera, int band)
+{
+	const int firstRow{ band * bandHeight };
+	const int endRow{ std::min(firstRow + bandHeight, m_Height) };
+	const size_t firstPixel{ static_cast<size_t>(firstRow) * m_Width };
+	const size_t endPixel{ static_cast<size_t>(endRow) * m_Width };
+
+	for (int py{ firstRow }; py < endRow; ++py)
+	{
+		for (int px{}; px < m_Width; ++px)
+		{
+			const Vector3 direction{ renderer.GetViewDirection(camera, m_CameraToWorld, px + 0.5f, py + 0.5f) };
+			const size_t pixel{ px + static_cast<size_t>(py) * m_Width };
+			m_Directions[0][pixel] = direction.x;
+			m_Directions[1][pixel] = direction.y;
+			m_Directions[2][pixel] = direction.z;
+		}
+	}
+	std::fill(m_Depths.begin() + firstPixel, m_Depths.begin() + endPixel, FLT_MAX);
+	std::fill(m_Primitives.begin() + firstPixel, m_Primitives.begin() + endPixel, noPrimitive);
+
+	// Spheres before planes and each in ascending order, a primitive only takes a pixel from a strictly farther one, like in the scene
+	VisibilitySpan span{};
+	span.origin = m_Origin;
+	span.rayMin = Ray{}.min;
+	const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+	for (uint32_t index{}; index < spheres.size(); ++index)
+	{
+		const PixelRect& rect{ m_SphereRects[index] };
+		if (rect.firstX > rect.lastX)
+			continue;
+
+		for (int py{ std::max(rect.firstY, firstRow) }; py <= std::min(rect.lastY, endRow - 1); ++py)
+		{
+			const size_t first{ rect.firstX + static_cast<size_t>(py) * m_Width };
+			for (int axis{}; axis < 3; ++axis)
+				span.pDirections[axis] = m_Directions[axis].data() + first;
+			span.pDepths = m_Depths.data() + first;
+			span.pPrimitives = m_Primitives.data() + first;
+			span.count = static_cast<uint32_t>(rect.lastX - rect.firstX + 1);
+			m_pKernels->rasterizeSphere(spheres[index], index, span);
+		}
+	}
+
+	// GeometryUtils::Intersect_Plane with the distance to the plane shared by all rays
+	const std::vector<Plane>& planes{ scene.GetPlaneGeometries() };
+	for (uint32_t index{}; index < planes.size(); ++index)
+	{
+		const Vector3& normal{ planes[index].normal };
+		const float toPlane{ Vector3::Dot(planes[index].origin - m_Origin, normal) };
+		for (size_t pixel{ firstPixel }; pixel < endPixel; ++pixel)
+		{
+			const float t{ toPlane / (m_Directions[0][pixel] * normal.x + m_Directions[1][pixel] * normal.y + m_Directions[2][pixel] * normal.z) };
+			if (t >= span.rayMin && t <= FLT_MAX && t < m_Depths[pixel])
+			{
+				m_Depths[pixel] = t;
+				m_Primitives[pixel] = index | planeFlag;
+			}
+		}
+	}
+}
+
+void Rasterizer::GetClosestHit(const Scene& scene, const Ray& ray, int px, int py, HitRecord& closestHit) const
+{
+	const uint32_t primitive{ GetPrimitive(px, py) };
+	if (primitive == noPrimitive)
+		return;
+
+	Intersection intersection{};
+	intersection.t = closestHit.t;
+	intersection.primitiveIndex = primitive & ~planeFlag;
+	bool isHit{};
+	if (primitive & planeFlag)
+	{
+		float t{};
+		isHit = GeometryUtils::Intersect_Plane(scene.GetPlaneGeometries()[intersection.primitiveIndex], ray, t) && t < intersection.t;
+		intersection.t = t;
+		intersection.primitiveType = PrimitiveType::Plane;
+	}
+	else
+	{
+		SpherePacket<8> packet{};
+		packet.Set(0, scene.GetSphereGeometries()[intersection.primitiveIndex]);
+		isHit = m_pKernels->intersectSpheres(&packet, 1, ray, intersection.t) >= 0;
+		intersection.primitiveType = PrimitiveType::Sphere;
+	}
+
+	// The ray is the one that was rasterized and hits the same primitive again, tracing it is only a safety net
+	if (isHit)
+		scene.FillHitRecord(ray, intersection, closestHit);
+	else
+		scene.GetClosestHit(ray, closestHit);
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Kernels.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+	struct Camera;
+
+	/**
+	 * \brief Primary visibility rasterized into a visibility buffer: per pixel the primitive its camera ray hits first and how far away.
+	 * A sphere covers the pixels of its bounds projected onto the image, whose rays go through KernelTable::rasterizeSphere one row
+	 * after the other. Planes cover every pixel. Bands of bandHeight rows are rasterized in parallel, each into its own rows of the buffer.
+	 */
+	class Rasterizer final
+	{
+	public:
+		static constexpr int bandHeight{ 16 };
+		static constexpr uint32_t planeFlag{ 0x80000000u }; // Set for pixels that see a plane, the other bits are its index
+		static constexpr uint32_t noPrimitive{ UINT32_MAX };
+
+		Rasterizer() = default;
+		~Rasterizer() = default;
+
+		Rasterizer(const Rasterizer&) = delete;
+		Rasterizer(Rasterizer&&) noexcept = delete;
+		Rasterizer& operator=(const Rasterizer&) = delete;
+		Rasterizer& operator=(Rasterizer&&) noexcept = delete;
+
+		// Rasterizes again when the camera, the image size or the scene's content changed since the last call.
+		// Pixel x, y of the width x height image looks along renderer's view direction through its center
+		void Update(const Scene& scene, const Renderer& renderer, const Camera& camera, const Matrix& cameraToWorld, int width, int height);
+
+		// Same as Scene::GetClosestHit for the ray from the camera through the center of pixel px, py of the last Update.
+		// Only the primitive seen there is intersected again, for the exact distance and surface
+		void GetClosestHit(const Scene& scene, const Ray& ray, int px, int py, HitRecord& closestHit) const;
+
+		// Of the camera ray through the center of pixel px, py, as Renderer::GetViewDirection
+		Vector3 GetDirection(int px, int py) const
+		{
+			const size_t pixel{ px + static_cast<size_t>(py) * m_Width };
+			return { m_Directions[0][pixel], m_Directions[1][pixel], m_Directions[2][pixel] };
+		}
+		uint32_t GetPrimitive(int px, int py) const { return m_Primitives[px + py * m_Width]; }
+		float GetDepth(int px, int py) const { return m_Depths[px + py * m_Width]; } // FLT_MAX where nothing is seen
+
+	private:
+		// Inclusive, empty when first is past last
+		struct PixelRect
+		{
+			int firstX{};
+			int firstY{};
+			int lastX{ -1 };
+			int lastY{ -1 };
+		};
+
+		PixelRect GetPixelRect(const Sphere& sphere) const;
+		void RasterizeBand(const Scene& scene, const Renderer& renderer, const Camera& camera, int band);
+
+		std::vector<float> m_Directions[3]{}; // Of every pixel's camera ray, as x, y and z streams
+		std::vector<float> m_Depths{};
+		std::vector<uint32_t> m_Primitives{};
+		std::vector<PixelRect> m_SphereRects{};
+		std::vector<int> m_BandIndices{}; // 0 to the number of bands, to rasterize them in parallel
+
+		// The camera's axes, pixels look along xNdc * right + yNdc * up + forward
+		Vector3 m_Right{};
+		Vector3 m_Up{};
+		Vector3 m_Forward{};
+		float m_ScaleX{}; // xNdc of the right border
+		float m_ScaleY{}; // yNdc of the top border
+
+		// What the buffer was rasterized for
+		Vector3 m_Origin{};
+		Matrix m_CameraToWorld{};
+		float m_FovAngle{};
+		int m_Width{};
+		int m_Height{};
+		uint64_t m_SceneGeneration{ UINT64_MAX };
+
+		const KernelTable* m_pKernels{ &GetKernels() };
+	};
+}
@@ -0,0 +1,107 @@
+//External includes
+#include "SDL.h"
+#include "SDL_surface.h"
+
+//Project includes
+#include "RenderThread.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include <algorithm>
+
+using namespace dae;
+
+RenderThread::RenderThread(Scene* pScene, Renderer* pRenderer) :
+	m_pScene(pScene),
+	m_pRenderer(pRenderer),
+	m_Thread(&RenderThread::Run, this)
+{
+}
+
+RenderThread::~RenderThread()
+{
+	// The frame in flight still finishes
+	m_IsRunning.store(false, std::memory_order_release);
+	m_Thread.join();
+}
+
+void RenderThread::SubmitScene(const Scene& scene)
+{
+	scene.CaptureState(m_SceneStates.GetWriteBuffer());
+	m_SceneStates.Publish();
+}
+
+void RenderThread::Post(std::function<void(Renderer&)> command)
+{
+	const std::lock_guard lock{ m_CommandMutex };
+	m_Commands.push_back(std::move(command));
+}
+
+bool RenderThread::PresentLatestFrame(SDL_Window* pWindow)
+{
+	if (!m_Frames.Consume())
+		return false;
+
+	const Frame& frame{ m_Frames.GetReadBuffer() };
+	SDL_Surface* pSurface{ SDL_GetWindowSurface(pWindow) };
+	SDL_ConvertPixels(std::min(frame.width, pSurface->w), std::min(frame.height, pSurface->h), SDL_PIXELFORMAT_ARGB8888, frame.pixels.data(),
+		frame.width * static_cast<int>(sizeof(uint32_t)), pSurface->format->format, pSurface->pixels, pSurface->pitch);
+	SDL_UpdateWindowSurface(pWindow);
+	return true;
+}
+
+void RenderThread::Run()
+{
+	while (m_IsRunning.load(std::memory_order_acquire))
+	{
+		ExecuteCommands();
+
+		// States submitted while the last frame rendered are skipped, only the newest one matters
+		if (m_SceneStates.Consume())
+			m_pScene->ApplyState(m_SceneStates.GetReadBuffer());
+
+		const float frameBudget{ m_FrameBudget.load(std::memory_order_relaxed) };
+		if (frameBudget > 0.f)
+			m_pRenderer->Render(m_pScene, SDL_GetPerformanceCounter() + static_cast<uint64_t>(frameBudget * SDL_GetPerformanceFrequency() / 1000.f));
+		else
+			m_pRenderer->Render(m_pScene);
+
+		PublishFrame();
+	}
+
+	// Commands posted right before shutting down, like a screenshot, still run
+	ExecuteCommands();
+}
+
+void RenderThread::ExecuteCommands()
+{
+	{
+		const std::lock_guard lock{ m_CommandMutex };
+		m_ExecutingCommands.swap(m_Commands);
+	}
+
+	for (const std::function<void(Renderer&)>& command : m_ExecutingCommands)
+		command(*m_pRenderer);
+
+	m_ExecutingCommands.clear();
+}
+
+void RenderThread::PublishFrame()
+{
+	const SDL_Surface* pBuffer{ m_pRenderer->GetBuffer() };
+
+	Frame& frame{ m_Frames.GetWriteBuffer() };
+	frame.width = pBuffer->w;
+	frame.height = pBuffer->h;
+	frame.pixels.resize(static_cast<size_t>(frame.width) * frame.height);
+
+	const uint8_t* pSource{ static_cast<const uint8_t*>(pBuffer->pixels) };
+	for (int py{}; py < frame.height; ++py)
+	{
+		const uint32_t* pRow{ reinterpret_cast<const uint32_t*>(pSource + static_cast<size_t>(py) * pBuffer->pitch) };
+		std::copy(pRow, pRow + frame.width, frame.pixels.begin() + static_cast<size_t>(py) * frame.width);
+	}
+
+	m_Frames.Publish();
+	m_ResolutionScale.store(m_pRenderer->GetResolutionScale(), std::memory_order_relaxed);
+	m_FrameCount.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Scene.h"
+#include "TripleBuffer.h"
+
+struct SDL_Window;
+
+namespace dae
+{
+	class Renderer;
+
+	/**
+	 * \brief Renders frames on a thread of its own so input handling and presenting never wait for a frame to finish.
+	 * The main thread updates a scene of its own and submits its state, then presents the newest completed frame, both through
+	 * triple buffers, so neither side takes a lock per frame. While the thread runs it owns the renderer and the scene it renders,
+	 * which takes over each submitted state between two frames. Anything else that changes the renderer is posted as a command.
+	 */
+	class RenderThread final
+	{
+	public:
+		// Starts rendering pScene with pRenderer right away, the renderer should be headless, frames reach the window through PresentLatestFrame.
+		// pScene must be initialized like the scenes whose state gets submitted, so it has the same materials
+		RenderThread(Scene* pScene, Renderer* pRenderer);
+		~RenderThread();
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread(RenderThread&&) noexcept = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+		RenderThread& operator=(RenderThread&&) noexcept = delete;
+
+		// Main thread side
+		void SubmitScene(const Scene& scene); // After updating it, scene stays the main thread's
+		void Post(std::function<void(Renderer&)> command);
+		// Copies the newest completed frame to the window, returns false when no frame completed since the last call
+		bool PresentLatestFrame(SDL_Window* pWindow);
+
+		// Milliseconds a frame may take before it is presented unfinished and resumed with the newest camera, 0 renders whole frames
+		void SetFrameBudget(float frameBudget) { m_FrameBudget.store(frameBudget, std::memory_order_relaxed); }
+		uint32_t GetFrameCount() const { return m_FrameCount.load(std::memory_order_relaxed); }
+		float GetResolutionScale() const { return m_ResolutionScale.load(std::memory_order_relaxed); }
+
+	private:
+		struct Frame
+		{
+			int width{};
+			int height{};
+			std::vector<uint32_t> pixels{};
+		};
+
+		void Run();
+		void ExecuteCommands();
+		void PublishFrame();
+
+		Scene* m_pScene;
+		Renderer* m_pRenderer;
+
+		TripleBuffer<SceneState> m_SceneStates{};
+		TripleBuffer<Frame> m_Frames{};
+
+		std::mutex m_CommandMutex{};
+		std::vector<std::function<void(Renderer&)>> m_Commands{};
+		std::vector<std::function<void(Renderer&)>> m_ExecutingCommands{};
+
+		std::atomic<bool> m_IsRunning{ true };
+		std::atomic<float> m_FrameBudget{};
+		std::atomic<uint32_t> m_FrameCount{};
+		std::atomic<float> m_ResolutionScale{ 1.f };
+
+		std::thread m_Thread; // Last, it starts after everything it uses is constructed
+	};
+}
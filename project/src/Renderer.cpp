@@ -4,142 +4,937 @@
 
 //Project includes
 #include "Renderer.h"
+#include "Denoiser.h"
+#include "LightVisibilityCache.h"
 #include "Maths.h"
 #include "Matrix.h"
 #include "Material.h"
+#include "Rasterizer.h"
+#include "ResolutionController.h"
 #include "Scene.h"
+#include "ShadowMaps.h"
+#include "TileCuller.h"
 #include "Utils.h"
+#include "Wavefront.h"
+#include <algorithm>
+#include <cmath>
+#include <execution>
 #include <iostream>
+#include <numeric>
 
 using namespace dae;
 
+namespace
+{
+	// Blends two pixels with 8 bit channels, two channels at a time in 16 bit lanes, weight in [0, 256]
+	uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight)
+	{
+		const uint32_t evenChannels{ (((a & 0x00ff00ffu) * (256 - weight) + (b & 0x00ff00ffu) * weight) >> 8) & 0x00ff00ffu };
+		const uint32_t oddChannels{ (((a >> 8) & 0x00ff00ffu) * (256 - weight) + ((b >> 8) & 0x00ff00ffu) * weight) & 0xff00ff00u };
+		return evenChannels | oddChannels;
+	}
+
+	PixelLayout GetPixelLayout(const SDL_PixelFormat* pFormat)
+	{
+		return { pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, pFormat->Amask };
+	}
+}
+
 Renderer::Renderer(SDL_Window * pWindow) :
 	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow))
+	m_pBuffer(SDL_GetWindowSurface(pWindow)),
+	m_pWavefront(std::make_unique<WavefrontPipeline>()),
+	m_pTileCuller(std::make_unique<TileCuller>()),
+	m_pRasterizer(std::make_unique<Rasterizer>()),
+	m_pShadowMaps(std::make_unique<ShadowMaps>()),
+	m_pLightCache(std::make_unique<LightVisibilityCache>()),
+	m_pDenoiser(std::make_unique<Denoiser>()),
+	m_pResolutionController(std::make_unique<ResolutionController>())
 {
 	//Initialize
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_PixelLayout = GetPixelLayout(m_pBuffer->format);
+	SetRenderResolution(1.f);
+}
+
+Renderer::Renderer(int width, int height) :
+	m_pBuffer(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888)),
+	m_OwnsBuffer(true),
+	m_Width(width),
+	m_Height(height),
+	m_pWavefront(std::make_unique<WavefrontPipeline>()),
+	m_pTileCuller(std::make_unique<TileCuller>()),
+	m_pRasterizer(std::make_unique<Rasterizer>()),
+	m_pShadowMaps(std::make_unique<ShadowMaps>()),
+	m_pLightCache(std::make_unique<LightVisibilityCache>()),
+	m_pDenoiser(std::make_unique<Denoiser>()),
+	m_pResolutionController(std::make_unique<ResolutionController>())
+{
+	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_PixelLayout = GetPixelLayout(m_pBuffer->format);
+	SetRenderResolution(1.f);
+}
+
+Renderer::~Renderer()
+{
+	if (m_OwnsBuffer)
+		SDL_FreeSurface(m_pBuffer);
 }
 
 void Renderer::Render(Scene* pScene) const
 {
+	Render(pScene, UINT64_MAX);
+}
+
+bool Renderer::Render(Scene* pScene, uint64_t deadline) const
+{
+	const uint64_t startTime{ SDL_GetPerformanceCounter() };
+
+	if (m_RowIndices.size() != static_cast<size_t>(m_Height))
+	{
+		m_RowIndices.resize(m_Height);
+		std::iota(m_RowIndices.begin(), m_RowIndices.end(), 0);
+	}
+
+	m_SecondaryRayCount = 0;
+	m_RenderedFraction = 1.f;
+	SetRenderResolution(m_DynamicResolutionEnabled ? m_pResolutionController->GetScale() : 1.f);
+
+	// Only the per pixel classic modes render tile by tile, the others always finish the frame
+	bool isComplete{ true };
+	if (m_CurrentLightingMode == LightingMode::PathTraced)
+		RenderPathTraced(pScene);
+	else if (m_RenderMode != RenderMode::Wavefront && (m_FoveationEnabled || deadline != UINT64_MAX))
+		isComplete = RenderPriorityTiles(pScene, deadline);
+	else
+		RenderTile(pScene, { 0, 0, m_RenderWidth, m_RenderHeight });
+
+	if (m_pRenderPixels != m_pBufferPixels)
+		Upscale();
+	m_ResolutionScale = m_RenderWidth / static_cast<float>(m_Width);
+
+	// Tiles rendered from outside of Render always go straight into the buffer
+	SetRenderResolution(1.f);
+	Present();
+
+	// Interrupted frames are extrapolated to what the whole frame would have cost
+	if (m_DynamicResolutionEnabled && m_RenderedFraction > 0.f)
+		m_pResolutionController->Update(1000.f * (SDL_GetPerformanceCounter() - startTime) / SDL_GetPerformanceFrequency() / m_RenderedFraction);
+
+	return isComplete;
+}
+
+void Renderer::RenderTile(Scene* pScene, const Tile& tile) const
+{
+	UpdateShadowCaches(pScene);
+	if (m_RenderMode == RenderMode::Wavefront && m_CurrentLightingMode != LightingMode::PathTraced)
+	{
+		uint32_t secondaryRayCount{};
+		const std::vector<ColorRGB>& colors{ m_pWavefront->Render(pScene, *this, tile, secondaryRayCount) };
+		m_SecondaryRayCount += secondaryRayCount;
+
+		for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+		{
+			m_pKernels->tonemap(colors.data() + (py - tile.y) * tile.width, 1.f, m_pRenderPixels + tile.x + (py * m_RenderWidth),
+				static_cast<uint32_t>(tile.width), m_PixelLayout);
+		}
+		return;
+	}
+
+	Camera& camera = pScene->GetCamera();
+	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+	const PixelKernel renderPixel{ GetPixelKernel() };
+	UpdatePrimaryVisibility(pScene, cameraToWorld);
+	uint32_t secondaryRayCount{};
+
+	for (int px{ tile.x }; px < tile.x + tile.width; ++px)
+	{
+		for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+		{
+			const ColorRGB finalColor{ (this->*renderPixel)(pScene, px, py, cameraToWorld, secondaryRayCount) };
+
+			//Update Color in Buffer
+			m_pRenderPixels[px + (py * m_RenderWidth)] = SDL_MapRGB(m_pBuffer->format,
+				static_cast<uint8_t>(finalColor.r * 255),
+				static_cast<uint8_t>(finalColor.g * 255),
+				static_cast<uint8_t>(finalColor.b * 255));
+		}
+	}
+
+	m_SecondaryRayCount += secondaryRayCount;
+}
+
+void Renderer::RenderTile(Scene* pScene, const Tile& tile, uint8_t* pRGBOut) const
+{
+	UpdateShadowCaches(pScene);
+	if (m_RenderMode == RenderMode::Wavefront && m_CurrentLightingMode != LightingMode::PathTraced)
+	{
+		uint32_t secondaryRayCount{};
+		for (const ColorRGB& color : m_pWavefront->Render(pScene, *this, tile, secondaryRayCount))
+		{
+			*pRGBOut++ = static_cast<uint8_t>(color.r * 255);
+			*pRGBOut++ = static_cast<uint8_t>(color.g * 255);
+			*pRGBOut++ = static_cast<uint8_t>(color.b * 255);
+		}
+		m_SecondaryRayCount += secondaryRayCount;
+		return;
+	}
+
 	Camera& camera = pScene->GetCamera();
+	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+	const PixelKernel renderPixel{ GetPixelKernel() };
+	UpdatePrimaryVisibility(pScene, cameraToWorld);
+	uint32_t secondaryRayCount{};
+
+	for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+	{
+		for (int px{ tile.x }; px < tile.x + tile.width; ++px)
+		{
+			const ColorRGB finalColor{ (this->*renderPixel)(pScene, px, py, cameraToWorld, secondaryRayCount) };
+
+			*pRGBOut++ = static_cast<uint8_t>(finalColor.r * 255);
+			*pRGBOut++ = static_cast<uint8_t>(finalColor.g * 255);
+			*pRGBOut++ = static_cast<uint8_t>(finalColor.b * 255);
+		}
+	}
+
+	m_SecondaryRayCount += secondaryRayCount;
+}
+
+void Renderer::WriteTile(const Tile& tile, const uint8_t* pRGB, uint64_t secondaryRayCount)
+{
+	m_SecondaryRayCount += secondaryRayCount;
+
+	for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+	{
+		for (int px{ tile.x }; px < tile.x + tile.width; ++px)
+		{
+			m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format, pRGB[0], pRGB[1], pRGB[2]);
+			pRGB += 3;
+		}
+	}
+}
+
+void Renderer::Present() const
+{
+	//Update SDL Surface
+	if (m_pWindow)
+		SDL_UpdateWindowSurface(m_pWindow);
+}
+
+template<Renderer::LightingMode lightingMode>
+Renderer::PixelKernel Renderer::GetPixelKernel() const
+{
+	const bool isRasterized{ m_RenderMode == RenderMode::Rasterized };
+	if (m_ShadowsEnabled)
+		return isRasterized ? &Renderer::RenderPixel<lightingMode, true, true> : &Renderer::RenderPixel<lightingMode, true, false>;
+	return isRasterized ? &Renderer::RenderPixel<lightingMode, false, true> : &Renderer::RenderPixel<lightingMode, false, false>;
+}
+
+Renderer::PixelKernel Renderer::GetPixelKernel() const
+{
+	switch (m_CurrentLightingMode)
+	{
+	case dae::Renderer::LightingMode::ObservedArea:
+		return GetPixelKernel<LightingMode::ObservedArea>();
+	case dae::Renderer::LightingMode::Radiance:
+		return GetPixelKernel<LightingMode::Radiance>();
+	case dae::Renderer::LightingMode::BRDF:
+		return GetPixelKernel<LightingMode::BRDF>();
+	case dae::Renderer::LightingMode::PathTraced: // TracePath reads the shadow setting itself and takes no primary hits from the rasterizer
+		return &Renderer::RenderPixel<LightingMode::PathTraced, true, false>;
+	case dae::Renderer::LightingMode::Combined:
+		break;
+	}
+	return GetPixelKernel<LightingMode::Combined>();
+}
+
+template<Renderer::LightingMode lightingMode, bool areShadowsEnabled, bool isRasterized>
+ColorRGB Renderer::RenderPixel(Scene* pScene, int px, int py, const Matrix& cameraToWorld, uint32_t& secondaryRayCount) const
+{
+	// Tiles rendered outside of Render get a single path traced sample, they are not accumulated
+	if constexpr (lightingMode == LightingMode::PathTraced)
+	{
+		PixelFeatures features{};
+		ColorRGB finalColor{ TracePath(pScene, px, py, cameraToWorld, m_AccumulatedSamples, features) };
+		finalColor.MaxToOne();
+		return finalColor;
+	}
+
+	const Camera& camera = pScene->GetCamera();
+	auto& materials = pScene->GetMaterials();
+
+	Vector3 rayDirection{};
+	if constexpr (isRasterized)
+		rayDirection = m_pRasterizer->GetDirection(px, py);
+	else
+		rayDirection = GetViewDirection(camera, cameraToWorld, px + 0.5f, py + 0.5f);
+
+	//For Each pixel...
+	// ... Ray Direction calculations above ...
+	// Ray we are casting from the camera towards each pixel
+	Ray viewRay{ camera.origin ,rayDirection };
+
+	// Color to write to the color buffer (default = black)
+	ColorRGB finalColor{ 0,0,0 };
+
+	// Reflection and refraction rays are followed with an explicit stack instead of recursion,
+	// depth first so at most one pending sibling per bounce is stored
+	struct RayStackEntry
+	{
+		Ray ray{};
+		ColorRGB throughput{};
+		int depth{};
+	};
+	RayStackEntry rayStack[m_MaxRayStackSize];
+	int rayStackSize{ 0 };
+	rayStack[rayStackSize++] = { viewRay, colors::White, 0 };
+
+	const int maxBounces{ m_ReflectionsEnabled ? m_MaxBounces : 0 };
+
+	while (rayStackSize > 0)
+	{
+		const RayStackEntry entry{ rayStack[--rayStackSize] };
+
+		//HitRecord containing more info about potential hit
+		HitRecord closestHit{};
+		if (entry.depth > 0)
+			pScene->GetClosestHit(entry.ray, closestHit);
+		else if constexpr (isRasterized)
+			m_pRasterizer->GetClosestHit(*pScene, entry.ray, px, py, closestHit);
+		else
+			m_pTileCuller->GetClosestHit(*pScene, entry.ray, px, py, closestHit);
+		if (!closestHit.didHit)
+			continue;
+
+		// T_value visualization
+		// const float scaled_t = closestHit.t / 500.f;
+		// finalColor = { scaled_t,scaled_t,scaled_t };
+
+		finalColor += entry.throughput * ShadeHit<lightingMode, areShadowsEnabled>(pScene, closestHit, entry.ray.direction);
+
+		if (entry.depth >= maxBounces)
+			continue;
+
+		const SpecularScatter scatter{ materials[closestHit.materialIndex]->GetSpecularScatter(closestHit, entry.ray.direction) };
+
+		SecondaryRay secondaryRays[2];
+		const int numSecondaryRays{ ScatterSpecular(closestHit, entry.ray.direction, scatter, entry.throughput, m_ThroughputThreshold, secondaryRays) };
+		for (int index{}; index < numSecondaryRays && rayStackSize < m_MaxRayStackSize; ++index)
+		{
+			rayStack[rayStackSize++] = { secondaryRays[index].ray, secondaryRays[index].throughput, entry.depth + 1 };
+			++secondaryRayCount;
+		}
+	}
+
+	finalColor.MaxToOne();
+	return finalColor;
+}
+
+template<Renderer::LightingMode lightingMode, bool areShadowsEnabled>
+ColorRGB Renderer::ShadeHit(Scene* pScene, HitRecord& hitRecord, const Vector3& viewDirection) const
+{
 	auto& materials = pScene->GetMaterials();
 	auto& lights = pScene->GetLights();
 
+	ColorRGB finalColor{ 0,0,0 };
+
+	// If we hit something, set finalColor to material color, else keep BLACK
+	// Use HitRecord::materialIndex to find the corresponding material
+	Ray lightRay{};
+	hitRecord.normal.Normalize();
+
+	for (int indexLights{}; indexLights < lights.size(); ++indexLights)
+	{
+		lightRay = GetLightRay(hitRecord, lights[indexLights]);
+
+		finalColor += ShadeLight<lightingMode>(materials[hitRecord.materialIndex], hitRecord, lights[indexLights], lightRay.direction, viewDirection);
+
+		// HARD SHADOW
+		if constexpr (areShadowsEnabled)
+		{
+			const float shadowFactor{ GetShadowFactor(pScene, lightRay, indexLights, hitRecord.normal) };
+			if (shadowFactor != 1.f)
+			{
+				finalColor *= shadowFactor;
+			}
+		}
+	}
+
+	return finalColor;
+}
+
+Ray Renderer::GetLightRay(const HitRecord& hitRecord, const Light& light)
+{
+	Ray lightRay{};
+	lightRay.origin = hitRecord.origin + (hitRecord.normal * 0.01f);
+	lightRay.direction = LightUtils::GetDirectionToLight(light, lightRay.origin);
+
+	lightRay.min = 0.0001f;
+	lightRay.max = light.type == LightType::Directional ? FLT_MAX : lightRay.direction.Magnitude(); // Directional lights are infinitely far away
+
+	lightRay.direction.Normalize();
+	return lightRay;
+}
+
+float Renderer::GetShadowFactor(const Scene* pScene, const Ray& lightRay, uint32_t lightIndex, const Vector3& normal) const
+{
+	if (m_ShadowMapsEnabled && m_pShadowMaps->HasMap(lightIndex))
+	{
+		for (const Plane& plane : pScene->GetPlaneGeometries())
+		{
+			if (GeometryUtils::HitTest_Plane(plane, lightRay))
+				return 0.5f;
+		}
+		return 1.f - 0.5f * m_pShadowMaps->GetOcclusion(lightIndex, lightRay.origin, normal);
+	}
+
+	if (!m_LightCacheEnabled)
+		return pScene->DoesHit(lightRay) ? 0.5f : 1.f;
+
+	// Traced until the rays of the point's cell agree, from then on the cell answers
+	const uint64_t key{ m_pLightCache->GetKey(lightRay.origin, normal, lightIndex) };
+	switch (m_pLightCache->Find(key))
+	{
+	case LightVisibilityCache::Visibility::Visible:
+		return 1.f;
+	case LightVisibilityCache::Visibility::Blocked:
+		return 0.5f;
+	case LightVisibilityCache::Visibility::Unknown:
+		break;
+	}
+	const bool isBlocked{ pScene->DoesHit(lightRay) };
+	m_pLightCache->Record(key, isBlocked);
+	return isBlocked ? 0.5f : 1.f;
+}
+
+ColorRGB Renderer::ShadeLight(LightingMode lightingMode, Material* pMaterial, const HitRecord& hitRecord, const Light& light, const Vector3& lightDirection, const Vector3& viewDirection)
+{
+	switch (lightingMode)
+	{
+	case dae::Renderer::LightingMode::ObservedArea:
+		return ShadeLight<LightingMode::ObservedArea>(pMaterial, hitRecord, light, lightDirection, viewDirection);
+	case dae::Renderer::LightingMode::Radiance:
+		return ShadeLight<LightingMode::Radiance>(pMaterial, hitRecord, light, lightDirection, viewDirection);
+	case dae::Renderer::LightingMode::BRDF:
+		return ShadeLight<LightingMode::BRDF>(pMaterial, hitRecord, light, lightDirection, viewDirection);
+	case dae::Renderer::LightingMode::Combined:
+	case dae::Renderer::LightingMode::PathTraced: // Only reached by the wavefront path, which does not path trace
+		return ShadeLight<LightingMode::Combined>(pMaterial, hitRecord, light, lightDirection, viewDirection);
+	}
+	return {};
+}
+
+template<Renderer::LightingMode lightingMode>
+ColorRGB Renderer::ShadeLight(Material* pMaterial, const HitRecord& hitRecord, const Light& light, const Vector3& lightDirection, const Vector3& viewDirection)
+{
+	// BRDFs!
+	if constexpr (lightingMode == LightingMode::Radiance)
+		return LightUtils::GetRadiance(light, hitRecord.origin);
+	else if constexpr (lightingMode == LightingMode::BRDF)
+		return pMaterial->Shade(hitRecord, lightDirection, viewDirection);
+	else
+	{
+		float lambertsCos = Vector3::Dot(hitRecord.normal, lightDirection);
+		lambertsCos = std::max(lambertsCos, 0.0001f);
+		if constexpr (lightingMode == LightingMode::ObservedArea)
+			return { lambertsCos,lambertsCos,lambertsCos };
+		else
+			return LightUtils::GetRadiance(light, hitRecord.origin) * pMaterial->Shade(hitRecord, lightDirection, viewDirection) * lambertsCos;
+	}
+}
+
+int Renderer::ScatterSpecular(const HitRecord& hitRecord, const Vector3& rayDirection, const SpecularScatter& scatter,
+	const ColorRGB& throughput, float throughputThreshold, SecondaryRay* pSecondaryRays)
+{
+	int numSecondaryRays{ 0 };
+
+	// Hitting the plane/sphere from the back side (inside a refractive sphere)
+	Vector3 normal{ hitRecord.normal.Normalized() };
+	const bool isEntering{ Vector3::Dot(rayDirection, normal) < 0.f };
+	if (!isEntering)
+		normal = -normal;
+
+	ColorRGB reflectance{ scatter.reflectance };
+	const ColorRGB transmittedThroughput{ throughput * scatter.transmittance };
+	if (transmittedThroughput.r + transmittedThroughput.g + transmittedThroughput.b > throughputThreshold)
+	{
+		const float eta{ isEntering ? 1.f / scatter.ior : scatter.ior };
+		const float cosIncident{ -Vector3::Dot(rayDirection, normal) };
+		const float sinTransmittedSqr{ eta * eta * (1.f - cosIncident * cosIncident) };
+
+		if (sinTransmittedSqr > 1.f)
+		{
+			// Total internal reflection, the transmitted energy is reflected instead
+			reflectance += scatter.transmittance;
+		}
+		else
+		{
+			Ray refractedRay{};
+			refractedRay.direction = rayDirection * eta + normal * (eta * cosIncident - sqrtf(1.f - sinTransmittedSqr));
+			refractedRay.direction.Normalize();
+			refractedRay.origin = hitRecord.origin - (normal * 0.01f);
+
+			pSecondaryRays[numSecondaryRays++] = { refractedRay, transmittedThroughput };
+		}
+	}
+
+	const ColorRGB reflectedThroughput{ throughput * reflectance };
+	if (reflectedThroughput.r + reflectedThroughput.g + reflectedThroughput.b > throughputThreshold)
+	{
+		Ray reflectedRay{};
+		reflectedRay.direction = Vector3::Reflect(rayDirection, normal);
+		reflectedRay.origin = hitRecord.origin + (normal * 0.01f);
+
+		pSecondaryRays[numSecondaryRays++] = { reflectedRay, reflectedThroughput };
+	}
+
+	return numSecondaryRays;
+}
+
+void Renderer::UpdatePrimaryVisibility(Scene* pScene, const Matrix& cameraToWorld) const
+{
+	// The path tracer samples its camera rays all over each pixel, it uses neither the culled lists nor the visibility buffer
+	if (m_CurrentLightingMode == LightingMode::PathTraced)
+		return;
+
+	if (m_RenderMode == RenderMode::Rasterized)
+		m_pRasterizer->Update(*pScene, *this, pScene->GetCamera(), cameraToWorld, m_RenderWidth, m_RenderHeight);
+	else
+		m_pTileCuller->Update(*pScene, pScene->GetCamera(), cameraToWorld, m_RenderWidth, m_RenderHeight);
+}
+
+void Renderer::UpdateShadowCaches(Scene* pScene) const
+{
+	// The path tracer always traces its shadow rays
+	if (!m_ShadowsEnabled || m_CurrentLightingMode == LightingMode::PathTraced)
+		return;
+
+	if (m_ShadowMapsEnabled)
+		m_pShadowMaps->Update(*pScene);
+	if (m_LightCacheEnabled)
+		m_pLightCache->Update(*pScene);
+}
+
+Vector3 Renderer::GetViewDirection(const Camera& camera, const Matrix& cameraToWorld, float x, float y) const
+{
+	float aspectRatio{m_RenderWidth/float(m_RenderHeight)};
+	float FOV{ tan((camera.fovAngle) / 2) };
+
+	// float gradient = px / static_cast<float>(m_Width);
+	// gradient += py / static_cast<float>(m_Height);
+	// gradient /= 2.0f;
+
+	float xNdc{ ((2 * x / m_RenderWidth) - 1) * FOV * aspectRatio };
+	float yNdc{ (1 - (2 * y / m_RenderHeight)) * FOV };
+
+	Vector3 rayDirection{ xNdc , yNdc, 1 };
+	rayDirection = cameraToWorld.TransformVector(rayDirection);
+	rayDirection.Normalize();
+	return rayDirection;
+}
+
+void Renderer::RenderPathTraced(Scene* pScene) const
+{
+	Camera& camera = pScene->GetCamera();
 	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
 
-	float aspectRatio{m_Width/float(m_Height)};
-	float FOV{ tan((pScene->GetCamera().fovAngle) / 2) };
+	const size_t numPixels{ static_cast<size_t>(m_RenderWidth) * m_RenderHeight };
+	// Moved geometry, lights or materials invalidate the samples just like a moved camera
+	if (m_AccumulatedSamples == 0 || m_Accumulation.size() != numPixels || pScene->GetContentGeneration() != m_AccumulatedSceneGeneration
+		|| !(cameraToWorld == m_AccumulatedCameraToWorld) || camera.fovAngle != m_AccumulatedFovAngle)
+	{
+		m_Accumulation.assign(numPixels, {});
+		m_AccumulatedAlbedos.assign(numPixels, {});
+		m_AccumulatedNormals.assign(numPixels, {});
+		m_AccumulatedDepths.assign(numPixels, 0.f);
+		m_AccumulatedSamples = 0;
+		m_AccumulatedCameraToWorld = cameraToWorld;
+		m_AccumulatedFovAngle = camera.fovAngle;
+		m_AccumulatedSceneGeneration = pScene->GetContentGeneration();
+	}
+
+	// Every pixel draws from its own stateless sampler, so rows can be traced in parallel
+	const float sampleWeight{ 1.f / (m_AccumulatedSamples + 1) };
+	std::for_each(std::execution::par, m_RowIndices.begin(), m_RowIndices.begin() + m_RenderHeight, [&](int py)
+		{
+			for (int px{}; px < m_RenderWidth; ++px)
+			{
+				const int pixelIndex{ px + (py * m_RenderWidth) };
+
+				PixelFeatures features{};
+				const ColorRGB sample{ TracePath(pScene, px, py, cameraToWorld, m_AccumulatedSamples, features) };
+
+				if (std::isfinite(sample.r + sample.g + sample.b))
+					m_Accumulation[pixelIndex] += sample;
+				m_AccumulatedAlbedos[pixelIndex] += features.albedo;
+				m_AccumulatedNormals[pixelIndex] += features.normal;
+				m_AccumulatedDepths[pixelIndex] += features.depth;
+			}
+
+			if (!m_DenoiserEnabled)
+			{
+				const int rowStart{ py * m_RenderWidth };
+				m_pKernels->tonemap(m_Accumulation.data() + rowStart, sampleWeight, m_pRenderPixels + rowStart, static_cast<uint32_t>(m_RenderWidth), m_PixelLayout);
+			}
+		});
+
+	++m_AccumulatedSamples;
 
-	for (int px{}; px < m_Width; ++px)
+	if (m_DenoiserEnabled)
 	{
-		for (int py{}; py < m_Height; ++py)
+		const std::vector<ColorRGB>& colors{ m_pDenoiser->Denoise({ m_RenderWidth, m_RenderHeight, m_Accumulation.data(), m_AccumulatedAlbedos.data(),
+			m_AccumulatedNormals.data(), m_AccumulatedDepths.data(), sampleWeight }) };
+
+		std::for_each(std::execution::par, m_RowIndices.begin(), m_RowIndices.begin() + m_RenderHeight, [&](int py)
+			{
+				const int rowStart{ py * m_RenderWidth };
+				m_pKernels->tonemap(colors.data() + rowStart, 1.f, m_pRenderPixels + rowStart, static_cast<uint32_t>(m_RenderWidth), m_PixelLayout);
+			});
+	}
+}
+
+void Renderer::WritePixel(int pixelIndex, ColorRGB color) const
+{
+	color.MaxToOne();
+
+	m_pRenderPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+		static_cast<uint8_t>(color.r * 255),
+		static_cast<uint8_t>(color.g * 255),
+		static_cast<uint8_t>(color.b * 255));
+}
+
+ColorRGB Renderer::TracePath(Scene* pScene, int px, int py, const Matrix& cameraToWorld, uint32_t sampleIndex, PixelFeatures& features) const
+{
+	const Camera& camera = pScene->GetCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	Sampling::PixelSampler sampler{ static_cast<uint32_t>(px), static_cast<uint32_t>(py), sampleIndex };
+
+	// Jittered inside the pixel, accumulating samples antialiases the image
+	const Sample2D pixelSample{ sampler.Get2D() };
+	Ray ray{ camera.origin, GetViewDirection(camera, cameraToWorld, px + pixelSample.u, py + pixelSample.v) };
+
+	ColorRGB radiance{ 0,0,0 };
+	ColorRGB throughput{ colors::White };
+	float bsdfPdf{};
+	bool isSpecularBounce{ true }; // Camera rays count as specular, area lights they hit are not light sampled
+
+	for (int pathLength{}; pathLength < m_MaxPathLength; ++pathLength)
+	{
+		HitRecord hitRecord{};
+		pScene->GetClosestHit(ray, hitRecord);
+
+		// Area light in front of the surface, weighted against the light sample that could have found it
+		int hitLightIndex{ -1 };
+		float lightT{ hitRecord.t };
+		for (int indexLights{}; indexLights < static_cast<int>(lights.size()); ++indexLights)
 		{
-			// float gradient = px / static_cast<float>(m_Width);
-			// gradient += py / static_cast<float>(m_Height);
-			// gradient /= 2.0f;
+			float t{};
+			if (LightUtils::IsAreaLight(lights[indexLights]) && LightUtils::IntersectAreaLight(lights[indexLights], ray, t) && t < lightT)
+			{
+				lightT = t;
+				hitLightIndex = indexLights;
+			}
+		}
 
-			float xNdc{ ((2 * (px + 0.5f) / m_Width) - 1) * FOV * aspectRatio };
-			float yNdc{ (1 - (2 * (py + 0.5f) / m_Height)) * FOV };
+		if (hitLightIndex >= 0)
+		{
+			const Light& light{ lights[hitLightIndex] };
+			if (pathLength == 0)
+				features = { light.color, -ray.direction, lightT };
 
-			Vector3 rayDirection{ xNdc , yNdc, 1 };
-			rayDirection = cameraToWorld.TransformVector(rayDirection);
-			rayDirection.Normalize();
+			const float weight{ isSpecularBounce ? 1.f
+				: Sampling::PowerHeuristic(bsdfPdf, LightUtils::GetLightPdf(light, ray.origin, ray.direction, lightT)) };
+			radiance += throughput * light.color * (light.intensity * weight);
+			break;
+		}
 
+		if (!hitRecord.didHit)
+			break;
 
-			//For Each pixel...
-			// ... Ray Direction calculations above ...
-			// Ray we are casting from the camera towards each pixel
-			Ray viewRay{ camera.origin ,rayDirection };
+		hitRecord.normal.Normalize();
+		const Material* pMaterial{ materials[hitRecord.materialIndex] };
+		if (pathLength == 0)
+			features = { pMaterial->GetAlbedo(), hitRecord.normal, hitRecord.t };
 
-			// Color to write to the color buffer (default = black)
-			ColorRGB finalColor{ 0,0,0 };
+		const Vector3 v{ -ray.direction }; // Unlike the classic modes, materials get the direction towards the viewer here
+		const Vector3 offsetOrigin{ hitRecord.origin + (hitRecord.normal * 0.01f) };
 
-			//HitRecord containing more info about potential hit
-			HitRecord closestHit{};
-			pScene->GetClosestHit(viewRay, closestHit);
-			
-			if (closestHit.didHit)
+		// Next event estimation, one sample on every light
+		if (!pMaterial->IsDeltaBSDF())
+		{
+			for (const Light& light : lights)
 			{
-				// T_value visualization
-				// const float scaled_t = closestHit.t / 500.f;
-				// finalColor = { scaled_t,scaled_t,scaled_t };
-			
-				// If we hit something, set finalColor to material color, else keep BLACK
-				// Use HitRecord::materialIndex to find the corresponding material
-				Ray lightRay{};
-			
-				for (int indexLights{}; indexLights < lights.size(); ++indexLights)
+				LightUtils::LightSample lightSample{};
+				if (!LightUtils::SampleLight(light, offsetOrigin, sampler.Get2D(), lightSample))
+					continue;
+
+				const float lDOTn{ Vector3::Dot(lightSample.direction, hitRecord.normal) };
+				if (lDOTn <= 0.f)
+					continue;
+
+				if (m_ShadowsEnabled)
 				{
-					
-					lightRay.origin = closestHit.origin + (closestHit.normal*0.01f);
-					lightRay.direction = LightUtils::GetDirectionToLight(pScene->GetLights()[indexLights], lightRay.origin);
-					
-					lightRay.min = 0.0001f;
-					lightRay.max = lightRay.direction.Magnitude();
-				
-					lightRay.direction.Normalize(); 
-					
-
-					 // BRDFs!
-					 ColorRGB Ergb{ LightUtils::GetRadiance(pScene->GetLights()[indexLights],closestHit.origin) };
-					 closestHit.normal.Normalize();
-
-					 float lambertsCos = Vector3::Dot(closestHit.normal, lightRay.direction);
-					 lambertsCos = std::max(lambertsCos, 0.0001f);
-
-					 ColorRGB BRDFrgb = materials[closestHit.materialIndex]->Shade(closestHit,lightRay.direction, viewRay.direction);
-					 
-					 switch (m_CurrentLightingMode)
-					 {
-					 case dae::Renderer::LightingMode::ObservedArea:
-					 	if (lambertsCos > 0)
-					 		finalColor += { lambertsCos,lambertsCos,lambertsCos };
-					 	break;
-					 case dae::Renderer::LightingMode::Radiance:
-					 	finalColor += Ergb;
-					 	break;
-					 case dae::Renderer::LightingMode::BRDF:
-						 finalColor += BRDFrgb;
-					 	break;
-					 case dae::Renderer::LightingMode::Combined:
-						 finalColor += Ergb * BRDFrgb  * lambertsCos;
-					 	break;
-					 }
-
-					// HARD SHADOW
-					if(m_ShadowsEnabled)
-					{
-						if (pScene->DoesHit(lightRay))
-						{
-							finalColor *= 0.5;
-						}
-					}
-					
-					
+					Ray lightRay{ offsetOrigin, lightSample.direction };
+					lightRay.max = lightSample.distance * 0.999f;
+					if (pScene->DoesHit(lightRay))
+						continue;
 				}
+
+				const float weight{ lightSample.isDelta ? 1.f
+					: Sampling::PowerHeuristic(lightSample.pdf, pMaterial->GetPdf(hitRecord, lightSample.direction, v)) };
+				radiance += throughput * pMaterial->Shade(hitRecord, lightSample.direction, v) * lightSample.radiance
+					* (lDOTn * weight / lightSample.pdf);
 			}
-			
+		}
 
-			//Update Color in Buffer
-			finalColor.MaxToOne();
+		// Continue the path in a direction picked by the material
+		const Sample2D bsdfSample2D{ sampler.Get2D() };
+		BSDFSample bsdfSample{};
+		if (!pMaterial->SampleBSDF(hitRecord, v, bsdfSample2D, sampler.Get1D(), bsdfSample))
+			break;
 
-			m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-				static_cast<uint8_t>(finalColor.r * 255),
-				static_cast<uint8_t>(finalColor.g * 255),
-				static_cast<uint8_t>(finalColor.b * 255));
+		throughput *= bsdfSample.weight;
+		bsdfPdf = bsdfSample.pdf;
+		isSpecularBounce = bsdfSample.isSpecular;
+
+		// Russian roulette, unlikely paths are ended and the survivors weighted up to stay unbiased
+		const float roulette{ sampler.Get1D() };
+		if (pathLength >= 3)
+		{
+			const float survival{ std::min(std::max(throughput.r, std::max(throughput.g, throughput.b)), 0.95f) };
+			if (roulette >= survival)
+				break;
+			throughput *= 1.f / survival;
+		}
+
+		const float side{ Vector3::Dot(bsdfSample.direction, hitRecord.normal) > 0.f ? 0.01f : -0.01f };
+		ray = Ray{ hitRecord.origin + (hitRecord.normal * side), bsdfSample.direction };
+	}
+
+	return radiance;
+}
+
+bool Renderer::RenderPriorityTiles(Scene* pScene, uint64_t deadline) const
+{
+	Camera& camera = pScene->GetCamera();
+	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
 
-			
+	// Unfinished work is only continued while it still describes the same image
+	if (m_NextPriorityTile >= m_PriorityTiles.size() || !(cameraToWorld == m_PriorityTilesCameraToWorld)
+		|| camera.fovAngle != m_PriorityTilesFovAngle || m_RenderWidth != m_PriorityTilesWidth
+		|| pScene->GetContentGeneration() != m_PriorityTilesSceneGeneration)
+	{
+		BuildPriorityTiles(camera, deadline != UINT64_MAX);
+		m_NextPriorityTile = 0;
+		m_PriorityTilesCameraToWorld = cameraToWorld;
+		m_PriorityTilesFovAngle = camera.fovAngle;
+		m_PriorityTilesWidth = m_RenderWidth;
+		m_PriorityTilesSceneGeneration = pScene->GetContentGeneration();
+	}
 
+	// Waves of tiles run in parallel one after the other, so the region around the focus is finished first.
+	// At least one wave per call, so every call makes progress
+	const size_t firstTile{ m_NextPriorityTile };
+	const PixelKernel renderPixel{ GetPixelKernel() };
+	UpdatePrimaryVisibility(pScene, cameraToWorld);
+	UpdateShadowCaches(pScene);
+	do
+	{
+		const auto waveBegin{ m_PriorityTiles.begin() + m_NextPriorityTile };
+		const auto waveEnd{ m_PriorityTiles.begin() + std::min(m_NextPriorityTile + m_PriorityTilesPerWave, m_PriorityTiles.size()) };
+		std::for_each(std::execution::par, waveBegin, waveEnd, [&](const PriorityTile& tile)
+			{
+				uint32_t secondaryRayCount{};
+				RenderPriorityTile(pScene, tile, renderPixel, cameraToWorld, secondaryRayCount);
+				m_SecondaryRayCount += secondaryRayCount;
+			});
+		m_NextPriorityTile = waveEnd - m_PriorityTiles.begin();
+	} while (m_NextPriorityTile < m_PriorityTiles.size() && SDL_GetPerformanceCounter() < deadline);
 
+	m_RenderedFraction = (m_NextPriorityTile - firstTile) / static_cast<float>(m_PriorityTiles.size());
+	return m_NextPriorityTile >= m_PriorityTiles.size();
+}
+
+void Renderer::BuildPriorityTiles(const Camera& camera, bool addPreview) const
+{
+	// The focus is in window pixels, the centre of the image until the mouse was seen
+	const float renderScale{ m_RenderWidth / static_cast<float>(m_Width) };
+	const float focusX{ camera.focusX >= 0 ? (camera.focusX + 0.5f) * renderScale : m_RenderWidth * 0.5f };
+	const float focusY{ camera.focusY >= 0 ? (camera.focusY + 0.5f) * renderScale : m_RenderHeight * 0.5f };
+	const float radius{ m_FoveaRadius * m_RenderHeight };
+
+	m_PriorityTiles.clear();
+	for (int y{}; y < m_RenderHeight; y += m_PriorityTileSize)
+	{
+		for (int x{}; x < m_RenderWidth; x += m_PriorityTileSize)
+		{
+			PriorityTile tile{ x, y, std::min(m_PriorityTileSize, m_RenderWidth - x), std::min(m_PriorityTileSize, m_RenderHeight - y), 1 };
+
+			const float dx{ std::max({ x - focusX, focusX - (x + tile.width), 0.f }) };
+			const float dy{ std::max({ y - focusY, focusY - (y + tile.height), 0.f }) };
+			tile.distance = std::sqrt(dx * dx + dy * dy);
+			if (m_FoveationEnabled)
+				tile.stride = tile.distance <= radius ? 1 : tile.distance <= 2.f * radius ? 2 : m_MaxTileStride;
+			m_PriorityTiles.push_back(tile);
 		}
 	}
 
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	std::sort(m_PriorityTiles.begin(), m_PriorityTiles.end(),
+		[](const PriorityTile& a, const PriorityTile& b) { return a.distance < b.distance; });
+
+	// With a deadline every tile first gets a cheap version, tiles already that coarse need no refinement
+	if (addPreview)
+	{
+		const size_t numTiles{ m_PriorityTiles.size() };
+		for (size_t index{}; index < numTiles; ++index)
+		{
+			PriorityTile preview{ m_PriorityTiles[index] };
+			preview.stride = m_MaxTileStride;
+			m_PriorityTiles.push_back(preview);
+		}
+		std::rotate(m_PriorityTiles.begin(), m_PriorityTiles.begin() + numTiles, m_PriorityTiles.end());
+		m_PriorityTiles.erase(std::remove_if(m_PriorityTiles.begin() + numTiles, m_PriorityTiles.end(),
+			[](const PriorityTile& tile) { return tile.stride == m_MaxTileStride; }), m_PriorityTiles.end());
+	}
+}
+
+void Renderer::RenderPriorityTile(Scene* pScene, const PriorityTile& tile, PixelKernel renderPixel, const Matrix& cameraToWorld, uint32_t& secondaryRayCount) const
+{
+	if (tile.stride == 1)
+	{
+		for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+		{
+			for (int px{ tile.x }; px < tile.x + tile.width; ++px)
+				WritePixel(px + (py * m_RenderWidth), (this->*renderPixel)(pScene, px, py, cameraToWorld, secondaryRayCount));
+		}
+		return;
+	}
+
+	// Traced pixels every stride pixels plus the last row and column, so every other pixel of the tile lies between traced ones
+	constexpr int maxLatticeSize{ m_PriorityTileSize / 2 + 1 };
+	int latticeX[maxLatticeSize]{}, latticeY[maxLatticeSize]{};
+	const auto buildLattice = [&](int* pLattice, int size)
+		{
+			int count{ 1 };
+			while (pLattice[count - 1] + tile.stride < size - 1)
+			{
+				pLattice[count] = pLattice[count - 1] + tile.stride;
+				++count;
+			}
+			if (size > 1)
+				pLattice[count++] = size - 1;
+			return count;
+		};
+	const int numX{ buildLattice(latticeX, tile.width) };
+	const int numY{ buildLattice(latticeY, tile.height) };
+
+	ColorRGB samples[maxLatticeSize * maxLatticeSize]{};
+	for (int j{}; j < numY; ++j)
+	{
+		for (int i{}; i < numX; ++i)
+			samples[i + (j * numX)] = (this->*renderPixel)(pScene, tile.x + latticeX[i], tile.y + latticeY[j], cameraToWorld, secondaryRayCount);
+	}
+
+	// Interval of the lattice around a pixel and the position inside it
+	const auto locate = [&](const int* pLattice, int count, int local, int& index0, int& index1)
+		{
+			index0 = std::min(local / tile.stride, std::max(count - 2, 0));
+			index1 = std::min(index0 + 1, count - 1);
+			const int span{ pLattice[index1] - pLattice[index0] };
+			return span > 0 ? (local - pLattice[index0]) / static_cast<float>(span) : 0.f;
+		};
+
+	for (int ly{}; ly < tile.height; ++ly)
+	{
+		int j0{}, j1{};
+		const float ty{ locate(latticeY, numY, ly, j0, j1) };
+		for (int lx{}; lx < tile.width; ++lx)
+		{
+			int i0{}, i1{};
+			const float tx{ locate(latticeX, numX, lx, i0, i1) };
+
+			const ColorRGB top{ ColorRGB::Lerp(samples[i0 + (j0 * numX)], samples[i1 + (j0 * numX)], tx) };
+			const ColorRGB bottom{ ColorRGB::Lerp(samples[i0 + (j1 * numX)], samples[i1 + (j1 * numX)], tx) };
+			WritePixel(tile.x + lx + ((tile.y + ly) * m_RenderWidth), ColorRGB::Lerp(top, bottom, ty));
+		}
+	}
+}
+
+void Renderer::SetRenderResolution(float scale) const
+{
+	// Multiples of 4 keep the aspect ratio close and avoid a new size for every tiny change of the scale
+	const int width{ std::max(4 * static_cast<int>(std::lround(m_Width * scale / 4)), 4) };
+	if (width >= m_Width)
+	{
+		m_RenderWidth = m_Width;
+		m_RenderHeight = m_Height;
+		m_pRenderPixels = m_pBufferPixels;
+		return;
+	}
+
+	m_RenderWidth = width;
+	m_RenderHeight = std::max(static_cast<int>(std::lround(width * static_cast<float>(m_Height) / m_Width)), 1);
+	m_ScaledPixels.resize(static_cast<size_t>(m_RenderWidth) * m_RenderHeight);
+	m_pRenderPixels = m_ScaledPixels.data();
+}
+
+void Renderer::Upscale() const
+{
+	// Pixel centers of the buffer mapped onto the scaled down copy, interpolated in fixed point straight on the mapped pixels
+	const float scaleX{ m_RenderWidth / static_cast<float>(m_Width) };
+	const float scaleY{ m_RenderHeight / static_cast<float>(m_Height) };
+
+	std::for_each(std::execution::par, m_RowIndices.begin(), m_RowIndices.end(), [&](int py)
+		{
+			const float sourceY{ std::clamp((py + 0.5f) * scaleY - 0.5f, 0.f, static_cast<float>(m_RenderHeight - 1)) };
+			const int y0{ static_cast<int>(sourceY) };
+			const uint32_t weightY{ static_cast<uint32_t>((sourceY - y0) * 256) };
+			const uint32_t* pRow0{ m_ScaledPixels.data() + (y0 * m_RenderWidth) };
+			const uint32_t* pRow1{ m_ScaledPixels.data() + (std::min(y0 + 1, m_RenderHeight - 1) * m_RenderWidth) };
+
+			uint32_t* pPixels{ m_pBufferPixels + (py * m_Width) };
+			for (int px{}; px < m_Width; ++px)
+			{
+				const float sourceX{ std::clamp((px + 0.5f) * scaleX - 0.5f, 0.f, static_cast<float>(m_RenderWidth - 1)) };
+				const int x0{ static_cast<int>(sourceX) };
+				const int x1{ std::min(x0 + 1, m_RenderWidth - 1) };
+				const uint32_t weightX{ static_cast<uint32_t>((sourceX - x0) * 256) };
+
+				pPixels[px] = LerpPixel(LerpPixel(pRow0[x0], pRow0[x1], weightX), LerpPixel(pRow1[x0], pRow1[x1], weightX), weightY);
+			}
+		});
+}
+
+void Renderer::SetDynamicResolutionEnabled(bool dynamicResolutionEnabled)
+{
+	m_DynamicResolutionEnabled = dynamicResolutionEnabled;
+	m_pResolutionController->Reset();
+}
+
+float Renderer::GetTargetFrameTime() const
+{
+	return m_pResolutionController->GetTargetFrameTime();
+}
+
+void Renderer::SetTargetFrameTime(float targetFrameTime)
+{
+	m_pResolutionController->SetTargetFrameTime(targetFrameTime);
+}
+
+void Renderer::SetLightCacheCellSize(float cellSize)
+{
+	// Not below 0.001 units, which also keeps a zero or NaN sent by a coordinator from dividing by zero
+	m_pLightCache->SetCellSize(cellSize > 0.001f ? cellSize : 0.001f);
+	ResetAccumulation();
+}
+
+float Renderer::GetLightCacheCellSize() const
+{
+	return m_pLightCache->GetCellSize();
 }
 
 bool Renderer::SaveBufferToImage() const
@@ -147,6 +942,28 @@ bool Renderer::SaveBufferToImage() const
 	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
 }
 
+void Renderer::SetMaxBounces(int maxBounces)
+{
+	// Depth first traversal keeps at most one pending sibling per bounce on the stack
+	m_MaxBounces = std::clamp(maxBounces, 0, m_MaxRayStackSize - 2);
+}
+
+void Renderer::ToggleRenderMode()
+{
+	switch (m_RenderMode)
+	{
+	case RenderMode::PerPixel:
+		m_RenderMode = RenderMode::Wavefront;
+		break;
+	case RenderMode::Wavefront:
+		m_RenderMode = RenderMode::Rasterized;
+		break;
+	case RenderMode::Rasterized:
+		m_RenderMode = RenderMode::PerPixel;
+		break;
+	}
+}
+
 void Renderer::CycleLightingMode()
 {
 	switch (m_CurrentLightingMode)
@@ -161,7 +978,11 @@ void Renderer::CycleLightingMode()
 		m_CurrentLightingMode = LightingMode::Combined;
 		break;
 	case dae::Renderer::LightingMode::Combined:
+		m_CurrentLightingMode = LightingMode::PathTraced;
+		break;
+	case dae::Renderer::LightingMode::PathTraced:
 		m_CurrentLightingMode = LightingMode::ObservedArea;
 		break;
 	}
+	ResetAccumulation();
 }
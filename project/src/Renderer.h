@@ -1,19 +1,42 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Kernels.h"
+#include "Maths.h"
 
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
+	class Denoiser;
+	class LightVisibilityCache;
+	class Material;
+	class Rasterizer;
+	class ResolutionController;
 	class Scene;
+	class ShadowMaps;
+	class TileCuller;
+	class WavefrontPipeline;
+	struct Camera;
+	struct HitRecord;
+	struct Light;
+	struct PixelFeatures;
+	struct Ray;
+	struct SecondaryRay;
+	struct SpecularScatter;
+	struct Tile;
 
 	class Renderer final
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		Renderer(int width, int height); // Headless, renders into an owned surface
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
@@ -21,30 +44,223 @@ namespace dae
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
 		void Render(Scene* pScene) const;
+		// Renders until the deadline (an SDL performance counter value) passes, the tiles closest to the focus first, and returns
+		// whether the frame is complete. Unfinished tiles show a coarse preview, the next call continues them while the camera stands still
+		bool Render(Scene* pScene, uint64_t deadline) const;
+		void RenderTile(Scene* pScene, const Tile& tile) const;
+		void RenderTile(Scene* pScene, const Tile& tile, uint8_t* pRGBOut) const; // Tightly packed RGB8, row by row
+		void WriteTile(const Tile& tile, const uint8_t* pRGB, uint64_t secondaryRayCount); // Rendered elsewhere, with the secondary rays traced for it
+		void Present() const;
 		bool SaveBufferToImage() const;
 
-		void CycleLightingMode();
-		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; };
-
-	private:
+		SDL_Surface* GetBuffer() const { return m_pBuffer; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
 
 		enum class LightingMode
 		{
 			ObservedArea=0,	// Lambert Cosine Law
 			Radiance=1,		// Incident Radiance
 			BRDF=2,			// Scattering of the light
-			Combined=3		// ObservedArea*Radiance*BRDF
+			Combined=3,		// ObservedArea*Radiance*BRDF
+			PathTraced=4	// Monte Carlo global illumination, accumulated over frames while nothing changes
+		};
+
+		enum class RenderMode
+		{
+			PerPixel=0,		// Every pixel traced to completion on its own
+			Wavefront=1,	// All rays of a bounce processed stage by stage from SoA queues
+			Rasterized=2	// Like PerPixel, but what the camera sees first comes from a visibility buffer, only later rays are traced
 		};
-		
+
+		void CycleLightingMode();
+		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; ResetAccumulation(); };
+
+		LightingMode GetLightingMode() const { return m_CurrentLightingMode; }
+		void SetLightingMode(LightingMode lightingMode) { m_CurrentLightingMode = lightingMode; ResetAccumulation(); }
+		bool AreShadowsEnabled() const { return m_ShadowsEnabled; }
+		void SetShadowsEnabled(bool shadowsEnabled) { m_ShadowsEnabled = shadowsEnabled; ResetAccumulation(); }
+
+		// Looks shadows of directional lights up in shadow maps filtered over a few texels instead of tracing them, in the classic modes
+		void ToggleShadowMaps() { m_ShadowMapsEnabled = !m_ShadowMapsEnabled; ResetAccumulation(); }
+		bool AreShadowMapsEnabled() const { return m_ShadowMapsEnabled; }
+		void SetShadowMapsEnabled(bool shadowMapsEnabled) { m_ShadowMapsEnabled = shadowMapsEnabled; ResetAccumulation(); }
+
+		// Remembers traced shadow rays per small world space cell while the scene stays the same, in the classic modes.
+		// Once a few rays of a cell agreed, other points in it reuse their answer
+		void ToggleLightCache() { m_LightCacheEnabled = !m_LightCacheEnabled; ResetAccumulation(); }
+		bool IsLightCacheEnabled() const { return m_LightCacheEnabled; }
+		void SetLightCacheEnabled(bool lightCacheEnabled) { m_LightCacheEnabled = lightCacheEnabled; ResetAccumulation(); }
+		// Edge of a cell in world units, smaller cells get fewer shadows wrong near their edges but answer after more traced rays
+		void SetLightCacheCellSize(float cellSize);
+		float GetLightCacheCellSize() const;
+
+		void ToggleReflections() { m_ReflectionsEnabled = !m_ReflectionsEnabled; }
+		bool AreReflectionsEnabled() const { return m_ReflectionsEnabled; }
+		void SetReflectionsEnabled(bool reflectionsEnabled) { m_ReflectionsEnabled = reflectionsEnabled; }
+
+		// Reflection/refraction depth, limited by the size of the per-pixel ray stack
+		int GetMaxBounces() const { return m_MaxBounces; }
+		void SetMaxBounces(int maxBounces);
+
+		// Secondary rays whose summed rgb throughput drops below this are not traced
+		float GetThroughputThreshold() const { return m_ThroughputThreshold; }
+		void SetThroughputThreshold(float throughputThreshold) { m_ThroughputThreshold = throughputThreshold; }
+
+		void ToggleRenderMode();
+		RenderMode GetRenderMode() const { return m_RenderMode; }
+		void SetRenderMode(RenderMode renderMode) { m_RenderMode = renderMode; }
+
+		// Longest path followed by the path tracer, Russian roulette usually ends paths earlier
+		int GetMaxPathLength() const { return m_MaxPathLength; }
+		void SetMaxPathLength(int maxPathLength) { m_MaxPathLength = std::max(maxPathLength, 1); ResetAccumulation(); }
+
+		// Filters the path traced image with the albedo, normal and depth of the first hits, the samples themselves are kept
+		void ToggleDenoiser() { m_DenoiserEnabled = !m_DenoiserEnabled; }
+		bool IsDenoiserEnabled() const { return m_DenoiserEnabled; }
+		void SetDenoiserEnabled(bool denoiserEnabled) { m_DenoiserEnabled = denoiserEnabled; }
+
+		// Renders at a lower internal resolution while frames take longer than the target frame time, upscaled into the buffer
+		void ToggleDynamicResolution() { SetDynamicResolutionEnabled(!m_DynamicResolutionEnabled); }
+		bool IsDynamicResolutionEnabled() const { return m_DynamicResolutionEnabled; }
+		void SetDynamicResolutionEnabled(bool dynamicResolutionEnabled);
+		float GetTargetFrameTime() const; // Milliseconds
+		void SetTargetFrameTime(float targetFrameTime);
+		// Internal resolution of the last frame relative to the buffer
+		float GetResolutionScale() const { return m_ResolutionScale; }
+
+		// Traces every pixel only around the camera's focus, coarser further out, and finishes the tiles closest to it first
+		void ToggleFoveation() { m_FoveationEnabled = !m_FoveationEnabled; }
+		bool IsFoveationEnabled() const { return m_FoveationEnabled; }
+		void SetFoveationEnabled(bool foveationEnabled) { m_FoveationEnabled = foveationEnabled; }
+		// Radius around the focus traced at full resolution, relative to the image height
+		float GetFoveaRadius() const { return m_FoveaRadius; }
+		void SetFoveaRadius(float foveaRadius) { m_FoveaRadius = std::max(foveaRadius, 0.f); }
+
+		// Path traced samples per pixel averaged into the current image, restarts when the camera or settings change
+		uint32_t GetAccumulatedSamples() const { return m_AccumulatedSamples; }
+		void ResetAccumulation() { m_AccumulatedSamples = 0; m_PriorityTiles.clear(); }
+
+		// Reflection and refraction rays traced during the last Render, or by the tiles rendered and written since ResetSecondaryRayCount
+		uint64_t GetSecondaryRayCount() const { return m_SecondaryRayCount; }
+		void ResetSecondaryRayCount() const { m_SecondaryRayCount = 0; }
+
+	private:
+		friend class Rasterizer;
+		friend class WavefrontPipeline;
+
+		static constexpr int m_MaxRayStackSize{ 16 };
+		static constexpr int m_PriorityTileSize{ 16 };
+		static constexpr int m_PriorityTilesPerWave{ 32 };
+		static constexpr int m_MaxTileStride{ 4 };
+
+		struct PriorityTile
+		{
+			int x{};
+			int y{};
+			int width{};
+			int height{};
+			int stride{};		// Distance between traced pixels, the ones in between are interpolated
+			float distance{};	// From the focus to the closest pixel of the tile
+		};
+
+		// One instantiation of the pixel kernel per lighting mode, shadow setting and source of primary hits (the rasterizer or the
+		// tile culler), so neither the pixel nor the per light loop branches on them. GetPixelKernel picks the one for the current settings, once per tile
+		using PixelKernel = ColorRGB(Renderer::*)(Scene* pScene, int px, int py, const Matrix& cameraToWorld, uint32_t& secondaryRayCount) const;
+		PixelKernel GetPixelKernel() const;
+		template<LightingMode lightingMode>
+		PixelKernel GetPixelKernel() const;
+		template<LightingMode lightingMode, bool areShadowsEnabled, bool isRasterized>
+		ColorRGB RenderPixel(Scene* pScene, int px, int py, const Matrix& cameraToWorld, uint32_t& secondaryRayCount) const;
+		template<LightingMode lightingMode, bool areShadowsEnabled>
+		ColorRGB ShadeHit(Scene* pScene, HitRecord& hitRecord, const Vector3& viewDirection) const;
+		void UpdatePrimaryVisibility(Scene* pScene, const Matrix& cameraToWorld) const; // Before tracing primary rays of the current camera
+		void UpdateShadowCaches(Scene* pScene) const; // Shadow maps and light cache, before shading in the classic modes
+		Vector3 GetViewDirection(const Camera& camera, const Matrix& cameraToWorld, float x, float y) const; // Continuous pixel coordinates
+
+		void RenderPathTraced(Scene* pScene) const;
+		ColorRGB TracePath(Scene* pScene, int px, int py, const Matrix& cameraToWorld, uint32_t sampleIndex, PixelFeatures& features) const;
+		void WritePixel(int pixelIndex, ColorRGB color) const; // Clamps and stores into the render pixels
+
+		// Continues the work list of the current frame (or starts a new one) until the deadline, returns whether it is finished
+		bool RenderPriorityTiles(Scene* pScene, uint64_t deadline) const;
+		void BuildPriorityTiles(const Camera& camera, bool addPreview) const;
+		void RenderPriorityTile(Scene* pScene, const PriorityTile& tile, PixelKernel renderPixel, const Matrix& cameraToWorld, uint32_t& secondaryRayCount) const;
+
+		void SetRenderResolution(float scale) const; // Points the render functions at the buffer or at a scaled down copy of it
+		void Upscale() const; // Bilinear, from the scaled down copy into the buffer
+
+		// Shading building blocks shared by the per pixel and the wavefront path
+		static Ray GetLightRay(const HitRecord& hitRecord, const Light& light);
+		// What light lightIndex is scaled by at the origin of its light ray, 0.5 in shadow, 1 when lit and in between at filtered shadow map edges
+		float GetShadowFactor(const Scene* pScene, const Ray& lightRay, uint32_t lightIndex, const Vector3& normal) const;
+		static ColorRGB ShadeLight(LightingMode lightingMode, Material* pMaterial, const HitRecord& hitRecord, const Light& light,
+			const Vector3& lightDirection, const Vector3& viewDirection);
+		template<LightingMode lightingMode> // Only evaluates what the mode shows
+		static ColorRGB ShadeLight(Material* pMaterial, const HitRecord& hitRecord, const Light& light, const Vector3& lightDirection, const Vector3& viewDirection);
+		static int ScatterSpecular(const HitRecord& hitRecord, const Vector3& rayDirection, const SpecularScatter& scatter,
+			const ColorRGB& throughput, float throughputThreshold, SecondaryRay* pSecondaryRays); // Writes up to 2 rays
+
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
+		RenderMode m_RenderMode{ RenderMode::PerPixel };
 		bool m_ShadowsEnabled{true};
+		bool m_ShadowMapsEnabled{ false };
+		bool m_LightCacheEnabled{ false };
+		bool m_ReflectionsEnabled{ false }; // Off until asked for, every reflective pixel costs up to m_MaxBounces more rays
+		int m_MaxBounces{ 3 };
+		float m_ThroughputThreshold{ 0.01f };
+		int m_MaxPathLength{ 8 };
+		bool m_DenoiserEnabled{ true };
+		bool m_DynamicResolutionEnabled{ false };
+		bool m_FoveationEnabled{ false };
+		float m_FoveaRadius{ 0.2f };
+
+		mutable std::atomic<uint64_t> m_SecondaryRayCount{};
+
+		// Running sum of path traced samples and their first hit features per pixel, and the camera they were traced with
+		mutable std::vector<ColorRGB> m_Accumulation{};
+		mutable std::vector<ColorRGB> m_AccumulatedAlbedos{};
+		mutable std::vector<Vector3> m_AccumulatedNormals{};
+		mutable std::vector<float> m_AccumulatedDepths{};
+		mutable uint32_t m_AccumulatedSamples{};
+		mutable Matrix m_AccumulatedCameraToWorld{};
+		mutable float m_AccumulatedFovAngle{};
+		mutable uint64_t m_AccumulatedSceneGeneration{};
+		mutable std::vector<int> m_RowIndices{}; // One per row of the buffer
+
+		// Size of and pixels written by the render functions, either the buffer itself or m_ScaledPixels
+		mutable int m_RenderWidth{};
+		mutable int m_RenderHeight{};
+		mutable uint32_t* m_pRenderPixels{};
+		mutable std::vector<uint32_t> m_ScaledPixels{};
+		mutable float m_ResolutionScale{ 1.f };
+
+		// Work list of the tile renderer, a coarse preview of every tile followed by the refinement, each closest to the focus first
+		mutable std::vector<PriorityTile> m_PriorityTiles{};
+		mutable size_t m_NextPriorityTile{};
+		mutable Matrix m_PriorityTilesCameraToWorld{};
+		mutable float m_PriorityTilesFovAngle{};
+		mutable int m_PriorityTilesWidth{};
+		mutable uint64_t m_PriorityTilesSceneGeneration{};
+		mutable float m_RenderedFraction{ 1.f }; // Part of a whole frame rendered by the last call
 
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		bool m_OwnsBuffer{ false };
+		PixelLayout m_PixelLayout{}; // Of the buffer
+		const KernelTable* m_pKernels{ &GetKernels() };
 
 		int m_Width{};
 		int m_Height{};
+
+		std::unique_ptr<WavefrontPipeline> m_pWavefront{};
+		std::unique_ptr<TileCuller> m_pTileCuller{}; // Primary rays of the classic modes only test what their tile sees
+		std::unique_ptr<Rasterizer> m_pRasterizer{}; // Visibility buffer of the rasterized mode
+		std::unique_ptr<ShadowMaps> m_pShadowMaps{};
+		std::unique_ptr<LightVisibilityCache> m_pLightCache{};
+		std::unique_ptr<Denoiser> m_pDenoiser{};
+		std::unique_ptr<ResolutionController> m_pResolutionController{};
 	};
 }
@@ -0,0 +1,37 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+float ResolutionController::Update(float frameTime)
+{
+	if (frameTime <= 0.f)
+		return m_Scale;
+
+	m_SmoothedFrameTime = m_SmoothedFrameTime > 0.f ? m_SmoothedFrameTime + (frameTime - m_SmoothedFrameTime) * m_Smoothing : frameTime;
+
+	const float ratio{ m_TargetFrameTime / m_SmoothedFrameTime };
+	if (std::abs(ratio - 1.f) <= m_Deadband)
+		return m_Scale;
+
+	// Cost follows the pixel count, the square of the scale
+	const float scale{ std::clamp(m_Scale * std::pow(ratio, 0.5f * m_Gain), m_MinScale, m_MaxScale) };
+
+	// The smoothed time still describes the old scale, predict it for the new one so the lag does not cause an overshoot
+	m_SmoothedFrameTime *= (scale * scale) / (m_Scale * m_Scale);
+	m_Scale = scale;
+	return m_Scale;
+}
+
+void ResolutionController::Reset()
+{
+	m_Scale = m_MaxScale;
+	m_SmoothedFrameTime = 0.f;
+}
+
+void ResolutionController::SetTargetFrameTime(float targetFrameTime)
+{
+	m_TargetFrameTime = std::max(targetFrameTime, 1.f);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace dae
+{
+	/**
+	 * \brief Picks the render resolution scale that keeps frames close to a target frame time.
+	 * Frame times are smoothed, small deviations are ignored and every correction assumes the cost grows with the number of pixels,
+	 * so the scale settles instead of oscillating between too slow and too fast.
+	 */
+	class ResolutionController final
+	{
+	public:
+		ResolutionController() = default;
+		~ResolutionController() = default;
+
+		ResolutionController(const ResolutionController&) = delete;
+		ResolutionController(ResolutionController&&) noexcept = delete;
+		ResolutionController& operator=(const ResolutionController&) = delete;
+		ResolutionController& operator=(ResolutionController&&) noexcept = delete;
+
+		// Feeds the time in milliseconds the last frame took at the current scale, returns the scale for the next frame
+		float Update(float frameTime);
+		void Reset();
+
+		float GetScale() const { return m_Scale; }
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+		void SetTargetFrameTime(float targetFrameTime);
+
+	private:
+		static constexpr float m_MinScale{ 0.25f };
+		static constexpr float m_MaxScale{ 1.f };
+		static constexpr float m_Smoothing{ 0.3f };	// Weight of the newest frame time
+		static constexpr float m_Deadband{ 0.1f };	// Relative deviation from the target that is left alone
+		static constexpr float m_Gain{ 0.6f };		// Part of the deviation corrected per frame
+
+		float m_TargetFrameTime{ 1000.f / 60.f };
+		float m_Scale{ m_MaxScale };
+		float m_SmoothedFrameTime{};
+	};
+}
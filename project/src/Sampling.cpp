@@ -0,0 +1,146 @@
+#include "Sampling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint32_t g_NumTexels{ Sampling::BlueNoise::Size * Sampling::BlueNoise::Size };
+
+		// Void-and-cluster (Ulichney 1993): points are ranked by repeatedly removing the tightest cluster or filling the largest void,
+		// measured with a Gaussian energy that wraps around the edges so the mask tiles
+		class VoidAndCluster final
+		{
+		public:
+			VoidAndCluster() :
+				m_Kernel(g_NumTexels), m_Energy(g_NumTexels), m_Pattern(g_NumTexels)
+			{
+				constexpr uint32_t size{ Sampling::BlueNoise::Size };
+				constexpr float sigma{ 1.5f };
+				for (uint32_t dy{}; dy < size; ++dy)
+				{
+					for (uint32_t dx{}; dx < size; ++dx)
+					{
+						const float x{ float(std::min(dx, size - dx)) };
+						const float y{ float(std::min(dy, size - dy)) };
+						m_Kernel[dx + dy * size] = std::exp(-(x * x + y * y) / (2.f * sigma * sigma));
+					}
+				}
+			}
+
+			void Toggle(uint32_t texel)
+			{
+				constexpr uint32_t mask{ Sampling::BlueNoise::Size - 1 };
+				const float sign{ m_Pattern[texel] ? -1.f : 1.f };
+				m_Pattern[texel] ^= 1;
+
+				const uint32_t tx{ texel & mask };
+				const uint32_t ty{ texel / Sampling::BlueNoise::Size };
+				for (uint32_t index{}; index < g_NumTexels; ++index)
+				{
+					const uint32_t dx{ ((index & mask) - tx) & mask };
+					const uint32_t dy{ ((index / Sampling::BlueNoise::Size) - ty) & mask };
+					m_Energy[index] += sign * m_Kernel[dx + dy * Sampling::BlueNoise::Size];
+				}
+			}
+
+			bool IsSet(uint32_t texel) const { return m_Pattern[texel] != 0; }
+
+			// Set texel with the highest energy
+			uint32_t FindTightestCluster() const { return Find(true); }
+			// Empty texel with the lowest energy
+			uint32_t FindLargestVoid() const { return Find(false); }
+
+		private:
+			uint32_t Find(bool cluster) const
+			{
+				uint32_t best{};
+				float bestEnergy{ cluster ? -FLT_MAX : FLT_MAX };
+				for (uint32_t index{}; index < g_NumTexels; ++index)
+				{
+					if (bool(m_Pattern[index]) != cluster)
+						continue;
+
+					if (cluster ? m_Energy[index] > bestEnergy : m_Energy[index] < bestEnergy)
+					{
+						bestEnergy = m_Energy[index];
+						best = index;
+					}
+				}
+				return best;
+			}
+
+			std::vector<float> m_Kernel{};
+			std::vector<float> m_Energy{};
+			std::vector<uint8_t> m_Pattern{};
+		};
+
+		std::vector<float> GenerateBlueNoise()
+		{
+			// Random initial pattern covering a tenth of the texels
+			VoidAndCluster prototype{};
+			uint32_t numPoints{};
+			for (uint32_t seed{}; numPoints < g_NumTexels / 10; ++seed)
+			{
+				const uint32_t texel{ Sampling::Hash(seed) % g_NumTexels };
+				if (!prototype.IsSet(texel))
+				{
+					prototype.Toggle(texel);
+					++numPoints;
+				}
+			}
+
+			// Move points from the tightest cluster into the largest void until that no longer changes anything
+			while (true)
+			{
+				const uint32_t cluster{ prototype.FindTightestCluster() };
+				prototype.Toggle(cluster);
+				const uint32_t largestVoid{ prototype.FindLargestVoid() };
+				prototype.Toggle(largestVoid);
+				if (largestVoid == cluster)
+					break;
+			}
+
+			std::vector<uint32_t> ranks(g_NumTexels);
+
+			// Points of the prototype get the lowest ranks, the tightest cluster is removed (and ranked) first
+			VoidAndCluster pattern{ prototype };
+			for (uint32_t rank{ numPoints }; rank > 0; --rank)
+			{
+				const uint32_t cluster{ pattern.FindTightestCluster() };
+				pattern.Toggle(cluster);
+				ranks[cluster] = rank - 1;
+			}
+
+			// The remaining texels are ranked in the order they fill the largest void
+			for (uint32_t rank{ numPoints }; rank < g_NumTexels; ++rank)
+			{
+				const uint32_t largestVoid{ prototype.FindLargestVoid() };
+				prototype.Toggle(largestVoid);
+				ranks[largestVoid] = rank;
+			}
+
+			std::vector<float> mask(g_NumTexels);
+			for (uint32_t index{}; index < g_NumTexels; ++index)
+				mask[index] = (ranks[index] + .5f) / g_NumTexels;
+			return mask;
+		}
+	}
+
+	namespace Sampling
+	{
+		namespace BlueNoise
+		{
+			float Get(uint32_t x, uint32_t y)
+			{
+				// Magic static, generated once and read only afterwards so every thread can share it
+				static const std::vector<float> mask{ GenerateBlueNoise() };
+				return mask[(x & (Size - 1)) + (y & (Size - 1)) * Size];
+			}
+		}
+	}
+}
@@ -0,0 +1,196 @@
+#pragma once
+#include <array>
+#include <cassert>
+#include <cstdint>
+
+#include "Maths.h"
+
+namespace dae
+{
+	struct Sample2D
+	{
+		float u{};
+		float v{};
+	};
+
+	namespace Sampling
+	{
+		// Integer hash (lowbias32), decorrelates pixels and dimensions without any shared state
+		inline uint32_t Hash(uint32_t value)
+		{
+			value ^= value >> 16;
+			value *= 0x7feb352du;
+			value ^= value >> 15;
+			value *= 0x846ca68bu;
+			value ^= value >> 16;
+			return value;
+		}
+
+		inline float ToUnitFloat(uint32_t value)
+		{
+			// 24 bits so the result stays strictly below 1
+			return (value >> 8) * (1.f / 16777216.f);
+		}
+
+		namespace Sobol
+		{
+			// Only the first two dimensions are tabulated. Samplers pad them instead of going higher: every further pair of dimensions
+			// draws dimensions 0 and 1 again at a shuffled index, Owen scrambled with seeds of its own (see PixelSampler)
+			constexpr uint32_t NumDimensions{ 2 };
+
+			// Direction numbers of the first two Sobol dimensions (Joe-Kuo), computed at compile time
+			constexpr std::array<std::array<uint32_t, 32>, NumDimensions> MakeDirections()
+			{
+				std::array<std::array<uint32_t, 32>, NumDimensions> directions{};
+				for (uint32_t bit{}; bit < 32; ++bit)
+				{
+					// Dimension 0 is the van der Corput sequence, dimension 1 has s = 1, a = 0, m = { 1 }
+					directions[0][bit] = 1u << (31 - bit);
+					directions[1][bit] = bit == 0 ? 1u << 31 : directions[1][bit - 1] ^ (directions[1][bit - 1] >> 1);
+				}
+				return directions;
+			}
+			constexpr std::array<std::array<uint32_t, 32>, NumDimensions> Directions{ MakeDirections() };
+
+			// dimension must be below NumDimensions
+			constexpr uint32_t Sample(uint32_t index, uint32_t dimension)
+			{
+				assert(dimension < NumDimensions);
+				uint32_t value{};
+				for (uint32_t bit{}; index != 0; ++bit, index >>= 1)
+				{
+					if (index & 1u)
+						value ^= Directions[dimension][bit];
+				}
+				return value;
+			}
+
+			constexpr uint32_t ReverseBits(uint32_t value)
+			{
+				value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+				value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+				value = ((value >> 4) & 0x0f0f0f0fu) | ((value & 0x0f0f0f0fu) << 4);
+				value = ((value >> 8) & 0x00ff00ffu) | ((value & 0x00ff00ffu) << 8);
+				return (value >> 16) | (value << 16);
+			}
+
+			// Hash based Owen scrambling (Laine-Karras permutation, Burley 2020): every bit is flipped depending on the bits above it,
+			// which keeps the stratification of the sequence while decorrelating different seeds
+			constexpr uint32_t OwenScramble(uint32_t value, uint32_t seed)
+			{
+				value = ReverseBits(value);
+				value += seed;
+				value ^= value * 0x6c50b47cu;
+				value ^= value * 0xb82f1e52u;
+				value ^= value * 0xc7afe638u;
+				value ^= value * 0x8d22f6e6u;
+				return ReverseBits(value);
+			}
+		}
+
+		namespace BlueNoise
+		{
+			constexpr uint32_t Size{ 64 }; // Power of two, lookups wrap around
+
+			// Tileable void-and-cluster mask with values in [0, 1), generated once on first use
+			float Get(uint32_t x, uint32_t y);
+		}
+
+		/**
+		 * \brief Stateless sampler for one sample of one pixel.
+		 * Every dimension (or pair of dimensions) draws from its own shuffled, Owen scrambled 2D Sobol sequence seeded per pixel,
+		 * Sobol dimensions 0 and 1 padded to as many as a path needs, then gets a Cranley-Patterson shift from a blue noise mask
+		 * so the error left at low sample counts is spread as blue noise.
+		 * Copies are cheap and threads never touch shared data.
+		 */
+		class PixelSampler final
+		{
+		public:
+			PixelSampler(uint32_t px, uint32_t py, uint32_t sampleIndex) :
+				m_Px(px), m_Py(py), m_PixelSeed(Hash(px ^ Hash(py))), m_SampleIndex(sampleIndex)
+			{
+			}
+
+			float Get1D()
+			{
+				const uint32_t seed{ Hash(m_PixelSeed ^ Hash(m_Dimension)) };
+				const uint32_t index{ Sobol::OwenScramble(m_SampleIndex, seed) };
+				const float value{ ToUnitFloat(Sobol::OwenScramble(Sobol::Sample(index, 0), Hash(seed))) };
+				return Shift(value, m_Dimension++);
+			}
+
+			Sample2D Get2D()
+			{
+				const uint32_t seed{ Hash(m_PixelSeed ^ Hash(m_Dimension)) };
+				const uint32_t index{ Sobol::OwenScramble(m_SampleIndex, seed) };
+				const float u{ ToUnitFloat(Sobol::OwenScramble(Sobol::Sample(index, 0), Hash(seed))) };
+				const float v{ ToUnitFloat(Sobol::OwenScramble(Sobol::Sample(index, 1), Hash(seed + 1))) };
+
+				const Sample2D sample{ Shift(u, m_Dimension), Shift(v, m_Dimension + 1) };
+				m_Dimension += 2;
+				return sample;
+			}
+
+		private:
+			// Every dimension looks up the mask at its own offset so dimensions stay decorrelated
+			float Shift(float value, uint32_t dimension) const
+			{
+				const uint32_t offset{ Hash(dimension + 0x9e3779b9u) };
+				value += BlueNoise::Get(m_Px + offset, m_Py + (offset >> 16));
+				return value >= 1.f ? value - 1.f : value;
+			}
+
+			uint32_t m_Px{};
+			uint32_t m_Py{};
+			uint32_t m_PixelSeed{};
+			uint32_t m_SampleIndex{};
+			uint32_t m_Dimension{};
+		};
+
+		// Orthonormal basis around n, returns tangent * local.x + bitangent * local.y + n * local.z
+		inline Vector3 ToWorld(const Vector3& n, const Vector3& local)
+		{
+			const float sign{ std::copysign(1.f, n.z) };
+			const float a{ -1.f / (sign + n.z) };
+			const float b{ n.x * n.y * a };
+			const Vector3 tangent{ 1.f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+			const Vector3 bitangent{ b, sign + n.y * n.y * a, -n.y };
+			return tangent * local.x + bitangent * local.y + n * local.z;
+		}
+
+		// pdf = cos(theta) / PI
+		inline Vector3 CosineSampleHemisphere(const Vector3& n, const Sample2D& sample)
+		{
+			const float radius{ std::sqrt(sample.u) };
+			const float phi{ PI_2 * sample.v };
+			return ToWorld(n, { radius * std::cos(phi), radius * std::sin(phi), std::sqrt(std::max(0.f, 1.f - sample.u)) });
+		}
+
+		// Half vector distributed as D_GGX(h) * cos(theta_h), alpha as used by BRDF::NormalDistribution_GGX (roughness squared)
+		inline Vector3 SampleGGXHalfVector(const Vector3& n, float roughness, const Sample2D& sample)
+		{
+			const float alphaSqr{ Square(roughness * roughness) };
+			const float cosTheta{ std::sqrt((1.f - sample.u) / (1.f + (alphaSqr - 1.f) * sample.u)) };
+			const float sinTheta{ std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta)) };
+			const float phi{ PI_2 * sample.v };
+			return ToWorld(n, { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta });
+		}
+
+		// Directions inside the cone around axis with the given half angle, pdf = 1 / (2 PI (1 - cosThetaMax))
+		inline Vector3 UniformSampleCone(const Vector3& axis, float cosThetaMax, const Sample2D& sample)
+		{
+			const float cosTheta{ 1.f - sample.u * (1.f - cosThetaMax) };
+			const float sinTheta{ std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta)) };
+			const float phi{ PI_2 * sample.v };
+			return ToWorld(axis, { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta });
+		}
+
+		// Multiple importance sampling weight of strategy f against strategy g (one sample each)
+		inline float PowerHeuristic(float pdfF, float pdfG)
+		{
+			const float f{ pdfF * pdfF };
+			const float g{ pdfG * pdfG };
+			return f + g > 0.f ? f / (f + g) : 0.f;
+		}
+	}
+}
@@ -1,121 +1,580 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "Serialization.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
 
 namespace dae {
+	namespace
+	{
+		// Exact, any move at all has to reach the consumers
+		bool HasMoved(const Camera& from, const Camera& to)
+		{
+			return from.origin.x != to.origin.x || from.origin.y != to.origin.y || from.origin.z != to.origin.z
+				|| from.forward.x != to.forward.x || from.forward.y != to.forward.y || from.forward.z != to.forward.z
+				|| from.fovAngle != to.fovAngle;
+		}
+
+		// Row by row, Matrix is not trivially copyable
+		void WriteMatrix(std::ostream& stream, const Matrix& matrix)
+		{
+			for (int row{}; row < 4; ++row)
+				Serialization::Write(stream, matrix[row]);
+		}
+
+		bool ReadMatrix(std::istream& stream, Matrix& matrix)
+		{
+			for (int row{}; row < 4; ++row)
+			{
+				if (!Serialization::Read(stream, matrix[row]))
+					return false;
+			}
+			return true;
+		}
+	}
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
-	Scene::Scene() :
-		m_Materials({ new Material_SolidColor({1,0,0}) })
+	Scene::Scene()
 	{
 		m_SphereGeometries.reserve(32);
 		m_PlaneGeometries.reserve(32);
 		m_TriangleMeshGeometries.reserve(32);
 		m_Lights.reserve(32);
+
+		AddMaterial<Material_SolidColor>(ColorRGB{ 1,0,0 });
 	}
 
-	Scene::~Scene()
+	void Scene::Update(dae::Timer* pTimer)
 	{
-		for (auto& pMaterial : m_Materials)
-		{
-			delete pMaterial;
-			pMaterial = nullptr;
-		}
+		const Camera previousCamera{ m_Camera };
+		m_Camera.Update(pTimer);
 
-		m_Materials.clear();
+		if (HasMoved(previousCamera, m_Camera))
+			MarkDirty(SceneComponent::Camera);
 	}
 
-	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	void Scene::SetCamera(const Camera& camera)
 	{
-		float smallestT{ closestHit.t };
-		int closestIdx{-1};
-		
+		const bool hasMoved{ HasMoved(m_Camera, camera) };
+		m_Camera = camera;
+
+		if (hasMoved)
+			MarkDirty(SceneComponent::Camera);
+	}
+
+	void Scene::CaptureState(SceneState& state) const
+	{
+		// The state's vectors keep their capacity, only components that changed get copied
+		const auto capture = [&](SceneComponent component, auto& destination, const auto& source)
+			{
+				uint64_t& generation{ state.generations[static_cast<int>(component)] };
+				if (generation != GetGeneration(component))
+				{
+					destination = source;
+					generation = GetGeneration(component);
+				}
+			};
+
+		state.camera = m_Camera;
+		state.generations[static_cast<int>(SceneComponent::Camera)] = GetGeneration(SceneComponent::Camera);
+		capture(SceneComponent::Spheres, state.spheres, m_SphereGeometries);
+		capture(SceneComponent::Planes, state.planes, m_PlaneGeometries);
+		capture(SceneComponent::TriangleMeshes, state.triangleMeshes, m_TriangleMeshGeometries);
+		capture(SceneComponent::Lights, state.lights, m_Lights);
+	}
+
+	void Scene::ApplyState(const SceneState& state)
+	{
+		const auto apply = [&](SceneComponent component, auto& destination, const auto& source)
+			{
+				const int componentIndex{ static_cast<int>(component) };
+				if (state.generations[componentIndex] != m_AppliedStateGenerations[componentIndex])
+				{
+					if (destination.size() != source.size())
+						++m_HandleGeneration;
+					destination = source;
+					m_AppliedStateGenerations[componentIndex] = state.generations[componentIndex];
+					MarkDirty(component);
+				}
+			};
+
+		SetCamera(state.camera);
+		apply(SceneComponent::Spheres, m_SphereGeometries, state.spheres);
+		apply(SceneComponent::Planes, m_PlaneGeometries, state.planes);
+		apply(SceneComponent::TriangleMeshes, m_TriangleMeshGeometries, state.triangleMeshes);
+		apply(SceneComponent::Lights, m_Lights, state.lights);
+	}
+
+	void Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
+	{
+		Intersection intersection{};
+		intersection.t = closestHit.t;
+
+		if (GetClosestIntersection(ray, intersection))
+			FillHitRecord(ray, intersection, closestHit);
+	}
+
+	bool Scene::GetClosestIntersection(const Ray& ray, Intersection& intersection) const
+	{
+		bool didHit{ false };
+		float t{};
+
 		/////////////
 		// SPHERE
 		/////////////
-		
-		for (int sphereIndex{}; sphereIndex < m_SphereGeometries.size(); ++sphereIndex)
+		int sphereSlot{ -1 };
+		if (m_IsSphereGrid)
+			sphereSlot = IntersectSphereGrid(ray, intersection.t);
+		else if (m_NumTreePackets > 0)
+			sphereSlot = m_pKernels->intersectSphereBVH(m_SphereBVH.GetNodes().data(), m_SpherePackets.data(), ray, intersection.t);
+
+		const int tailSlot{ m_pKernels->intersectSpheres(m_SpherePackets.data() + m_NumTreePackets,
+			static_cast<uint32_t>(m_SpherePackets.size()) - m_NumTreePackets, ray, intersection.t) };
+		if (tailSlot >= 0)
+			sphereSlot = static_cast<int>(m_NumTreePackets) * m_SpherePacketWidth + tailSlot;
+
+		if (sphereSlot >= 0)
 		{
-			GeometryUtils::HitTest_Sphere(m_SphereGeometries[sphereIndex], ray, closestHit);
-			if (closestHit.t < smallestT&& closestHit.t>0)
-			{
-				smallestT = closestHit.t;
-				closestIdx = sphereIndex;
-			}
+			intersection.primitiveIndex = m_SlotSpheres[sphereSlot];
+			intersection.primitiveType = PrimitiveType::Sphere;
+			didHit = true;
 		}
-		
+
 		///////////
 		// PLANE
 		///////////
-		bool planeCloser{false};
-		
-		for (int planeIndex{}; planeIndex < m_PlaneGeometries.size(); ++planeIndex)
+		for (uint32_t planeIndex{}; planeIndex < m_PlaneGeometries.size(); ++planeIndex)
 		{
-			GeometryUtils::HitTest_Plane(m_PlaneGeometries[planeIndex], ray, closestHit);
-			if (closestHit.t < smallestT&& closestHit.t>0)
+			if (GeometryUtils::Intersect_Plane(m_PlaneGeometries[planeIndex], ray, t) && t < intersection.t)
 			{
-				smallestT = closestHit.t;
-				closestIdx = planeIndex;
-				planeCloser = true;
+				intersection.t = t;
+				intersection.primitiveIndex = planeIndex;
+				intersection.primitiveType = PrimitiveType::Plane;
+				didHit = true;
 			}
 		}
-		
+
 		////////////
 		// TRIANGLE
 		////////////
-		
-		
-		
-		///////////
-		// check
-		///////////
-		if(closestIdx!=-1)
+
+		return didHit;
+	}
+
+	int Scene::IntersectSphereGrid(const Ray& ray, float& t) const
+	{
+		int sphereSlot{ -1 };
+		m_SphereGrid.ForEachCell(ray, [&](uint32_t cell, float exit)
+			{
+				const uint32_t firstPacket{ m_GridCellPackets[cell] };
+				const int slot{ m_pKernels->intersectSpheres(m_SpherePackets.data() + firstPacket, m_GridCellPackets[cell + 1] - firstPacket, ray, t) };
+				if (slot >= 0)
+					sphereSlot = static_cast<int>(firstPacket) * m_SpherePacketWidth + slot;
+
+				// Anything closer than where the ray leaves this cell overlaps this cell or one before it
+				return t <= exit;
+			});
+		return sphereSlot;
+	}
+
+	bool Scene::HitTestSphereGrid(const Ray& ray) const
+	{
+		return m_SphereGrid.ForEachCell(ray, [&](uint32_t cell, float)
+			{
+				const uint32_t firstPacket{ m_GridCellPackets[cell] };
+				return m_pKernels->hitTestSpheres(m_SpherePackets.data() + firstPacket, m_GridCellPackets[cell + 1] - firstPacket, ray);
+			});
+	}
+
+	void Scene::FillHitRecord(const Ray& ray, const Intersection& intersection, HitRecord& hitRecord) const
+	{
+		switch (intersection.primitiveType)
 		{
-			if (planeCloser) GeometryUtils::HitTest_Plane(m_PlaneGeometries[closestIdx], ray, closestHit);
-			else   GeometryUtils::HitTest_Sphere(m_SphereGeometries[closestIdx], ray, closestHit);
+		case PrimitiveType::Sphere:
+			GeometryUtils::FillHitRecord_Sphere(m_SphereGeometries[intersection.primitiveIndex], ray, intersection.t, hitRecord);
+			break;
+		case PrimitiveType::Plane:
+			GeometryUtils::FillHitRecord_Plane(m_PlaneGeometries[intersection.primitiveIndex], ray, intersection.t, hitRecord);
+			break;
+		default:
+			hitRecord.didHit = false;
+			break;
 		}
-		
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		for (int sphereIndex{}; sphereIndex < m_SphereGeometries.size(); ++sphereIndex)
+		if (m_IsSphereGrid && HitTestSphereGrid(ray)) return true;
+		if (!m_IsSphereGrid && m_NumTreePackets > 0 && m_pKernels->hitTestSphereBVH(m_SphereBVH.GetNodes().data(), m_SpherePackets.data(), ray)) return true;
+		if (m_pKernels->hitTestSpheres(m_SpherePackets.data() + m_NumTreePackets, static_cast<uint32_t>(m_SpherePackets.size()) - m_NumTreePackets, ray)) return true;
+
+		for (const Plane& plane : m_PlaneGeometries)
+		{
+			if (GeometryUtils::HitTest_Plane(plane, ray)) return true;
+		}
+
+		return false;
+	}
+
+#pragma region Scene Serialization
+	void Scene::Serialize(std::ostream& stream) const
+	{
+		Serialization::WriteVector(stream, m_SphereGeometries);
+		Serialization::WriteVector(stream, m_PlaneGeometries);
+		Serialization::WriteVector(stream, m_Lights);
+
+		Serialization::Write(stream, static_cast<uint32_t>(m_TriangleMeshGeometries.size()));
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		{
+			Serialization::WriteVector(stream, mesh.positions);
+			Serialization::WriteVector(stream, mesh.normals);
+			Serialization::WriteVector(stream, mesh.indices);
+			Serialization::Write(stream, mesh.materialIndex);
+			Serialization::Write(stream, mesh.cullMode);
+
+			// Sent as they are, the receiver cannot recompute the transformed vertices without the mesh's update
+			WriteMatrix(stream, mesh.rotationTransform);
+			WriteMatrix(stream, mesh.translationTransform);
+			WriteMatrix(stream, mesh.scaleTransform);
+			Serialization::WriteVector(stream, mesh.transformedPositions);
+			Serialization::WriteVector(stream, mesh.transformedNormals);
+		}
+
+		Serialization::Write(stream, static_cast<uint32_t>(m_Materials.size()));
+		for (const Material* pMaterial : m_Materials)
+		{
+			pMaterial->Serialize(stream);
+		}
+
+		Serialization::Write(stream, m_Camera.origin);
+		Serialization::Write(stream, m_Camera.fovAngle);
+		Serialization::Write(stream, m_Camera.totalPitch);
+		Serialization::Write(stream, m_Camera.totalYaw);
+	}
+
+	bool Scene::Deserialize(std::istream& stream)
+	{
+		++m_HandleGeneration;
+		if (!Serialization::ReadVector(stream, m_SphereGeometries) ||
+			!Serialization::ReadVector(stream, m_PlaneGeometries) ||
+			!Serialization::ReadVector(stream, m_Lights))
+			return false;
+
+		// Meshes and materials are added as they arrive, so a corrupt count fails at the end of the data instead of allocating up front
+		uint32_t numMeshes{};
+		if (!Serialization::Read(stream, numMeshes))
+			return false;
+
+		m_TriangleMeshGeometries.clear();
+		for (uint32_t index{}; index < numMeshes; ++index)
+		{
+			TriangleMesh mesh{};
+			if (!Serialization::ReadVector(stream, mesh.positions) ||
+				!Serialization::ReadVector(stream, mesh.normals) ||
+				!Serialization::ReadVector(stream, mesh.indices) ||
+				!Serialization::Read(stream, mesh.materialIndex) ||
+				!Serialization::Read(stream, mesh.cullMode) ||
+				!ReadMatrix(stream, mesh.rotationTransform) ||
+				!ReadMatrix(stream, mesh.translationTransform) ||
+				!ReadMatrix(stream, mesh.scaleTransform) ||
+				!Serialization::ReadVector(stream, mesh.transformedPositions) ||
+				!Serialization::ReadVector(stream, mesh.transformedNormals))
+				return false;
+			m_TriangleMeshGeometries.push_back(std::move(mesh));
+		}
+
+		//Replace the default material, the serialized list already contains it
+		m_Materials.clear();
+		m_Arena.Reset();
+
+		uint32_t numMaterials{};
+		if (!Serialization::Read(stream, numMaterials))
+			return false;
+
+		for (uint32_t index{}; index < numMaterials; ++index)
+		{
+			Material* pMaterial = Material::Deserialize(stream, m_Arena);
+			if (!pMaterial)
+				return false;
+			m_Materials.push_back(pMaterial);
+		}
+
+		// Shading looks materials up without a bounds check
+		const auto isValidMaterial = [this](const auto& geometry) { return geometry.materialIndex < m_Materials.size(); };
+		if (!std::all_of(m_SphereGeometries.begin(), m_SphereGeometries.end(), isValidMaterial) ||
+			!std::all_of(m_PlaneGeometries.begin(), m_PlaneGeometries.end(), isValidMaterial) ||
+			!std::all_of(m_TriangleMeshGeometries.begin(), m_TriangleMeshGeometries.end(), isValidMaterial))
+			return false;
+
+		float totalPitch{}, totalYaw{};
+		if (!Serialization::Read(stream, m_Camera.origin) ||
+			!Serialization::Read(stream, m_Camera.fovAngle) ||
+			!Serialization::Read(stream, totalPitch) ||
+			!Serialization::Read(stream, totalYaw))
+			return false;
+		m_Camera.SetRotation(totalPitch, totalYaw);
+
+		for (int component{}; component < static_cast<int>(SceneComponent::Count); ++component)
+			MarkDirty(static_cast<SceneComponent>(component));
+
+		return true;
+	}
+#pragma endregion
+
+#pragma region Scene Change Tracking
+	void DirtyRange::Add(uint32_t index, uint32_t numIndices)
+	{
+		if (numIndices == 0)
+			return;
+
+		if (IsEmpty())
+		{
+			first = index;
+			count = numIndices;
+			return;
+		}
+
+		const uint32_t end{ std::max(first + count, index + numIndices) };
+		first = std::min(first, index);
+		count = end - first;
+	}
+
+	uint64_t Scene::GetContentGeneration() const
+	{
+		uint64_t generation{};
+		for (int component{}; component < static_cast<int>(SceneComponent::Count); ++component)
 		{
-	
-			// We calculate A B and C
-			float A{ Vector3::Dot(ray.direction,ray.direction) };
-			float B{ Vector3::Dot(2 * (ray.direction)	,  ray.origin - m_SphereGeometries[sphereIndex].origin) };
-			float C{ Vector3::Dot(ray.origin - m_SphereGeometries[sphereIndex].origin ,
-				ray.origin - m_SphereGeometries[sphereIndex].origin) - (m_SphereGeometries[sphereIndex].radius * m_SphereGeometries[sphereIndex].radius) };
-	
-			// We calculate the DISCRIMINANT, this tells us where the ray is vs the sphere
-			float discriminant{ (B * B) - (4 * A * C) };
-	
-			if (discriminant > 0)
+			if (component != static_cast<int>(SceneComponent::Camera))
+				generation = std::max(generation, m_ComponentGenerations[component]);
+		}
+		return generation;
+	}
+
+	DirtyRange Scene::GetDirtyRange(SceneComponent component, uint64_t sinceGeneration) const
+	{
+		const int componentIndex{ static_cast<int>(component) };
+		DirtyRange range{};
+		if (sinceGeneration >= m_ComponentGenerations[componentIndex])
+			return range;
+
+		if (sinceGeneration < m_OldestRecordedGenerations[componentIndex])
+		{
+			range.Add(0, GetComponentSize(component));
+			return range;
+		}
+
+		for (const DirtyRecord& record : m_DirtyRecords[componentIndex])
+		{
+			if (record.generation > sinceGeneration)
+				range.Add(record.range.first, record.range.count);
+		}
+		return range;
+	}
+
+	void Scene::MarkDirty(SceneComponent component)
+	{
+		const int componentIndex{ static_cast<int>(component) };
+		m_ComponentGenerations[componentIndex] = ++m_Generation;
+
+		// Covers every older record, they can all go
+		const uint32_t size{ GetComponentSize(component) };
+		m_DirtyRecords[componentIndex].clear();
+		m_DirtyRecords[componentIndex].push_back({ m_Generation, { 0, size } });
+
+		if (component == SceneComponent::Spheres)
+			UpdateSpherePackets({ 0, size });
+	}
+
+	void Scene::MarkDirty(SceneComponent component, uint32_t index)
+	{
+		const int componentIndex{ static_cast<int>(component) };
+		m_ComponentGenerations[componentIndex] = ++m_Generation;
+
+		if (component == SceneComponent::Spheres)
+			UpdateSpherePackets({ index, 1 });
+
+		// A scene being built up or one primitive changing every frame keeps extending the newest record
+		std::vector<DirtyRecord>& records{ m_DirtyRecords[componentIndex] };
+		if (!records.empty())
+		{
+			DirtyRecord& newest{ records.back() };
+			if (index == newest.range.first + newest.range.count || (index == newest.range.first && newest.range.count == 1))
 			{
-				float t = ((-B - sqrt(discriminant)) / (2 * A));
+				newest.generation = m_Generation;
+				newest.range.Add(index);
+				return;
+			}
+		}
 
-				if (t < ray.max)
-				{
-					if (t > ray.min)
-					{
-						return true;
-					}
-				}
+		if (records.size() == m_MaxDirtyRecords)
+		{
+			m_OldestRecordedGenerations[componentIndex] = records.front().generation;
+			records.erase(records.begin());
+		}
+		records.push_back({ m_Generation, { index, 1 } });
+	}
+
+	void Scene::UpdateTransforms(TriangleMeshHandle handle)
+	{
+		GetTriangleMesh(handle).UpdateTransforms();
+		MarkDirty(handle);
+	}
+
+	void Scene::UpdateSpherePackets(const DirtyRange& range)
+	{
+		// Spheres are only ever appended. The tree or grid is rebuilt when everything changed or when the spheres added since it was built
+		// outgrow a linear scan, so building it is paid for by a quarter of its spheres
+		const uint32_t numSpheres{ static_cast<uint32_t>(m_SphereGeometries.size()) };
+		const bool isEverySphere{ range.count >= numSpheres };
+		if (isEverySphere || numSpheres - m_NumTreeSpheres > std::max(m_MaxLinearSpheres, m_NumTreeSpheres / 4))
+		{
+			m_NumMovingRebuilds = isEverySphere ? m_NumMovingRebuilds + 1 : 0;
+			RebuildSphereAccelerator();
+			if (m_NumTreeSpheres == numSpheres)
+				return;
+		}
+
+		const uint32_t numAddedSpheres{ numSpheres - m_NumTreeSpheres };
+		const size_t numPackets{ m_NumTreePackets + (numAddedSpheres + m_SpherePacketWidth - 1) / m_SpherePacketWidth };
+		m_SpherePackets.resize(numPackets);
+		m_SlotSpheres.resize(numPackets * m_SpherePacketWidth, UINT32_MAX);
+		for (uint32_t sphere{ static_cast<uint32_t>(m_SphereSlots.size()) }; sphere < numSpheres; ++sphere)
+		{
+			const uint32_t slot{ m_NumTreePackets * m_SpherePacketWidth + sphere - m_NumTreeSpheres };
+			m_SphereSlots.push_back(slot);
+			m_SlotSpheres[slot] = sphere;
+		}
+
+		bool isTreeChanged{};
+		for (uint32_t index{ range.first }; index < range.first + range.count && index < numSpheres; ++index)
+		{
+			const uint32_t slot{ m_SphereSlots[index] };
+			m_SpherePackets[slot / m_SpherePacketWidth].Set(slot % m_SpherePacketWidth, m_SphereGeometries[index]);
+			isTreeChanged |= index < m_NumTreeSpheres;
+		}
+
+		// A moved sphere may leave its cells, a grid can not be refitted like a tree
+		if (isTreeChanged && m_IsSphereGrid)
+			RebuildSphereAccelerator();
+		else if (isTreeChanged)
+			RefitSphereBVH();
+	}
+
+	void Scene::RebuildSphereAccelerator()
+	{
+		// A small scene is faster scanned linearly, all of its spheres are left to UpdateSpherePackets
+		const uint32_t numSpheres{ static_cast<uint32_t>(m_SphereGeometries.size()) };
+		m_SphereBounds.clear();
+		if (numSpheres > m_MaxLinearSpheres)
+			std::transform(m_SphereGeometries.begin(), m_SphereGeometries.end(), std::back_inserter(m_SphereBounds), AABB::FromSphere);
+
+		// Many evenly spread spheres of about one size, like a particle dump, are found two to three times faster through a grid
+		m_IsSphereGrid = numSpheres >= m_MinGridSpheres && UniformGrid::IsUniform(m_SphereBounds);
+		if (m_IsSphereGrid)
+		{
+			RebuildSphereGrid();
+			return;
+		}
+
+		// The SAH tree traces faster, the linear one builds an order of magnitude faster. It is worth it for huge scenes,
+		// and for spheres that all change again and again, which a tree built for one frame is soon rebuilt for anyway
+		const bool isLinear{ numSpheres >= m_MinLinearBuildSpheres || m_NumMovingRebuilds > 1 };
+		m_SphereBVH.Build(m_SphereBounds, isLinear ? BVHBuilder::Linear : BVHBuilder::BinnedSAH);
+		const uint32_t numTreeSpheres{ static_cast<uint32_t>(m_SphereBounds.size()) };
+
+		// Leaf i is packet i, lanes past the leaf's spheres stay empty
+		const std::vector<WideBVH::Leaf>& leaves{ m_SphereBVH.GetLeaves() };
+		const std::vector<uint32_t>& sphereIndices{ m_SphereBVH.GetPrimitiveIndices() };
+		m_NumTreeSpheres = numTreeSpheres;
+		m_NumTreePackets = static_cast<uint32_t>(leaves.size());
+		m_SpherePackets.assign(leaves.size(), {});
+		m_SphereSlots.resize(numTreeSpheres);
+		m_SlotSpheres.assign(leaves.size() * m_SpherePacketWidth, UINT32_MAX);
+		for (uint32_t leafIndex{}; leafIndex < leaves.size(); ++leafIndex)
+		{
+			for (uint32_t lane{}; lane < leaves[leafIndex].count; ++lane)
+			{
+				const uint32_t sphere{ sphereIndices[leaves[leafIndex].first + lane] };
+				const uint32_t slot{ leafIndex * m_SpherePacketWidth + lane };
+				m_SpherePackets[leafIndex].Set(static_cast<int>(lane), m_SphereGeometries[sphere]);
+				m_SphereSlots[sphere] = slot;
+				m_SlotSpheres[slot] = sphere;
 			}
 		}
-	
-		for (int planeIndex{}; planeIndex < m_PlaneGeometries.size(); ++planeIndex)
+	}
+
+	void Scene::RebuildSphereGrid()
+	{
+		m_SphereGrid.Build(m_SphereBounds);
+		const std::vector<uint32_t>& cellStarts{ m_SphereGrid.GetCellStarts() };
+		const std::vector<uint32_t>& sphereIndices{ m_SphereGrid.GetPrimitiveIndices() };
+		const uint32_t numCells{ m_SphereGrid.GetNumCells() };
+
+		// Every cell gets as many packets as its spheres fill, a sphere in several cells has a lane in each of them
+		m_GridCellPackets.resize(numCells + 1);
+		m_GridCellPackets[0] = 0;
+		for (uint32_t cell{}; cell < numCells; ++cell)
+			m_GridCellPackets[cell + 1] = m_GridCellPackets[cell] + (cellStarts[cell + 1] - cellStarts[cell] + m_SpherePacketWidth - 1) / m_SpherePacketWidth;
+
+		const uint32_t numPackets{ m_GridCellPackets.back() };
+		m_NumTreeSpheres = static_cast<uint32_t>(m_SphereBounds.size());
+		m_NumTreePackets = numPackets;
+		m_SpherePackets.assign(numPackets, {});
+		m_SphereSlots.resize(m_NumTreeSpheres);
+		m_SlotSpheres.assign(numPackets * m_SpherePacketWidth, UINT32_MAX);
+		for (uint32_t cell{}; cell < numCells; ++cell)
+		{
+			for (uint32_t index{ cellStarts[cell] }; index < cellStarts[cell + 1]; ++index)
+			{
+				const uint32_t sphere{ sphereIndices[index] };
+				const uint32_t slot{ m_GridCellPackets[cell] * m_SpherePacketWidth + index - cellStarts[cell] };
+				m_SpherePackets[slot / m_SpherePacketWidth].Set(static_cast<int>(slot % m_SpherePacketWidth), m_SphereGeometries[sphere]);
+				m_SphereSlots[sphere] = slot;
+				m_SlotSpheres[slot] = sphere;
+			}
+		}
+	}
+
+	void Scene::RefitSphereBVH()
+	{
+		// Moved spheres keep their leaf, the boxes only grow or shrink around them
+		const std::vector<WideBVH::Leaf>& leaves{ m_SphereBVH.GetLeaves() };
+		const std::vector<uint32_t>& sphereIndices{ m_SphereBVH.GetPrimitiveIndices() };
+		m_SphereBounds.assign(leaves.size(), {});
+		for (size_t leafIndex{}; leafIndex < leaves.size(); ++leafIndex)
+		{
+			for (uint32_t index{ leaves[leafIndex].first }; index < leaves[leafIndex].first + leaves[leafIndex].count; ++index)
+				m_SphereBounds[leafIndex].Grow(AABB::FromSphere(m_SphereGeometries[sphereIndices[index]]));
+		}
+		m_SphereBVH.Refit(m_SphereBounds);
+	}
+
+	uint32_t Scene::GetComponentSize(SceneComponent component) const
+	{
+		switch (component)
 		{
-			if (GeometryUtils::HitTest_Plane(m_PlaneGeometries[planeIndex], ray)) return true;
+		case SceneComponent::Spheres:
+			return static_cast<uint32_t>(m_SphereGeometries.size());
+		case SceneComponent::Planes:
+			return static_cast<uint32_t>(m_PlaneGeometries.size());
+		case SceneComponent::TriangleMeshes:
+			return static_cast<uint32_t>(m_TriangleMeshGeometries.size());
+		case SceneComponent::Lights:
+			return static_cast<uint32_t>(m_Lights.size());
+		case SceneComponent::Materials:
+			return static_cast<uint32_t>(m_Materials.size());
+		default:
+			return 1;
 		}
-	 	
-	 	return false;
-	 }
+	}
+#pragma endregion
 
 #pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	SphereHandle Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
 		Sphere s;
 		s.origin = origin;
@@ -123,10 +582,11 @@ namespace dae {
 		s.materialIndex = materialIndex;
 
 		m_SphereGeometries.emplace_back(s);
-		return &m_SphereGeometries.back();
+		MarkDirty(SceneComponent::Spheres, static_cast<uint32_t>(m_SphereGeometries.size() - 1));
+		return { static_cast<uint32_t>(m_SphereGeometries.size() - 1), m_HandleGeneration };
 	}
 
-	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
+	PlaneHandle Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
 	{
 		Plane p;
 		p.origin = origin;
@@ -134,20 +594,22 @@ namespace dae {
 		p.materialIndex = materialIndex;
 
 		m_PlaneGeometries.emplace_back(p);
-		return &m_PlaneGeometries.back();
+		MarkDirty(SceneComponent::Planes, static_cast<uint32_t>(m_PlaneGeometries.size() - 1));
+		return { static_cast<uint32_t>(m_PlaneGeometries.size() - 1), m_HandleGeneration };
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	TriangleMeshHandle Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
 	{
 		TriangleMesh m{};
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
 
 		m_TriangleMeshGeometries.emplace_back(m);
-		return &m_TriangleMeshGeometries.back();
+		MarkDirty(SceneComponent::TriangleMeshes, static_cast<uint32_t>(m_TriangleMeshGeometries.size() - 1));
+		return { static_cast<uint32_t>(m_TriangleMeshGeometries.size() - 1), m_HandleGeneration };
 	}
 
-	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
+	LightHandle Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
 		l.origin = origin;
@@ -156,10 +618,11 @@ namespace dae {
 		l.type = LightType::Point;
 
 		m_Lights.emplace_back(l);
-		return &m_Lights.back();
+		MarkDirty(SceneComponent::Lights, static_cast<uint32_t>(m_Lights.size() - 1));
+		return { static_cast<uint32_t>(m_Lights.size() - 1), m_HandleGeneration };
 	}
 
-	Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
+	LightHandle Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
 	{
 		Light l;
 		l.direction = direction;
@@ -168,13 +631,38 @@ namespace dae {
 		l.type = LightType::Directional;
 
 		m_Lights.emplace_back(l);
-		return &m_Lights.back();
+		MarkDirty(SceneComponent::Lights, static_cast<uint32_t>(m_Lights.size() - 1));
+		return { static_cast<uint32_t>(m_Lights.size() - 1), m_HandleGeneration };
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
+	LightHandle Scene::AddSphereAreaLight(const Vector3& origin, float radius, float radiance, const ColorRGB& color)
 	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
+		Light l;
+		l.origin = origin;
+		l.radius = radius;
+		l.intensity = radiance;
+		l.color = color;
+		l.type = LightType::SphereArea;
+
+		m_Lights.emplace_back(l);
+		MarkDirty(SceneComponent::Lights, static_cast<uint32_t>(m_Lights.size() - 1));
+		return { static_cast<uint32_t>(m_Lights.size() - 1), m_HandleGeneration };
+	}
+
+	LightHandle Scene::AddRectAreaLight(const Vector3& origin, const Vector3& edgeU, const Vector3& edgeV, float radiance, const ColorRGB& color)
+	{
+		Light l;
+		l.origin = origin;
+		l.edgeU = edgeU;
+		l.edgeV = edgeV;
+		l.direction = Vector3::Cross(edgeU, edgeV).Normalized();
+		l.intensity = radiance;
+		l.color = color;
+		l.type = LightType::RectArea;
+
+		m_Lights.emplace_back(l);
+		MarkDirty(SceneComponent::Lights, static_cast<uint32_t>(m_Lights.size() - 1));
+		return { static_cast<uint32_t>(m_Lights.size() - 1), m_HandleGeneration };
 	}
 #pragma endregion
 #pragma endregion
@@ -184,11 +672,11 @@ namespace dae {
 	{
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial<Material_SolidColor>(colors::Blue);
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial<Material_SolidColor>(colors::Yellow);
+		const unsigned char matId_Solid_Green = AddMaterial<Material_SolidColor>(colors::Green);
+		const unsigned char matId_Solid_Magenta = AddMaterial<Material_SolidColor>(colors::Magenta);
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -211,11 +699,11 @@ namespace dae {
 
 		//default: Material id0 >> SolidColor Material (RED)
 		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		const unsigned char matId_Solid_Blue = AddMaterial<Material_SolidColor>(colors::Blue);
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const unsigned char matId_Solid_Yellow = AddMaterial<Material_SolidColor>(colors::Yellow);
+		const unsigned char matId_Solid_Green = AddMaterial<Material_SolidColor>(colors::Green);
+		const unsigned char matId_Solid_Magenta = AddMaterial<Material_SolidColor>(colors::Magenta);
 
 		//Plane
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f,0.f }, matId_Solid_Green);
@@ -246,14 +734,14 @@ namespace dae {
 		m_Camera.origin = { 0.f,3.f, -9.f };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f,.915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f,.915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f,.915f }, 1.f, 1.f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f,.75f }, .0f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f,.75f }, .0f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f,.75f }, .0f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f,.915f }, 1.f, 1.f);
+		const auto matCT_GrayMediumMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f,.915f }, 1.f, .6f);
+		const auto matCT_GraySmoothMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f,.915f }, 1.f, 1.f);
+		const auto matCT_GrayRoughPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f,.75f }, .0f, 1.f);
+		const auto matCT_GrayMediumPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f,.75f }, .0f, .6f);
+		const auto matCT_GraySmoothPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f,.75f }, .0f, .1f);
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f,.57f,.57f }, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial<Material_Lambert>(ColorRGB{ .49f,.57f,.57f }, 1.f);
 
 		// PLANE
 		AddPlane(Vector3{0.f,0.f,10.f}, Vector3{0.f,0.f,-1.f}, matLambert_GrayBlue);	// back
@@ -263,9 +751,9 @@ namespace dae {
 		AddPlane(Vector3{-5.f,0.f,0.f}, Vector3{1.f,0.f,0.f}, matLambert_GrayBlue);		// left
 
 		//// Temporary Lambert-Phong Spheres & Materials
-		//const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
-		//const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
-		//const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
+		//const auto matLambertPhong1 = AddMaterial<Material_LambertPhong>(colors::Blue, 0.5f, 0.5f, 3.f);
+		//const auto matLambertPhong2 = AddMaterial<Material_LambertPhong>(colors::Blue, 0.5f, 0.5f, 15.f);
+		//const auto matLambertPhong3 = AddMaterial<Material_LambertPhong>(colors::Blue, 0.5f, 0.5f, 50.f);
 		//
 		//AddSphere(Vector3{ -1.75,1.f,0.f }, .75f, matLambertPhong1);
 		//AddSphere(Vector3{ 0.f,1.f,0.f }, .75f, matLambertPhong2);
@@ -294,9 +782,9 @@ namespace dae {
 		// m_Camera.fovAngle = 45.f;
 		   
 		// //default: Material id0 >> SolidColor Material (RED)
-		// const auto matLambert_Red = AddMaterial	(new Material_Lambert(colors::Red,1.f));
-		// const auto matLambertPhong_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f,1.f,60.f));
-		// const auto matLambert_Yellow = AddMaterial(new Material_Lambert(colors::Yellow, 1.f));
+		// const auto matLambert_Red = AddMaterial<Material_Lambert>(colors::Red,1.f);
+		// const auto matLambertPhong_Blue = AddMaterial<Material_LambertPhong>(colors::Blue, 1.f,1.f,60.f);
+		// const auto matLambert_Yellow = AddMaterial<Material_Lambert>(colors::Yellow, 1.f);
 		   
 		// // Spheres
 		// AddSphere({ -.75f, 1.f, 0.f }, 1.f, matLambert_Red);
@@ -311,4 +799,47 @@ namespace dae {
 		
 	}
 #pragma endregion
+
+#pragma region SCENE AREA LIGHTS
+	void Scene_AreaLights::Initialize()
+	{
+		m_Camera.origin = { 0.f,3.f, -9.f };
+		m_Camera.fovAngle = 45.f;
+
+		const auto matCT_GrayMediumMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f,.915f }, 1.f, .6f);
+		const auto matCT_GraySmoothMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f,.915f }, 1.f, .2f);
+		const auto matCT_GrayRoughPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f,.75f }, .0f, 1.f);
+		const auto matCT_GraySmoothPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f,.75f }, .0f, .1f);
+		const auto matDielectric_Glass = AddMaterial<Material_Dielectric>(ColorRGB{ .95f, .95f, .95f }, 1.5f);
+
+		const auto matLambert_GrayBlue = AddMaterial<Material_Lambert>(ColorRGB{ .49f,.57f,.57f }, 1.f);
+
+		// PLANE
+		AddPlane(Vector3{0.f,0.f,10.f}, Vector3{0.f,0.f,-1.f}, matLambert_GrayBlue);	// back
+		AddPlane(Vector3{0.f,0.f,0.f}, Vector3{0.f,1.f,0.f}, matLambert_GrayBlue);		// bottom
+		AddPlane(Vector3{0.f,10.f,0.f}, Vector3{0.f,-1.f,0.f}, matLambert_GrayBlue);	// top
+		AddPlane(Vector3{5.f,0.f,0.f}, Vector3{-1.f,0.f,0.f}, matLambert_GrayBlue);		// right
+		AddPlane(Vector3{-5.f,0.f,0.f}, Vector3{1.f,0.f,0.f}, matLambert_GrayBlue);		// left
+
+		// SPHERE
+		AddSphere(Vector3{-1.75,1.f,0.f}, .75f, matCT_GrayMediumMetal);
+		AddSphere(Vector3{ 0.f,1.f,0.f}, .75f, matDielectric_Glass);
+		AddSphere(Vector3{1.75,1.f,0.f}, .75f, matCT_GraySmoothMetal);
+		AddSphere(Vector3{-1.75,3.f,0.f}, .75f, matCT_GrayRoughPlastic);
+		AddSphere(Vector3{1.75,3.f,0.f}, .75f, matCT_GraySmoothPlastic);
+
+		// LIGHT
+		AddRectAreaLight(Vector3{ 0.f,9.9f,0.f }, Vector3{ 1.5f,0.f,0.f }, Vector3{ 0.f,0.f,1.5f }, 25.f, ColorRGB{ 1.f,.8f,.6f });	// ceiling panel
+		AddSphereAreaLight(Vector3{ 0.f,3.f,0.f }, .4f, 20.f, ColorRGB{ .34f,.47f,.68f });	// glowing orb
+	}
+#pragma endregion
+
+#pragma region SCENE REMOTE
+	void Scene_Remote::Initialize()
+	{
+		std::istringstream stream(m_SceneData);
+		if (!Deserialize(stream))
+			throw std::runtime_error("Invalid scene data received");
+	}
+#pragma endregion
 }
@@ -1,10 +1,16 @@
 #pragma once
+#include <cassert>
+#include <iosfwd>
 #include <string>
 #include <vector>
 
 #include "Maths.h"
 #include "DataTypes.h"
+#include "BVH.h"
+#include "UniformGrid.h"
 #include "Camera.h"
+#include "Kernels.h"
+#include "MemoryArena.h"
 
 namespace dae
 {
@@ -15,12 +21,45 @@ namespace dae
 	struct Sphere;
 	struct Light;
 
+	//Parts of the scene that are versioned separately
+	enum class SceneComponent
+	{
+		Camera,
+		Spheres,
+		Planes,
+		TriangleMeshes,
+		Lights,
+		Materials,
+		Count
+	};
+
+	//Indices [first, first + count) of a scene array that changed, empty when count is 0
+	struct DirtyRange
+	{
+		uint32_t first{};
+		uint32_t count{};
+
+		bool IsEmpty() const { return count == 0; }
+		void Add(uint32_t index, uint32_t numIndices = 1);
+	};
+
+	//What Update may change, handed from the scene a simulation updates to a copy of it that renders on another thread (see RenderThread)
+	struct SceneState
+	{
+		Camera camera{};
+		std::vector<Sphere> spheres{};
+		std::vector<Plane> planes{};
+		std::vector<TriangleMesh> triangleMeshes{};
+		std::vector<Light> lights{};
+		uint64_t generations[static_cast<int>(SceneComponent::Count)]{}; // Of the scene's components when they were copied
+	};
+
 	//Scene Base Class
 	class Scene
 	{
 	public:
 		Scene();
-		virtual ~Scene();
+		virtual ~Scene() = default;
 
 		Scene(const Scene&) = delete;
 		Scene(Scene&&) noexcept = delete;
@@ -28,19 +67,47 @@ namespace dae
 		Scene& operator=(Scene&&) noexcept = delete;
 
 		virtual void Initialize() = 0;
-		virtual void Update(dae::Timer* pTimer)
-		{
-			m_Camera.Update(pTimer);
-		}
+		virtual void Update(dae::Timer* pTimer);
 
+		//Changes made through GetCamera are not tracked, SetCamera or MarkDirty(SceneComponent::Camera) bumps the camera generation
 		Camera& GetCamera() { return m_Camera; }
+		void SetCamera(const Camera& camera);
+
+		//Every change gets a new, higher generation. Consumers remember the generation they last saw and only redo what changed since
+		uint64_t GetGeneration() const { return m_Generation; }
+		uint64_t GetGeneration(SceneComponent component) const { return m_ComponentGenerations[static_cast<int>(component)]; }
+		uint64_t GetContentGeneration() const; // Everything but the camera
+		//Indices of component that changed after sinceGeneration, the whole array when the changes are too old to still be recorded
+		DirtyRange GetDirtyRange(SceneComponent component, uint64_t sinceGeneration) const;
+
+		//Call after changing a whole part of the scene, like the camera through GetCamera
+		void MarkDirty(SceneComponent component);
+
+		//Copies the components that changed since state was last captured into it. Materials are not part of the state, the
+		//scene a state is applied to must have created the same ones
+		void CaptureState(SceneState& state) const;
+		//Takes over the camera and the components that changed since the last state applied, marking them dirty
+		void ApplyState(const SceneState& state);
+
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(const Ray& ray) const;
 
+		//Traversal only tracks t and the primitive, FillHitRecord reconstructs the surface for the winner
+		bool GetClosestIntersection(const Ray& ray, Intersection& intersection) const;
+		void FillHitRecord(const Ray& ray, const Intersection& intersection, HitRecord& hitRecord) const;
+
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+
+		//False for invalid handles and ones handed out before Deserialize or ApplyState replaced the arrays they index
+		template<typename T>
+		bool IsCurrent(Handle<T> handle) const { return handle.IsValid() && handle.generation == m_HandleGeneration; }
+
+		//Writes geometry, lights, materials and camera so another process can rebuild the scene
+		void Serialize(std::ostream& stream) const;
 
 	protected:
 		std::string	sceneName;
@@ -51,15 +118,86 @@ namespace dae
 		std::vector<Light> m_Lights{};
 		std::vector<Material*> m_Materials{};
 
+		//Owns all materials, each one's destructor runs with the scene and the memory goes block by block
+		MemoryArena m_Arena{};
+
 		Camera m_Camera{};
 
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
-		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		SphereHandle AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
+		PlaneHandle AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
+		TriangleMeshHandle AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+
+		LightHandle AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
+		LightHandle AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+		LightHandle AddSphereAreaLight(const Vector3& origin, float radius, float radiance, const ColorRGB& color);
+		LightHandle AddRectAreaLight(const Vector3& origin, const Vector3& edgeU, const Vector3& edgeV, float radiance, const ColorRGB& color); // Emits along cross(edgeU, edgeV)
+
+		template<typename T, typename... Args>
+		unsigned char AddMaterial(Args&&... args)
+		{
+			m_Materials.push_back(m_Arena.Create<T>(std::forward<Args>(args)...));
+			MarkDirty(SceneComponent::Materials, static_cast<uint32_t>(m_Materials.size() - 1));
+			return static_cast<unsigned char>(m_Materials.size() - 1);
+		}
+
+		Sphere& GetSphere(SphereHandle handle) { assert(IsCurrent(handle)); return m_SphereGeometries[handle.index]; }
+		Plane& GetPlane(PlaneHandle handle) { assert(IsCurrent(handle)); return m_PlaneGeometries[handle.index]; }
+		TriangleMesh& GetTriangleMesh(TriangleMeshHandle handle) { assert(IsCurrent(handle)); return m_TriangleMeshGeometries[handle.index]; }
+		Light& GetLight(LightHandle handle) { assert(IsCurrent(handle)); return m_Lights[handle.index]; }
 
-		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
-		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		//Call after changing something through GetSphere, GetPlane, GetTriangleMesh or GetLight, spheres are only intersected from a copy kept up to date here
+		void MarkDirty(SphereHandle handle) { assert(IsCurrent(handle)); MarkDirty(SceneComponent::Spheres, handle.index); }
+		void MarkDirty(PlaneHandle handle) { assert(IsCurrent(handle)); MarkDirty(SceneComponent::Planes, handle.index); }
+		void MarkDirty(TriangleMeshHandle handle) { assert(IsCurrent(handle)); MarkDirty(SceneComponent::TriangleMeshes, handle.index); }
+		void MarkDirty(LightHandle handle) { assert(IsCurrent(handle)); MarkDirty(SceneComponent::Lights, handle.index); }
+		void MarkDirty(SceneComponent component, uint32_t index);
+
+		//Applies the mesh's translation, rotation and scale and records the change
+		void UpdateTransforms(TriangleMeshHandle handle);
+
+		bool Deserialize(std::istream& stream);
+
+	private:
+		struct DirtyRecord
+		{
+			uint64_t generation{};
+			DirtyRange range{};
+		};
+
+		static constexpr size_t m_MaxDirtyRecords{ 64 }; // Per component, older changes are only known by their generation
+		static constexpr int m_SpherePacketWidth{ 8 }; // What every variant of the sphere kernels takes
+		static constexpr uint32_t m_MaxLinearSpheres{ 128 }; // Below about this many spheres the packet kernels beat walking a tree
+		static constexpr uint32_t m_MinLinearBuildSpheres{ 65536 }; // From about this many spheres only the linear builder rebuilds within a frame
+		static constexpr uint32_t m_MinGridSpheres{ 1024 }; // Below about this many spheres a tree is nearly as fast, and too few cells tell how evenly they spread
+
+		uint32_t GetComponentSize(SceneComponent component) const;
+		void UpdateSpherePackets(const DirtyRange& range);
+		void RebuildSphereAccelerator();
+		void RebuildSphereGrid();
+		void RefitSphereBVH();
+		int IntersectSphereGrid(const Ray& ray, float& t) const;
+		bool HitTestSphereGrid(const Ray& ray) const;
+
+		// The tree's leaves or the grid's cells first, then packets of the spheres added since it was built
+		std::vector<SpherePacket<m_SpherePacketWidth>> m_SpherePackets{};
+		WideBVH m_SphereBVH{};
+		UniformGrid m_SphereGrid{};
+		std::vector<uint32_t> m_GridCellPackets{}; // Cell i has the packets from element i up to element i + 1
+		bool m_IsSphereGrid{}; // The grid is used instead of the tree
+		uint32_t m_NumTreeSpheres{};
+		uint32_t m_NumTreePackets{};
+		uint32_t m_NumMovingRebuilds{}; // Rebuilds in a row because every sphere changed, the spheres are animated
+		std::vector<uint32_t> m_SphereSlots{}; // Per sphere, packet * width + lane
+		std::vector<uint32_t> m_SlotSpheres{}; // Per lane of every packet, UINT32_MAX when unused
+		std::vector<AABB> m_SphereBounds{}; // Refit scratch, per leaf
+		const KernelTable* m_pKernels{ &GetKernels() }; // Fastest variant for this CPU
+
+		uint64_t m_Generation{};
+		uint64_t m_ComponentGenerations[static_cast<int>(SceneComponent::Count)]{};
+		std::vector<DirtyRecord> m_DirtyRecords[static_cast<int>(SceneComponent::Count)]{};
+		uint64_t m_OldestRecordedGenerations[static_cast<int>(SceneComponent::Count)]{}; // Changes after this one are all in the records
+		uint64_t m_AppliedStateGenerations[static_cast<int>(SceneComponent::Count)]{}; // Of the captured scene, see ApplyState
+		uint32_t m_HandleGeneration{ 1 }; // Handed out with every handle, bumped when the arrays get replaced
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -109,4 +247,39 @@ namespace dae
 
 		void Initialize() override;
 	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//WEEK 3 Scene lit by area lights, meant for the path traced lighting mode
+	class Scene_AreaLights final : public Scene
+	{
+	public:
+		Scene_AreaLights() = default;
+		~Scene_AreaLights() override = default;
+
+		Scene_AreaLights(const Scene_AreaLights&) = delete;
+		Scene_AreaLights(Scene_AreaLights&&) noexcept = delete;
+		Scene_AreaLights& operator=(const Scene_AreaLights&) = delete;
+		Scene_AreaLights& operator=(Scene_AreaLights&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Scene received from a render coordinator (see Scene::Serialize)
+	class Scene_Remote final : public Scene
+	{
+	public:
+		explicit Scene_Remote(const std::string& sceneData) : m_SceneData(sceneData) {}
+		~Scene_Remote() override = default;
+
+		Scene_Remote(const Scene_Remote&) = delete;
+		Scene_Remote(Scene_Remote&&) noexcept = delete;
+		Scene_Remote& operator=(const Scene_Remote&) = delete;
+		Scene_Remote& operator=(Scene_Remote&&) noexcept = delete;
+
+		void Initialize() override;
+
+	private:
+		std::string m_SceneData{};
+	};
 }
@@ -0,0 +1,59 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	namespace Serialization
+	{
+		//Raw binary (de)serialization of trivially copyable data, both ends are expected to share the same layout and endianness
+		template<typename T>
+		void Write(std::ostream& stream, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written raw");
+			stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		template<typename T>
+		bool Read(std::istream& stream, T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read raw");
+			stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+			return !stream.fail();
+		}
+
+		template<typename T>
+		void WriteVector(std::ostream& stream, const std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be written raw");
+			Write(stream, static_cast<uint32_t>(values.size()));
+			stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+		}
+
+		template<typename T>
+		bool ReadVector(std::istream& stream, std::vector<T>& values)
+		{
+			static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable types can be read raw");
+			uint32_t size{};
+			if (!Read(stream, size))
+				return false;
+
+			//Grown as the values arrive, a corrupt size fails at the end of the stream instead of allocating all of it up front
+			constexpr size_t valuesPerRead{ 65536 };
+			values.clear();
+			while (values.size() < size)
+			{
+				const size_t first{ values.size() };
+				values.resize(std::min<size_t>(size, first + valuesPerRead));
+				stream.read(reinterpret_cast<char*>(values.data() + first), (values.size() - first) * sizeof(T));
+				if (stream.fail())
+					return false;
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#include "ShadowMaps.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+
+using namespace dae;
+
+void ShadowMaps::Update(const Scene& scene)
+{
+	if (scene.GetContentGeneration() == m_SceneGeneration)
+		return;
+	m_SceneGeneration = scene.GetContentGeneration();
+
+	if (m_RowIndices.empty())
+	{
+		m_RowIndices.resize(resolution);
+		std::iota(m_RowIndices.begin(), m_RowIndices.end(), 0);
+	}
+
+	// Without spheres nothing but planes casts shadows, those are always traced
+	const std::vector<Light>& lights{ scene.GetLights() };
+	const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+	m_Maps.resize(lights.size());
+	for (size_t index{}; index < lights.size(); ++index)
+	{
+		Map& map{ m_Maps[index] };
+		map.isUsed = lights[index].type == LightType::Directional && !spheres.empty();
+		if (map.isUsed)
+			RenderMap(spheres, lights[index], map);
+	}
+}
+
+void ShadowMaps::RenderMap(const std::vector<Sphere>& spheres, const Light& light, Map& map)
+{
+	map.w = light.direction.Normalized();
+	const Vector3 helper{ std::abs(map.w.y) > 0.9f ? Vector3::UnitX : Vector3::UnitY };
+	map.u = Vector3::Cross(helper, map.w).Normalized();
+	map.v = Vector3::Cross(map.w, map.u);
+
+	m_ProjectedSpheres.resize(spheres.size());
+	std::transform(spheres.begin(), spheres.end(), m_ProjectedSpheres.begin(), [&](const Sphere& sphere)
+		{
+			return ProjectedSphere{ Vector3::Dot(sphere.origin, map.u), Vector3::Dot(sphere.origin, map.v), Vector3::Dot(sphere.origin, map.w), sphere.radius };
+		});
+
+	// The square around every sphere seen from the light, with a border of empty texels
+	float minU{ FLT_MAX }, maxU{ -FLT_MAX }, minV{ FLT_MAX }, maxV{ -FLT_MAX };
+	for (const ProjectedSphere& sphere : m_ProjectedSpheres)
+	{
+		minU = std::min(minU, sphere.u - sphere.radius);
+		maxU = std::max(maxU, sphere.u + sphere.radius);
+		minV = std::min(minV, sphere.v - sphere.radius);
+		maxV = std::max(maxV, sphere.v + sphere.radius);
+	}
+	map.texelSize = std::max(maxU - minU, maxV - minV) / (resolution - 2);
+	map.minU = minU - map.texelSize;
+	map.minV = minV - map.texelSize;
+
+	map.depths.assign(static_cast<size_t>(resolution) * resolution, -FLT_MAX);
+	std::for_each(std::execution::par, m_RowIndices.begin(), m_RowIndices.end(), [&](int row) { RenderRow(map, row); });
+}
+
+void ShadowMaps::RenderRow(Map& map, int row) const
+{
+	float* pDepths{ map.depths.data() + static_cast<size_t>(row) * resolution };
+	const float rowV{ map.minV + (row + 0.5f) * map.texelSize };
+	for (const ProjectedSphere& sphere : m_ProjectedSpheres)
+	{
+		const float radiusSquared{ sphere.radius * sphere.radius };
+		const float toRow{ rowV - sphere.v };
+		if (toRow * toRow >= radiusSquared)
+			continue;
+
+		// Texels whose centers are inside the sphere's outline on this row
+		const float halfWidth{ std::sqrt(radiusSquared - toRow * toRow) };
+		const int firstColumn{ std::max(static_cast<int>(std::ceil((sphere.u - halfWidth - map.minU) / map.texelSize - 0.5f)), 0) };
+		const int lastColumn{ std::min(static_cast<int>(std::floor((sphere.u + halfWidth - map.minU) / map.texelSize - 0.5f)), resolution - 1) };
+		for (int column{ firstColumn }; column <= lastColumn; ++column)
+		{
+			const float toColumn{ map.minU + (column + 0.5f) * map.texelSize - sphere.u };
+			const float sqrDistance{ toColumn * toColumn + toRow * toRow };
+			if (sqrDistance < radiusSquared)
+				pDepths[column] = std::max(pDepths[column], sphere.w + std::sqrt(radiusSquared - sqrDistance));
+		}
+	}
+}
+
+float ShadowMaps::GetOcclusion(uint32_t lightIndex, const Vector3& point, const Vector3& normal) const
+{
+	const Map& map{ m_Maps[lightIndex] };
+
+	// Facing away from the light, the ray towards it goes through the surface the point is on
+	const float cosine{ Vector3::Dot(normal, map.w) };
+	if (cosine <= 0.f)
+		return 1.f;
+
+	// The receiver's own surface may be up to its slope times the filter's reach further along w in the texels around it
+	const float slope{ std::sqrt(1.f - std::min(cosine * cosine, 1.f)) / std::max(cosine, 0.05f) };
+	const float bias{ map.texelSize * (pcfRadius + 1) * (1.f + 1.5f * slope) };
+	const float depth{ Vector3::Dot(point, map.w) + bias };
+
+	const int column{ static_cast<int>(std::floor((Vector3::Dot(point, map.u) - map.minU) / map.texelSize)) };
+	const int row{ static_cast<int>(std::floor((Vector3::Dot(point, map.v) - map.minV) / map.texelSize)) };
+	int numOccluded{};
+	for (int y{ row - pcfRadius }; y <= row + pcfRadius; ++y)
+	{
+		if (y < 0 || y >= resolution)
+			continue;
+		const float* pDepths{ map.depths.data() + static_cast<size_t>(y) * resolution };
+		for (int x{ column - pcfRadius }; x <= column + pcfRadius; ++x)
+		{
+			if (x >= 0 && x < resolution && pDepths[x] > depth)
+				++numOccluded;
+		}
+	}
+
+	constexpr int numTaps{ (2 * pcfRadius + 1) * (2 * pcfRadius + 1) };
+	return numOccluded / static_cast<float>(numTaps);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Scene;
+
+	/**
+	 * \brief Shadow maps of the directional lights, looked up instead of tracing shadow rays towards them.
+	 * A map looks along its light over the bounds of all spheres, every texel holds how far towards the light the sphere surface
+	 * closest to the light is at its center. A point is in shadow where a texel is further than the point itself plus a slope
+	 * scaled bias, averaged over the (2 * pcfRadius + 1)^2 texels around it. Rows of a map are rendered in parallel.
+	 * Planes are not in the maps, they are cheap enough to test exactly.
+	 */
+	class ShadowMaps final
+	{
+	public:
+		static constexpr int resolution{ 1024 }; // Texels along both sides of a map
+		static constexpr int pcfRadius{ 1 };
+
+		ShadowMaps() = default;
+		~ShadowMaps() = default;
+
+		ShadowMaps(const ShadowMaps&) = delete;
+		ShadowMaps(ShadowMaps&&) noexcept = delete;
+		ShadowMaps& operator=(const ShadowMaps&) = delete;
+		ShadowMaps& operator=(ShadowMaps&&) noexcept = delete;
+
+		// Renders the maps again when the scene's content changed since the last call
+		void Update(const Scene& scene);
+
+		bool HasMap(uint32_t lightIndex) const { return lightIndex < m_Maps.size() && m_Maps[lightIndex].isUsed; }
+
+		// Fraction in [0, 1] of the filtered texels around point that shadow it from light lightIndex, which must have a map.
+		// Same as a ray from point towards the light hitting a sphere, up to the resolution of the map
+		float GetOcclusion(uint32_t lightIndex, const Vector3& point, const Vector3& normal) const;
+
+	private:
+		struct Map
+		{
+			bool isUsed{};
+			Vector3 u{}; // Along the texel columns
+			Vector3 v{}; // Along the texel rows
+			Vector3 w{}; // Towards the light
+			float minU{};
+			float minV{};
+			float texelSize{}; // Texels are square, in world units
+			std::vector<float> depths{}; // Along w, -FLT_MAX where no sphere is
+		};
+
+		// A sphere's center in the u, v, w frame of the map being rendered
+		struct ProjectedSphere
+		{
+			float u{};
+			float v{};
+			float w{};
+			float radius{};
+		};
+
+		void RenderMap(const std::vector<Sphere>& spheres, const Light& light, Map& map);
+		void RenderRow(Map& map, int row) const;
+
+		std::vector<Map> m_Maps{}; // One per light of the scene
+		std::vector<ProjectedSphere> m_ProjectedSpheres{};
+		std::vector<int> m_RowIndices{}; // 0 to resolution, to render rows in parallel
+		uint64_t m_SceneGeneration{ UINT64_MAX };
+	};
+}
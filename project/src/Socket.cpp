@@ -0,0 +1,246 @@
+#include "Socket.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using SocketLength = int;
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using SocketLength = socklen_t;
+#endif
+
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+#ifdef _WIN32
+		using NativeSocket = SOCKET;
+		constexpr NativeSocket NativeInvalidSocket{ INVALID_SOCKET };
+
+		struct WinsockInitializer
+		{
+			WinsockInitializer()
+			{
+				WSADATA wsaData{};
+				WSAStartup(MAKEWORD(2, 2), &wsaData);
+			}
+			~WinsockInitializer() { WSACleanup(); }
+		};
+
+		void EnsureInitialized()
+		{
+			static WinsockInitializer initializer{};
+		}
+
+		void ShutdownNative(NativeSocket socket)
+		{
+			//A listening socket is not connected, cancelling its pending I/O wakes the thread blocked in accept instead
+			if (shutdown(socket, SD_BOTH) != 0)
+				CancelIoEx(reinterpret_cast<HANDLE>(socket), nullptr);
+		}
+
+		void CloseNative(NativeSocket socket)
+		{
+			shutdown(socket, SD_BOTH);
+			closesocket(socket);
+		}
+
+		constexpr int SendFlags{ 0 };
+#else
+		using NativeSocket = int;
+		constexpr NativeSocket NativeInvalidSocket{ -1 };
+
+		void EnsureInitialized() {}
+
+		void ShutdownNative(NativeSocket socket)
+		{
+			shutdown(socket, SHUT_RDWR);
+		}
+
+		void CloseNative(NativeSocket socket)
+		{
+			shutdown(socket, SHUT_RDWR);
+			close(socket);
+		}
+
+#ifdef MSG_NOSIGNAL
+		constexpr int SendFlags{ MSG_NOSIGNAL }; // A dead peer must not raise SIGPIPE
+#else
+		constexpr int SendFlags{ 0 };
+#endif
+#endif
+
+		NativeSocket ToNative(intptr_t handle)
+		{
+			return static_cast<NativeSocket>(handle);
+		}
+
+		void DisableNagle(NativeSocket socket)
+		{
+			int noDelay{ 1 };
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+		}
+	}
+
+	Socket::~Socket()
+	{
+		Close();
+	}
+
+	Socket::Socket(Socket&& other) noexcept :
+		m_Handle(std::exchange(other.m_Handle, InvalidHandle))
+	{
+	}
+
+	Socket& Socket::operator=(Socket&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			m_Handle = std::exchange(other.m_Handle, InvalidHandle);
+		}
+		return *this;
+	}
+
+	Socket Socket::Listen(uint16_t port, bool acceptsRemote)
+	{
+		EnsureInitialized();
+
+		const NativeSocket listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listenSocket == NativeInvalidSocket)
+			return {};
+
+		int reuseAddress{ 1 };
+		setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuseAddress), sizeof(reuseAddress));
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(acceptsRemote ? INADDR_ANY : INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+
+		if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+			listen(listenSocket, SOMAXCONN) != 0)
+		{
+			CloseNative(listenSocket);
+			return {};
+		}
+
+		return Socket{ static_cast<intptr_t>(listenSocket) };
+	}
+
+	Socket Socket::Connect(const std::string& host, uint16_t port)
+	{
+		EnsureInitialized();
+
+		addrinfo hints{};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+
+		addrinfo* pResult{};
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pResult) != 0)
+			return {};
+
+		NativeSocket connectSocket{ NativeInvalidSocket };
+		for (const addrinfo* pInfo = pResult; pInfo; pInfo = pInfo->ai_next)
+		{
+			connectSocket = socket(pInfo->ai_family, pInfo->ai_socktype, pInfo->ai_protocol);
+			if (connectSocket == NativeInvalidSocket)
+				continue;
+
+			if (connect(connectSocket, pInfo->ai_addr, static_cast<SocketLength>(pInfo->ai_addrlen)) == 0)
+				break;
+
+			CloseNative(connectSocket);
+			connectSocket = NativeInvalidSocket;
+		}
+		freeaddrinfo(pResult);
+
+		if (connectSocket == NativeInvalidSocket)
+			return {};
+
+		DisableNagle(connectSocket);
+		return Socket{ static_cast<intptr_t>(connectSocket) };
+	}
+
+	Socket Socket::Accept() const
+	{
+		if (!IsValid())
+			return {};
+
+		const NativeSocket clientSocket = accept(ToNative(m_Handle), nullptr, nullptr);
+		if (clientSocket == NativeInvalidSocket)
+			return {};
+
+		DisableNagle(clientSocket);
+		return Socket{ static_cast<intptr_t>(clientSocket) };
+	}
+
+	bool Socket::Send(const void* pData, size_t size) const
+	{
+		const char* pBytes = static_cast<const char*>(pData);
+		while (size > 0)
+		{
+			const auto sent = send(ToNative(m_Handle), pBytes, static_cast<int>(size), SendFlags);
+			if (sent <= 0)
+				return false;
+
+			pBytes += sent;
+			size -= static_cast<size_t>(sent);
+		}
+		return true;
+	}
+
+	bool Socket::Receive(void* pData, size_t size) const
+	{
+		char* pBytes = static_cast<char*>(pData);
+		while (size > 0)
+		{
+			const auto received = recv(ToNative(m_Handle), pBytes, static_cast<int>(size), 0);
+			if (received <= 0)
+				return false;
+
+			pBytes += received;
+			size -= static_cast<size_t>(received);
+		}
+		return true;
+	}
+
+	bool Socket::SetReceiveTimeout(int milliseconds) const
+	{
+		if (!IsValid())
+			return false;
+
+#ifdef _WIN32
+		const DWORD timeout{ static_cast<DWORD>(milliseconds) };
+#else
+		timeval timeout{};
+		timeout.tv_sec = milliseconds / 1000;
+		timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+		return setsockopt(ToNative(m_Handle), SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout)) == 0;
+	}
+
+	void Socket::Shutdown() const
+	{
+		if (IsValid())
+		{
+			ShutdownNative(ToNative(m_Handle));
+		}
+	}
+
+	void Socket::Close()
+	{
+		if (IsValid())
+		{
+			CloseNative(ToNative(std::exchange(m_Handle, InvalidHandle)));
+		}
+	}
+}
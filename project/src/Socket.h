@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	/**
+	 * \brief Minimal blocking TCP socket (Winsock on Windows, BSD sockets elsewhere)
+	 */
+	class Socket final
+	{
+	public:
+		Socket() = default;
+		~Socket();
+
+		Socket(const Socket&) = delete;
+		Socket& operator=(const Socket&) = delete;
+		Socket(Socket&& other) noexcept;
+		Socket& operator=(Socket&& other) noexcept;
+
+		// Only for connections from this machine, unless acceptsRemote also opens it to every network interface
+		static Socket Listen(uint16_t port, bool acceptsRemote = false);
+		static Socket Connect(const std::string& host, uint16_t port);
+		Socket Accept() const;
+
+		bool IsValid() const { return m_Handle != InvalidHandle; }
+
+		// Blocks until all bytes are transferred, returns false if the connection dropped
+		bool Send(const void* pData, size_t size) const;
+		bool Receive(void* pData, size_t size) const;
+
+		// Receive also returns false when the peer sends nothing for this long, 0 waits forever. A timed out stream is out of sync, drop it
+		bool SetReceiveTimeout(int milliseconds) const;
+
+		// Stops all traffic and wakes up threads blocked on this socket, also in Accept. The handle stays owned until Close
+		void Shutdown() const;
+		void Close();
+
+	private:
+		static constexpr intptr_t InvalidHandle{ -1 };
+
+		explicit Socket(intptr_t handle) : m_Handle(handle) {}
+
+		intptr_t m_Handle{ InvalidHandle };
+	};
+}
@@ -0,0 +1,151 @@
+#include "TileCuller.h"
+#include "Camera.h"
+#include "Scene.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <iterator>
+#include <numeric>
+
+using namespace dae;
+
+void TileCuller::Update(const Scene& scene, const Camera& camera, const Matrix& cameraToWorld, int width, int height)
+{
+	if (cameraToWorld == m_CameraToWorld && camera.fovAngle == m_FovAngle && width == m_Width && height == m_Height
+		&& scene.GetContentGeneration() == m_SceneGeneration)
+		return;
+
+	m_Origin = camera.origin;
+	m_CameraToWorld = cameraToWorld;
+	m_FovAngle = camera.fovAngle;
+	m_Width = width;
+	m_Height = height;
+	m_SceneGeneration = scene.GetContentGeneration();
+
+	m_NumTilesX = (width + tileSize - 1) / tileSize;
+	m_NumTilesY = (height + tileSize - 1) / tileSize;
+	m_Tiles.resize(static_cast<size_t>(m_NumTilesX) * m_NumTilesY);
+	m_RowIndices.resize(m_NumTilesY);
+	std::iota(m_RowIndices.begin(), m_RowIndices.end(), 0);
+
+	// Pixel x, y looks along (xNdc, yNdc, 1) in camera space, the same projection as Renderer::GetViewDirection
+	const float aspectRatio{ width / static_cast<float>(height) };
+	const float fov{ std::tan(camera.fovAngle / 2) };
+	const auto getNdcX = [&](int column) { return ((2.f * std::min(column * tileSize, width) / width) - 1.f) * fov * aspectRatio; };
+	const auto getNdcY = [&](int row) { return (1.f - (2.f * std::min(row * tileSize, height) / height)) * fov; };
+
+	m_ColumnNormals.resize(m_NumTilesX + 1);
+	for (int column{}; column <= m_NumTilesX; ++column)
+		m_ColumnNormals[column] = cameraToWorld.TransformVector(Vector3{ 1.f, 0.f, -getNdcX(column) }).Normalized();
+	m_RowNormals.resize(m_NumTilesY + 1);
+	for (int row{}; row <= m_NumTilesY; ++row)
+		m_RowNormals[row] = cameraToWorld.TransformVector(Vector3{ 0.f, -1.f, getNdcY(row) }).Normalized();
+	m_CornerDirections.resize(static_cast<size_t>(m_NumTilesX + 1) * (m_NumTilesY + 1));
+	for (int row{}; row <= m_NumTilesY; ++row)
+	{
+		for (int column{}; column <= m_NumTilesX; ++column)
+			m_CornerDirections[column + row * (m_NumTilesX + 1)] = cameraToWorld.TransformVector(Vector3{ getNdcX(column), getNdcY(row), 1.f });
+	}
+
+	std::for_each(std::execution::par, m_RowIndices.begin(), m_RowIndices.end(), [&](int row) { CullRow(scene, row); });
+}
+
+void TileCuller::CullRow(const Scene& scene, int row)
+{
+	Tile* pTiles{ m_Tiles.data() + static_cast<size_t>(row) * m_NumTilesX };
+	for (int column{}; column < m_NumTilesX; ++column)
+	{
+		pTiles[column].spheres.clear();
+		pTiles[column].planes.clear();
+	}
+
+	// Distances from the camera to the tile borders' planes. A sphere further than its radius outside of one can not be hit.
+	// Lists stop one past maxCandidateSpheres, those tiles are not culled anyway
+	const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+	const Vector3& above{ m_RowNormals[row] };
+	const Vector3& below{ m_RowNormals[row + 1] };
+	for (uint32_t index{}; index < spheres.size(); ++index)
+	{
+		const Vector3& center{ spheres[index].origin };
+		const float toCenter[3]{ center.x - m_Origin.x, center.y - m_Origin.y, center.z - m_Origin.z };
+		const float radius{ spheres[index].radius };
+		const auto getDistance = [&](const Vector3& normal) { return normal.x * toCenter[0] + normal.y * toCenter[1] + normal.z * toCenter[2]; };
+		if (getDistance(above) < -radius || getDistance(below) > radius)
+			continue;
+
+		bool isRightOfLeft{ getDistance(m_ColumnNormals[0]) >= -radius };
+		for (int column{}; column < m_NumTilesX; ++column)
+		{
+			const float toRight{ getDistance(m_ColumnNormals[column + 1]) };
+			std::vector<uint32_t>& candidates{ pTiles[column].spheres };
+			if (isRightOfLeft && toRight <= radius && candidates.size() <= maxCandidateSpheres)
+				candidates.push_back(index);
+			isRightOfLeft = toRight >= -radius;
+		}
+	}
+
+	// A ray hits a plane in front of it when it points towards the plane, every ray of a tile points between its corner rays
+	const std::vector<Plane>& planes{ scene.GetPlaneGeometries() };
+	for (uint32_t index{}; index < planes.size(); ++index)
+	{
+		const float side{ Vector3::Dot(planes[index].origin - m_Origin, planes[index].normal) };
+		for (int column{}; column < m_NumTilesX; ++column)
+		{
+			const Vector3* pCorners[4]{
+				&m_CornerDirections[column + row * (m_NumTilesX + 1)], &m_CornerDirections[column + 1 + row * (m_NumTilesX + 1)],
+				&m_CornerDirections[column + (row + 1) * (m_NumTilesX + 1)], &m_CornerDirections[column + 1 + (row + 1) * (m_NumTilesX + 1)] };
+			if (std::any_of(std::begin(pCorners), std::end(pCorners), [&](const Vector3* pCorner) { return Vector3::Dot(*pCorner, planes[index].normal) * side > 0.f; }))
+				pTiles[column].planes.push_back(index);
+		}
+	}
+
+	for (int column{}; column < m_NumTilesX; ++column)
+	{
+		Tile& tile{ pTiles[column] };
+		tile.isCulled = tile.spheres.size() <= maxCandidateSpheres;
+		tile.spherePackets.clear();
+		if (!tile.isCulled)
+			continue;
+
+		tile.spherePackets.resize((tile.spheres.size() + 7) / 8);
+		for (uint32_t lane{}; lane < tile.spheres.size(); ++lane)
+			tile.spherePackets[lane / 8].Set(static_cast<int>(lane % 8), spheres[tile.spheres[lane]]);
+	}
+}
+
+void TileCuller::GetClosestHit(const Scene& scene, const Ray& ray, int px, int py, HitRecord& closestHit) const
+{
+	const Tile& tile{ GetTile(px, py) };
+	if (!tile.isCulled)
+	{
+		scene.GetClosestHit(ray, closestHit);
+		return;
+	}
+
+	// Spheres before planes and each in ascending order, so ties go to the same primitive as in the scene
+	Intersection intersection{};
+	intersection.t = closestHit.t;
+	const int lane{ m_pKernels->intersectSpheres(tile.spherePackets.data(), static_cast<uint32_t>(tile.spherePackets.size()), ray, intersection.t) };
+	if (lane >= 0)
+	{
+		intersection.primitiveIndex = tile.spheres[lane];
+		intersection.primitiveType = PrimitiveType::Sphere;
+	}
+
+	const std::vector<Plane>& planes{ scene.GetPlaneGeometries() };
+	float t{};
+	for (const uint32_t planeIndex : tile.planes)
+	{
+		if (GeometryUtils::Intersect_Plane(planes[planeIndex], ray, t) && t < intersection.t)
+		{
+			intersection.t = t;
+			intersection.primitiveIndex = planeIndex;
+			intersection.primitiveType = PrimitiveType::Plane;
+		}
+	}
+
+	if (intersection.primitiveType != PrimitiveType::None)
+		scene.FillHitRecord(ray, intersection, closestHit);
+}
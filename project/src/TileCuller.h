@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Kernels.h"
+#include "Matrix.h"
+
+namespace dae
+{
+	class Scene;
+	struct Camera;
+
+	/**
+	 * \brief Per tile lists of the spheres and planes that primary rays through the tile can hit.
+	 * Every tile of tileSize x tileSize pixels is a frustum of four planes through the camera. A sphere is a candidate when
+	 * no plane has it fully outside, a plane when one of the tile's corner rays points towards it. Tile rows are culled in parallel.
+	 * A tile that sees more than maxCandidateSpheres spheres leaves its rays to the scene's tree or grid.
+	 */
+	class TileCuller final
+	{
+	public:
+		static constexpr int tileSize{ 16 };
+		static constexpr uint32_t maxCandidateSpheres{ 128 }; // Beyond about this many a tree beats testing the spheres one packet after the other
+
+		TileCuller() = default;
+		~TileCuller() = default;
+
+		TileCuller(const TileCuller&) = delete;
+		TileCuller(TileCuller&&) noexcept = delete;
+		TileCuller& operator=(const TileCuller&) = delete;
+		TileCuller& operator=(TileCuller&&) noexcept = delete;
+
+		// Culls again when the camera, the image size or the scene's content changed since the last call.
+		// The image is width x height pixels, viewed like Renderer does with a vertical field of view of camera.fovAngle
+		void Update(const Scene& scene, const Camera& camera, const Matrix& cameraToWorld, int width, int height);
+
+		// Same as Scene::GetClosestHit for a ray from the camera through pixel px, py of the image of the last Update
+		void GetClosestHit(const Scene& scene, const Ray& ray, int px, int py, HitRecord& closestHit) const;
+
+		// Whether the rays of the tile around pixel px, py only test its candidates
+		bool IsCulled(int px, int py) const { return GetTile(px, py).isCulled; }
+
+	private:
+		struct Tile
+		{
+			std::vector<uint32_t> spheres{}; // Indices in ascending order, the same as the lanes of spherePackets
+			std::vector<SpherePacket<8>> spherePackets{};
+			std::vector<uint32_t> planes{};
+			bool isCulled{};
+		};
+
+		const Tile& GetTile(int px, int py) const { return m_Tiles[px / tileSize + (py / tileSize) * m_NumTilesX]; }
+		void CullRow(const Scene& scene, int row);
+
+		int m_NumTilesX{};
+		int m_NumTilesY{};
+		std::vector<Tile> m_Tiles{};
+		std::vector<int> m_RowIndices{}; // 0 to m_NumTilesY, to cull the rows in parallel
+
+		// The borders between tiles as planes through the camera. Column k keeps what lies right of the border left of column k,
+		// row k what lies below the border above row k, so a tile keeps its column's and its row's plane and drops the next one's
+		std::vector<Vector3> m_ColumnNormals{};
+		std::vector<Vector3> m_RowNormals{};
+		std::vector<Vector3> m_CornerDirections{}; // Through every tile corner, (m_NumTilesX + 1) per row of corners
+
+		// What the candidates were culled for
+		Vector3 m_Origin{};
+		Matrix m_CameraToWorld{};
+		float m_FovAngle{};
+		int m_Width{};
+		int m_Height{};
+		uint64_t m_SceneGeneration{ UINT64_MAX };
+
+		const KernelTable* m_pKernels{ &GetKernels() };
+	};
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace dae
+{
+	/**
+	 * \brief Lock-free hand off of values from one producer thread to one consumer thread.
+	 * The producer and consumer each own a buffer, the third one sits in the middle. Publishing swaps the producer's buffer with the
+	 * middle one and flags it as fresh, consuming swaps the middle one with the consumer's buffer when it is fresh.
+	 * Neither side ever waits, the consumer always gets the newest published value and skips the ones in between.
+	 */
+	template<typename T>
+	class TripleBuffer final
+	{
+	public:
+		TripleBuffer() = default;
+		~TripleBuffer() = default;
+
+		TripleBuffer(const TripleBuffer&) = delete;
+		TripleBuffer(TripleBuffer&&) noexcept = delete;
+		TripleBuffer& operator=(const TripleBuffer&) = delete;
+		TripleBuffer& operator=(TripleBuffer&&) noexcept = delete;
+
+		// Producer side, fill the write buffer then publish it
+		T& GetWriteBuffer() { return m_Buffers[m_WriteIndex]; }
+		void Publish()
+		{
+			m_WriteIndex = m_MiddleIndex.exchange(m_WriteIndex | m_FreshFlag, std::memory_order_acq_rel) & m_IndexMask;
+		}
+
+		// Consumer side, returns false and keeps the current read buffer when nothing was published since the last call
+		bool Consume()
+		{
+			if ((m_MiddleIndex.load(std::memory_order_relaxed) & m_FreshFlag) == 0)
+				return false;
+
+			m_ReadIndex = m_MiddleIndex.exchange(m_ReadIndex, std::memory_order_acq_rel) & m_IndexMask;
+			return true;
+		}
+		const T& GetReadBuffer() const { return m_Buffers[m_ReadIndex]; }
+
+	private:
+		static constexpr uint32_t m_IndexMask{ 3 };
+		static constexpr uint32_t m_FreshFlag{ 4 };
+
+		T m_Buffers[3]{};
+		uint32_t m_WriteIndex{ 0 };
+		std::atomic<uint32_t> m_MiddleIndex{ 1 };
+		uint32_t m_ReadIndex{ 2 };
+	};
+}
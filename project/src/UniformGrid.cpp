@@ -0,0 +1,165 @@
+#include "UniformGrid.h"
+
+#include <atomic>
+#include <execution>
+#include <numeric>
+
+using namespace dae;
+
+namespace
+{
+	// About perCell of count primitives per cell of bounds, cubic cells unless an axis runs into maxResolution
+	void GetResolution(const AABB& bounds, uint32_t count, float perCell, uint32_t resolution[3])
+	{
+		const float extent[3]{ bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z };
+
+		// Flat or thin bounds are treated as at least a cell deep, so their cells do not shrink towards nothing
+		const float largest{ std::max({ extent[0], extent[1], extent[2] }) };
+		const float minExtent{ largest / UniformGrid::maxResolution };
+		const float volume{ std::max(extent[0], minExtent) * std::max(extent[1], minExtent) * std::max(extent[2], minExtent) };
+		const float cellSize{ std::cbrt(volume * perCell / count) };
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float cells{ cellSize > 0.f ? std::ceil(extent[axis] / cellSize) : 1.f };
+			resolution[axis] = static_cast<uint32_t>(std::clamp(cells, 1.f, static_cast<float>(UniformGrid::maxResolution)));
+		}
+	}
+
+	AABB GetBounds(const std::vector<AABB>& primitiveBounds)
+	{
+		return std::reduce(std::execution::par, primitiveBounds.begin(), primitiveBounds.end(), AABB{}, [](AABB bounds, const AABB& other)
+			{
+				bounds.Grow(other);
+				return bounds;
+			});
+	}
+}
+
+bool UniformGrid::IsUniform(const std::vector<AABB>& primitiveBounds)
+{
+	const uint32_t numPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+	if (numPrimitives == 0)
+		return false;
+
+	// Sizes: the largest primitive at most twice as large as the average one
+	struct Sizes
+	{
+		double sum{};
+		float largest{};
+	};
+	const Sizes sizes{ std::transform_reduce(std::execution::par, primitiveBounds.begin(), primitiveBounds.end(), Sizes{},
+		[](const Sizes& a, const Sizes& b) { return Sizes{ a.sum + b.sum, std::max(a.largest, b.largest) }; },
+		[](const AABB& bounds)
+		{
+			const float size{ std::max({ bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z }) };
+			return Sizes{ size, size };
+		}) };
+	if (sizes.largest > 2.f * static_cast<float>(sizes.sum / numPrimitives))
+		return false;
+
+	// Spread: centers counted in cells of about eight. Evenly spread centers vary by about a third of that between cells,
+	// clusters leave most cells empty and pile up in a few, which makes the counts vary more than they average
+	AABB centerBounds{};
+	for (const AABB& bounds : primitiveBounds)
+		centerBounds.Grow(bounds.GetCenter());
+	uint32_t resolution[3]{};
+	GetResolution(centerBounds, numPrimitives, 8.f, resolution);
+	const float scale[3]{
+		resolution[0] / std::max(centerBounds.max.x - centerBounds.min.x, FLT_MIN),
+		resolution[1] / std::max(centerBounds.max.y - centerBounds.min.y, FLT_MIN),
+		resolution[2] / std::max(centerBounds.max.z - centerBounds.min.z, FLT_MIN) };
+	const auto getCell = [&](float coordinate, float min, int axis)
+		{
+			return static_cast<uint32_t>(std::min(std::max(0.f, (coordinate - min) * scale[axis]), resolution[axis] - 1.f));
+		};
+
+	std::vector<uint32_t> counts(resolution[0] * resolution[1] * resolution[2]);
+	for (const AABB& bounds : primitiveBounds)
+	{
+		const Vector3 center{ bounds.GetCenter() };
+		++counts[getCell(center.x, centerBounds.min.x, 0) + resolution[0] * (getCell(center.y, centerBounds.min.y, 1) + resolution[1] * getCell(center.z, centerBounds.min.z, 2))];
+	}
+
+	const double mean{ static_cast<double>(numPrimitives) / counts.size() };
+	double variance{};
+	for (const uint32_t count : counts)
+		variance += (count - mean) * (count - mean);
+	variance /= static_cast<double>(counts.size());
+	return variance <= mean * mean;
+}
+
+void UniformGrid::Build(const std::vector<AABB>& primitiveBounds)
+{
+	const uint32_t numPrimitives{ static_cast<uint32_t>(primitiveBounds.size()) };
+	m_CellStarts.clear();
+	m_PrimitiveIndices.clear();
+	if (numPrimitives == 0)
+		return;
+
+	m_Bounds = GetBounds(primitiveBounds);
+	GetResolution(m_Bounds, numPrimitives, primitivesPerCell, m_Resolution);
+	const float boundsMin[3]{ m_Bounds.min.x, m_Bounds.min.y, m_Bounds.min.z };
+	const float extent[3]{ m_Bounds.max.x - boundsMin[0], m_Bounds.max.y - boundsMin[1], m_Bounds.max.z - boundsMin[2] };
+	for (int axis{}; axis < 3; ++axis)
+	{
+		m_CellSize[axis] = extent[axis] / m_Resolution[axis];
+		m_InverseCellSize[axis] = m_CellSize[axis] > 0.f ? 1.f / m_CellSize[axis] : 0.f;
+	}
+
+	// The cells a primitive's bounds overlap, grown by a thousandth of a cell so one that touches a border is in both cells.
+	// Rounding while walking the grid then can not skip the cell a primitive is hit in
+	const auto getCellRange = [&](const AABB& bounds, uint32_t first[3], uint32_t last[3])
+		{
+			const float primitiveMin[3]{ bounds.min.x, bounds.min.y, bounds.min.z };
+			const float primitiveMax[3]{ bounds.max.x, bounds.max.y, bounds.max.z };
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const float maxCell{ m_Resolution[axis] - 1.f };
+				first[axis] = static_cast<uint32_t>(std::min(std::max(0.f, (primitiveMin[axis] - boundsMin[axis]) * m_InverseCellSize[axis] - .001f), maxCell));
+				last[axis] = static_cast<uint32_t>(std::min(std::max(0.f, (primitiveMax[axis] - boundsMin[axis]) * m_InverseCellSize[axis] + .001f), maxCell));
+			}
+		};
+	const auto forEachCell = [&](const AABB& bounds, auto function)
+		{
+			uint32_t first[3]{}, last[3]{};
+			getCellRange(bounds, first, last);
+			for (uint32_t z{ first[2] }; z <= last[2]; ++z)
+			{
+				for (uint32_t y{ first[1] }; y <= last[1]; ++y)
+				{
+					for (uint32_t x{ first[0] }; x <= last[0]; ++x)
+						function(x + m_Resolution[0] * (y + m_Resolution[1] * z));
+				}
+			}
+		};
+
+	// Counting sort: every primitive counts itself in its cells, the counts summed up are where each cell starts,
+	// then every primitive writes its index to the next free place of its cells
+	const uint32_t numCells{ GetNumCells() };
+	m_PrimitiveOrder.resize(numPrimitives);
+	std::iota(m_PrimitiveOrder.begin(), m_PrimitiveOrder.end(), 0u);
+	m_CellStarts.assign(numCells + 1, 0u);
+	std::for_each(std::execution::par, m_PrimitiveOrder.begin(), m_PrimitiveOrder.end(), [&](uint32_t primitive)
+		{
+			forEachCell(primitiveBounds[primitive], [&](uint32_t cell) { std::atomic_ref<uint32_t>{ m_CellStarts[cell] }.fetch_add(1, std::memory_order_relaxed); });
+		});
+	std::exclusive_scan(m_CellStarts.begin(), m_CellStarts.end(), m_CellStarts.begin(), 0u);
+
+	m_PrimitiveIndices.resize(m_CellStarts.back());
+	m_CellCursors.assign(m_CellStarts.begin(), m_CellStarts.end() - 1);
+	std::for_each(std::execution::par, m_PrimitiveOrder.begin(), m_PrimitiveOrder.end(), [&](uint32_t primitive)
+		{
+			forEachCell(primitiveBounds[primitive], [&](uint32_t cell)
+				{
+					m_PrimitiveIndices[std::atomic_ref<uint32_t>{ m_CellCursors[cell] }.fetch_add(1, std::memory_order_relaxed)] = primitive;
+				});
+		});
+
+	// Threads fill a cell in any order, sorted so every build of the same primitives gives the same grid
+	m_CellOrder.resize(numCells);
+	std::iota(m_CellOrder.begin(), m_CellOrder.end(), 0u);
+	std::for_each(std::execution::par, m_CellOrder.begin(), m_CellOrder.end(), [&](uint32_t cell)
+		{
+			std::sort(m_PrimitiveIndices.begin() + m_CellStarts[cell], m_PrimitiveIndices.begin() + m_CellStarts[cell + 1]);
+		});
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	/**
+	 * \brief Uniform grid over the bounds of primitives, for many primitives of about the same size spread about evenly.
+	 * Every primitive is listed in each cell its bounds overlap, cells are stored x fastest as ranges of GetPrimitiveIndices.
+	 * Built in parallel by a counting sort, rays walk it front to back with a 3D-DDA (Amanatides and Woo).
+	 */
+	class UniformGrid final
+	{
+	public:
+		static constexpr uint32_t maxResolution{ 1024 }; // Per axis
+		static constexpr float primitivesPerCell{ 4.f }; // Targeted by the resolution, before counting primitives in more than one cell
+
+		UniformGrid() = default;
+		~UniformGrid() = default;
+
+		UniformGrid(const UniformGrid&) = delete;
+		UniformGrid(UniformGrid&&) noexcept = delete;
+		UniformGrid& operator=(const UniformGrid&) = delete;
+		UniformGrid& operator=(UniformGrid&&) noexcept = delete;
+
+		// Whether primitives are similar enough in size and spread evenly enough for a grid to beat a tree, from one pass over them
+		static bool IsUniform(const std::vector<AABB>& primitiveBounds);
+
+		void Build(const std::vector<AABB>& primitiveBounds);
+
+		bool IsEmpty() const { return m_CellStarts.empty(); }
+		uint32_t GetNumCells() const { return m_Resolution[0] * m_Resolution[1] * m_Resolution[2]; }
+		// Cell i lists GetPrimitiveIndices in [starts[i], starts[i + 1])
+		const std::vector<uint32_t>& GetCellStarts() const { return m_CellStarts; }
+		const std::vector<uint32_t>& GetPrimitiveIndices() const { return m_PrimitiveIndices; }
+
+		// Calls function(cell, exit) for every cell the ray passes in [ray.min, ray.max], nearest first, with the distance at which
+		// the ray leaves the cell. Stops when function returns true and returns whether it did
+		template<typename Function>
+		bool ForEachCell(const Ray& ray, Function function) const;
+
+	private:
+		AABB m_Bounds{};
+		uint32_t m_Resolution[3]{};
+		float m_CellSize[3]{};
+		float m_InverseCellSize[3]{};
+		std::vector<uint32_t> m_CellStarts{};
+		std::vector<uint32_t> m_PrimitiveIndices{};
+
+		// Build scratch, kept so rebuilding every frame does not allocate
+		std::vector<uint32_t> m_PrimitiveOrder{}; // 0 to the number of primitives, to run over them in parallel
+		std::vector<uint32_t> m_CellOrder{}; // Same for the cells
+		std::vector<uint32_t> m_CellCursors{};
+	};
+
+	template<typename Function>
+	bool UniformGrid::ForEachCell(const Ray& ray, Function function) const
+	{
+		if (IsEmpty())
+			return false;
+
+		// Clipped to the grid's bounds, a ray parallel to an axis only passes if it starts between that axis' sides
+		const float origin[3]{ ray.origin.x, ray.origin.y, ray.origin.z };
+		const float direction[3]{ ray.direction.x, ray.direction.y, ray.direction.z };
+		const float boundsMin[3]{ m_Bounds.min.x, m_Bounds.min.y, m_Bounds.min.z };
+		const float boundsMax[3]{ m_Bounds.max.x, m_Bounds.max.y, m_Bounds.max.z };
+		float enter{ ray.min }, exit{ ray.max };
+		for (int axis{}; axis < 3; ++axis)
+		{
+			if (direction[axis] == 0.f)
+			{
+				if (origin[axis] < boundsMin[axis] || origin[axis] > boundsMax[axis])
+					return false;
+				continue;
+			}
+
+			const float inverse{ 1.f / direction[axis] };
+			const float toMin{ (boundsMin[axis] - origin[axis]) * inverse };
+			const float toMax{ (boundsMax[axis] - origin[axis]) * inverse };
+			enter = std::max(enter, std::min(toMin, toMax));
+			exit = std::min(exit, std::max(toMin, toMax));
+		}
+		if (enter > exit)
+			return false;
+
+		int cell[3]{}, step[3]{}, end[3]{};
+		float next[3]{}, delta[3]{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float position{ (origin[axis] + direction[axis] * enter - boundsMin[axis]) * m_InverseCellSize[axis] };
+			const int last{ static_cast<int>(m_Resolution[axis]) - 1 };
+			cell[axis] = std::clamp(static_cast<int>(position), 0, last);
+			if (direction[axis] == 0.f)
+			{
+				next[axis] = FLT_MAX;
+				delta[axis] = FLT_MAX;
+				continue;
+			}
+
+			// Distance to the next cell border along this axis, and between two borders
+			const float inverse{ 1.f / direction[axis] };
+			const bool isPositive{ direction[axis] > 0.f };
+			step[axis] = isPositive ? 1 : -1;
+			end[axis] = isPositive ? last + 1 : -1;
+			const float border{ boundsMin[axis] + (cell[axis] + (isPositive ? 1 : 0)) * m_CellSize[axis] };
+			next[axis] = (border - origin[axis]) * inverse;
+			delta[axis] = m_CellSize[axis] * std::abs(inverse);
+		}
+
+		const uint32_t strideY{ m_Resolution[0] };
+		const uint32_t strideZ{ m_Resolution[0] * m_Resolution[1] };
+		while (true)
+		{
+			const int axis{ next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2) };
+			const uint32_t index{ cell[0] + cell[1] * strideY + cell[2] * strideZ };
+			if (function(index, std::min(next[axis], exit)))
+				return true;
+			if (next[axis] > exit)
+				return false;
+
+			cell[axis] += step[axis];
+			if (cell[axis] == end[axis])
+				return false;
+			next[axis] += delta[axis];
+		}
+	}
+}
@@ -1,7 +1,14 @@
 #pragma once
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
 #include <fstream>
+#include <immintrin.h>
+#include "CpuFeatures.h"
 #include "Maths.h"
 #include "DataTypes.h"
+#include "Sampling.h"
 
 namespace dae
 {
@@ -9,76 +16,286 @@ namespace dae
 	{
 #pragma region Sphere HitTest
 		//SPHERE HIT-TESTS
+		//Only finds the nearest t in [ray.min, ray.max], see HitTest_Sphere for the full HitRecord
+		//Numerically stable form (Ray Tracing Gems, chapter 7), the direction has to be unit length
+		inline bool Intersect_Sphere(const Sphere& sphere, const Ray& ray, float& t)
+		{
+			const Vector3 sphereToRay{ ray.origin - sphere.origin };
+
+			// Distance along the ray to the point closest to the center, spheres entirely outside [min, max] are rejected without a sqrt
+			const float projection{ -Vector3::Dot(sphereToRay, ray.direction) };
+			if (projection + sphere.radius < ray.min || projection - sphere.radius > ray.max)
+				return false;
+
+			// r^2 - (distance from the center to the ray)^2, unlike b^2 - 4ac it does not cancel out for far away spheres. Tangent rays hit
+			const Vector3 perpendicular{ sphereToRay + projection * ray.direction };
+			const float radiusSquared{ sphere.radius * sphere.radius };
+			const float discriminant{ radiusSquared - Vector3::Dot(perpendicular, perpendicular) };
+			if (discriminant < 0.f)
+				return false;
+
+			// q is the root furthest from the origin, the other one follows from their product c without subtracting close numbers
+			const float c{ Vector3::Dot(sphereToRay, sphereToRay) - radiusSquared };
+			const float q{ projection + std::copysign(std::sqrt(discriminant), projection) };
+			const float t0{ std::min(c / q, q) };
+			const float t1{ std::max(c / q, q) };
+
+			const float hitT{ t0 >= ray.min ? t0 : t1 };
+			if (!(hitT >= ray.min && hitT <= ray.max))
+				return false;
+
+			t = hitT;
+			return true;
+		}
+
+		//Nearest t in [ray.min, ray.max] over lanes [firstLane, firstLane + 4) that is closer than t, same math as Intersect_Sphere without branches per lane.
+		//Returns the lane that hit, or -1 and t unchanged
+		template<int Width>
+		inline int Intersect_SphereLanes(const SpherePacket<Width>& packet, int firstLane, const Ray& ray, float& t)
+		{
+			const __m128 toRayX{ _mm_sub_ps(_mm_set1_ps(ray.origin.x), _mm_load_ps(packet.originX + firstLane)) };
+			const __m128 toRayY{ _mm_sub_ps(_mm_set1_ps(ray.origin.y), _mm_load_ps(packet.originY + firstLane)) };
+			const __m128 toRayZ{ _mm_sub_ps(_mm_set1_ps(ray.origin.z), _mm_load_ps(packet.originZ + firstLane)) };
+			const __m128 directionX{ _mm_set1_ps(ray.direction.x) };
+			const __m128 directionY{ _mm_set1_ps(ray.direction.y) };
+			const __m128 directionZ{ _mm_set1_ps(ray.direction.z) };
+			const __m128 radiusSquared{ _mm_load_ps(packet.radiusSquared + firstLane) };
+
+			const __m128 projection{ _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, directionX), _mm_mul_ps(toRayY, directionY)),
+				_mm_mul_ps(toRayZ, directionZ))) };
+			const __m128 perpendicularX{ _mm_add_ps(toRayX, _mm_mul_ps(projection, directionX)) };
+			const __m128 perpendicularY{ _mm_add_ps(toRayY, _mm_mul_ps(projection, directionY)) };
+			const __m128 perpendicularZ{ _mm_add_ps(toRayZ, _mm_mul_ps(projection, directionZ)) };
+			const __m128 discriminant{ _mm_sub_ps(radiusSquared, _mm_add_ps(_mm_add_ps(_mm_mul_ps(perpendicularX, perpendicularX),
+				_mm_mul_ps(perpendicularY, perpendicularY)), _mm_mul_ps(perpendicularZ, perpendicularZ))) };
+
+			const __m128 c{ _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, toRayX), _mm_mul_ps(toRayY, toRayY)), _mm_mul_ps(toRayZ, toRayZ)),
+				radiusSquared) };
+			const __m128 signMask{ _mm_set1_ps(-0.f) };
+			const __m128 root{ _mm_or_ps(_mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps())), _mm_and_ps(projection, signMask)) };
+			const __m128 q{ _mm_add_ps(projection, root) };
+			const __m128 cOverQ{ _mm_div_ps(c, q) };
+			const __m128 t0{ _mm_min_ps(cOverQ, q) };
+			const __m128 t1{ _mm_max_ps(cOverQ, q) };
+
+			const __m128 rayMin{ _mm_set1_ps(ray.min) };
+			const __m128 useNear{ _mm_cmpge_ps(t0, rayMin) };
+			const __m128 candidate{ _mm_or_ps(_mm_and_ps(useNear, t0), _mm_andnot_ps(useNear, t1)) };
+			const __m128 isHit{ _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(discriminant, _mm_setzero_ps()), _mm_cmpge_ps(candidate, rayMin)),
+				_mm_and_ps(_mm_cmple_ps(candidate, _mm_set1_ps(ray.max)), _mm_cmplt_ps(candidate, _mm_set1_ps(t)))) };
+
+			int hitMask{ _mm_movemask_ps(isHit) };
+			if (hitMask == 0)
+				return -1;
+
+			alignas(16) float hitT[4];
+			_mm_store_ps(hitT, candidate);
+			int hitLane{ -1 };
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const int lane{ std::countr_zero(static_cast<unsigned int>(hitMask)) };
+				if (hitLane < 0 || hitT[lane] < hitT[hitLane])
+					hitLane = lane;
+			}
+			t = hitT[hitLane];
+			return firstLane + hitLane;
+		}
+
+		//Nearest t in [ray.min, ray.max] over all lanes that is closer than t. Returns the lane that hit, or -1 and t unchanged
+		inline int Intersect_SpherePacket(const SpherePacket<4>& packet, const Ray& ray, float& t)
+		{
+			return Intersect_SphereLanes(packet, 0, ray, t);
+		}
+
+		DAE_TARGET_AVX inline int Intersect_SpherePacket(const SpherePacket<8>& packet, const Ray& ray, float& t)
+		{
+			const __m256 toRayX{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.x), _mm256_load_ps(packet.originX)) };
+			const __m256 toRayY{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.y), _mm256_load_ps(packet.originY)) };
+			const __m256 toRayZ{ _mm256_sub_ps(_mm256_set1_ps(ray.origin.z), _mm256_load_ps(packet.originZ)) };
+			const __m256 directionX{ _mm256_set1_ps(ray.direction.x) };
+			const __m256 directionY{ _mm256_set1_ps(ray.direction.y) };
+			const __m256 directionZ{ _mm256_set1_ps(ray.direction.z) };
+			const __m256 radiusSquared{ _mm256_load_ps(packet.radiusSquared) };
+
+			const __m256 projection{ _mm256_sub_ps(_mm256_setzero_ps(), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, directionX),
+				_mm256_mul_ps(toRayY, directionY)), _mm256_mul_ps(toRayZ, directionZ))) };
+			const __m256 perpendicularX{ _mm256_add_ps(toRayX, _mm256_mul_ps(projection, directionX)) };
+			const __m256 perpendicularY{ _mm256_add_ps(toRayY, _mm256_mul_ps(projection, directionY)) };
+			const __m256 perpendicularZ{ _mm256_add_ps(toRayZ, _mm256_mul_ps(projection, directionZ)) };
+			const __m256 discriminant{ _mm256_sub_ps(radiusSquared, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(perpendicularX, perpendicularX),
+				_mm256_mul_ps(perpendicularY, perpendicularY)), _mm256_mul_ps(perpendicularZ, perpendicularZ))) };
+
+			const __m256 c{ _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(toRayX, toRayX), _mm256_mul_ps(toRayY, toRayY)),
+				_mm256_mul_ps(toRayZ, toRayZ)), radiusSquared) };
+			const __m256 signMask{ _mm256_set1_ps(-0.f) };
+			const __m256 root{ _mm256_or_ps(_mm256_sqrt_ps(_mm256_max_ps(discriminant, _mm256_setzero_ps())), _mm256_and_ps(projection, signMask)) };
+			const __m256 q{ _mm256_add_ps(projection, root) };
+			const __m256 cOverQ{ _mm256_div_ps(c, q) };
+			const __m256 t0{ _mm256_min_ps(cOverQ, q) };
+			const __m256 t1{ _mm256_max_ps(cOverQ, q) };
+
+			const __m256 rayMin{ _mm256_set1_ps(ray.min) };
+			const __m256 candidate{ _mm256_blendv_ps(t1, t0, _mm256_cmp_ps(t0, rayMin, _CMP_GE_OQ)) };
+			const __m256 isHit{ _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(candidate, rayMin, _CMP_GE_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(candidate, _mm256_set1_ps(ray.max), _CMP_LE_OQ), _mm256_cmp_ps(candidate, _mm256_set1_ps(t), _CMP_LT_OQ))) };
+
+			int hitMask{ _mm256_movemask_ps(isHit) };
+			if (hitMask == 0)
+				return -1;
+
+			alignas(32) float hitT[8];
+			_mm256_store_ps(hitT, candidate);
+			int hitLane{ -1 };
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const int lane{ std::countr_zero(static_cast<unsigned int>(hitMask)) };
+				if (hitLane < 0 || hitT[lane] < hitT[hitLane])
+					hitLane = lane;
+			}
+			t = hitT[hitLane];
+			return hitLane;
+		}
+
+		//Lanes of the second packet in the upper half
+		DAE_TARGET_AVX512 inline __m512 LoadSpherePackets(const float* pFirst, const float* pSecond)
+		{
+			return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(_mm256_load_ps(pFirst))),
+				_mm256_castps_pd(_mm256_load_ps(pSecond)), 1));
+		}
+
+		//Intersect_SphereLanes on sixteen lanes that each pair a sphere with a ray, given as the ray origin minus the sphere center. Every AVX-512 kernel
+		//intersects spheres through here, so traced and rasterized rays round the same. Returns the lanes that hit closer than limit, with their t in candidate
+		DAE_TARGET_AVX512 DAE_FORCE_INLINE __mmask16 Intersect_SphereLanes16(__m512 toRayX, __m512 toRayY, __m512 toRayZ, __m512 directionX, __m512 directionY,
+			__m512 directionZ, __m512 radiusSquared, __m512 rayMin, __m512 rayMax, __m512 limit, __m512& candidate)
+		{
+			const __m512 projection{ _mm512_sub_ps(_mm512_setzero_ps(), _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(toRayX, directionX),
+				_mm512_mul_ps(toRayY, directionY)), _mm512_mul_ps(toRayZ, directionZ))) };
+			const __m512 perpendicularX{ _mm512_add_ps(toRayX, _mm512_mul_ps(projection, directionX)) };
+			const __m512 perpendicularY{ _mm512_add_ps(toRayY, _mm512_mul_ps(projection, directionY)) };
+			const __m512 perpendicularZ{ _mm512_add_ps(toRayZ, _mm512_mul_ps(projection, directionZ)) };
+			const __m512 discriminant{ _mm512_sub_ps(radiusSquared, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(perpendicularX, perpendicularX),
+				_mm512_mul_ps(perpendicularY, perpendicularY)), _mm512_mul_ps(perpendicularZ, perpendicularZ))) };
+
+			const __m512 c{ _mm512_sub_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(toRayX, toRayX), _mm512_mul_ps(toRayY, toRayY)),
+				_mm512_mul_ps(toRayZ, toRayZ)), radiusSquared) };
+			const __m512i signMask{ _mm512_set1_epi32(static_cast<int>(0x80000000u)) };
+			const __m512 root{ _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(_mm512_sqrt_ps(_mm512_max_ps(discriminant, _mm512_setzero_ps()))),
+				_mm512_and_si512(_mm512_castps_si512(projection), signMask))) };
+			const __m512 q{ _mm512_add_ps(projection, root) };
+			const __m512 cOverQ{ _mm512_div_ps(c, q) };
+			const __m512 t0{ _mm512_min_ps(cOverQ, q) };
+			const __m512 t1{ _mm512_max_ps(cOverQ, q) };
+
+			candidate = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(t0, rayMin, _CMP_GE_OQ), t1, t0);
+			return static_cast<__mmask16>(_mm512_cmp_ps_mask(discriminant, _mm512_setzero_ps(), _CMP_GE_OQ)
+				& _mm512_cmp_ps_mask(candidate, rayMin, _CMP_GE_OQ) & _mm512_cmp_ps_mask(candidate, rayMax, _CMP_LE_OQ)
+				& _mm512_cmp_ps_mask(candidate, limit, _CMP_LT_OQ));
+		}
+
+		//Both packets as one 16 lane packet, returns the lane that hit with the lanes of second after those of first
+		DAE_TARGET_AVX512 inline int Intersect_SpherePackets(const SpherePacket<8>& first, const SpherePacket<8>& second, const Ray& ray, float& t)
+		{
+			const __m512 toRayX{ _mm512_sub_ps(_mm512_set1_ps(ray.origin.x), LoadSpherePackets(first.originX, second.originX)) };
+			const __m512 toRayY{ _mm512_sub_ps(_mm512_set1_ps(ray.origin.y), LoadSpherePackets(first.originY, second.originY)) };
+			const __m512 toRayZ{ _mm512_sub_ps(_mm512_set1_ps(ray.origin.z), LoadSpherePackets(first.originZ, second.originZ)) };
+			__m512 candidate{};
+			unsigned int hitMask{ Intersect_SphereLanes16(toRayX, toRayY, toRayZ, _mm512_set1_ps(ray.direction.x), _mm512_set1_ps(ray.direction.y),
+				_mm512_set1_ps(ray.direction.z), LoadSpherePackets(first.radiusSquared, second.radiusSquared), _mm512_set1_ps(ray.min),
+				_mm512_set1_ps(ray.max), _mm512_set1_ps(t), candidate) };
+			if (hitMask == 0)
+				return -1;
+
+			alignas(64) float hitT[16];
+			_mm512_store_ps(hitT, candidate);
+			int hitLane{ -1 };
+			for (; hitMask != 0; hitMask &= hitMask - 1)
+			{
+				const int lane{ std::countr_zero(hitMask) };
+				if (hitLane < 0 || hitT[lane] < hitT[hitLane])
+					hitLane = lane;
+			}
+			t = hitT[hitLane];
+			return hitLane;
+		}
+
+		template<int Width>
+		inline bool HitTest_SpherePacket(const SpherePacket<Width>& packet, const Ray& ray)
+		{
+			float t{ FLT_MAX };
+			return Intersect_SpherePacket(packet, ray, t) >= 0;
+		}
+
+		inline void FillHitRecord_Sphere(const Sphere& sphere, const Ray& ray, float t, HitRecord& hitRecord)
+		{
+			hitRecord.t = t;
+			hitRecord.origin = ray.origin + (t * ray.direction);
+			hitRecord.normal = hitRecord.origin - sphere.origin;
+			hitRecord.normal.Normalize();
+			hitRecord.materialIndex = sphere.materialIndex;
+			hitRecord.didHit = true;
+		}
+
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
-			 hitRecord.didHit = false;
-			 // if like seen in w01 slides, we replace the point in the definition of a sphere w the def of ray
-			 // We get a quad function!!		ax^2+bx+c = 0
-			 
-			 // We calculate A B and C
-			 float A{ Vector3::Dot(ray.direction,ray.direction)};
-			 float B{ Vector3::Dot(	2 * (ray.direction)	,  (ray.origin - sphere.origin) )};
-			 float C{ Vector3::Dot(	(ray.origin - sphere.origin) ,  ray.origin - sphere.origin) - (sphere.radius * sphere.radius)	};
-			 
-			 // We calculate the DISCRIMINANT, this tells us where the ray is vs the sphere
-			 float discriminant{ (B*B) - (4 * A * C)};
-			 
-			 hitRecord.didHit = discriminant > 0;
-			 // RETURNS BASED ON DISC
-			 if (!ignoreHitRecord&&hitRecord.didHit)
-			 {
-			 	// hitRecord implement
-			 	hitRecord.t = ((-B - sqrt(discriminant)) / (2 * A));
-			 	if (hitRecord.t < ray.min)
-			 	{
-			 		hitRecord.t = ((-B + sqrt(discriminant)) / (2 * A));
-			 	}	
-			 
-			 	hitRecord.origin = ray.origin + (hitRecord.t * ray.direction);
-			 
-			 	hitRecord.normal = hitRecord.origin - sphere.origin;
-				hitRecord.normal.Normalize();
-			 	hitRecord.materialIndex = sphere.materialIndex;
-			 	
-			 	// RETURN
-				hitRecord.didHit = true;
-			 }
-			 return hitRecord.didHit;
+			float t{};
+			if (!Intersect_Sphere(sphere, ray, t))
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
 
+			if (!ignoreHitRecord)
+				FillHitRecord_Sphere(sphere, ray, t, hitRecord);
+			return true;
 		}
 
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Sphere(sphere, ray, temp, true);
+			float t{};
+			return Intersect_Sphere(sphere, ray, t);
 		}
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS
+		inline bool Intersect_Plane(const Plane& plane, const Ray& ray, float& t)
+		{
+			const float hitT{ (Vector3::Dot((plane.origin - ray.origin), plane.normal)) / (Vector3::Dot(ray.direction, plane.normal)) };
+
+			//Also rejects NaN from rays parallel to the plane
+			if (!(hitT >= ray.min && hitT <= ray.max))
+				return false;
+
+			t = hitT;
+			return true;
+		}
+
+		inline void FillHitRecord_Plane(const Plane& plane, const Ray& ray, float t, HitRecord& hitRecord)
+		{
+			hitRecord.t = t;
+			hitRecord.origin = ray.origin + (t * ray.direction);
+			hitRecord.normal = plane.normal;
+			hitRecord.materialIndex = plane.materialIndex;
+			hitRecord.didHit = true;
+		}
+
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
-			hitRecord.t = (dae::Vector3::Dot((plane.origin - ray.origin), plane.normal)) / (dae::Vector3::Dot(ray.direction, plane.normal));
-			hitRecord.didHit = (hitRecord.t < ray.max && hitRecord.t > ray.min);
-			 
-			 //if (hitRecord.t < ray.min) hitRecord.t = FLT_MAX;
-			 
-			 if ((hitRecord.t >= ray.min) && (hitRecord.t <= ray.max))
-			 {	
-			 	hitRecord.origin = ray.origin + (hitRecord.t * ray.direction);
-				hitRecord.normal = plane.normal;
-			 	hitRecord.materialIndex = plane.materialIndex;
-			 
-			 	hitRecord.didHit = true;
-			 	return hitRecord.didHit;
-			 }
-			 hitRecord.didHit=false;
-			 return hitRecord.didHit;
+			float t{};
+			if (!Intersect_Plane(plane, ray, t))
+			{
+				hitRecord.didHit = false;
+				return false;
+			}
+
+			if (!ignoreHitRecord)
+				FillHitRecord_Plane(plane, ray, t, hitRecord);
+			return true;
 		}
 
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
-			return HitTest_Plane(plane, ray, temp, true);
+			float t{};
+			return Intersect_Plane(plane, ray, t);
 		}
 #pragma endregion
 #pragma region Triangle HitTest
@@ -114,19 +331,32 @@ namespace dae
 
 	namespace LightUtils
 	{
-		//Direction from target to light
+		inline bool IsAreaLight(const Light& light)
+		{
+			return light.type == LightType::SphereArea || light.type == LightType::RectArea;
+		}
+
+		inline float GetArea(const Light& light)
+		{
+			if (light.type == LightType::SphereArea)
+				return PI_4 * light.radius * light.radius;
+			if (light.type == LightType::RectArea)
+				return 4.f * Vector3::Cross(light.edgeU, light.edgeV).Magnitude();
+			return 0.f;
+		}
+
+		//Direction from target to light, as long as the distance to positional lights and of unit length for directional ones
 		inline Vector3 GetDirectionToLight(const Light& light, const Vector3 origin)
 		{
-			if (light.type == LightType::Point)
+			if (light.type == LightType::Point || IsAreaLight(light))
 			{
+				// Area lights act as a point light at their center outside of path tracing
 				return Vector3{ light.origin - origin };
 			}
 			else if (light.type == LightType::Directional)
 			{
-				// TODO !  ADD FUNCTIONALITY FOR DIRECTIONAL LIGHT
-				Vector3 directionalLight = light.direction;
-				directionalLight.Normalize();
-				return directionalLight;
+				// Infinitely far away, every point sees the light along its direction
+				return light.direction.Normalized();
 			}
 			else return {};
 		}
@@ -139,11 +369,134 @@ namespace dae
 				float radius{ radiusVect.Magnitude() };
 				return (light.color * (light.intensity / (radius * radius)));
 			}
+			else if (light.type == LightType::SphereArea)
+			{
+				// Far field approximation, the projected disk seen from target
+				const float sqrDistance{ (light.origin - target).SqrMagnitude() };
+				return light.color * (light.intensity * PI * light.radius * light.radius / sqrDistance);
+			}
+			else if (light.type == LightType::RectArea)
+			{
+				const Vector3 toTarget{ target - light.origin };
+				const float sqrDistance{ toTarget.SqrMagnitude() };
+				const float cosLight{ std::max(Vector3::Dot(light.direction, toTarget) / std::sqrt(sqrDistance), 0.f) };
+				return light.color * (light.intensity * GetArea(light) * cosLight / sqrDistance);
+			}
 			else
 			{
 				return light.color * light.intensity;
 			}
 		}
+
+		//Incoming light at target from one sampled point of the light, pdf in solid angle (1 for point and directional lights)
+		struct LightSample
+		{
+			Vector3 direction{};
+			float distance{};
+			ColorRGB radiance{};
+			float pdf{};
+			bool isDelta{};
+		};
+
+		inline bool SampleLight(const Light& light, const Vector3& target, const Sample2D& sample, LightSample& lightSample)
+		{
+			switch (light.type)
+			{
+			case LightType::Point:
+			case LightType::Directional:
+			{
+				lightSample.direction = GetDirectionToLight(light, target);
+				lightSample.distance = light.type == LightType::Point ? lightSample.direction.Normalize() : FLT_MAX;
+				if (light.type == LightType::Directional)
+					lightSample.direction.Normalize();
+				lightSample.radiance = GetRadiance(light, target);
+				lightSample.pdf = 1.f;
+				lightSample.isDelta = true;
+				return true;
+			}
+			case LightType::SphereArea:
+			{
+				// Uniform over the cone of directions the sphere covers
+				Vector3 toCenter{ light.origin - target };
+				const float sqrDistance{ toCenter.SqrMagnitude() };
+				const float sqrRadius{ light.radius * light.radius };
+				if (sqrDistance <= sqrRadius)
+					return false;
+
+				toCenter /= std::sqrt(sqrDistance);
+				const float cosThetaMax{ std::sqrt(1.f - sqrRadius / sqrDistance) };
+				lightSample.direction = Sampling::UniformSampleCone(toCenter, cosThetaMax, sample);
+
+				const Vector3 fromCenter{ target - light.origin };
+				const float b{ Vector3::Dot(lightSample.direction, fromCenter) };
+				const float discriminant{ std::max(b * b - (sqrDistance - sqrRadius), 0.f) };
+				lightSample.distance = -b - std::sqrt(discriminant);
+				lightSample.radiance = light.color * light.intensity;
+				lightSample.pdf = 1.f / (PI_2 * (1.f - cosThetaMax));
+				lightSample.isDelta = false;
+				return lightSample.distance > 0.f;
+			}
+			case LightType::RectArea:
+			{
+				const Vector3 point{ light.origin + light.edgeU * (2.f * sample.u - 1.f) + light.edgeV * (2.f * sample.v - 1.f) };
+				lightSample.direction = point - target;
+				lightSample.distance = lightSample.direction.Normalize();
+
+				const float cosLight{ -Vector3::Dot(light.direction, lightSample.direction) };
+				if (cosLight <= 0.f)
+					return false;
+
+				lightSample.radiance = light.color * light.intensity;
+				lightSample.pdf = lightSample.distance * lightSample.distance / (GetArea(light) * cosLight);
+				lightSample.isDelta = false;
+				return true;
+			}
+			}
+			return false;
+		}
+
+		//Only the emitting side of a rectangle light is hit
+		inline bool IntersectAreaLight(const Light& light, const Ray& ray, float& t)
+		{
+			if (light.type == LightType::SphereArea)
+				return GeometryUtils::Intersect_Sphere(Sphere{ light.origin, light.radius }, ray, t);
+
+			if (light.type == LightType::RectArea)
+			{
+				const float cosLight{ Vector3::Dot(ray.direction, light.direction) };
+				if (cosLight >= 0.f)
+					return false;
+
+				t = Vector3::Dot(light.origin - ray.origin, light.direction) / cosLight;
+				if (!(t >= ray.min && t <= ray.max))
+					return false;
+
+				const Vector3 local{ ray.origin + ray.direction * t - light.origin };
+				return std::abs(Vector3::Dot(local, light.edgeU)) <= light.edgeU.SqrMagnitude()
+					&& std::abs(Vector3::Dot(local, light.edgeV)) <= light.edgeV.SqrMagnitude();
+			}
+			return false;
+		}
+
+		//Solid angle pdf with which SampleLight picks direction from target, when that direction reaches the light at t
+		inline float GetLightPdf(const Light& light, const Vector3& target, const Vector3& direction, float t)
+		{
+			if (light.type == LightType::SphereArea)
+			{
+				const float sqrDistance{ (light.origin - target).SqrMagnitude() };
+				const float sqrRadius{ light.radius * light.radius };
+				if (sqrDistance <= sqrRadius)
+					return 0.f;
+				return 1.f / (PI_2 * (1.f - std::sqrt(1.f - sqrRadius / sqrDistance)));
+			}
+
+			if (light.type == LightType::RectArea)
+			{
+				const float cosLight{ -Vector3::Dot(light.direction, direction) };
+				return cosLight > 0.f ? t * t / (GetArea(light) * cosLight) : 0.f;
+			}
+			return 0.f;
+		}
 	}
 
 	namespace Utils
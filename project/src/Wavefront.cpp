@@ -0,0 +1,298 @@
+#include "Wavefront.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+#include "Material.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+using namespace dae;
+
+const std::vector<ColorRGB>& WavefrontPipeline::Render(Scene* pScene, const Renderer& renderer, const Tile& tile, uint32_t& secondaryRayCount)
+{
+	const uint32_t numPixels{ static_cast<uint32_t>(tile.width * tile.height) };
+	m_Colors.assign(numPixels, {});
+
+	m_NumLights = static_cast<uint32_t>(pScene->GetLights().size());
+	m_NumMaterials = static_cast<uint32_t>(pScene->GetMaterials().size());
+
+	const int maxBounces{ renderer.AreReflectionsEnabled() ? renderer.GetMaxBounces() : 0 };
+
+	for (uint32_t firstPixel{}; firstPixel < numPixels; firstPixel += m_WaveSize)
+	{
+		GeneratePrimaryRays(pScene, renderer, tile, firstPixel, std::min(m_WaveSize, numPixels - firstPixel));
+
+		for (int depth{}; m_NumRays > 0; ++depth)
+		{
+			const bool spawnSecondaryRays{ depth < maxBounces };
+
+			ExtendRays(pScene);
+			ShadeHits(pScene, renderer, spawnSecondaryRays);
+			if (renderer.AreShadowsEnabled())
+				TraceShadowRays(pScene, renderer);
+			AccumulateRadiance();
+
+			if (!spawnSecondaryRays)
+				break;
+
+			m_NumRays = CompactSecondaryRays();
+			secondaryRayCount += m_NumRays;
+		}
+	}
+
+	std::for_each(std::execution::par, m_Colors.begin(), m_Colors.end(), [](ColorRGB& color) { color.MaxToOne(); });
+	return m_Colors;
+}
+
+void WavefrontPipeline::GeneratePrimaryRays(Scene* pScene, const Renderer& renderer, const Tile& tile, uint32_t firstPixel, uint32_t numPixels)
+{
+	Camera& camera = pScene->GetCamera();
+	const Matrix cameraToWorld = camera.CalculateCameraToWorld();
+
+	m_NumRays = numPixels;
+	m_Rays.Resize(m_NumRays);
+
+	ParallelFor(m_NumRays, m_RangeSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t rayIndex{ begin }; rayIndex < end; ++rayIndex)
+			{
+				const uint32_t pixelIndex{ firstPixel + rayIndex };
+				const int px{ tile.x + static_cast<int>(pixelIndex % tile.width) };
+				const int py{ tile.y + static_cast<int>(pixelIndex / tile.width) };
+
+				const Ray viewRay{ camera.origin, renderer.GetViewDirection(camera, cameraToWorld, px + 0.5f, py + 0.5f) };
+				m_Rays.Set(rayIndex, viewRay, colors::White, pixelIndex);
+			}
+		});
+}
+
+void WavefrontPipeline::ExtendRays(const Scene* pScene)
+{
+	m_HitOrigins.Resize(m_NumRays);
+	m_HitNormals.Resize(m_NumRays);
+	m_HitMaterials.resize(m_NumRays);
+
+	ParallelFor(m_NumRays, m_RangeSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t rayIndex{ begin }; rayIndex < end; ++rayIndex)
+			{
+				const Ray ray{ m_Rays.GetRay(rayIndex) };
+
+				Intersection intersection{};
+				if (!pScene->GetClosestIntersection(ray, intersection))
+				{
+					m_HitMaterials[rayIndex] = m_NumMaterials;
+					continue;
+				}
+
+				HitRecord hitRecord{};
+				pScene->FillHitRecord(ray, intersection, hitRecord);
+
+				m_HitOrigins.Set(rayIndex, hitRecord.origin);
+				m_HitNormals.Set(rayIndex, hitRecord.normal.Normalized());
+				m_HitMaterials[rayIndex] = hitRecord.materialIndex;
+			}
+		});
+}
+
+void WavefrontPipeline::ShadeHits(const Scene* pScene, const Renderer& renderer, bool spawnSecondaryRays)
+{
+	const auto& materials = pScene->GetMaterials();
+	const auto& lights = pScene->GetLights();
+	const Renderer::LightingMode lightingMode{ renderer.GetLightingMode() };
+	const float throughputThreshold{ renderer.GetThroughputThreshold() };
+
+	const size_t numShadowRays{ static_cast<size_t>(m_NumRays) * m_NumLights };
+	m_ShadowOrigins.Resize(numShadowRays);
+	m_ShadowDirections.Resize(numShadowRays);
+	m_ShadowDistances.resize(numShadowRays);
+	m_LightContributions.Resize(numShadowRays);
+	m_ShadowFactors.assign(numShadowRays, 1.f);
+
+	if (spawnSecondaryRays)
+	{
+		m_SecondaryRays.Resize(m_NumRays * 2);
+		m_SecondaryRayInvalid.assign(m_NumRays * 2, 1);
+	}
+
+	// Hits are grouped per material so every batch runs the same shading code on coherent data
+	const uint32_t numHits{ SortIndicesByKey(m_HitMaterials, m_NumRays, m_NumMaterials) };
+
+	ParallelFor(numHits, m_RangeSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t orderIndex{ begin }; orderIndex < end; ++orderIndex)
+			{
+				const uint32_t rayIndex{ m_Order[orderIndex] };
+
+				HitRecord hitRecord{};
+				hitRecord.origin = m_HitOrigins.Get(rayIndex);
+				hitRecord.normal = m_HitNormals.Get(rayIndex);
+				hitRecord.didHit = true;
+				hitRecord.materialIndex = static_cast<unsigned char>(m_HitMaterials[rayIndex]);
+
+				Material* pMaterial{ materials[hitRecord.materialIndex] };
+				const Vector3 viewDirection{ m_Rays.directions.Get(rayIndex) };
+
+				for (uint32_t lightIndex{}; lightIndex < m_NumLights; ++lightIndex)
+				{
+					const size_t shadowIndex{ static_cast<size_t>(rayIndex) * m_NumLights + lightIndex };
+					const Ray lightRay{ Renderer::GetLightRay(hitRecord, lights[lightIndex]) };
+
+					m_ShadowOrigins.Set(shadowIndex, lightRay.origin);
+					m_ShadowDirections.Set(shadowIndex, lightRay.direction);
+					m_ShadowDistances[shadowIndex] = lightRay.max;
+					m_LightContributions.Set(shadowIndex,
+						Renderer::ShadeLight(lightingMode, pMaterial, hitRecord, lights[lightIndex], lightRay.direction, viewDirection));
+				}
+
+				if (!spawnSecondaryRays)
+					continue;
+
+				const SpecularScatter scatter{ pMaterial->GetSpecularScatter(hitRecord, viewDirection) };
+
+				SecondaryRay secondaryRays[2];
+				const int numSecondaryRays{ Renderer::ScatterSpecular(hitRecord, viewDirection, scatter,
+					m_Rays.throughputs.Get(rayIndex), throughputThreshold, secondaryRays) };
+
+				for (int index{}; index < numSecondaryRays; ++index)
+				{
+					const uint32_t slot{ rayIndex * 2 + index };
+					m_SecondaryRays.Set(slot, secondaryRays[index].ray, secondaryRays[index].throughput, m_Rays.pixelIndices[rayIndex]);
+					m_SecondaryRayInvalid[slot] = 0;
+				}
+			}
+		});
+}
+
+void WavefrontPipeline::TraceShadowRays(const Scene* pScene, const Renderer& renderer)
+{
+	ParallelFor(m_NumRays * m_NumLights, m_RangeSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t shadowIndex{ begin }; shadowIndex < end; ++shadowIndex)
+			{
+				if (m_HitMaterials[shadowIndex / m_NumLights] == m_NumMaterials)
+					continue;
+
+				Ray lightRay{ m_ShadowOrigins.Get(shadowIndex), m_ShadowDirections.Get(shadowIndex) };
+				lightRay.max = m_ShadowDistances[shadowIndex];
+
+				m_ShadowFactors[shadowIndex] = renderer.GetShadowFactor(pScene, lightRay, shadowIndex % m_NumLights, m_HitNormals.Get(shadowIndex / m_NumLights));
+			}
+		});
+}
+
+void WavefrontPipeline::AccumulateRadiance()
+{
+	// Rays of one pixel are adjacent in the queue, range borders are moved so every pixel is owned by a single range
+	const auto findPixelStart = [this](uint32_t rayIndex)
+		{
+			while (rayIndex > 0 && rayIndex < m_NumRays && m_Rays.pixelIndices[rayIndex] == m_Rays.pixelIndices[rayIndex - 1])
+				++rayIndex;
+			return std::min(rayIndex, m_NumRays);
+		};
+
+	// Same order as the per pixel path, a shadow darkens everything accumulated before it
+	m_Radiances.Resize(m_NumRays);
+	const RadianceStreams streams{
+		{ m_LightContributions.r.data(), m_LightContributions.g.data(), m_LightContributions.b.data() }, m_ShadowFactors.data(), m_NumLights,
+		{ m_Rays.throughputs.r.data(), m_Rays.throughputs.g.data(), m_Rays.throughputs.b.data() },
+		{ m_Radiances.r.data(), m_Radiances.g.data(), m_Radiances.b.data() } };
+
+	ParallelFor(m_NumRays, m_ChunkSize, [&](uint32_t begin, uint32_t end)
+		{
+			const uint32_t pixelBegin{ findPixelStart(begin) };
+			const uint32_t pixelEnd{ findPixelStart(end) };
+			if (pixelBegin >= pixelEnd)
+				return;
+
+			// Missed rays are resolved too, computing them costs less than skipping them in the vector kernels
+			m_pKernels->resolveRadiance(streams, pixelBegin, pixelEnd);
+
+			for (uint32_t rayIndex{ pixelBegin }; rayIndex < pixelEnd; ++rayIndex)
+			{
+				if (m_HitMaterials[rayIndex] != m_NumMaterials)
+					m_Colors[m_Rays.pixelIndices[rayIndex]] += m_Radiances.Get(rayIndex);
+			}
+		});
+}
+
+uint32_t WavefrontPipeline::CompactSecondaryRays()
+{
+	// Stable, so the queue stays sorted on pixel index
+	const uint32_t numRays{ SortIndicesByKey(m_SecondaryRayInvalid, m_NumRays * 2, 1) };
+	m_Rays.Resize(numRays);
+
+	ParallelFor(numRays, m_RangeSize, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t rayIndex{ begin }; rayIndex < end; ++rayIndex)
+			{
+				const uint32_t slot{ m_Order[rayIndex] };
+				m_Rays.Set(rayIndex, m_SecondaryRays.GetRay(slot), m_SecondaryRays.throughputs.Get(slot), m_SecondaryRays.pixelIndices[slot]);
+			}
+		});
+
+	return numRays;
+}
+
+uint32_t WavefrontPipeline::SortIndicesByKey(const std::vector<uint32_t>& keys, uint32_t count, uint32_t numKeys)
+{
+	const uint32_t numChunks{ (count + m_ChunkSize - 1) / m_ChunkSize };
+	m_ChunkCounts.assign(static_cast<size_t>(numChunks) * numKeys, 0);
+
+	ParallelFor(count, m_ChunkSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t* pCounts{ m_ChunkCounts.data() + static_cast<size_t>(begin / m_ChunkSize) * numKeys };
+			for (uint32_t index{ begin }; index < end; ++index)
+			{
+				if (keys[index] < numKeys)
+					++pCounts[keys[index]];
+			}
+		});
+
+	// Exclusive prefix sum, key major so equal keys keep their input order
+	uint32_t total{};
+	for (uint32_t key{}; key < numKeys; ++key)
+	{
+		for (uint32_t chunk{}; chunk < numChunks; ++chunk)
+		{
+			uint32_t& chunkCount{ m_ChunkCounts[static_cast<size_t>(chunk) * numKeys + key] };
+			const uint32_t keyCount{ chunkCount };
+			chunkCount = total;
+			total += keyCount;
+		}
+	}
+
+	if (m_Order.size() < total)
+		m_Order.resize(total);
+
+	ParallelFor(count, m_ChunkSize, [&](uint32_t begin, uint32_t end)
+		{
+			uint32_t* pOffsets{ m_ChunkCounts.data() + static_cast<size_t>(begin / m_ChunkSize) * numKeys };
+			for (uint32_t index{ begin }; index < end; ++index)
+			{
+				if (keys[index] < numKeys)
+					m_Order[pOffsets[keys[index]]++] = index;
+			}
+		});
+
+	return total;
+}
+
+template<typename Function>
+void WavefrontPipeline::ParallelFor(uint32_t count, uint32_t rangeSize, const Function& function)
+{
+	// Work is handed out in ranges, per element tasks would cost more than most stages do per element
+	const uint32_t numRanges{ (count + rangeSize - 1) / rangeSize };
+	if (m_RangeIndices.size() < numRanges)
+	{
+		m_RangeIndices.resize(numRanges);
+		std::iota(m_RangeIndices.begin(), m_RangeIndices.end(), 0u);
+	}
+
+	std::for_each(std::execution::par, m_RangeIndices.begin(), m_RangeIndices.begin() + numRanges, [&](uint32_t range)
+		{
+			function(range * rangeSize, std::min(count, (range + 1) * rangeSize));
+		});
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Kernels.h"
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+
+	// Structure of arrays streams, every stage only touches the components it needs
+	struct Vector3Stream
+	{
+		std::vector<float> x{};
+		std::vector<float> y{};
+		std::vector<float> z{};
+
+		void Resize(size_t size)
+		{
+			x.resize(size);
+			y.resize(size);
+			z.resize(size);
+		}
+
+		Vector3 Get(size_t index) const { return { x[index], y[index], z[index] }; }
+		void Set(size_t index, const Vector3& v)
+		{
+			x[index] = v.x;
+			y[index] = v.y;
+			z[index] = v.z;
+		}
+	};
+
+	struct ColorStream
+	{
+		std::vector<float> r{};
+		std::vector<float> g{};
+		std::vector<float> b{};
+
+		void Resize(size_t size)
+		{
+			r.resize(size);
+			g.resize(size);
+			b.resize(size);
+		}
+
+		ColorRGB Get(size_t index) const { return { r[index], g[index], b[index] }; }
+		void Set(size_t index, const ColorRGB& c)
+		{
+			r[index] = c.r;
+			g[index] = c.g;
+			b[index] = c.b;
+		}
+	};
+
+	struct RayQueue
+	{
+		Vector3Stream origins{};
+		Vector3Stream directions{};
+		ColorStream throughputs{};
+		std::vector<uint32_t> pixelIndices{}; // Relative to the tile, the queue stays sorted on it
+
+		void Resize(size_t size)
+		{
+			origins.Resize(size);
+			directions.Resize(size);
+			throughputs.Resize(size);
+			pixelIndices.resize(size);
+		}
+
+		Ray GetRay(size_t index) const { return { origins.Get(index), directions.Get(index) }; }
+		void Set(size_t index, const Ray& ray, const ColorRGB& throughput, uint32_t pixelIndex)
+		{
+			origins.Set(index, ray.origin);
+			directions.Set(index, ray.direction);
+			throughputs.Set(index, throughput);
+			pixelIndices[index] = pixelIndex;
+		}
+	};
+
+	/**
+	 * \brief Renders tiles breadth first: all rays of a bounce go through ray generation, extension (closest hit),
+	 * shading grouped per material, shadow connection and compaction as separate parallel stages.
+	 * Produces the same image as the per pixel path of the Renderer, only the order of work differs.
+	 */
+	class WavefrontPipeline final
+	{
+	public:
+		WavefrontPipeline() = default;
+		~WavefrontPipeline() = default;
+
+		WavefrontPipeline(const WavefrontPipeline&) = delete;
+		WavefrontPipeline(WavefrontPipeline&&) noexcept = delete;
+		WavefrontPipeline& operator=(const WavefrontPipeline&) = delete;
+		WavefrontPipeline& operator=(WavefrontPipeline&&) noexcept = delete;
+
+		// Returns the tile's colors row by row, valid until the next call
+		const std::vector<ColorRGB>& Render(Scene* pScene, const Renderer& renderer, const Tile& tile, uint32_t& secondaryRayCount);
+
+	private:
+		// Primary rays are generated for this many pixels at a time to bound the size of the queues
+		static constexpr uint32_t m_WaveSize{ 1 << 16 };
+		// Elements per parallel task, larger for the sort and accumulation stages that do little per element
+		static constexpr uint32_t m_RangeSize{ 256 };
+		static constexpr uint32_t m_ChunkSize{ 4096 };
+
+		void GeneratePrimaryRays(Scene* pScene, const Renderer& renderer, const Tile& tile, uint32_t firstPixel, uint32_t numPixels);
+		void ExtendRays(const Scene* pScene);
+		void ShadeHits(const Scene* pScene, const Renderer& renderer, bool spawnSecondaryRays);
+		void TraceShadowRays(const Scene* pScene, const Renderer& renderer);
+		void AccumulateRadiance();
+		uint32_t CompactSecondaryRays();
+
+		// Stable parallel counting sort, fills m_Order with the indices of all keys below numKeys grouped per key
+		uint32_t SortIndicesByKey(const std::vector<uint32_t>& keys, uint32_t count, uint32_t numKeys);
+		template<typename Function>
+		void ParallelFor(uint32_t count, uint32_t rangeSize, const Function& function); // Calls function(begin, end) per range
+
+		const KernelTable* m_pKernels{ &GetKernels() };
+
+		std::vector<ColorRGB> m_Colors{};
+
+		RayQueue m_Rays{};
+		uint32_t m_NumRays{};
+
+		// Extension results, one per ray
+		Vector3Stream m_HitOrigins{};
+		Vector3Stream m_HitNormals{};
+		std::vector<uint32_t> m_HitMaterials{}; // Number of materials when the ray missed
+		uint32_t m_NumMaterials{};
+
+		// Shading results, one shadow ray per ray and light
+		Vector3Stream m_ShadowOrigins{};
+		Vector3Stream m_ShadowDirections{};
+		std::vector<float> m_ShadowDistances{};
+		ColorStream m_LightContributions{};
+		std::vector<float> m_ShadowFactors{}; // What each light is scaled by, see Renderer::GetShadowFactor
+		uint32_t m_NumLights{};
+		ColorStream m_Radiances{}; // One per ray, what it adds to its pixel
+
+		// Up to two secondary rays per ray, compacted into m_Rays after shading
+		RayQueue m_SecondaryRays{};
+		std::vector<uint32_t> m_SecondaryRayInvalid{}; // 1 while the slot is empty. A sort key, compaction drops the slots of key 1
+
+		std::vector<uint32_t> m_Order{};
+		std::vector<uint32_t> m_ChunkCounts{};
+		std::vector<uint32_t> m_RangeIndices{};
+	};
+}
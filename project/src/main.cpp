@@ -7,12 +7,22 @@
 #undef main
 
 //Standard includes
+#include <charconv>
+#include <functional>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 //Project includes
 #include "Timer.h"
+#include "CpuFeatures.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "BatchRenderer.h"
+#include "CameraPath.h"
+#include "DistributedRenderer.h"
+#include "LightVisibilityCache.h"
+#include "RenderThread.h"
 
 using namespace dae;
 
@@ -22,18 +32,174 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
-int main(int argc, char* args[])
+// Parses all of value, false when anything is left over or it does not fit number
+template<typename T>
+bool ParseNumber(std::string_view value, T& number)
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	const char* pEnd{ value.data() + value.size() };
+	const auto [pParsed, error] { std::from_chars(value.data(), pEnd, number) };
+	return error == std::errc{} && pParsed == pEnd;
+}
 
-	//Create window + surfaces
-	SDL_Init(SDL_INIT_VIDEO);
+// Parses "<a><separator><b>", e.g. "0-120" or "2/8"
+bool ParseIntPair(const std::string& value, char separator, int& a, int& b)
+{
+	const size_t separatorPos{ value.find(separator, 1) };
+	if (separatorPos == std::string::npos)
+		return false;
+
+	const std::string_view view{ value };
+	return ParseNumber(view.substr(0, separatorPos), a) && ParseNumber(view.substr(separatorPos + 1), b);
+}
+
+// Returns the value following option on the command line, or an empty string
+std::string GetOptionValue(int argc, char* args[], const std::string& option)
+{
+	for (int i{ 1 }; i + 1 < argc; ++i)
+	{
+		if (option == args[i])
+			return args[i + 1];
+	}
+	return {};
+}
+
+// Whether option is anywhere on the command line
+bool HasOption(int argc, char* args[], const std::string& option)
+{
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		if (option == args[i])
+			return true;
+	}
+	return false;
+}
+
+// Batch mode: --path <keyframes> [--frames <first>-<last>] [--job <index>/<count>] [--fps <fps>] [--out <prefix>]
+// Prints what was expected and returns false on a malformed option
+bool ParseBatchSettings(int argc, char* args[], BatchSettings& settings)
+{
+	settings.cameraPathFile = GetOptionValue(argc, args, "--path");
+	if (settings.cameraPathFile.empty())
+	{
+		std::cout << "Expected --path <keyframes>" << std::endl;
+		return false;
+	}
+
+	const std::string frames{ GetOptionValue(argc, args, "--frames") };
+	if (!frames.empty() && !ParseIntPair(frames, '-', settings.firstFrame, settings.lastFrame))
+	{
+		std::cout << "Expected --frames <first>-<last>" << std::endl;
+		return false;
+	}
+
+	const std::string job{ GetOptionValue(argc, args, "--job") };
+	if (!job.empty() && !ParseIntPair(job, '/', settings.jobIndex, settings.jobCount))
+	{
+		std::cout << "Expected --job <index>/<count>" << std::endl;
+		return false;
+	}
+
+	const std::string fps{ GetOptionValue(argc, args, "--fps") };
+	if (!fps.empty() && !(ParseNumber(fps, settings.framesPerSecond) && settings.framesPerSecond > 0.f))
+	{
+		std::cout << "Expected --fps <frames per second>" << std::endl;
+		return false;
+	}
+
+	const std::string outputPrefix{ GetOptionValue(argc, args, "--out") };
+	if (!outputPrefix.empty())
+		settings.outputPrefix = outputPrefix;
+
+	return true;
+}
 
+// Worker mode: --worker <host>:<port>, renders tiles for a coordinator until it shuts down
+int RunWorker(const std::string& address)
+{
+	const size_t separatorPos{ address.rfind(':') };
+	uint16_t port{};
+	if (separatorPos == std::string::npos || !ParseNumber(std::string_view{ address }.substr(separatorPos + 1), port))
+	{
+		std::cout << "Expected --worker <host>:<port>" << std::endl;
+		return 1;
+	}
+
+	SDL_Init(0);
+
+	RenderWorker worker{};
+	bool succeeded{ false };
+	if (worker.Connect(address.substr(0, separatorPos), port))
+		succeeded = worker.Run();
+	else
+		std::cout << "Could not connect to coordinator " << address << std::endl;
+
+	SDL_Quit();
+	return succeeded ? 0 : 1;
+}
+
+int RunBatch(const BatchSettings& settings, int width, int height)
+{
+	CameraPath path{};
+	if (!path.LoadFromFile(settings.cameraPathFile))
+	{
+		std::cout << "Could not load camera path " << settings.cameraPathFile << std::endl;
+		return 1;
+	}
+
+	SDL_Init(0);
+
+	const auto pScene = new Scene_W2();
+	pScene->Initialize();
+
+	const auto pBatchRenderer = new BatchRenderer(width, height);
+	const bool succeeded = pBatchRenderer->Run(pScene, path, settings);
+
+	delete pBatchRenderer;
+	delete pScene;
+
+	SDL_Quit();
+	return succeeded ? 0 : 1;
+}
+
+int main(int argc, char* args[])
+{
 	const uint32_t width = 640;
 	const uint32_t height = 480;
 
+	//Headless camera path rendering
+	if (HasOption(argc, args, "--path"))
+	{
+		BatchSettings batchSettings{};
+		if (!ParseBatchSettings(argc, args, batchSettings))
+			return 1;
+		return RunBatch(batchSettings, width, height);
+	}
+
+	//Distributed tile rendering
+	const std::string workerAddress{ GetOptionValue(argc, args, "--worker") };
+	if (!workerAddress.empty())
+		return RunWorker(workerAddress);
+
+	const std::string coordinatorOption{ GetOptionValue(argc, args, "--coordinator") };
+	uint16_t coordinatorPort{};
+	if (!coordinatorOption.empty() && !ParseNumber(coordinatorOption, coordinatorPort))
+	{
+		std::cout << "Expected --coordinator <port>" << std::endl;
+		return 1;
+	}
+
+	// --light-cache-cell <size>: edge of the light visibility cache's cells (F11), smaller is more accurate and slower to fill
+	const std::string cellSizeOption{ GetOptionValue(argc, args, "--light-cache-cell") };
+	float lightCacheCellSize{ LightVisibilityCache::defaultCellSize };
+	if (!cellSizeOption.empty() && !(ParseNumber(cellSizeOption, lightCacheCellSize) && lightCacheCellSize > 0.f))
+	{
+		std::cout << "Expected --light-cache-cell <size>" << std::endl;
+		return 1;
+	}
+
+	//Create window + surfaces
+	SDL_Init(SDL_INIT_VIDEO);
+
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"RayTracer - **Insert Name**",
 		SDL_WINDOWPOS_UNDEFINED,
@@ -45,12 +211,38 @@ int main(int argc, char* args[])
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	std::cout << "Kernels: " << ToString(GetInstructionSet()) << " (override with DAE_ISA)" << std::endl;
 
-	// const auto pScene = new Scene_W1();
-	 const auto pScene = new Scene_W2();
-	// const auto pScene = new Scene_W3();
-	pScene->Initialize();
+	const auto createScene = []() -> Scene*
+		{
+			// const auto pScene = new Scene_W1();
+			 const auto pScene = new Scene_W2();
+			// const auto pScene = new Scene_W3();
+			// const auto pScene = new Scene_AreaLights();
+			pScene->Initialize();
+			return pScene;
+		};
+	const auto pScene = createScene();
+
+	// --coordinator <port>: hand tiles out to workers connecting on that port, only from this machine without --remote-workers
+	const auto pCoordinator = coordinatorOption.empty() ? nullptr
+		: new RenderCoordinator(coordinatorPort, pScene, HasOption(argc, args, "--remote-workers"));
+
+	// Without a coordinator frames render on a thread of their own into a headless renderer, from a second scene that takes over
+	// the state of the one this loop updates. The loop only handles input, updates and presents
+	const auto pRenderer = pCoordinator ? new Renderer(pWindow) : new Renderer(static_cast<int>(width), static_cast<int>(height));
+	pRenderer->SetLightCacheCellSize(lightCacheCellSize);
+	const auto pRenderScene = pCoordinator ? nullptr : createScene();
+	const auto pRenderThread = pCoordinator ? nullptr : new RenderThread(pRenderScene, pRenderer);
+
+	// The render thread owns the renderer while it runs, changes are queued until its current frame is done
+	const auto changeRenderer = [&](const std::function<void(Renderer&)>& change)
+		{
+			if (pRenderThread)
+				pRenderThread->Post(change);
+			else
+				change(*pRenderer);
+		};
 
 	//Start loop
 	pTimer->Start();
@@ -61,6 +253,8 @@ int main(int argc, char* args[])
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool useFrameBudget = false;
+	uint32_t lastFrameCount = 0;
 	while (isLooping)
 	{
 		//--------- Get input events ---------
@@ -76,18 +270,52 @@ int main(int argc, char* args[])
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
 				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
-					pRenderer->ToggleShadows();
+					changeRenderer(&Renderer::ToggleShadows);
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
-					pRenderer->CycleLightingMode();
+					changeRenderer(&Renderer::CycleLightingMode);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					changeRenderer(&Renderer::ToggleReflections);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					changeRenderer(&Renderer::ToggleRenderMode);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
+					changeRenderer(&Renderer::ToggleDenoiser);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					changeRenderer(&Renderer::ToggleDynamicResolution);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					changeRenderer(&Renderer::ToggleFoveation);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+				{
+					// The coordinator renders whole frames on its workers, a frame budget only applies to the render thread
+					if (pRenderThread)
+					{
+						useFrameBudget = !useFrameBudget;
+						pRenderThread->SetFrameBudget(useFrameBudget ? 1000.f / 30.f : 0.f);
+					}
+					else
+						std::cout << "The frame budget is not supported with --coordinator" << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+					changeRenderer(&Renderer::ToggleShadowMaps);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+					changeRenderer(&Renderer::ToggleLightCache);
 				break;
 			}
 		}
 
 		//--------- Update ---------
 		pScene->Update(pTimer);
+		if (pRenderThread)
+			pRenderThread->SubmitScene(*pScene);
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		if (pRenderThread)
+		{
+			// Presents at display rate, a frame that is still rendering keeps the previous one on screen
+			pRenderThread->PresentLatestFrame(pWindow);
+			SDL_Delay(1);
+		}
+		else
+			pCoordinator->RenderFrame(pScene, pRenderer);
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -95,22 +323,37 @@ int main(int argc, char* args[])
 		if (printTimer >= 1.f)
 		{
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			if (pRenderThread)
+			{
+				const uint32_t frameCount{ pRenderThread->GetFrameCount() };
+				std::cout << "dFPS: " << pTimer->GetdFPS() << " | Render FPS: " << frameCount - lastFrameCount << " | Secondary rays: "
+					<< pRenderer->GetSecondaryRayCount() << " | Resolution scale: " << pRenderThread->GetResolutionScale() << std::endl;
+				lastFrameCount = frameCount;
+			}
+			else
+				std::cout << "dFPS: " << pTimer->GetdFPS() << " | Secondary rays: " << pRenderer->GetSecondaryRayCount()
+					<< " | Resolution scale: " << pRenderer->GetResolutionScale() << std::endl;
 		}
 
 		//Save screenshot after full render
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			changeRenderer([](Renderer& renderer)
+				{
+					if (!renderer.SaveBufferToImage())
+						std::cout << "Screenshot saved!" << std::endl;
+					else
+						std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+				});
 			takeScreenshot = false;
 		}
 	}
 	pTimer->Stop();
 
 	//Shutdown "framework"
+	delete pRenderThread;
+	delete pRenderScene;
+	delete pCoordinator;
 	delete pScene;
 	delete pRenderer;
 	delete pTimer;
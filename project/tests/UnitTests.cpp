@@ -2,6 +2,34 @@
 #include "../src/Vector3.h"
 #include "../src/Vector4.h"
 #include "../src/Matrix.h"
+#include "../src/Camera.h"
+#include "../src/CameraPath.h"
+#include "../src/Denoiser.h"
+#include "../src/DistributedRenderer.h"
+#include "../src/BVH.h"
+#include "../src/Kernels.h"
+#include "../src/LightVisibilityCache.h"
+#include "../src/BatchRenderer.h"
+#include "../src/Scene.h"
+#include "../src/Material.h"
+#include "../src/Rasterizer.h"
+#include "../src/MemoryArena.h"
+#include "../src/Renderer.h"
+#include "../src/RenderThread.h"
+#include "../src/ResolutionController.h"
+#include "../src/ShadowMaps.h"
+#include "../src/Socket.h"
+#include "../src/TileCuller.h"
+#include "../src/UniformGrid.h"
+#include "../src/Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <SDL_surface.h>
 
 namespace dae
 {
@@ -35,7 +63,1598 @@ namespace dae
 		EXPECT_EQ(dae::Vector3(-3.0f, 6.0f, -3.0f), dae::Vector3::Cross(v1, v2));
 	}
 
-	// W1
+	// Camera path
+	TEST(CameraPath, InterpolatesThroughKeyframes) {
+		CameraPath path{};
+		path.AddKeyframe({ 1.f, { 10.f, 0.f, 0.f }, 0.f, 0.f, 60.f });
+		path.AddKeyframe({ 0.f, { 0.f, 0.f, 0.f }, 0.f, 0.f, 90.f });
+
+		EXPECT_EQ(0.f, path.GetStartTime());
+		EXPECT_EQ(1.f, path.GetEndTime());
+		EXPECT_EQ(Vector3(0.f, 0.f, 0.f), path.Evaluate(-1.f).origin); // clamped before first key
+		EXPECT_EQ(Vector3(10.f, 0.f, 0.f), path.Evaluate(2.f).origin); // clamped after last key
+		EXPECT_NEAR(5.f, path.Evaluate(.5f).origin.x, 1e-4f);
+		EXPECT_NEAR(75.f, path.Evaluate(.5f).fovAngle, 1e-4f);
+
+		Camera camera{};
+		path.ApplyToCamera(0.f, camera);
+		EXPECT_EQ(Vector3::UnitZ, camera.forward);
+	}
+
+	TEST(CameraPath, TurnsTheShortWayAcrossHalfATurn) {
+		CameraPath path{};
+		path.AddKeyframe({ 0.f, {}, 170.f * TO_RADIANS, 0.f, 90.f });
+		path.AddKeyframe({ 1.f, {}, -170.f * TO_RADIANS, 0.f, 90.f });
+
+		// Halfway the camera looks straight back instead of having spun through 0
+		const float yaw{ path.Evaluate(.5f).yaw };
+		EXPECT_NEAR(-1.f, std::cos(yaw), 1e-4f);
+		const float quarterYaw{ path.Evaluate(.25f).yaw * TO_DEGREES };
+		EXPECT_GT(quarterYaw, 170.f);
+		EXPECT_LT(quarterYaw, 180.f);
+	}
+
+	TEST(BatchRenderer, SplitsFrameRangeOverJobs) {
+		int first{}, last{};
+		int covered{};
+		for (int job{}; job < 3; ++job)
+		{
+			ASSERT_TRUE(BatchRenderer::GetJobFrameRange(0, 9, job, 3, first, last));
+			EXPECT_EQ(covered, first); // chunks are contiguous
+			covered = last + 1;
+		}
+		EXPECT_EQ(10, covered);
+		EXPECT_FALSE(BatchRenderer::GetJobFrameRange(0, 1, 2, 3, first, last)); // more jobs than frames
+	}
+
+	// Distributed rendering
+	TEST(Scene, SerializeRoundTrip) {
+		Scene_W3 scene{};
+		scene.Initialize();
+
+		std::ostringstream stream{};
+		scene.Serialize(stream);
+
+		Scene_Remote remote{ stream.str() };
+		remote.Initialize();
+
+		ASSERT_EQ(scene.GetSphereGeometries().size(), remote.GetSphereGeometries().size());
+		ASSERT_EQ(scene.GetPlaneGeometries().size(), remote.GetPlaneGeometries().size());
+		ASSERT_EQ(scene.GetLights().size(), remote.GetLights().size());
+		ASSERT_EQ(scene.GetMaterials().size(), remote.GetMaterials().size());
+
+		EXPECT_EQ(scene.GetSphereGeometries()[4].origin, remote.GetSphereGeometries()[4].origin);
+		EXPECT_EQ(scene.GetCamera().origin, remote.GetCamera().origin);
+
+		HitRecord hit{};
+		hit.normal = Vector3::UnitY;
+		const Vector3 l{ Vector3(1.f, 1.f, 0.f).Normalized() };
+		for (size_t index{}; index < scene.GetMaterials().size(); ++index)
+		{
+			const ColorRGB expected{ scene.GetMaterials()[index]->Shade(hit, l, Vector3::UnitY) };
+			const ColorRGB actual{ remote.GetMaterials()[index]->Shade(hit, l, Vector3::UnitY) };
+			EXPECT_FLOAT_EQ(expected.r, actual.r);
+			EXPECT_FLOAT_EQ(expected.b, actual.b);
+		}
+	}
+
+	// A transformed mesh, which the receiver cannot transform again itself
+	class Scene_Mesh final : public Scene
+	{
+	public:
+		void Initialize() override
+		{
+			const unsigned char material{ AddMaterial<Material_Lambert>(ColorRGB{ .2f, .4f, .8f }, 1.f) };
+			m_MeshHandle = AddTriangleMesh(TriangleCullMode::NoCulling, material);
+			TriangleMesh& mesh{ GetTriangleMesh(m_MeshHandle) };
+			mesh.positions = { { 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } };
+			mesh.indices = { 0, 1, 2 };
+			mesh.normals = { -Vector3::UnitZ };
+			mesh.Translate({ 1.f, 2.f, 3.f });
+			mesh.RotateY(.5f);
+			mesh.Scale({ 2.f, 2.f, 2.f });
+			const Matrix transform{ mesh.scaleTransform * mesh.rotationTransform * mesh.translationTransform };
+			for (const Vector3& position : mesh.positions)
+				mesh.transformedPositions.push_back(transform.TransformPoint(position));
+			mesh.transformedNormals = { transform.TransformVector(mesh.normals[0]).Normalized() };
+
+			AddSphere({ 0.f, 0.f, 5.f }, 1.f, material);
+			AddPointLight({ 0.f, 5.f, 0.f }, 10.f, colors::White);
+		}
+
+		void TransformMesh(const Vector3& translation, const Vector3& scale)
+		{
+			TriangleMesh& mesh{ GetTriangleMesh(m_MeshHandle) };
+			mesh.Translate(translation);
+			mesh.Scale(scale);
+			UpdateTransforms(m_MeshHandle);
+		}
+
+	private:
+		TriangleMeshHandle m_MeshHandle{};
+	};
+
+	TEST(Scene, DeserializeRejectsTruncatedData) {
+		Scene_Mesh scene{};
+		scene.Initialize();
+		std::ostringstream stream{};
+		scene.Serialize(stream);
+		const std::string data{ stream.str() };
+
+		Scene_Remote remote{ data };
+		remote.Initialize();
+		ASSERT_EQ(1u, remote.GetTriangleMeshGeometries().size());
+		const TriangleMesh& expected{ scene.GetTriangleMeshGeometries()[0] };
+		const TriangleMesh& mesh{ remote.GetTriangleMeshGeometries()[0] };
+		EXPECT_EQ(expected.translationTransform, mesh.translationTransform);
+		EXPECT_EQ(expected.rotationTransform, mesh.rotationTransform);
+		EXPECT_EQ(expected.scaleTransform, mesh.scaleTransform);
+		EXPECT_EQ(expected.transformedPositions, mesh.transformedPositions);
+		EXPECT_EQ(expected.transformedNormals, mesh.transformedNormals);
+		EXPECT_EQ(expected.materialIndex, mesh.materialIndex);
+
+		// Cut anywhere, even in the counts of meshes and materials or in the camera at the end
+		for (size_t size{}; size < data.size(); ++size)
+		{
+			Scene_Remote truncated{ data.substr(0, size) };
+			EXPECT_THROW(truncated.Initialize(), std::runtime_error) << size << " of " << data.size() << " bytes";
+		}
+
+		// A count far past the end of the data fails without allocating it
+		std::string corrupt{ data };
+		const uint32_t numSpheres{ UINT32_MAX };
+		std::memcpy(corrupt.data(), &numSpheres, sizeof(numSpheres));
+		Scene_Remote oversized{ corrupt };
+		EXPECT_THROW(oversized.Initialize(), std::runtime_error);
+	}
+
+	// Scene memory
+	TEST(MemoryArena, AllocationsStayStableAndAligned) {
+		MemoryArena arena{ 256 };
+
+		std::vector<Vector3*> allocations{};
+		for (int index{}; index < 100; ++index)
+		{
+			Vector3* pVector = arena.Create<Vector3>(float(index), 0.f, 0.f);
+			EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(pVector) % alignof(Vector3));
+			allocations.push_back(pVector);
+		}
+		EXPECT_GT(arena.GetNumBlocks(), 1u);
+
+		for (int index{}; index < 100; ++index)
+			EXPECT_EQ(float(index), allocations[index]->x); // earlier blocks were never moved
+
+		void* pLarge = arena.Allocate(4096, 64); // bigger than a block
+		EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(pLarge) % 64);
+
+		arena.Reset();
+		EXPECT_EQ(0u, arena.GetNumBlocks());
+	}
+
+	TEST(MemoryArena, DestroysCreatedObjectsNewestFirst) {
+		struct Counted
+		{
+			std::vector<int>* pDestroyed{};
+			int id{};
+			~Counted() { pDestroyed->push_back(id); }
+		};
+
+		std::vector<int> destroyed{};
+		{
+			MemoryArena arena{ 256 };
+			for (int id{}; id < 20; ++id)
+				arena.Create<Counted>(&destroyed, id);
+			arena.Reset();
+			EXPECT_EQ(20u, destroyed.size());
+			EXPECT_EQ(19, destroyed.front());
+			EXPECT_EQ(0, destroyed.back());
+
+			arena.Create<Counted>(&destroyed, 20);
+		}
+		ASSERT_EQ(21u, destroyed.size());
+		EXPECT_EQ(20, destroyed.back()); // The destructor destroys what is left
+	}
+
+	// Hit tests
+	TEST(GeometryUtils, SphereIntersectionPicksRootInRange) {
+		const Sphere sphere{ { 0.f, 0.f, 10.f }, 2.f };
+		float t{};
+
+		ASSERT_TRUE(GeometryUtils::Intersect_Sphere(sphere, Ray{ Vector3::Zero, Vector3::UnitZ }, t));
+		EXPECT_NEAR(8.f, t, 1e-4f); // near root
+
+		ASSERT_TRUE(GeometryUtils::Intersect_Sphere(sphere, Ray{ { 0.f, 0.f, 10.f }, Vector3::UnitZ }, t));
+		EXPECT_NEAR(2.f, t, 1e-4f); // inside >> far root
+
+		Ray shortRay{ Vector3::Zero, Vector3::UnitZ };
+		shortRay.max = 5.f;
+		EXPECT_FALSE(GeometryUtils::Intersect_Sphere(sphere, shortRay, t)); // beyond ray.max
+		EXPECT_FALSE(GeometryUtils::Intersect_Sphere(sphere, Ray{ Vector3::Zero, -Vector3::UnitZ }, t)); // behind
+	}
+
+	TEST(GeometryUtils, SpherePacketsMatchTheScalarKernel) {
+		// Tangent rays hit, far away spheres keep their precision
+		const Sphere tangent{ { 1.f, 0.f, 10.f }, 1.f };
+		float t{};
+		ASSERT_TRUE(GeometryUtils::Intersect_Sphere(tangent, Ray{ Vector3::Zero, Vector3::UnitZ }, t));
+		EXPECT_NEAR(10.f, t, 1e-3f);
+		ASSERT_TRUE(GeometryUtils::Intersect_Sphere(Sphere{ { 0.f, 0.f, 1e4f }, .5f }, Ray{ Vector3::Zero, Vector3::UnitZ }, t));
+		EXPECT_EQ(1e4f - .5f, t);
+
+		std::vector<Sphere> spheres{};
+		for (int i{}; i < 13; ++i)
+			spheres.push_back({ { (i % 5) - 2.f, (i % 3) - 1.f, 4.f + i }, .3f + (i % 4) * .2f });
+
+		SpherePacket<4> packets4[4]{};
+		SpherePacket<8> packets8[2]{};
+		for (int i{}; i < static_cast<int>(spheres.size()); ++i)
+		{
+			packets4[i / 4].Set(i % 4, spheres[i]);
+			packets8[i / 8].Set(i % 8, spheres[i]);
+		}
+
+		for (int y{ -10 }; y <= 10; ++y)
+		{
+			for (int x{ -10 }; x <= 10; ++x)
+			{
+				Ray ray{ { 0.f, 0.f, 2.f + (x + y) % 3 }, Vector3{ x * .05f, y * .05f, 1.f }.Normalized() };
+				ray.max = 12.f;
+
+				float expectedT{ FLT_MAX };
+				int expectedIndex{ -1 };
+				for (int i{}; i < static_cast<int>(spheres.size()); ++i)
+				{
+					if (GeometryUtils::Intersect_Sphere(spheres[i], ray, t) && t < expectedT)
+					{
+						expectedT = t;
+						expectedIndex = i;
+					}
+				}
+
+				float t4{ FLT_MAX }, t8{ FLT_MAX };
+				int index4{ -1 }, index8{ -1 };
+				for (int packet{}; packet < 4; ++packet)
+				{
+					const int lane{ GeometryUtils::Intersect_SpherePacket(packets4[packet], ray, t4) };
+					if (lane >= 0)
+						index4 = packet * 4 + lane;
+				}
+				for (int packet{}; packet < 2; ++packet)
+				{
+					const int lane{ GeometryUtils::Intersect_SpherePacket(packets8[packet], ray, t8) };
+					if (lane >= 0)
+						index8 = packet * 8 + lane;
+				}
+
+				EXPECT_EQ(expectedIndex, index4);
+				EXPECT_EQ(expectedIndex, index8);
+				if (expectedIndex >= 0)
+				{
+					EXPECT_NEAR(expectedT, t4, 1e-4f);
+					EXPECT_NEAR(expectedT, t8, 1e-4f);
+				}
+			}
+		}
+	}
+
+	TEST(Kernels, EveryInstructionSetMatchesScalar) {
+		const KernelTable& scalar{ GetKernels(InstructionSet::Scalar) };
+
+		// Three packets, so the 16 lane kernel also runs its leftover packet
+		std::vector<SpherePacket<8>> packets(3);
+		for (int i{}; i < 21; ++i)
+			packets[i / 8].Set(i % 8, { { (i % 5) - 2.f, (i % 3) - 1.f, 4.f + i }, .3f + (i % 4) * .2f });
+
+		std::vector<ColorRGB> colors{};
+		for (int i{}; i < 37; ++i)
+			colors.push_back({ i * .05f, (i % 7) * .4f, 1.f - i * .01f });
+
+		constexpr uint32_t numRays{ 37 }, numLights{ 3 };
+		std::vector<float> contributions[3]{}, throughputs[3]{}, expectedRadiances[3]{}, radiances[3]{};
+		std::vector<float> shadowFactors(numRays * numLights);
+		for (int channel{}; channel < 3; ++channel)
+		{
+			for (uint32_t i{}; i < numRays * numLights; ++i)
+				contributions[channel].push_back((i * 7 + channel) % 11 * .1f);
+			for (uint32_t i{}; i < numRays; ++i)
+				throughputs[channel].push_back(1.f - (i + channel) % 5 * .2f);
+			expectedRadiances[channel].assign(numRays, -1.f);
+		}
+		for (uint32_t i{}; i < numRays * numLights; ++i)
+			shadowFactors[i] = i % 4 == 1 ? .5f : i % 4 == 3 ? .75f : 1.f; // Traced shadows and a filtered shadow map edge
+
+		const auto getStreams = [&](std::vector<float>* pRadiances)
+			{
+				return RadianceStreams{ { contributions[0].data(), contributions[1].data(), contributions[2].data() }, shadowFactors.data(), numLights,
+					{ throughputs[0].data(), throughputs[1].data(), throughputs[2].data() }, { pRadiances[0].data(), pRadiances[1].data(), pRadiances[2].data() } };
+			};
+		scalar.resolveRadiance(getStreams(expectedRadiances), 1, numRays - 1);
+
+		std::vector<uint32_t> expectedPixels(colors.size());
+		scalar.tonemap(colors.data(), .7f, expectedPixels.data(), static_cast<uint32_t>(colors.size()), {});
+
+		// A row of camera rays, long enough to leave a tail after the widest kernel, across overlapping spheres
+		const Sphere rowSpheres[3]{ { { 0.f, 0.f, 6.f }, 1.f }, { { .6f, 0.f, 5.f }, .5f }, { { -1.f, .2f, 7.f }, 1.5f } };
+		std::vector<float> directions[3]{};
+		for (uint32_t i{}; i < numRays; ++i)
+		{
+			const Vector3 direction{ Vector3{ (i - 18.f) * .02f, .01f, 1.f }.Normalized() };
+			directions[0].push_back(direction.x);
+			directions[1].push_back(direction.y);
+			directions[2].push_back(direction.z);
+		}
+		const auto rasterizeRow = [&](const KernelTable& kernels, std::vector<float>& depths, std::vector<uint32_t>& primitives)
+			{
+				depths.assign(numRays, FLT_MAX);
+				primitives.assign(numRays, UINT32_MAX);
+				const VisibilitySpan span{ {}, .0001f, { directions[0].data(), directions[1].data(), directions[2].data() }, depths.data(), primitives.data(), numRays };
+				for (uint32_t sphere{}; sphere < 3; ++sphere)
+					kernels.rasterizeSphere(rowSpheres[sphere], sphere, span);
+			};
+		std::vector<float> expectedDepths{}, depths{};
+		std::vector<uint32_t> expectedPrimitives{}, primitives{};
+		rasterizeRow(scalar, expectedDepths, expectedPrimitives);
+		for (const uint32_t primitive : { 0u, 1u, 2u, UINT32_MAX }) // Each sphere covers some rays and the background others
+			EXPECT_NE(expectedPrimitives.end(), std::find(expectedPrimitives.begin(), expectedPrimitives.end(), primitive));
+
+		for (int index{}; index <= static_cast<int>(DetectInstructionSet()); ++index)
+		{
+			const KernelTable& kernels{ GetKernels(static_cast<InstructionSet>(index)) };
+			SCOPED_TRACE(ToString(kernels.instructionSet));
+
+			for (int y{ -6 }; y <= 6; ++y)
+			{
+				for (int x{ -6 }; x <= 6; ++x)
+				{
+					Ray ray{ { 0.f, 0.f, 2.f + (x + y) % 3 }, Vector3{ x * .08f, y * .08f, 1.f }.Normalized() };
+					ray.max = 20.f;
+
+					float expectedT{ FLT_MAX }, t{ FLT_MAX };
+					EXPECT_EQ(scalar.intersectSpheres(packets.data(), 3, ray, expectedT), kernels.intersectSpheres(packets.data(), 3, ray, t));
+					EXPECT_NEAR(expectedT, t, 1e-4f);
+					EXPECT_EQ(scalar.hitTestSpheres(packets.data(), 3, ray), kernels.hitTestSpheres(packets.data(), 3, ray));
+				}
+			}
+
+			for (int channel{}; channel < 3; ++channel)
+				radiances[channel].assign(numRays, -1.f);
+			kernels.resolveRadiance(getStreams(radiances), 1, numRays - 1);
+			for (int channel{}; channel < 3; ++channel)
+				EXPECT_EQ(expectedRadiances[channel], radiances[channel]);
+
+			std::vector<uint32_t> pixels(colors.size());
+			kernels.tonemap(colors.data(), .7f, pixels.data(), static_cast<uint32_t>(colors.size()), {});
+			EXPECT_EQ(expectedPixels, pixels);
+
+			rasterizeRow(kernels, depths, primitives);
+			EXPECT_EQ(expectedPrimitives, primitives);
+			for (uint32_t i{}; i < numRays; ++i)
+				EXPECT_NEAR(expectedDepths[i], depths[i], 1e-4f);
+		}
+	}
+
+	// Reflections
+	TEST(Renderer, TracesReflectionsOnlyWhenAskedTo) {
+		Scene_W3 scene{};
+		scene.Initialize();
+
+		Renderer renderer{ 64, 48 };
+		EXPECT_FALSE(renderer.AreReflectionsEnabled());
+		renderer.Render(&scene);
+		EXPECT_EQ(0u, renderer.GetSecondaryRayCount());
+
+		renderer.ToggleReflections();
+		renderer.Render(&scene);
+		EXPECT_GT(renderer.GetSecondaryRayCount(), 0u);
+	}
+
+	TEST(Material, DielectricScatterConservesEnergy) {
+		const Material_Dielectric glass{ colors::White, 1.5f };
+		HitRecord hitRecord{};
+		hitRecord.normal = Vector3::UnitY;
+
+		const SpecularScatter headOn{ glass.GetSpecularScatter(hitRecord, -Vector3::UnitY) };
+		EXPECT_NEAR(0.04f, headOn.reflectance.r, 1e-4f); // f0 of glass
+		EXPECT_NEAR(1.f, headOn.reflectance.r + headOn.transmittance.r, 1e-4f);
+
+		const SpecularScatter grazing{ glass.GetSpecularScatter(hitRecord, Vector3{ 1.f, -0.01f, 0.f }.Normalized()) };
+		EXPECT_GT(grazing.reflectance.r, headOn.reflectance.r);
+		EXPECT_NEAR(1.f, grazing.reflectance.r + grazing.transmittance.r, 1e-4f);
+	}
+
+	// Wavefront
+	TEST(Renderer, WavefrontMatchesPerPixel) {
+		Scene_W3 scene{};
+		scene.Initialize();
+
+		Renderer perPixel{ 64, 48 };
+		Renderer wavefront{ 64, 48 };
+		wavefront.SetRenderMode(Renderer::RenderMode::Wavefront);
+		for (Renderer* pRenderer : { &perPixel, &wavefront })
+			pRenderer->SetReflectionsEnabled(true);
+
+		perPixel.Render(&scene);
+		wavefront.Render(&scene);
+
+		EXPECT_EQ(perPixel.GetSecondaryRayCount(), wavefront.GetSecondaryRayCount());
+		EXPECT_EQ(0, std::memcmp(perPixel.GetBuffer()->pixels, wavefront.GetBuffer()->pixels, 64 * 48 * sizeof(uint32_t)));
+	}
+
+	TEST(Renderer, EveryPixelKernelMatchesTheWavefrontPath) {
+		// The per pixel kernel is compiled once per setting, the wavefront path checks the settings at run time
+		Scene_W3 scene{};
+		scene.Initialize();
+
+		Renderer perPixel{ 64, 48 };
+		Renderer wavefront{ 64, 48 };
+		wavefront.SetRenderMode(Renderer::RenderMode::Wavefront);
+		for (Renderer* pRenderer : { &perPixel, &wavefront })
+			pRenderer->SetReflectionsEnabled(true);
+		for (const Renderer::LightingMode lightingMode : { Renderer::LightingMode::ObservedArea, Renderer::LightingMode::Radiance,
+			Renderer::LightingMode::BRDF, Renderer::LightingMode::Combined })
+		{
+			std::vector<uint32_t> shadowed{};
+			for (const bool areShadowsEnabled : { true, false })
+			{
+				SCOPED_TRACE(static_cast<int>(lightingMode) * 2 + areShadowsEnabled);
+				for (Renderer* pRenderer : { &perPixel, &wavefront })
+				{
+					pRenderer->SetLightingMode(lightingMode);
+					pRenderer->SetShadowsEnabled(areShadowsEnabled);
+					pRenderer->Render(&scene);
+				}
+				EXPECT_EQ(0, std::memcmp(perPixel.GetBuffer()->pixels, wavefront.GetBuffer()->pixels, 64 * 48 * sizeof(uint32_t)));
+
+				const uint32_t* pPixels{ static_cast<const uint32_t*>(perPixel.GetBuffer()->pixels) };
+				if (areShadowsEnabled)
+					shadowed.assign(pPixels, pPixels + 64 * 48);
+				else
+					EXPECT_FALSE(std::equal(shadowed.begin(), shadowed.end(), pPixels));
+			}
+		}
+	}
+
+	// Lights
+	TEST(LightUtils, DirectionalLightsShineFromOneDirectionEverywhere) {
+		Light sun{};
+		sun.type = LightType::Directional;
+		sun.direction = { 0.f, 2.f, 0.f };
+		EXPECT_EQ(Vector3::UnitY, LightUtils::GetDirectionToLight(sun, Vector3::Zero));
+		EXPECT_EQ(Vector3::UnitY, LightUtils::GetDirectionToLight(sun, { 100.f, -5.f, 3.f }));
+
+		Light point{};
+		point.origin = { 0.f, 4.f, 0.f };
+		EXPECT_EQ(Vector3(0.f, 3.f, 0.f), LightUtils::GetDirectionToLight(point, Vector3::UnitY)); // Spans the distance
+	}
+
+	// Path tracing
+	TEST(LightUtils, AreaLightSamplesMatchTheirPdf) {
+		Light rectLight{};
+		rectLight.origin = { 0.f, 5.f, 0.f };
+		rectLight.edgeU = { 1.f, 0.f, 0.f };
+		rectLight.edgeV = { 0.f, 0.f, 1.f };
+		rectLight.direction = -Vector3::UnitY;
+		rectLight.intensity = 1.f;
+		rectLight.type = LightType::RectArea;
+
+		Light sphereLight{ rectLight };
+		sphereLight.radius = .5f;
+		sphereLight.type = LightType::SphereArea;
+
+		for (const Light& light : { rectLight, sphereLight })
+		{
+			for (uint32_t sampleIndex{}; sampleIndex < 16; ++sampleIndex)
+			{
+				Sampling::PixelSampler sampler{ 7, 3, sampleIndex };
+				LightUtils::LightSample lightSample{};
+				ASSERT_TRUE(LightUtils::SampleLight(light, Vector3::Zero, sampler.Get2D(), lightSample));
+
+				// The sampled direction reaches the light at the sampled distance, with the same pdf
+				float t{};
+				ASSERT_TRUE(LightUtils::IntersectAreaLight(light, Ray{ Vector3::Zero, lightSample.direction }, t));
+				EXPECT_NEAR(lightSample.distance, t, 1e-3f);
+				EXPECT_NEAR(lightSample.pdf, LightUtils::GetLightPdf(light, Vector3::Zero, lightSample.direction, t), 1e-3f);
+			}
+		}
+	}
+
+	// Sampling
+	TEST(Sampling, ScrambledSobolStaysStratified) {
+		static_assert(Sampling::Sobol::Sample(1, 0) == 1u << 31 && Sampling::Sobol::Sample(3, 1) == 1u << 30);
+
+		for (uint32_t seed{}; seed < 4; ++seed)
+		{
+			// Every one of the first 16 points lands in its own cell of the 4x4 grid and of both 16x1 grids
+			std::array<int, 16> cells{}, columns{}, rows{};
+			for (uint32_t index{}; index < 16; ++index)
+			{
+				const uint32_t shuffled{ Sampling::Sobol::OwenScramble(index, seed) };
+				const float u{ Sampling::ToUnitFloat(Sampling::Sobol::OwenScramble(Sampling::Sobol::Sample(shuffled, 0), seed + 1)) };
+				const float v{ Sampling::ToUnitFloat(Sampling::Sobol::OwenScramble(Sampling::Sobol::Sample(shuffled, 1), seed + 2)) };
+				ASSERT_LT(u, 1.f);
+				ASSERT_LT(v, 1.f);
+				++cells[int(u * 4) + int(v * 4) * 4];
+				++columns[int(u * 16)];
+				++rows[int(v * 16)];
+			}
+			for (int cell{}; cell < 16; ++cell)
+			{
+				EXPECT_EQ(1, cells[cell]);
+				EXPECT_EQ(1, columns[cell]);
+				EXPECT_EQ(1, rows[cell]);
+			}
+		}
+
+		// The blue noise mask holds every rank exactly once
+		std::vector<int> ranks(Sampling::BlueNoise::Size * Sampling::BlueNoise::Size);
+		for (uint32_t y{}; y < Sampling::BlueNoise::Size; ++y)
+		{
+			for (uint32_t x{}; x < Sampling::BlueNoise::Size; ++x)
+			{
+				EXPECT_EQ(Sampling::BlueNoise::Get(x, y), Sampling::BlueNoise::Get(x + Sampling::BlueNoise::Size, y)); // tiles
+				++ranks[size_t(Sampling::BlueNoise::Get(x, y) * ranks.size())];
+			}
+		}
+		EXPECT_EQ(ranks.end(), std::find_if(ranks.begin(), ranks.end(), [](int count) { return count != 1; }));
+	}
+
+	// Denoising
+	TEST(Denoiser, SmoothsNoiseButKeepsDepthEdges) {
+		constexpr int size{ 32 };
+		std::vector<ColorRGB> colors(size * size), albedos(size * size, colors::White);
+		std::vector<Vector3> normals(size * size, Vector3::UnitZ);
+		std::vector<float> depths(size * size);
+		for (int index{}; index < size * size; ++index)
+		{
+			const bool isNear{ index % size < size / 2 };
+			const float noise{ (index + index / size) % 2 ? .1f : -.1f }; // checkerboard
+			colors[index] = ColorRGB{ 1.f, 1.f, 1.f } * (isNear ? .2f + noise : .8f);
+			depths[index] = isNear ? 1.f : 10.f;
+		}
+
+		Denoiser denoiser{};
+		const std::vector<ColorRGB>& result{ denoiser.Denoise({ size, size, colors.data(), albedos.data(), normals.data(), depths.data() }) };
+
+		const int row{ (size / 2) * size };
+		EXPECT_NEAR(.2f, result[row + 4].r, .02f);
+		EXPECT_NEAR(.2f, result[row + 5].r, .02f);
+		EXPECT_NEAR(.2f, result[row + size / 2 - 1].r, .02f);
+		EXPECT_NEAR(.8f, result[row + size / 2].r, .02f); // across the edge nothing bleeds in
+	}
+
+	// Foveated rendering
+	TEST(Renderer, FoveationKeepsTheFocusExact) {
+		Scene_W3 scene{};
+		scene.Initialize();
+
+		Renderer full{ 64, 48 };
+		Renderer foveated{ 64, 48 };
+		full.SetReflectionsEnabled(true);
+		foveated.SetReflectionsEnabled(true);
+		foveated.SetFoveationEnabled(true);
+
+		full.Render(&scene);
+		scene.GetCamera().focusX = 0;
+		scene.GetCamera().focusY = 0;
+		foveated.Render(&scene);
+
+		EXPECT_LT(foveated.GetSecondaryRayCount(), full.GetSecondaryRayCount()); // the reflective spheres in the centre are traced coarser
+		const uint32_t* pFull{ static_cast<const uint32_t*>(full.GetBuffer()->pixels) };
+		const uint32_t* pFoveated{ static_cast<const uint32_t*>(foveated.GetBuffer()->pixels) };
+		for (int py{}; py < 16; ++py)
+		{
+			for (int px{}; px < 16; ++px)
+				ASSERT_EQ(pFull[px + (py * 64)], pFoveated[px + (py * 64)]) << px << ", " << py;
+		}
+	}
+
+	// Interruptible rendering
+	TEST(Renderer, InterruptedFramesResumeUntilComplete) {
+		Scene_W3 scene{};
+		scene.Initialize();
+
+		Renderer full{ 256, 192 };
+		Renderer interrupted{ 256, 192 };
+		full.Render(&scene);
+
+		// A deadline in the past still renders one wave of tiles per call
+		int numCalls{ 1 };
+		EXPECT_FALSE(interrupted.Render(&scene, 0));
+		while (!interrupted.Render(&scene, 0))
+			ASSERT_LT(++numCalls, 1000);
+
+		EXPECT_GT(numCalls, 2);
+		EXPECT_EQ(0, std::memcmp(full.GetBuffer()->pixels, interrupted.GetBuffer()->pixels, 256 * 192 * sizeof(uint32_t)));
+	}
+
+	// Dynamic resolution
+	TEST(ResolutionController, SettlesOnTheTargetFrameTime) {
+		ResolutionController controller{};
+		controller.SetTargetFrameTime(16.f);
+
+		// A frame at full resolution takes 40 ms, the cost follows the pixel count
+		float scale{ controller.GetScale() };
+		int numChanges{};
+		for (int frame{}; frame < 100; ++frame)
+		{
+			const float nextScale{ controller.Update(40.f * scale * scale) };
+			if (frame >= 50 && nextScale != scale)
+				++numChanges;
+			scale = nextScale;
+		}
+
+		EXPECT_EQ(0, numChanges); // settled, no oscillation
+		EXPECT_NEAR(16.f, 40.f * scale * scale, 16.f * .1f);
+
+		controller.Update(1.f); // Cheap frames never go above the full resolution
+		for (int frame{}; frame < 100; ++frame)
+			controller.Update(1.f);
+		EXPECT_EQ(1.f, controller.GetScale());
+	}
+
+	// Render thread
+	TEST(RenderThread, RendersWithTheNewestCamera) {
+		Scene_W1 scene{};
+		scene.Initialize();
+		Scene_W1 simulatedScene{};
+		simulatedScene.Initialize();
+		Scene_W1 expectedScene{};
+		expectedScene.Initialize();
+
+		const Camera startCamera{ scene.GetCamera() };
+		Camera camera{ startCamera };
+		camera.origin += Vector3{ 1.f, .5f, -2.f };
+		camera.SetRotation(.1f, -.2f);
+		expectedScene.GetCamera() = camera;
+
+		Renderer expected{ 64, 48 };
+		expected.Render(&expectedScene);
+
+		Renderer renderer{ 64, 48 };
+		std::vector<uint32_t> pixels{};
+		std::atomic<bool> isCopied{};
+		{
+			RenderThread renderThread{ &scene, &renderer };
+			for (int i{}; i < 10; ++i)
+				renderThread.SubmitScene(simulatedScene); // Older states get skipped
+			simulatedScene.SetCamera(camera);
+			renderThread.SubmitScene(simulatedScene);
+
+			// Two frames later the frame that started before the submit is gone
+			const uint32_t frameCount{ renderThread.GetFrameCount() };
+			while (renderThread.GetFrameCount() < frameCount + 2)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			renderThread.Post([&](Renderer& r)
+				{
+					const uint32_t* pPixels{ static_cast<const uint32_t*>(r.GetBuffer()->pixels) };
+					pixels.assign(pPixels, pPixels + 64 * 48);
+					isCopied = true;
+				});
+		}
+
+		ASSERT_TRUE(isCopied);
+		EXPECT_EQ(0, std::memcmp(expected.GetBuffer()->pixels, pixels.data(), 64 * 48 * sizeof(uint32_t)));
+	}
+
+	// Distributed rendering
+	TEST(RenderCoordinator, ReissuesTheTileOfAStalledWorker) {
+		Scene_W1 scene{};
+		scene.Initialize();
+		RenderCoordinator coordinator{ 5597, &scene };
+		ASSERT_TRUE(coordinator.IsListening());
+		coordinator.SetTileTimeout(200);
+
+		// Takes a tile and never answers, then waits to be cut off
+		std::atomic<int> numTiles{};
+		std::thread stalledWorker{ [&numTiles]()
+			{
+				const Socket socket{ Socket::Connect("127.0.0.1", 5597) };
+				Distributed::MessageHeader header{};
+				std::vector<char> payload{};
+				while (socket.Receive(&header, sizeof(header)))
+				{
+					payload.resize(header.size);
+					if (header.size > 0 && !socket.Receive(payload.data(), payload.size()))
+						break;
+					if (header.type == Distributed::MessageType::Tile)
+						++numTiles;
+				}
+			} };
+		while (coordinator.GetNumWorkers() == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		Renderer renderer{ 64, 48 };
+		coordinator.RenderFrame(&scene, &renderer);
+		stalledWorker.join();
+		EXPECT_EQ(1, numTiles);
+		EXPECT_EQ(0, coordinator.GetNumWorkers());
+
+		// The coordinator rendered the reissued tile itself
+		Renderer expected{ 64, 48 };
+		expected.Render(&scene);
+		EXPECT_EQ(0, std::memcmp(expected.GetBuffer()->pixels, renderer.GetBuffer()->pixels, 64 * 48 * sizeof(uint32_t)));
+	}
+
+	// Scene change tracking
+	class Scene_Animated final : public Scene
+	{
+	public:
+		void Initialize() override
+		{
+			for (int i{}; i < 6; ++i)
+				m_SphereHandles.push_back(AddSphere({ static_cast<float>(i), 1.f, 0.f }, .5f));
+			AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f });
+			m_LightHandles.push_back(AddPointLight({ 0.f, 5.f, -5.f }, 70.f, colors::White));
+			m_LightHandles.push_back(AddPointLight({ 0.f, 5.f, 5.f }, 70.f, colors::White));
+		}
+
+		SphereHandle GetSphereHandle(uint32_t index) const { return m_SphereHandles[index]; }
+
+		void MoveSphere(uint32_t index, const Vector3& offset)
+		{
+			GetSphere(m_SphereHandles[index]).origin += offset;
+			MarkDirty(m_SphereHandles[index]);
+		}
+
+		void ScaleLight(uint32_t index, float factor)
+		{
+			GetLight(m_LightHandles[index]).intensity *= factor;
+			MarkDirty(m_LightHandles[index]);
+		}
+
+	private:
+		std::vector<SphereHandle> m_SphereHandles{};
+		std::vector<LightHandle> m_LightHandles{};
+	};
+
+	TEST(Scene, TakesOverCapturedStates) {
+		Scene_Animated simulatedScene{};
+		simulatedScene.Initialize();
+		Scene_Animated scene{};
+		scene.Initialize();
+
+		SceneState state{};
+		simulatedScene.MoveSphere(3, { 0.f, 0.f, 2.f });
+		simulatedScene.ScaleLight(1, .5f);
+		simulatedScene.CaptureState(state);
+		scene.ApplyState(state);
+		EXPECT_EQ(3.f, scene.GetSphereGeometries()[3].origin.x);
+		EXPECT_EQ(2.f, scene.GetSphereGeometries()[3].origin.z);
+		EXPECT_EQ(35.f, scene.GetLights()[1].intensity);
+
+		// Traced in the copy the sphere is where it moved to
+		HitRecord hit{};
+		scene.GetClosestHit({ { 3.f, 1.f, -5.f }, { 0.f, 0.f, 1.f } }, hit);
+		ASSERT_TRUE(hit.didHit);
+		EXPECT_NEAR(6.5f, hit.t, 1e-4f);
+
+		// Without changes in between nothing is taken over again
+		const uint64_t generation{ scene.GetGeneration() };
+		simulatedScene.CaptureState(state);
+		scene.ApplyState(state);
+		EXPECT_EQ(generation, scene.GetGeneration());
+
+		simulatedScene.MoveSphere(0, { 0.f, 1.f, 0.f });
+		simulatedScene.CaptureState(state);
+		scene.ApplyState(state);
+		EXPECT_EQ(2.f, scene.GetSphereGeometries()[0].origin.y);
+		EXPECT_TRUE(scene.GetDirtyRange(SceneComponent::Lights, generation).IsEmpty());
+		EXPECT_FALSE(scene.GetDirtyRange(SceneComponent::Spheres, generation).IsEmpty());
+	}
+
+	TEST(Scene, HandlesGoStaleWhenTheArraysAreReplaced) {
+		Scene_Animated scene{};
+		scene.Initialize();
+		const SphereHandle handle{ scene.GetSphereHandle(2) };
+		EXPECT_TRUE(scene.IsCurrent(handle));
+		EXPECT_FALSE(scene.IsCurrent(SphereHandle{}));
+
+		// Taking over as many spheres as before keeps the handles
+		SceneState state{};
+		scene.CaptureState(state);
+		scene.ApplyState(state);
+		EXPECT_TRUE(scene.IsCurrent(handle));
+
+		state.spheres.push_back({ { 0.f, 3.f, 0.f }, .5f });
+		++state.generations[static_cast<int>(SceneComponent::Spheres)];
+		scene.ApplyState(state);
+		EXPECT_FALSE(scene.IsCurrent(handle));
+	}
+
+	TEST(Scene, RecordsWhatChangedSinceAGeneration) {
+		Scene_Animated scene{};
+		scene.Initialize();
+
+		// Building the scene dirtied every sphere
+		const DirtyRange built{ scene.GetDirtyRange(SceneComponent::Spheres, 0) };
+		EXPECT_EQ(0u, built.first);
+		EXPECT_EQ(scene.GetSphereGeometries().size(), built.count);
+
+		const uint64_t generation{ scene.GetGeneration() };
+		EXPECT_TRUE(scene.GetDirtyRange(SceneComponent::Spheres, generation).IsEmpty());
+
+		scene.MoveSphere(4, { 0.f, 1.f, 0.f });
+		scene.MoveSphere(2, { 0.f, 1.f, 0.f });
+		const DirtyRange moved{ scene.GetDirtyRange(SceneComponent::Spheres, generation) };
+		EXPECT_EQ(2u, moved.first);
+		EXPECT_EQ(3u, moved.count);
+		EXPECT_TRUE(scene.GetDirtyRange(SceneComponent::Planes, generation).IsEmpty());
+
+		// The camera is versioned apart from the content, setting the same camera changes nothing
+		const uint64_t contentGeneration{ scene.GetContentGeneration() };
+		Camera camera{ scene.GetCamera() };
+		scene.SetCamera(camera);
+		EXPECT_EQ(contentGeneration, scene.GetGeneration());
+		camera.origin.x += 1.f;
+		scene.SetCamera(camera);
+		EXPECT_LT(contentGeneration, scene.GetGeneration(SceneComponent::Camera));
+		EXPECT_EQ(contentGeneration, scene.GetContentGeneration());
+
+		// Too many changes to record, the whole array counts as changed
+		for (int i{}; i < 100; ++i)
+		{
+			scene.MoveSphere(5, { 0.f, .1f, 0.f });
+			scene.MoveSphere(3, { 0.f, .1f, 0.f });
+		}
+		EXPECT_EQ(scene.GetSphereGeometries().size(), scene.GetDirtyRange(SceneComponent::Spheres, generation).count);
+	}
+
+	TEST(Scene, UpdatesMeshTransforms) {
+		Scene_Mesh scene{};
+		scene.Initialize();
+		const uint64_t generation{ scene.GetGeneration() };
+
+		// Scaled, then rotated around y, then translated
+		scene.TransformMesh({ 1.f, 2.f, 3.f }, { 2.f, 2.f, 2.f });
+		const TriangleMesh& mesh{ scene.GetTriangleMeshGeometries()[0] };
+		ASSERT_EQ(3u, mesh.transformedPositions.size());
+		EXPECT_EQ(Vector3(1.f, 2.f, 3.f), mesh.transformedPositions[0]);
+		EXPECT_NEAR(2.f * cosf(.5f), std::abs(mesh.transformedPositions[1].x - 1.f), 1e-5f);
+		EXPECT_NEAR(2.f * sinf(.5f), std::abs(mesh.transformedPositions[1].z - 3.f), 1e-5f);
+		EXPECT_NEAR(4.f, mesh.transformedPositions[2].y, 1e-5f);
+		ASSERT_EQ(1u, mesh.transformedNormals.size());
+		EXPECT_NEAR(1.f, mesh.transformedNormals[0].Magnitude(), 1e-5f);
+
+		const DirtyRange updated{ scene.GetDirtyRange(SceneComponent::TriangleMeshes, generation) };
+		EXPECT_EQ(0u, updated.first);
+		EXPECT_EQ(1u, updated.count);
+		EXPECT_TRUE(scene.GetDirtyRange(SceneComponent::Spheres, generation).IsEmpty());
+
+		// Scaled unevenly the normal stays perpendicular to the triangle
+		scene.TransformMesh({}, { 1.f, 3.f, 5.f });
+		const Vector3 edge0{ mesh.transformedPositions[1] - mesh.transformedPositions[0] };
+		const Vector3 edge1{ mesh.transformedPositions[2] - mesh.transformedPositions[0] };
+		EXPECT_NEAR(0.f, Vector3::Dot(edge0, mesh.transformedNormals[0]), 1e-5f);
+		EXPECT_NEAR(0.f, Vector3::Dot(edge1, mesh.transformedNormals[0]), 1e-5f);
+	}
+
+	TEST(Renderer, AccumulationRestartsWhenTheSceneChanges) {
+		Scene_Animated scene{};
+		scene.Initialize();
+
+		Renderer renderer{ 32, 24 };
+		renderer.SetLightingMode(Renderer::LightingMode::PathTraced);
+		renderer.Render(&scene);
+		renderer.Render(&scene);
+		EXPECT_EQ(2u, renderer.GetAccumulatedSamples());
+
+		scene.ScaleLight(0, 2.f);
+		renderer.Render(&scene);
+		EXPECT_EQ(1u, renderer.GetAccumulatedSamples());
+	}
+
+	// Acceleration structures
+	// Spread over a 10 x 10 x 10 box by irrational steps, some overlapping their neighbours
+	Sphere GetCrowdSphere(uint32_t index)
+	{
+		const auto fraction = [index](float step) { const float x{ index * step }; return x - std::floor(x); };
+		return { { 10.f * fraction(.618034f), 10.f * fraction(.414214f), 10.f * fraction(.732051f) }, .2f + .3f * fraction(.236068f) };
+	}
+
+	class Scene_Crowd final : public Scene
+	{
+	public:
+		void Initialize() override { AddSpheres(300); }
+
+		void AddSpheres(uint32_t count)
+		{
+			for (uint32_t i{}; i < count; ++i)
+			{
+				const Sphere sphere{ GetCrowdSphere(static_cast<uint32_t>(m_SphereGeometries.size())) };
+				m_SphereHandles.push_back(AddSphere(sphere.origin, sphere.radius));
+			}
+		}
+
+		void MoveSphere(uint32_t index, const Vector3& offset)
+		{
+			GetSphere(m_SphereHandles[index]).origin += offset;
+			MarkDirty(m_SphereHandles[index]);
+		}
+
+		// Like an animated scene's Update, every sphere changes and the tree is rebuilt
+		void MoveEverySphere(float angle)
+		{
+			for (Sphere& sphere : m_SphereGeometries)
+				sphere.origin = Vector3{ 5.f, 5.f, 5.f } + Matrix::CreateRotationY(angle).TransformVector(sphere.origin - Vector3{ 5.f, 5.f, 5.f });
+			MarkDirty(SceneComponent::Spheres);
+		}
+
+	private:
+		std::vector<SphereHandle> m_SphereHandles{};
+	};
+
+	// Rays from in front of the crowd, some through it and some past it
+	template<typename Function>
+	void ForEachCrowdRay(Function function)
+	{
+		for (int y{ -8 }; y <= 8; ++y)
+		{
+			for (int x{ -8 }; x <= 8; ++x)
+				function(Ray{ { 5.f, 5.f, -5.f }, Vector3{ x * .06f, y * .06f, 1.f }.Normalized() });
+		}
+	}
+
+	// Every sphere in exactly one leaf of at most maxLeafSize, every child inside its slot's bounds. Returns the depth of the tree
+	uint32_t ExpectValidTree(const WideBVH& bvh, uint32_t numPrimitives)
+	{
+		std::vector<int> leafCounts(numPrimitives);
+		for (const WideBVH::Leaf& range : bvh.GetLeaves())
+		{
+			EXPECT_LE(range.count, WideBVH::maxLeafSize);
+			for (uint32_t lane{}; lane < range.count; ++lane)
+				++leafCounts[bvh.GetPrimitiveIndices()[range.first + lane]];
+		}
+		EXPECT_TRUE(std::all_of(leafCounts.begin(), leafCounts.end(), [](int count) { return count == 1; }));
+
+		// Children come after their parents, so depths are known by the time a node is visited
+		const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+		std::vector<uint32_t> depths(nodes.size(), 1);
+		uint32_t depth{};
+		for (size_t nodeIndex{}; nodeIndex < nodes.size(); ++nodeIndex)
+		{
+			const BVHNode& node{ nodes[nodeIndex] };
+			depth = std::max(depth, depths[nodeIndex]);
+			for (uint32_t slot{}; slot < node.numChildren; ++slot)
+			{
+				if (node.children[slot] < 0)
+					continue;
+				EXPECT_GT(node.children[slot], static_cast<int32_t>(nodeIndex));
+				depths[node.children[slot]] = depths[nodeIndex] + 1;
+				const AABB child{ nodes[node.children[slot]].GetBounds() };
+				EXPECT_LE(node.minX[slot], child.min.x);
+				EXPECT_LE(node.minY[slot], child.min.y);
+				EXPECT_LE(node.minZ[slot], child.min.z);
+				EXPECT_GE(node.maxX[slot], child.max.x);
+				EXPECT_GE(node.maxY[slot], child.max.y);
+				EXPECT_GE(node.maxZ[slot], child.max.z);
+			}
+		}
+		return depth;
+	}
+
+	TEST(WideBVH, EveryInstructionSetMatchesTheLinearScan) {
+		std::vector<Sphere> spheres(500);
+		std::vector<AABB> bounds(spheres.size());
+		for (uint32_t i{}; i < spheres.size(); ++i)
+		{
+			spheres[i] = GetCrowdSphere(i);
+			bounds[i] = AABB::FromSphere(spheres[i]);
+		}
+
+		for (const BVHBuilder builder : { BVHBuilder::BinnedSAH, BVHBuilder::Linear })
+		{
+			SCOPED_TRACE(builder == BVHBuilder::Linear ? "Linear" : "BinnedSAH");
+			WideBVH bvh{};
+			bvh.Build(bounds, builder);
+			const std::vector<BVHNode>& nodes{ bvh.GetNodes() };
+			ASSERT_FALSE(nodes.empty());
+			ExpectValidTree(bvh, static_cast<uint32_t>(spheres.size()));
+
+			std::vector<SpherePacket<8>> packets(bvh.GetLeaves().size());
+			for (uint32_t leaf{}; leaf < packets.size(); ++leaf)
+			{
+				const WideBVH::Leaf& range{ bvh.GetLeaves()[leaf] };
+				for (uint32_t lane{}; lane < range.count; ++lane)
+					packets[leaf].Set(static_cast<int>(lane), spheres[bvh.GetPrimitiveIndices()[range.first + lane]]);
+			}
+
+			// Leaf i is packet i, so the tree reports the same lanes as scanning every packet
+			const KernelTable& scalar{ GetKernels(InstructionSet::Scalar) };
+			for (int index{}; index <= static_cast<int>(DetectInstructionSet()); ++index)
+			{
+				const KernelTable& kernels{ GetKernels(static_cast<InstructionSet>(index)) };
+				SCOPED_TRACE(ToString(kernels.instructionSet));
+
+				int numHits{};
+				ForEachCrowdRay([&](const Ray& ray)
+					{
+						float expectedT{ FLT_MAX }, t{ FLT_MAX };
+						const int expected{ scalar.intersectSpheres(packets.data(), static_cast<uint32_t>(packets.size()), ray, expectedT) };
+						EXPECT_EQ(expected, kernels.intersectSphereBVH(nodes.data(), packets.data(), ray, t));
+						EXPECT_NEAR(expectedT, t, 1e-4f);
+						EXPECT_EQ(expected >= 0, kernels.hitTestSphereBVH(nodes.data(), packets.data(), ray));
+						numHits += expected >= 0;
+					});
+				EXPECT_GT(numHits, 0);
+			}
+		}
+	}
+
+	TEST(WideBVH, DegenerateInputsKeepTheDepthBounded) {
+		// Boxes in one place give SAH nothing to bin and Morton codes nothing to split on,
+		// boxes at exponentially growing distances make SAH peel a few leaves off at a time, 31 levels deep without maxDepth
+		std::vector<AABB> samePlace(3000, AABB{ { 1.f, 2.f, 3.f }, { 2.f, 3.f, 4.f } });
+		std::vector<AABB> lopsided(8000);
+		for (uint32_t i{}; i < lopsided.size(); ++i)
+		{
+			const float x{ std::pow(1.01f, static_cast<float>(i)) };
+			lopsided[i] = { { x, 0.f, 0.f }, { x + .5f, .5f, .5f } };
+		}
+
+		for (const std::vector<AABB>* pBounds : { &samePlace, &lopsided })
+		{
+			for (const BVHBuilder builder : { BVHBuilder::BinnedSAH, BVHBuilder::Linear })
+			{
+				SCOPED_TRACE(builder == BVHBuilder::Linear ? "Linear" : "BinnedSAH");
+				WideBVH bvh{};
+				bvh.Build(*pBounds, builder);
+				EXPECT_LE(ExpectValidTree(bvh, static_cast<uint32_t>(pBounds->size())), WideBVH::maxDepth + 4);
+			}
+		}
+	}
+
+	// Closest sphere of every ray by testing all of them
+	void ExpectLinearScanHits(const Scene& scene)
+	{
+		const std::vector<Sphere>& spheres{ scene.GetSphereGeometries() };
+		ForEachCrowdRay([&](const Ray& ray)
+			{
+				float expectedT{ FLT_MAX };
+				uint32_t expected{ UINT32_MAX };
+				for (uint32_t i{}; i < spheres.size(); ++i)
+				{
+					float t{};
+					if (GeometryUtils::Intersect_Sphere(spheres[i], ray, t) && t < expectedT)
+					{
+						expectedT = t;
+						expected = i;
+					}
+				}
+
+				Intersection intersection{};
+				EXPECT_EQ(expected != UINT32_MAX, scene.GetClosestIntersection(ray, intersection));
+				EXPECT_EQ(expected, intersection.primitiveIndex);
+				EXPECT_NEAR(expectedT, intersection.t, 1e-4f);
+				EXPECT_EQ(expected != UINT32_MAX, scene.DoesHit(ray));
+			});
+	}
+
+	TEST(Scene, SphereTreeFollowsMovedAndAddedSpheres) {
+		Scene_Crowd scene{};
+		scene.Initialize();
+		ExpectLinearScanHits(scene);
+
+		// Moved spheres stay in their leaves, the tree is refit around them
+		for (uint32_t i{}; i < 300; i += 7)
+			scene.MoveSphere(i, { 1.f, -.5f, 2.f });
+		ExpectLinearScanHits(scene);
+
+		// Added spheres are scanned linearly until there are enough to rebuild, moving one of them leaves the tree alone
+		scene.AddSpheres(40);
+		scene.MoveSphere(310, { 0.f, 1.f, 0.f });
+		ExpectLinearScanHits(scene);
+		scene.AddSpheres(200);
+		ExpectLinearScanHits(scene);
+	}
+
+	TEST(Scene, SphereTreeFollowsEverySphereMovingEveryFrame) {
+		// The first rebuilds use the SAH builder, the following ones the linear one
+		Scene_Crowd scene{};
+		scene.Initialize();
+		for (int frame{}; frame < 4; ++frame)
+		{
+			scene.MoveEverySphere(.3f);
+			ExpectLinearScanHits(scene);
+		}
+
+		// Adding spheres goes back to the SAH builder
+		scene.AddSpheres(200);
+		ExpectLinearScanHits(scene);
+		scene.MoveEverySphere(.3f);
+		ExpectLinearScanHits(scene);
+	}
+
+	TEST(UniformGrid, ListsEveryPrimitiveInTheCellsItOverlaps) {
+		std::vector<AABB> even(2000), clustered(2000), mixedSizes(2000);
+		for (uint32_t i{}; i < even.size(); ++i)
+		{
+			even[i] = AABB::FromSphere(GetCrowdSphere(i));
+			clustered[i] = AABB::FromSphere({ GetCrowdSphere(i).origin * (i % 10 == 0 ? 1.f : .05f), .01f });
+			mixedSizes[i] = AABB::FromSphere({ GetCrowdSphere(i).origin, i % 100 == 0 ? 3.f : .2f });
+		}
+		EXPECT_TRUE(UniformGrid::IsUniform(even));
+		EXPECT_FALSE(UniformGrid::IsUniform(clustered));
+		EXPECT_FALSE(UniformGrid::IsUniform(mixedSizes));
+
+		// Every primitive is in at least one cell, in order within each cell
+		UniformGrid grid{};
+		grid.Build(even);
+		ASSERT_FALSE(grid.IsEmpty());
+		const std::vector<uint32_t>& starts{ grid.GetCellStarts() };
+		ASSERT_EQ(starts.size(), grid.GetNumCells() + 1);
+		std::vector<std::vector<uint32_t>> cellsOf(even.size());
+		for (uint32_t cell{}; cell < grid.GetNumCells(); ++cell)
+		{
+			EXPECT_TRUE(std::is_sorted(grid.GetPrimitiveIndices().begin() + starts[cell], grid.GetPrimitiveIndices().begin() + starts[cell + 1]));
+			for (uint32_t index{ starts[cell] }; index < starts[cell + 1]; ++index)
+				cellsOf[grid.GetPrimitiveIndices()[index]].push_back(cell);
+		}
+		EXPECT_TRUE(std::none_of(cellsOf.begin(), cellsOf.end(), [](const std::vector<uint32_t>& cells) { return cells.empty(); }));
+
+		// Walking the grid along a ray reaches the cells of every primitive the ray hits, before the distance it is hit at
+		ForEachCrowdRay([&](const Ray& ray)
+			{
+				std::vector<float> cellExits(grid.GetNumCells(), -1.f);
+				grid.ForEachCell(ray, [&](uint32_t cell, float exit)
+					{
+						EXPECT_LT(cellExits[cell], 0.f);
+						cellExits[cell] = exit;
+						return false;
+					});
+				for (uint32_t i{}; i < even.size(); ++i)
+				{
+					float t{};
+					if (!GeometryUtils::Intersect_Sphere(GetCrowdSphere(i), ray, t))
+						continue;
+					EXPECT_TRUE(std::any_of(cellsOf[i].begin(), cellsOf[i].end(), [&](uint32_t cell) { return cellExits[cell] >= t - 1e-4f; }));
+				}
+			});
+	}
+
+	TEST(Scene, SphereGridFollowsMovedAndAddedSpheres) {
+		// Enough evenly spread spheres of about one size that the scene walks a grid instead of a tree
+		Scene_Crowd scene{};
+		scene.AddSpheres(1500);
+		ExpectLinearScanHits(scene);
+
+		scene.MoveSphere(42, { 0.f, 0.f, -3.f });
+		ExpectLinearScanHits(scene);
+		scene.AddSpheres(100);
+		ExpectLinearScanHits(scene);
+		scene.AddSpheres(500);
+		ExpectLinearScanHits(scene);
+		scene.MoveEverySphere(.3f);
+		ExpectLinearScanHits(scene);
+	}
+
+	TEST(TileCuller, PrimaryRaysHitWhatTheSceneHits) {
+		// Few spheres between planes, and a crowd some of whose tiles see too many spheres to be culled
+		Scene_W3 walls{};
+		walls.Initialize();
+		Scene_Crowd crowd{};
+		crowd.AddSpheres(1500);
+		crowd.SetCamera(Camera{ { 5.f, 5.f, -5.f }, 45.f });
+
+		constexpr int width{ 100 }, height{ 70 };
+		for (Scene* pScene : { static_cast<Scene*>(&walls), static_cast<Scene*>(&crowd) })
+		{
+			Camera& camera{ pScene->GetCamera() };
+			const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+			TileCuller culler{};
+			culler.Update(*pScene, camera, cameraToWorld, width, height);
+
+			int numCulled{};
+			for (int py{}; py < height; ++py)
+			{
+				for (int px{}; px < width; ++px)
+				{
+					// As Renderer::GetViewDirection
+					const float fov{ std::tan(camera.fovAngle / 2) };
+					const Vector3 direction{ ((2 * (px + .5f) / width) - 1) * fov * width / static_cast<float>(height), (1 - (2 * (py + .5f) / height)) * fov, 1.f };
+					const Ray ray{ camera.origin, cameraToWorld.TransformVector(direction).Normalized() };
+
+					HitRecord expected{}, hit{};
+					pScene->GetClosestHit(ray, expected);
+					culler.GetClosestHit(*pScene, ray, px, py, hit);
+					ASSERT_EQ(expected.didHit, hit.didHit);
+					EXPECT_NEAR(expected.t, hit.t, 1e-4f);
+					EXPECT_EQ(expected.materialIndex, hit.materialIndex);
+					EXPECT_NEAR(expected.normal.z, hit.normal.z, 1e-4f);
+					numCulled += culler.IsCulled(px, py);
+				}
+			}
+			EXPECT_GT(numCulled, 0);
+			if (pScene == &crowd)
+				EXPECT_LT(numCulled, width * height);
+		}
+	}
+
+	// Rasterized primary visibility
+	TEST(Rasterizer, RasterizedImageMatchesTheTracedOne) {
+		// Planes behind a few spheres, and a crowd whose spheres overlap on screen
+		Scene_W3 walls{};
+		walls.Initialize();
+		Scene_Crowd crowd{};
+		crowd.AddSpheres(1500);
+		crowd.SetCamera(Camera{ { 5.f, 5.f, -5.f }, 45.f });
+
+		constexpr int width{ 100 }, height{ 70 };
+		Renderer traced{ width, height };
+		Renderer rasterized{ width, height };
+		rasterized.SetRenderMode(Renderer::RenderMode::Rasterized);
+		traced.SetReflectionsEnabled(true);
+		rasterized.SetReflectionsEnabled(true);
+		for (Scene* pScene : { static_cast<Scene*>(&walls), static_cast<Scene*>(&crowd) })
+		{
+			traced.Render(pScene);
+			rasterized.Render(pScene);
+			EXPECT_EQ(0, std::memcmp(traced.GetBuffer()->pixels, rasterized.GetBuffer()->pixels, width * height * sizeof(uint32_t)));
+
+			// Every pixel's primitive is the one its camera ray hits first
+			Camera& camera{ pScene->GetCamera() };
+			const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+			Rasterizer rasterizer{};
+			rasterizer.Update(*pScene, traced, camera, cameraToWorld, width, height);
+			int numHits{};
+			for (int py{}; py < height; ++py)
+			{
+				for (int px{}; px < width; ++px)
+				{
+					// As Renderer::GetViewDirection
+					const float fov{ std::tan(camera.fovAngle / 2) };
+					const Vector3 direction{ ((2 * (px + .5f) / width) - 1) * fov * width / static_cast<float>(height), (1 - (2 * (py + .5f) / height)) * fov, 1.f };
+					const Ray ray{ camera.origin, cameraToWorld.TransformVector(direction).Normalized() };
+
+					HitRecord expected{};
+					pScene->GetClosestHit(ray, expected);
+					ASSERT_EQ(expected.didHit, rasterizer.GetPrimitive(px, py) != Rasterizer::noPrimitive);
+					if (!expected.didHit)
+						continue;
+					EXPECT_NEAR(expected.t, rasterizer.GetDepth(px, py), 1e-4f * expected.t);
+					++numHits;
+				}
+			}
+			EXPECT_GT(numHits, 0);
+
+			// A small step of the camera rasterizes again
+			camera.origin.x += .05f;
+			traced.Render(pScene);
+			rasterized.Render(pScene);
+			EXPECT_EQ(0, std::memcmp(traced.GetBuffer()->pixels, rasterized.GetBuffer()->pixels, width * height * sizeof(uint32_t)));
+		}
+	}
+
+	TEST(Rasterizer, EveryInstructionSetRasterizesLikeItTraces) {
+		// Crowd spheres as a scan over packets and as a tree, seen by the camera rays of an image whose rows leave a tail after sixteen lanes
+		std::vector<Sphere> spheres(500);
+		std::vector<AABB> bounds(spheres.size());
+		for (uint32_t i{}; i < spheres.size(); ++i)
+		{
+			spheres[i] = GetCrowdSphere(i);
+			bounds[i] = AABB::FromSphere(spheres[i]);
+		}
+		std::vector<SpherePacket<8>> packets((spheres.size() + 7) / 8);
+		for (uint32_t i{}; i < spheres.size(); ++i)
+			packets[i / 8].Set(i % 8, spheres[i]);
+
+		WideBVH bvh{};
+		bvh.Build(bounds, BVHBuilder::BinnedSAH);
+		std::vector<SpherePacket<8>> leafPackets(bvh.GetLeaves().size());
+		for (uint32_t leaf{}; leaf < leafPackets.size(); ++leaf)
+		{
+			const WideBVH::Leaf& range{ bvh.GetLeaves()[leaf] };
+			for (uint32_t lane{}; lane < range.count; ++lane)
+				leafPackets[leaf].Set(static_cast<int>(lane), spheres[bvh.GetPrimitiveIndices()[range.first + lane]]);
+		}
+
+		constexpr int width{ 100 }, height{ 70 };
+		const Vector3 origin{ 5.f, 5.f, -5.f };
+		std::vector<float> directions[3]{};
+		for (int py{}; py < height; ++py)
+		{
+			for (int px{}; px < width; ++px)
+			{
+				const Vector3 direction{ Vector3{ (px - width / 2) * .008f, (height / 2 - py) * .008f, 1.f }.Normalized() };
+				for (int axis{}; axis < 3; ++axis)
+					directions[axis].push_back(direction[axis]);
+			}
+		}
+
+		// The AVX-512 table is used where the CPU has it whatever DAE_ISA says, its sixteen lanes round differently from the narrower kernels
+		for (int index{}; index <= static_cast<int>(DetectInstructionSet()); ++index)
+		{
+			const KernelTable& kernels{ GetKernels(static_cast<InstructionSet>(index)) };
+			SCOPED_TRACE(ToString(kernels.instructionSet));
+
+			std::vector<float> depths(width * height, FLT_MAX);
+			std::vector<uint32_t> primitives(width * height, UINT32_MAX);
+			for (uint32_t sphere{}; sphere < spheres.size(); ++sphere)
+			{
+				for (int py{}; py < height; ++py)
+				{
+					const size_t first{ static_cast<size_t>(py) * width };
+					const VisibilitySpan span{ origin, Ray{}.min, { directions[0].data() + first, directions[1].data() + first, directions[2].data() + first },
+						depths.data() + first, primitives.data() + first, width };
+					kernels.rasterizeSphere(spheres[sphere], sphere, span);
+				}
+			}
+
+			int numHits{};
+			for (size_t pixel{}; pixel < depths.size(); ++pixel)
+			{
+				const Ray ray{ origin, { directions[0][pixel], directions[1][pixel], directions[2][pixel] } };
+				float scanT{ FLT_MAX }, treeT{ FLT_MAX };
+				const int scanHit{ kernels.intersectSpheres(packets.data(), static_cast<uint32_t>(packets.size()), ray, scanT) };
+				const int treeSlot{ kernels.intersectSphereBVH(bvh.GetNodes().data(), leafPackets.data(), ray, treeT) };
+				ASSERT_EQ(scanHit >= 0 ? static_cast<uint32_t>(scanHit) : UINT32_MAX, primitives[pixel]);
+				if (scanHit < 0)
+					continue;
+
+				// Bit for bit the same distance, so both render modes shade the exact same point
+				const WideBVH::Leaf& leaf{ bvh.GetLeaves()[treeSlot / 8] };
+				EXPECT_EQ(primitives[pixel], bvh.GetPrimitiveIndices()[leaf.first + treeSlot % 8]);
+				EXPECT_EQ(scanT, depths[pixel]);
+				EXPECT_EQ(treeT, depths[pixel]);
+				++numHits;
+			}
+			EXPECT_GT(numHits, width * height / 10);
+		}
+	}
+
+	// The crowd standing on a floor, in the sun and under a point light
+	class Scene_Sunlit final : public Scene
+	{
+	public:
+		void Initialize() override
+		{
+			m_Camera = Camera{ { 5.f, 6.f, -9.f }, 1.f };
+			for (uint32_t i{}; i < 300; ++i)
+			{
+				const Sphere sphere{ GetCrowdSphere(i) };
+				m_SphereHandles.push_back(AddSphere(sphere.origin, sphere.radius));
+			}
+			AddPlane({ 0.f, -.5f, 0.f }, Vector3::UnitY);
+			AddDirectionalLight({ .4f, 1.f, -.3f }, 2.f, colors::White);
+			AddPointLight({ 5.f, 15.f, -5.f }, 200.f, colors::White);
+		}
+
+		void PlaceSphere(uint32_t index, const Vector3& origin)
+		{
+			GetSphere(m_SphereHandles[index]).origin = origin;
+			MarkDirty(m_SphereHandles[index]);
+		}
+
+	private:
+		std::vector<SphereHandle> m_SphereHandles{};
+	};
+
+	TEST(ShadowMaps, OcclusionMatchesTracedShadowRays) {
+		Scene_Sunlit scene{};
+		scene.Initialize();
+		ShadowMaps shadowMaps{};
+		shadowMaps.Update(scene);
+		ASSERT_TRUE(shadowMaps.HasMap(0));
+		EXPECT_FALSE(shadowMaps.HasMap(1));
+
+		// Points on the floor and on the spheres, as shadow rays start from them. The maps only miss at shadow edges
+		const Vector3 toSun{ scene.GetLights()[0].direction.Normalized() };
+		int numPoints{}, numShadowed{}, numMismatches{};
+		const auto testPoint = [&](const Vector3& point, const Vector3& normal)
+			{
+				Ray ray{ point + normal * .01f, toSun };
+				ray.min = .0001f;
+				const float occlusion{ shadowMaps.GetOcclusion(0, ray.origin, normal) };
+				EXPECT_GE(occlusion, 0.f);
+				EXPECT_LE(occlusion, 1.f);
+
+				const bool isShadowed{ scene.DoesHit(ray) };
+				++numPoints;
+				numShadowed += isShadowed;
+				numMismatches += isShadowed != (occlusion > .5f);
+			};
+		for (float z{ -2.f }; z <= 12.f; z += .1f)
+		{
+			for (float x{ -2.f }; x <= 12.f; x += .1f)
+				testPoint({ x, -.5f, z }, Vector3::UnitY);
+		}
+		for (const Sphere& sphere : scene.GetSphereGeometries())
+		{
+			for (int i{}; i < 16; ++i)
+			{
+				const Vector3 normal{ Vector3{ std::cos(i * 2.4f), (i - 7.5f) / 8.f, std::sin(i * 2.4f) }.Normalized() };
+				testPoint(sphere.origin + normal * sphere.radius, normal);
+			}
+		}
+		EXPECT_GT(numShadowed, numPoints / 10);
+		EXPECT_LT(numMismatches, numPoints / 50);
+
+		// Moving a sphere renders the maps again
+		const float before{ shadowMaps.GetOcclusion(0, { 20.f, -.49f, 20.f }, Vector3::UnitY) };
+		scene.PlaceSphere(0, Vector3{ 20.f, -.49f, 20.f } + toSun * 3.f);
+		shadowMaps.Update(scene);
+		EXPECT_EQ(0.f, before);
+		EXPECT_EQ(1.f, shadowMaps.GetOcclusion(0, { 20.f, -.49f, 20.f }, Vector3::UnitY));
+	}
+
+	TEST(ShadowMaps, EveryClassicModeShadesWithTheMaps) {
+		Scene_Sunlit scene{};
+		scene.Initialize();
+
+		constexpr int width{ 100 }, height{ 70 };
+		Renderer traced{ width, height };
+		traced.Render(&scene);
+		std::vector<uint32_t> tracedPixels(static_cast<uint32_t*>(traced.GetBuffer()->pixels), static_cast<uint32_t*>(traced.GetBuffer()->pixels) + width * height);
+
+		// The same image from every mode, close to the traced one
+		std::vector<uint32_t> expectedPixels{};
+		for (const Renderer::RenderMode renderMode : { Renderer::RenderMode::PerPixel, Renderer::RenderMode::Wavefront, Renderer::RenderMode::Rasterized })
+		{
+			Renderer renderer{ width, height };
+			renderer.SetRenderMode(renderMode);
+			renderer.SetShadowMapsEnabled(true);
+			renderer.Render(&scene);
+			const uint32_t* pPixels{ static_cast<uint32_t*>(renderer.GetBuffer()->pixels) };
+			if (expectedPixels.empty())
+				expectedPixels.assign(pPixels, pPixels + width * height);
+			EXPECT_EQ(0, std::memcmp(expectedPixels.data(), pPixels, width * height * sizeof(uint32_t)));
+		}
+		int numDifferent{};
+		for (size_t pixel{}; pixel < tracedPixels.size(); ++pixel)
+			numDifferent += tracedPixels[pixel] != expectedPixels[pixel];
+		EXPECT_GT(numDifferent, 0);
+		EXPECT_LT(numDifferent, width * height / 20);
+	}
+
+	TEST(LightVisibilityCache, CellsAnswerOnceTheirRaysAgree) {
+		Scene_W3 scene{};
+		scene.Initialize();
+		LightVisibilityCache cache{};
+		cache.Update(scene);
+
+		const Vector3 point{ 1.01f, 0.01f, 2.01f };
+		const uint64_t key{ cache.GetKey(point, Vector3::UnitY, 0) };
+		EXPECT_EQ(key, cache.GetKey(point + Vector3{ .02f, .02f, .02f }, Vector3{ .1f, .99f, 0.f }.Normalized(), 0));
+		EXPECT_NE(key, cache.GetKey(point + Vector3{ cache.GetCellSize(), 0.f, 0.f }, Vector3::UnitY, 0));
+		EXPECT_NE(key, cache.GetKey(point, Vector3::UnitX, 0));
+		EXPECT_NE(key, cache.GetKey(point, Vector3::UnitY, 1));
+
+		for (uint32_t i{}; i < LightVisibilityCache::confirmations; ++i)
+		{
+			EXPECT_EQ(LightVisibilityCache::Visibility::Unknown, cache.Find(key));
+			cache.Record(key, true);
+		}
+		EXPECT_EQ(LightVisibilityCache::Visibility::Blocked, cache.Find(key));
+
+		// A cell on a shadow edge keeps tracing
+		const uint64_t edgeKey{ cache.GetKey(point, Vector3::UnitY, 1) };
+		cache.Record(edgeKey, false);
+		for (uint32_t i{}; i < 2 * LightVisibilityCache::confirmations; ++i)
+			cache.Record(edgeKey, true);
+		EXPECT_EQ(LightVisibilityCache::Visibility::Unknown, cache.Find(edgeKey));
+
+		// Moving the camera keeps what was traced, changing the scene forgets it
+		scene.GetCamera().origin.x += 1.f;
+		scene.MarkDirty(SceneComponent::Camera);
+		cache.Update(scene);
+		EXPECT_EQ(LightVisibilityCache::Visibility::Blocked, cache.Find(key));
+		scene.MarkDirty(SceneComponent::Lights);
+		cache.Update(scene);
+		EXPECT_EQ(LightVisibilityCache::Visibility::Unknown, cache.Find(key));
+
+		// So does a new cell size
+		for (uint32_t i{}; i < LightVisibilityCache::confirmations; ++i)
+			cache.Record(key, true);
+		cache.SetCellSize(.05f);
+		cache.Update(scene);
+		EXPECT_EQ(LightVisibilityCache::Visibility::Unknown, cache.Find(key));
+		EXPECT_NE(key, cache.GetKey(point, Vector3::UnitY, 0));
+	}
+
+	struct CachedShadowRays
+	{
+		int numLookups{};
+		int numFound{};
+		int numWrong{};
+	};
+
+	// The camera's first hits of frames a small step apart, every light looked up before tracing towards it. Counts the last frame
+	CachedShadowRays LookUpCameraHits(Scene& scene, LightVisibilityCache& cache, int width, int height, int numFrames)
+	{
+		CachedShadowRays counts{};
+		for (int frame{}; frame < numFrames; ++frame)
+		{
+			Camera& camera{ scene.GetCamera() };
+			camera.origin.x += frame * .05f;
+			scene.MarkDirty(SceneComponent::Camera);
+			cache.Update(scene);
+			const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+			const float fov{ std::tan(camera.fovAngle / 2) };
+			for (int py{}; py < height; ++py)
+			{
+				for (int px{}; px < width; ++px)
+				{
+					const Vector3 direction{ ((2 * (px + .5f) / width) - 1) * fov * width / static_cast<float>(height), (1 - (2 * (py + .5f) / height)) * fov, 1.f };
+					HitRecord hitRecord{};
+					scene.GetClosestHit({ camera.origin, cameraToWorld.TransformVector(direction).Normalized() }, hitRecord);
+					if (!hitRecord.didHit)
+						continue;
+
+					hitRecord.normal.Normalize();
+					for (uint32_t lightIndex{}; lightIndex < scene.GetLights().size(); ++lightIndex)
+					{
+						Ray lightRay{ hitRecord.origin + hitRecord.normal * .01f };
+						lightRay.direction = LightUtils::GetDirectionToLight(scene.GetLights()[lightIndex], lightRay.origin);
+						lightRay.max = lightRay.direction.Normalize();
+						lightRay.min = .0001f;
+
+						const uint64_t key{ cache.GetKey(lightRay.origin, hitRecord.normal, lightIndex) };
+						const LightVisibilityCache::Visibility visibility{ cache.Find(key) };
+						const bool isBlocked{ scene.DoesHit(lightRay) };
+						if (visibility == LightVisibilityCache::Visibility::Unknown)
+							cache.Record(key, isBlocked);
+
+						if (frame < numFrames - 1)
+							continue;
+						++counts.numLookups;
+						counts.numFound += visibility != LightVisibilityCache::Visibility::Unknown;
+						counts.numWrong += visibility == (isBlocked ? LightVisibilityCache::Visibility::Visible : LightVisibilityCache::Visibility::Blocked);
+					}
+				}
+			}
+		}
+		return counts;
+	}
+
+	TEST(LightVisibilityCache, NavigatingAStaticSceneMostlyReusesShadowRays) {
+		Scene_W3 scene{};
+		scene.Initialize();
+		LightVisibilityCache cache{};
+		cache.Update(scene);
+
+		constexpr int width{ 320 }, height{ 240 }, numFrames{ 3 };
+		const CachedShadowRays counts{ LookUpCameraHits(scene, cache, width, height, numFrames) };
+		EXPECT_GT(counts.numFound, counts.numLookups / 2);
+		EXPECT_LT(counts.numWrong, counts.numLookups / 200);
+
+		// Rendered frames stay close to the traced ones
+		Renderer traced{ width, height };
+		Renderer cached{ width, height };
+		cached.SetLightCacheEnabled(true);
+		for (int frame{}; frame < numFrames; ++frame)
+		{
+			scene.GetCamera().origin.x += .05f;
+			scene.MarkDirty(SceneComponent::Camera);
+			traced.Render(&scene);
+			cached.Render(&scene);
+
+			const uint32_t* pTraced{ static_cast<uint32_t*>(traced.GetBuffer()->pixels) };
+			const uint32_t* pCached{ static_cast<uint32_t*>(cached.GetBuffer()->pixels) };
+			int numDifferent{};
+			for (int pixel{}; pixel < width * height; ++pixel)
+				numDifferent += pTraced[pixel] != pCached[pixel];
+			EXPECT_LT(numDifferent, width * height / 100);
+		}
+	}
+
+	TEST(LightVisibilityCache, SmallerCellsGetFewerShadowsWrong) {
+		// Wrong answers come from cells a shadow edge runs through unseen, so they shrink with the cells
+		int previousWrong{ INT_MAX };
+		for (const float cellSize : { .4f, .2f, .1f, .05f })
+		{
+			SCOPED_TRACE(cellSize);
+			Scene_W3 scene{};
+			scene.Initialize();
+			LightVisibilityCache cache{};
+			cache.SetCellSize(cellSize);
+			cache.Update(scene);
+
+			const CachedShadowRays counts{ LookUpCameraHits(scene, cache, 320, 240, 3) };
+			EXPECT_LT(counts.numWrong, previousWrong);
+			EXPECT_LT(counts.numWrong, counts.numLookups * cellSize / 20.f);
+			previousWrong = counts.numWrong;
+		}
+	}
 
 	int main(int argc, char** argv) {
 		::testing::InitGoogleTest(&argc, argv);